@@ -56,6 +56,7 @@
 
 @property (nonatomic) TopoMap *topoMap;
 @property (nonatomic) NavMachine* currentMachine;
+@property (atomic, readonly) NavLocation *currentLocation; // nil until located and after reset
 @property (atomic, readonly) NSValue *locationUpdated;
 @property (atomic, readonly) NSValue *orientationUpdated;
 @property (atomic, readonly) NavLocation *debugCurrentLocation;
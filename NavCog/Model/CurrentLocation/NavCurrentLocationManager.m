@@ -30,14 +30,16 @@
 #import "NavLocalizerFactory.h"
 #import "NavEdgeLocalizer.h"
 #import "NavLocalizeResult.h"
+#import "NavGlobalFingerprintIndex.h"
+#import "NavLocalizationExecutor.h"
 
 #define clipAngle(angle) [NavUtil clipAngle:(angle)]
 #define clipAngle2(angle) [NavUtil clipAngle2:(angle)]
 #define MIN_KNNDIST_THRESHOLD 1.0
+#define GLOBAL_CANDIDATE_NUM 8
 
 @interface NavCurrentLocationManager ()
 
-@property (atomic, readonly) NavLocation *currentLocation;
 @property (atomic, readonly) NavEdge* currentEdge;
 @property (atomic, readonly) NavNode* currentNode;
 @property (strong, nonatomic) CLLocationManager *beaconManager;
@@ -51,6 +53,9 @@
 @property (nonatomic) float gyroDrift;
 
 @property BOOL locationSearching;
+@property (nonatomic) NavBeaconScan *lastScan;
+@property (nonatomic) int scanNum;
+@property (nonatomic) double scanFanOutTime;
 
 @end
 
@@ -93,10 +98,13 @@ static const float GyroDriftLimit = 3;
 
 - (void) reset
 {
-    _locationSearching = NO;
-    _currentLocation = nil;
-    _currentEdge = nil;
-    _currentNode = nil;
+    [[NavLocalizationExecutor sharedInstance] performSync:^{
+        _lastScan = nil;
+        _locationSearching = NO;
+        _currentLocation = nil;
+        _currentEdge = nil;
+        _currentNode = nil;
+    }];
     _currentOrientation = 0;
 }
 
@@ -180,10 +188,33 @@ static const float GyroDriftLimit = 3;
 - (void) receivedBeaconsArray:(NSArray *) beacons
 {
     [NavLog logBeacons:beacons];
+    // converted once, every localizer reads the same frame
+    NavBeaconScan *scan = [[NavBeaconScan alloc] initWithBeacons:beacons];
+    [[NavLocalizationExecutor sharedInstance] performAsync:^{
+        [self localizeWithBeaconScan:scan];
+    }];
+}
+
+// runs on the localization queue, only the result is published on the main thread
+- (void) localizeWithBeaconScan:(NavBeaconScan *) scan
+{
+    NSDate *start = [NSDate date];
+    _lastScan = scan;
+    NSMutableArray *receivers = [@[] mutableCopy];
     for(NavLocalizer *localizer in [NavLocalizerFactory allCoreLocalizers]) {
-        [localizer inputBeacons:beacons];
+        if (localizer.prepared) {
+            [localizer beginInputEpoch];
+            [receivers addObject:localizer];
+        }
+    }
+    [receivers addObject:[NavLocalizerFactory globalFingerprintIndex]];
+    [[NavLocalizationExecutor sharedInstance] inputBeaconScan:scan toReceivers:receivers];
+    _scanFanOutTime += [[NSDate date] timeIntervalSinceDate:start];
+    if (++_scanNum == 100) {
+        NSLog(@"ScanFanOut,%d,%f", _scanNum, _scanFanOutTime * 1000 / _scanNum);
+        _scanNum = 0;
+        _scanFanOutTime = 0;
     }
-
     NavLocation *location = [[NavLocation alloc] initWithMap:_topoMap];
     if (_currentLocation == nil) {
         NSLog(@"No Current Location, searching.");
@@ -212,12 +243,15 @@ static const float GyroDriftLimit = 3;
     }
     [self updateCurrentLocation:location];
     
-    [self setLocationUpdated:@(YES)];
-    
-    // trigger debugCurrentLocation
-    if (_currentLocation) {
-        [self setDebugCurrentLocation:_currentLocation];
-    }
+    NavLocation *currentLocation = _currentLocation;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self setLocationUpdated:@(YES)];
+        
+        // trigger debugCurrentLocation
+        if (currentLocation) {
+            [self setDebugCurrentLocation:currentLocation];
+        }
+    });
 }
 
 - (void)updateCurrentLocation:(NavLocation *)location {
@@ -236,35 +270,88 @@ static const float GyroDriftLimit = 3;
 
 - (void) initLocalizaion
 {
-    for(NavLocalizer* nl in [NavLocalizerFactory allCoreLocalizers]) {
-        [nl initializeState:@{@"allreset":@(true)}];
+    [[NavLocalizationExecutor sharedInstance] performSync:^{
+        for(NavLocalizer* nl in [NavLocalizerFactory allCoreLocalizers]) {
+            [nl beginInputEpoch];
+            [nl initializeState:@{@"allreset":@(true)}];
+        }
+        [[NavLocalizerFactory globalFingerprintIndex] initializeState];
+    }];
+}
+
+// localizers are built the first time an edge is looked at and catch up
+// with the latest scan, after that they are fed with every scan
+- (void)prepareLocalizer:(NavLocalizer *)localizer
+{
+    if (localizer && !localizer.prepared) {
+        [localizer prepare];
+        if (_lastScan) {
+            [localizer inputBeaconScan:_lastScan];
+        }
     }
 }
 
 - (void)initLocalizationOnEdge:(NSString *)edgeID withOptions:(NSDictionary *)options
 {
-    NavEdgeLocalizer *nel = [NavLocalizerFactory localizerForEdge:edgeID];
-    
-    [nel initializeState:options];
+    [[NavLocalizationExecutor sharedInstance] performSync:^{
+        NavEdgeLocalizer *nel = [NavLocalizerFactory localizerForEdge:edgeID];
+        [self prepareLocalizer:nel];
+        
+        [nel initializeState:options];
+    }];
 }
 
 - (NavLocation *)getCurrentLocationWithInit: (BOOL) init {
-    if (init) {
-        [self initLocalizaion];
-    }
-    
-    NavLocation *r = [self getLocation:[NavLocalizerFactory allEdgeLocalizers] withKNNThreshold:1.0 withInit:NO];
+    __block NavLocation *r;
+    [[NavLocalizationExecutor sharedInstance] performSync:^{
+        if (init) {
+            [self initLocalizaion];
+        }
+        
+        r = [self getLocation:[self candidateEdgeLocalizers] withKNNThreshold:1.0 withInit:NO];
+    }];
     NSLog(@"current location(init=%d) %f %f %f ", init, r.xInEdge, r.yInEdge, r.knndist);
     return r;
 }
 
+// 1D_Beacon edges are ranked by the global fingerprint index with the same
+// normalized distance used in getLocation:withKNNThreshold:withInit:, only the
+// best of them are evaluated. Edges of other localizers are always evaluated.
+- (NSArray *)candidateEdgeLocalizers
+{
+    NavGlobalFingerprintIndex *index = [NavLocalizerFactory globalFingerprintIndex];
+    NSMutableArray *candidates = [@[] mutableCopy];
+    NSMutableArray *ranked = [@[] mutableCopy];
+    for (NavEdgeLocalizer *nel in [NavLocalizerFactory allEdgeLocalizers]) {
+        double knndist = [index knnDistanceForLocalizerID:nel.parent.idStr];
+        NavEdge *edge = [_topoMap getEdgeById:nel.edgeInfo.edgeID];
+        if (knndist < 0 || edge == nil) {
+            [candidates addObject:nel];
+            continue;
+        }
+        float dist = (knndist - edge.minKnnDist) / (edge.maxKnnDist - edge.minKnnDist);
+        [ranked addObject:@[@(dist), nel]];
+    }
+    [ranked sortUsingComparator:^NSComparisonResult(NSArray *a, NSArray *b) {
+        return [a[0] compare:b[0]];
+    }];
+    for (NSUInteger i = 0; i < MIN(ranked.count, GLOBAL_CANDIDATE_NUM); i++) {
+        [candidates addObject:ranked[i][1]];
+    }
+    return candidates;
+}
+
 - (NavLocation *)getLocationOnEdge:(NSString*) edgeID
 {
-    NavEdgeLocalizer *nel = [NavLocalizerFactory localizerForEdge:edgeID];
+    __block NavLocalizeResult *pos;
+    [[NavLocalizationExecutor sharedInstance] performSync:^{
+        NavEdgeLocalizer *nel = [NavLocalizerFactory localizerForEdge:edgeID];
+        [self prepareLocalizer:nel];
+        pos = [nel getLocation];
+    }];
     
     NavLocation *location = [[NavLocation alloc] initWithMap:_topoMap];
     NavEdge *edge = [_topoMap getEdgeById:edgeID];
-    NavLocalizeResult *pos = [nel getLocation];
     
     location.layerID = edge.parentLayer.zIndex;
     location.edgeID = edge.edgeID;
@@ -286,7 +373,11 @@ static const float GyroDriftLimit = 3;
         [ids addObject:edge.edgeID];
     }
     
-    return [self getLocation:[NavLocalizerFactory localizersForEdges:ids] withKNNThreshold:minKnnDist withInit:init];
+    __block NavLocation *location;
+    [[NavLocalizationExecutor sharedInstance] performSync:^{
+        location = [self getLocation:[NavLocalizerFactory localizersForEdges:ids] withKNNThreshold:minKnnDist withInit:init];
+    }];
+    return location;
 }
 
 - (NavLocation *)getLocation:(NSArray *)localizers withKNNThreshold:(float)minKnnDist withInit:(BOOL) init
@@ -299,6 +390,7 @@ static const float GyroDriftLimit = 3;
         if (edge == nil) {
             continue;
         }
+        [self prepareLocalizer:nel];
         if (init) {
             [nel initializeState:nil];
         }
@@ -343,7 +435,9 @@ static const float GyroDriftLimit = 3;
         [data addObject:[NSNumber numberWithFloat:lastKnnDist]];
         [NavLog logArray:data withType:@"FoundCurrentLocation"];
     }
-    [self setDebugCurrentLocation2: location];
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [self setDebugCurrentLocation2: location];
+    });
     return location;
 }
 
@@ -357,8 +451,10 @@ static const float GyroDriftLimit = 3;
         } else {
             edgeID = [[[_currentMachine getCurrentState] targetEdge] edgeID];
         }
-        NavEdgeLocalizer *nel = [NavLocalizerFactory localizerForEdge:edgeID];
-        [nel inputAcceleration:data];
+        [[NavLocalizationExecutor sharedInstance] performAsync:^{
+            NavEdgeLocalizer *nel = [NavLocalizerFactory localizerForEdge:edgeID];
+            [nel inputAcceleration:data];
+        }];
     }
 }
 
@@ -372,8 +468,10 @@ static const float GyroDriftLimit = 3;
         } else {
             edgeID = [[[_currentMachine getCurrentState] targetEdge] edgeID];
         }
-        NavEdgeLocalizer *nel = [NavLocalizerFactory localizerForEdge:edgeID];
-        [nel inputMotion:data];
+        [[NavLocalizationExecutor sharedInstance] performAsync:^{
+            NavEdgeLocalizer *nel = [NavLocalizerFactory localizerForEdge:edgeID];
+            [nel inputMotion:data];
+        }];
     }
     
     NSNumber* yaw = [data objectForKey:@"yaw"];    
@@ -427,8 +525,6 @@ static const float GyroDriftLimit = 3;
     }
 
     
-    NSArray *timesArray = logFile.timesArray;
-    NSArray *objectsArray = logFile.objectsArray;
     NSDate *startTime = logFile.startTime;
     
     _logReplay = true;
@@ -438,23 +534,23 @@ static const float GyroDriftLimit = 3;
     
     dispatch_queue_t queue = dispatch_queue_create("com.navcog.logsimulatorqueue", NULL);
     
-    unsigned long int arraySize = [timesArray count];
-    
     dispatch_async(queue, ^{
         
-        NSDate* time = startTime;
-        NSTimeInterval waitFix = 0; // Adjust waitTime according to last processing time
+        __block NSDate* time = startTime;
+        __block NSTimeInterval waitFix = 0; // Adjust waitTime according to last processing time
         
-        for (int i=0; i < arraySize; i++) {
+        // events are read from the file as the replay goes
+        [logFile enumerateEventsUsingBlock:^(NSDate *eventTime, id object, BOOL *stop) {
             if (!_logReplay) {
+                *stop = YES;
                 return;
             }
 
-            NSTimeInterval waitTime = MAX([timesArray[i] timeIntervalSinceDate:time] + waitFix, 0);
+            NSTimeInterval waitTime = MAX([eventTime timeIntervalSinceDate:time] + waitFix, 0);
             NSDate *startProcess = [NSDate date];
 
-            if ([objectsArray[i] isKindOfClass: [NSArray class]]) {
-                NSArray* beacons = objectsArray[i]; // = start processing time
+            if ([object isKindOfClass: [NSArray class]]) {
+                NSArray* beacons = object; // = start processing time
                 
                 //call beacons
                 [NSThread sleepForTimeInterval:waitTime*timeMultiplier];
@@ -462,8 +558,8 @@ static const float GyroDriftLimit = 3;
                     
                     [self receivedBeaconsArray: beacons];
                 });
-            } else if ([objectsArray[i] isKindOfClass: [NSMutableDictionary class]]) {
-                NSMutableDictionary* data = objectsArray[i];
+            } else if ([object isKindOfClass: [NSMutableDictionary class]]) {
+                NSMutableDictionary* data = object;
                 
                 //call motion
                 if ([data[@"type"] isEqualToString:@"acceleration"]) {
@@ -478,11 +574,14 @@ static const float GyroDriftLimit = 3;
                     });
                 }
             } else {
-                continue;
+                return;
             }
 
             waitFix = [startProcess timeIntervalSinceNow]; // = - (processing time)
-            time = timesArray[i];
+            time = eventTime;
+        }];
+        if (!_logReplay) {
+            return;
         }
         
         dispatch_sync(dispatch_get_main_queue(), ^{
@@ -528,7 +627,10 @@ static const float GyroDriftLimit = 3;
 
 - (NSString *)getLocalizerNameForEdge:(NSString *)edgeID
 {
-    NavEdgeLocalizer *nel = [NavLocalizerFactory localizerForEdge:edgeID];
+    __block NavEdgeLocalizer *nel;
+    [[NavLocalizationExecutor sharedInstance] performSync:^{
+        nel = [NavLocalizerFactory localizerForEdge:edgeID];
+    }];
     return NSStringFromClass([nel.parent class]);
 }
 
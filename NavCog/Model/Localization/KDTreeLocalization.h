@@ -27,6 +27,11 @@
 #import <Foundation/Foundation.h>
 #import "NavLocalizer.h"
 
+#ifdef __cplusplus
+#include <memory>
+class NavFingerprintData;
+#endif
+
 
 typedef struct NavPoint {
     float x;
@@ -38,6 +43,17 @@ typedef struct NavPoint {
 
 - (void)initializeWithFile:(NSString *)filename;
 - (void)initializeWithAbsolutePath:(NSString *)filePath;
+// converts a "MinorID of N Beacon Used" text file into the binary fingerprint format,
+// compact stores RSSI as int8 instead of float
++ (BOOL)convertFingerprintFile:(NSString *)textPath toBinaryFile:(NSString *)binaryPath compact:(BOOL)compact;
+
+#ifdef __cplusplus
+// fingerprint data can be shared with other localizers and indexes, see
+// NavLocalizerFactory, the kNN index is built on prepare
++ (std::shared_ptr<NavFingerprintData>)loadFingerprint:(NSString *)filePath;
++ (std::shared_ptr<NavFingerprintData>)loadFingerprintFromData:(NSData *)data;
+- (void)initializeWithFingerprint:(std::shared_ptr<NavFingerprintData>)fingerprint;
+#endif
 //- (void)initializeWithDataString:(NSString *)dataStr;
 
 @end
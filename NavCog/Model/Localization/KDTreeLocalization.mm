@@ -26,35 +26,26 @@
 
 #import "KDTreeLocalization.h"
 #import <opencv2/opencv.hpp>
-#import <unordered_map>
 #import <CoreLocation/CoreLocation.h>
 #import <algorithm>
+#import <memory>
+#import "NavFingerprintData.hpp"
+#import "NavKNNSearch.hpp"
+#import "NavFlannKNN.hpp"
+#import "NavFingerprintLocalizer.hpp"
 
-#define KNN_NUM 5
-#define TREE_NUM 5
-#define SMOOTHING_WEIGHT 0.6
-#define JUMPING_BOUND 3
+#define KNN_NUM NavFingerprintLocalizer::kKNNNum
 
 using namespace std;
 
 @interface KDTreeLocalization ()
 
-@property (nonatomic) vector<float> preFeatVec;
-@property (nonatomic) vector<float> featVec;
-@property (nonatomic) vector<int> indices;
-@property (nonatomic) vector<float> dists;
 @property (nonatomic) cv::Mat featMap;
-@property (nonatomic) cv::Mat posMap;
-@property (nonatomic) cv::flann::Index kdTree;
-@property (nonatomic) NavPoint currentLocation;
-@property (nonatomic) unordered_map<int, int> beaconIndexMap;
+@property (nonatomic) shared_ptr<NavFingerprintLocalizer> core;
+@property (nonatomic) shared_ptr<NavFingerprintData> fingerprint;
 @property (nonatomic) int sampleNum;
 @property (nonatomic) int beaconNum;
-@property (nonatomic) Boolean bStart;
-@property (nonatomic) struct NavPoint prePoint;
-@property (nonatomic) NSDate *preDate, *jumpDate;
 @property (nonatomic) NavLocalizeResult *result;
-@property (nonatomic) double timeMultiplier;
 
 @end
 
@@ -62,82 +53,125 @@ using namespace std;
 
 - (instancetype)init
 {
-    self = [super init];
-    if (self) {
-        for (int i = 0; i < _beaconNum; i++) {
-            _featVec[i] = -100;
-        }
-        for (int i = 0; i < _beaconNum; i++) {
-            _preFeatVec[i] = -100;
-        }
-        _bStart = false;
-    }
-    _timeMultiplier = 1;
-    NSDictionary* env = [[NSProcessInfo processInfo] environment];
-    if ([env valueForKey:@"simspeed"]) {
-        _timeMultiplier = 1.0/[[env valueForKey:@"simspeed"] doubleValue];
-    }
+    return [self initWithID:nil];
+}
+
+- (instancetype)initWithID:(NSString *)idStr
+{
+    self = [super initWithID:idStr];
     return self;
 }
 
 // when you restart navigation for another path
 // you need to clean the history knowledge
 - (void)initializeState:(NSDictionary *)options {
-    for (int i = 0; i < _beaconNum; i++) {
-        _featVec[i] = -100;
-    }
-    for (int i = 0; i < _beaconNum; i++) {
-        _preFeatVec[i] = -100;
+    if (_core) {
+        _core->reset();
     }
-    _bStart = false;
 }
 
 - (void)initializeWithFile:(NSString *)filename {
-    _bStart = false;
     NSArray *split = [filename componentsSeparatedByString:@"."];
     NSString *filePath = [[NSBundle mainBundle] pathForResource:(NSString *)split[0] ofType:(NSString *)split[1]];
     [self initializeWithAbsolutePath:filePath];
 }
 
 - (void)initializeWithAbsolutePath:(NSString *)filePath {
-    _sampleNum = [self getDataNumOfFeatureFile:[filePath UTF8String]];
-    
-    FILE *fp = fopen([filePath UTF8String], "r");
-    fscanf(fp, "MinorID of %d Beacon Used : ", &_beaconNum);
-    for (int i = 0; i < _beaconNum; i++) {
-        int beaconID;
-        fscanf(fp, "%d,", &beaconID);
-        _beaconIndexMap[beaconID] = i;
+    shared_ptr<NavFingerprintData> fingerprint = [KDTreeLocalization loadFingerprint:filePath];
+    if (!fingerprint) {
+        _sampleNum = _beaconNum = 0;
+        return;
     }
+    [self initializeWithFingerprint:fingerprint];
+    [self prepare];
+}
+
++ (shared_ptr<NavFingerprintData>)loadFingerprint:(NSString *)filePath
+{
+    NSDate *start = [NSDate date];
+    // text files are converted once into a binary cache in the temp directory,
+    // binary files (and cache hits) are mapped without parsing
+    shared_ptr<NavFingerprintData> fingerprint = make_shared<NavFingerprintData>();
+    if (!fingerprint->loadFileWithCache([filePath UTF8String], [NSTemporaryDirectory() UTF8String])) {
+        NSLog(@"Could not load fingerprint file %@", filePath);
+        return nullptr;
+    }
+    NSLog(@"FingerprintLoad,%d,%d,%@,%f", fingerprint->sampleNum(), fingerprint->beaconNum(),
+          fingerprint->isMapped() ? @"mapped" : @"parsed", [[NSDate date] timeIntervalSinceDate:start] * 1000);
+    return fingerprint;
+}
+
++ (shared_ptr<NavFingerprintData>)loadFingerprintFromData:(NSData *)data
+{
+    NSDate *start = [NSDate date];
+    shared_ptr<NavFingerprintData> fingerprint = make_shared<NavFingerprintData>();
+    if (!fingerprint->loadBytesWithCache((const char *)data.bytes, data.length, [NSTemporaryDirectory() UTF8String])) {
+        NSLog(@"Could not load fingerprint data");
+        return nullptr;
+    }
+    NSLog(@"FingerprintLoad,%d,%d,%@,%f", fingerprint->sampleNum(), fingerprint->beaconNum(),
+          fingerprint->isMapped() ? @"mapped" : @"parsed", [[NSDate date] timeIntervalSinceDate:start] * 1000);
+    return fingerprint;
+}
+
+// only keeps the data, the search structures are built by prepare
+- (void)initializeWithFingerprint:(shared_ptr<NavFingerprintData>)fingerprint {
+    _fingerprint = fingerprint;
+    _sampleNum = _fingerprint->sampleNum();
+    _beaconNum = _fingerprint->beaconNum();
+    _core.reset();
+}
+
+- (BOOL)prepared
+{
+    return _core != nullptr;
+}
+
+- (void)prepare
+{
+    if (_core || !_fingerprint) {
+        return;
+    }
+    NSDate *start = [NSDate date];
+    // wrap the loaded features without copying, _fingerprint owns the memory
+    _featMap = cv::Mat(_sampleNum, _beaconNum, CV_32F, (void *)_fingerprint->features());
     
-    _indices.resize(KNN_NUM);
-    _dists.resize(KNN_NUM);
-    _featVec.resize(_beaconNum);
-    _preFeatVec.resize(_beaconNum);
-    for (int i = 0; i < _beaconNum; i++) {
-        _preFeatVec[i] = -100;
+    shared_ptr<NavKNNSearch> searcher = [self createSearcher:[[NSUserDefaults standardUserDefaults] stringForKey:@"knn_backend_preference"]];
+    
+    _core = make_shared<NavFingerprintLocalizer>(_fingerprint, searcher);
+    _core->logHandler([](const char *line) {
+        NSLog(@"%s", line);
+    });
+    if (dynamic_pointer_cast<NavSparseKNN>(searcher)) {
+        // the inverted index holds everything needed for matching
+        _featMap.release();
+        _fingerprint.reset();
     }
-    _featMap.create(_sampleNum, _beaconNum, CV_32F);
-    _posMap.create(_sampleNum, 2, CV_32F);
-    for (int i = 0; i < _sampleNum; i++) {
-        float x, y;
-        int validBeaconNum;
-        fscanf(fp, "%f,%f,%d,", &x, &y, &validBeaconNum);
-        _posMap.at<float>(i,0) = x;
-        _posMap.at<float>(i,1) = y;
-        for (int j = 0; j < _beaconNum; j++) {
-            _featMap.at<float>(i, j) = -100.0;
-        }
-        for (int j = 0; j < validBeaconNum; j++) {
-            int majorID, minorID, rssi, indx;
-            fscanf(fp, "%d,%d,%d,", &majorID, &minorID, &rssi);
-            indx = _beaconIndexMap[minorID];
-            _featMap.at<float>(i, indx) = rssi;
+    NSLog(@"FingerprintBuild,%@,%d,%d,%s,%f", self.idStr, _sampleNum, _beaconNum, searcher->name(),
+          [[NSDate date] timeIntervalSinceDate:start] * 1000);
+}
+
+// backend is "kdtree", "bruteforce", "sparse" or nil/"auto" to choose by the shape of the data
+- (shared_ptr<NavKNNSearch>)createSearcher:(NSString *)backend
+{
+    const float *features = _fingerprint->features();
+    if (!backend || [backend isEqualToString:@"auto"]) {
+        if (NavSparseKNN::isPreferredFor(features, _sampleNum, _beaconNum, NAV_FINGERPRINT_NO_SIGNAL)) {
+            backend = @"sparse";
+        } else if (_sampleNum <= NavBruteForceKNN::kPreferredMaxRows) {
+            backend = @"bruteforce";
         }
     }
-    
-    _kdTree.build(_featMap, cv::flann::KDTreeIndexParams(TREE_NUM));
-    fclose(fp);
+    if ([backend isEqualToString:@"sparse"] || [backend isEqualToString:@"bruteforce"]) {
+        return NavFingerprintLocalizer::createSearcher(*_fingerprint, [backend UTF8String]);
+    }
+    return make_shared<NavFlannKNN>(_featMap, _beaconNum);
+}
+
++ (BOOL)convertFingerprintFile:(NSString *)textPath toBinaryFile:(NSString *)binaryPath compact:(BOOL)compact
+{
+    return NavFingerprintData::convertTextToBinary([textPath UTF8String], [binaryPath UTF8String],
+                                                   compact ? NavFingerprintFeatureInt8 : NavFingerprintFeatureFloat32);
 }
 
 /*
@@ -196,116 +230,24 @@ using namespace std;
 //- (NavLocalizeResult *)localizeWithBeacons:(NSArray *)beacons {
 - (void) inputBeacons:(NSArray *)beacons
 {
-    NSDate* now = [NSDate date];
-    if (_bStart && _preDate && [now timeIntervalSinceDate:_preDate] < 0.5*_timeMultiplier) {
-        // Return last position after 0.5 sec
-        NavLocalizeResult *result;
-        //struct NavPoint result;
-        result.knndist = _prePoint.knndist;
-        result.x = _prePoint.x * 3;
-        result.y = _prePoint.y * 3;
-        _result = result;
-    }
-    _preDate = now;
-    float jump = JUMPING_BOUND, smooth = SMOOTHING_WEIGHT;
-    if (_bStart && _jumpDate) {
-        double duration = [now timeIntervalSinceDate:_jumpDate];
-        if (duration > 10) {
-            // Adjust jump & smooth parameter based on jumping duration
-            jump = jump * duration;
-//            smooth = 1.0;
-            NSLog(@"duration=%f, jump=%f, smooth=%f", duration, jump, smooth);
-        }
-    }
-    for (int i = 0; i < _beaconNum; i++) {
-        _featVec[i] = -100;
-    }
-    for (CLBeacon *beacon in beacons) {
-        if (_beaconIndexMap.find(beacon.minor.intValue) != _beaconIndexMap.end()) {
-            _featVec[_beaconIndexMap[beacon.minor.intValue]] = (beacon.rssi == 0 ? -100 : beacon.rssi);
-        }
-    }
-    
-//    for (int i = 0; i < _beaconNum; i++) {
-//        if (_preFeatVec[i] > -90) {
-//            _featVec[i] = (_featVec[i] < -99 ? _preFeatVec[i] : _featVec[i]);
-//        }
-//    }
-    
-    if (_bStart) {
-        for (int i = 0; i < _beaconNum; i++) {
-            _featVec[i] = _featVec[i] * smooth + _preFeatVec[i] * (1 - smooth);
-        }
+    [self inputBeaconScan:[[NavBeaconScan alloc] initWithBeacons:beacons]];
+}
+
+- (void) inputBeaconScan:(NavBeaconScan *)scan
+{
+    if (!_core) {
+        return;
     }
+    _core->putBeacons(scan.frame);
     
-    _kdTree.knnSearch(_featVec, _indices, _dists, KNN_NUM);
-    //struct NavPoint result;
+    const NavFingerprintLocalizer::Result &r = _core->result();
     NavLocalizeResult *result = [[NavLocalizeResult alloc] init];
-    result.knndist = _dists[0];
-    result.x = 0;
-    result.y = 0;
-    float distSum = 0;
-    for (int i = 0; i < KNN_NUM; i++) {
-        result.x += _posMap.at<float>(_indices[i], 0) / (_dists[i] + 1e-20);
-        result.y += _posMap.at<float>(_indices[i], 1) / (_dists[i] + 1e-20);
-        distSum += 1 / (_dists[i] + 1e-20);
-    }
-    result.x /= (distSum + 1e-20);
-    result.y /= (distSum + 1e-20);
-    
-    for (int i = 0; i < _beaconNum; i++) {
-        _preFeatVec[i] = _featVec[i];
-    }
-    
-    if (_bStart) {
-        if (ABS(result.x - _prePoint.x) > jump || ABS(result.y - _prePoint.y) > jump) {
-            if (_jumpDate == nil) {
-                _jumpDate = now;
-            }
-        } else {
-            _jumpDate = nil;
-        }
-        if (result.x - _prePoint.x > jump) {
-            result.x = _prePoint.x + jump;
-        } else if (result.x - _prePoint.x < -jump) {
-            result.x = _prePoint.x - jump;
-        }
-        
-        if (result.y - _prePoint.y > jump) {
-            result.y = _prePoint.y + jump;
-        } else if (result.y - _prePoint.y < -jump) {
-            result.y = _prePoint.y - jump;
-        }
-        
-        result.x = result.x * smooth + _prePoint.x * (1 - smooth);
-        result.y = result.y * smooth + _prePoint.y * (1 - smooth);
-        
-        _prePoint.x = result.x;
-        _prePoint.y = result.y;
-    } else {
-        _prePoint.x = result.x;
-        _prePoint.y = result.y;
-        _jumpDate = nil;
-    }
-    _prePoint.knndist = result.knndist;
-    
-    _bStart = true;
-    result.x *= 3;
-    result.y *= 3;
+    result.x = r.x;
+    result.y = r.y;
+    result.knndist = r.knndist;
     _result = result;
 }
 
-- (int)getDataNumOfFeatureFile:(const char *)path {
-    FILE *fp = fopen(path, "r");
-    char line[1024];
-    int lineCnt = 0;
-    while (fgets(line, 1024, fp) != NULL) {
-        lineCnt++;
-    }
-    fclose(fp);
-    return lineCnt - 1;
-}
-
 - (int)getDataNumOfDataString:(const char *)dataStr {
     int count = 0;
     const char* p = dataStr;
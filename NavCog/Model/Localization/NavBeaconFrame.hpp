@@ -0,0 +1,58 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavBeaconFrame_hpp
+#define NavBeaconFrame_hpp
+
+#include <stdint.h>
+#include <vector>
+
+struct NavBeaconReading {
+    int32_t major;
+    int32_t minor;
+    int32_t rssi; // as ranged, 0 if unknown
+};
+
+// One ranging callback, converted once and shared read-only by every localizer.
+class NavBeaconFrame {
+public:
+    NavBeaconFrame() : mFrameID(0), mTimestamp(0), mRunTest(false) {}
+    NavBeaconFrame(uint64_t frameID, double timestamp, std::vector<NavBeaconReading>&& readings, bool runTest)
+    : mFrameID(frameID), mTimestamp(timestamp), mReadings(std::move(readings)), mRunTest(runTest) {}
+
+    uint64_t frameID() const { return mFrameID; }
+    // milliseconds since 1970, as used by loc::Beacons
+    double timestamp() const { return mTimestamp; }
+    const std::vector<NavBeaconReading>& readings() const { return mReadings; }
+    size_t size() const { return mReadings.size(); }
+    bool empty() const { return mReadings.empty(); }
+    // the "run test" input is a single string instead of beacons
+    bool isRunTest() const { return mRunTest; }
+
+private:
+    uint64_t mFrameID;
+    double mTimestamp;
+    std::vector<NavBeaconReading> mReadings;
+    bool mRunTest;
+};
+
+#endif /* NavBeaconFrame_hpp */
@@ -18,23 +18,31 @@
  * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
- *
- * Contributors:
- *  Chengxiong Ruan (CMU) - initial API and implementation
- *  IBM Corporation - initial API and implementation
  *******************************************************************************/
+
 #import <Foundation/Foundation.h>
-#import "NavNode.h"
 
-@class NavNode;
+#ifdef __cplusplus
+#include "NavBeaconFrame.hpp"
+#endif
+
+// Holds the beacons of one ranging callback. The CLBeacon array is converted
+// once into a NavBeaconFrame that localizers read from directly.
+@interface NavBeaconScan : NSObject
+
+@property (readonly) NSArray *beacons;
+
+- (instancetype)initWithBeacons:(NSArray *)beacons;
+
+#ifdef __cplusplus
+- (const NavBeaconFrame &)frame;
+#endif
+
+@end
 
-@interface NavMinHeap : NSObject
+// implemented by everything that consumes beacon scans
+@protocol NavBeaconScanReceiver <NSObject>
 
-- (void)initHeapWithSize:(int)size;
-- (void)offer:(NavNode *)node; // insert a node into heap
-- (NavNode *)poll; // remove the top node from the heap, and return it;
-- (NavNode *)peek; // peek the top node
-- (int)getSize;
-- (void)siftAndUpdateNode:(NavNode *)node withNewDist:(int)newDist; // sift the node up or down when the distance is updated, node's distFromStartNode property will be updated within this method
+- (void)inputBeaconScan:(NavBeaconScan *)scan;
 
 @end
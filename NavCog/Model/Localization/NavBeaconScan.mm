@@ -0,0 +1,57 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#import "NavBeaconScan.h"
+#import <CoreLocation/CoreLocation.h>
+
+@implementation NavBeaconScan {
+    NavBeaconFrame _frame;
+}
+
+static uint64_t frameCount = 0;
+
+- (instancetype)initWithBeacons:(NSArray *)beacons
+{
+    self = [super init];
+    if (self) {
+        _beacons = beacons;
+        
+        std::vector<NavBeaconReading> readings;
+        readings.reserve(beacons.count);
+        bool runTest = beacons.count == 1 && [beacons[0] isKindOfClass:[NSString class]];
+        for (CLBeacon *b in beacons) {
+            if ([b isKindOfClass:[CLBeacon class]]) {
+                NavBeaconReading r = {b.major.intValue, b.minor.intValue, (int32_t)b.rssi};
+                readings.push_back(r);
+            }
+        }
+        _frame = NavBeaconFrame(++frameCount, [[NSDate date] timeIntervalSince1970] * 1000, std::move(readings), runTest);
+    }
+    return self;
+}
+
+- (const NavBeaconFrame &)frame
+{
+    return _frame;
+}
+
+@end
@@ -47,8 +47,19 @@
     return newLocalizer;
 }
 
+- (BOOL)prepared
+{
+    return _parent.prepared;
+}
+
+- (void)prepare
+{
+    [_parent prepare];
+}
+
 - (void)initializeState:(NSDictionary*) options
 {
+    [_parent beginInputEpoch];
     [_parent initializeState:options];
 }
 
@@ -82,16 +93,29 @@
 
 - (void) inputBeacons:(NSArray *)beacons
 {
+    [_parent beginInputEpoch];
     [_parent inputBeacons:beacons];
 }
 
+- (void) inputBeaconScan:(NavBeaconScan *)scan
+{
+    [_parent beginInputEpoch];
+    [_parent inputBeaconScan:scan];
+}
+
 - (void) inputAcceleration: (NSDictionary*) data
 {
+    if (_parent.distanceScoreDependsOnMotion) {
+        [_parent beginInputEpoch];
+    }
     [_parent inputAcceleration:data];
 }
 
 - (void) inputMotion: (NSDictionary*) data
 {
+    if (_parent.distanceScoreDependsOnMotion) {
+        [_parent beginInputEpoch];
+    }
     [_parent inputMotion:data];
 }
 
@@ -99,7 +123,7 @@
 - (double) computeDistanceScoreWithOptions: (NSDictionary*) options;{
     NSMutableDictionary* newDict = [options mutableCopy];
     newDict[@"edgeID"] = _edgeInfo.edgeID;
-    return [_parent computeDistanceScoreWithOptions:newDict];
+    return [_parent cachedDistanceScoreWithOptions:newDict];
 }
 
 - (void) setBeacons:(NSDictionary *)beacons
@@ -121,6 +145,9 @@
             }
         }
         [_parent performSelector:@selector(setBeacons:) withObject:beaconsCopy];
+        if ([_parent respondsToSelector:@selector(prepareForEdge:)]) {
+            [_parent performSelector:@selector(prepareForEdge:) withObject:_edgeInfo];
+        }
     }
 }
 
@@ -0,0 +1,229 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+// Fingerprint load benchmark, the text parser against the binary format
+// mapped by NavFingerprintData. It is not part of the app target, on Linux
+// or macOS build it with
+//
+//   c++ -std=c++11 -O2 -INavCog/Model/Localization
+//       NavCog/Model/Localization/NavFingerprintBenchMain.cpp
+//       NavCog/Model/Localization/NavFingerprintData.cpp -o navfingerprintbench
+//
+// usage: navfingerprintbench [-r repeats] [-d dir] [rows... | text files...]
+//        (default 1000 10000 50000 synthetic rows, 10 repeats, dir /tmp)
+//
+// Each input is loaded as KDTreeLocalization does at launch:
+//
+//   parse       loadFile of the text file
+//   cache cold  loadFileWithCache without a cache file, parses and writes it
+//   cache warm  loadFileWithCache with the cache, hashes the text and maps
+//   float32     loadFile of a converted float32 binary file, mapped
+//   int8        loadFile of a converted int8 binary file, expanded to float
+//
+// Every load is followed by a pass over all features so lazily mapped pages
+// are paid for, and the sums are checked against the parsed data. The files
+// stay in the page cache, so this is the CPU cost of a warm launch. The
+// synthetic text files and all binary files are written to dir.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include "NavFingerprintData.hpp"
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double elapsedUs(BenchClock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(BenchClock::now() - start).count();
+}
+
+// a sample every 2 m on a square floor, a beacon every 10 m seen within 30 m
+static bool writeSynthetic(const std::string& path, int rows)
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        return false;
+    }
+    int side = std::max(1, (int)ceil(sqrt((double)rows)));
+    int beaconSide = std::max(1, side * 2 / 10 + 1);
+    int beaconNum = beaconSide * beaconSide;
+    fprintf(fp, "MinorID of %d Beacon Used : ", beaconNum);
+    for (int b = 0; b < beaconNum; b++) {
+        fprintf(fp, "%d,", b + 1);
+    }
+    fprintf(fp, "\n");
+    std::mt19937 rng(rows);
+    std::normal_distribution<double> noise(0, 4);
+    std::vector<int> seen;
+    for (int r = 0; r < rows; r++) {
+        double x = (r % side) * 2.0, y = (r / side) * 2.0;
+        seen.clear();
+        for (int b = 0; b < beaconNum; b++) {
+            if (hypot(x - (b % beaconSide) * 10.0, y - (b / beaconSide) * 10.0) <= 30) {
+                seen.push_back(b);
+            }
+        }
+        fprintf(fp, "%f,%f,%d", x, y, (int)seen.size());
+        for (int b : seen) {
+            double d = std::max(1.0, hypot(x - (b % beaconSide) * 10.0, y - (b / beaconSide) * 10.0));
+            fprintf(fp, ",1,%d,%d", b + 1, std::max(-99, (int)lround(-60 - 20 * log10(d) + noise(rng))));
+        }
+        fprintf(fp, "\n");
+    }
+    return fclose(fp) == 0;
+}
+
+static double featureSum(const NavFingerprintData& data)
+{
+    double sum = 0;
+    const float* f = data.features();
+    size_t n = (size_t)data.sampleNum() * data.beaconNum();
+    for (size_t i = 0; i < n; i++) {
+        sum += f[i];
+    }
+    return sum;
+}
+
+static long fileSize(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? (long)st.st_size : -1;
+}
+
+// mean time in ms of load, -1 if it failed or the features differ from sum
+static double measure(int repeats, double sum, const std::function<bool(NavFingerprintData&)>& load,
+                      const std::function<void()>& prepare = nullptr)
+{
+    double us = 0;
+    for (int i = 0; i < repeats; i++) {
+        if (prepare) {
+            prepare();
+        }
+        NavFingerprintData data;
+        BenchClock::time_point start = BenchClock::now();
+        bool ok = load(data);
+        double s = ok ? featureSum(data) : 0;
+        us += elapsedUs(start);
+        // int8 cells are rounded
+        if (!ok || fabs(s - sum) > 0.5 * data.sampleNum() * data.beaconNum() + 1e-6 * fabs(sum)) {
+            return -1;
+        }
+    }
+    return us / repeats / 1000;
+}
+
+static int benchmark(const std::string& path, const std::string& dir, int repeats)
+{
+    NavFingerprintData parsed;
+    if (!parsed.loadFile(path)) {
+        fprintf(stderr, "Could not load %s\n", path.c_str());
+        return 1;
+    }
+    if (parsed.isMapped()) {
+        fprintf(stderr, "%s is not a text fingerprint\n", path.c_str());
+        return 1;
+    }
+    double sum = featureSum(parsed);
+    char name[64];
+    snprintf(name, sizeof(name), "/fingerprint-%016llx.nvfp", (unsigned long long)parsed.sourceHash());
+    std::string cachePath = dir + name;
+    std::string f32Path = dir + "/navfingerprintbench-f32.nvfp";
+    std::string i8Path = dir + "/navfingerprintbench-i8.nvfp";
+    if (!NavFingerprintData::convertTextToBinary(path, f32Path, NavFingerprintFeatureFloat32) ||
+        !NavFingerprintData::convertTextToBinary(path, i8Path, NavFingerprintFeatureInt8)) {
+        fprintf(stderr, "Could not write binary files to %s\n", dir.c_str());
+        return 1;
+    }
+    
+    printf("%s: %d rows, %d beacons, text %ld bytes, float32 %ld bytes, int8 %ld bytes\n", path.c_str(),
+           parsed.sampleNum(), parsed.beaconNum(), fileSize(path), fileSize(f32Path), fileSize(i8Path));
+    struct {
+        const char* name;
+        double ms;
+    } results[] = {
+        {"parse", measure(repeats, sum, [&](NavFingerprintData& d) { return d.loadFile(path); })},
+        {"cache cold", measure(repeats, sum, [&](NavFingerprintData& d) { return d.loadFileWithCache(path, dir); },
+                               [&]() { unlink(cachePath.c_str()); })},
+        {"cache warm", measure(repeats, sum, [&](NavFingerprintData& d) { return d.loadFileWithCache(path, dir); })},
+        {"float32", measure(repeats, sum, [&](NavFingerprintData& d) { return d.loadFile(f32Path); })},
+        {"int8", measure(repeats, sum, [&](NavFingerprintData& d) { return d.loadFile(i8Path); })},
+    };
+    int result = 0;
+    for (const auto& r : results) {
+        if (r.ms < 0) {
+            printf("  %-10s failed\n", r.name);
+            result = 1;
+        } else {
+            printf("  %-10s %.3f ms\n", r.name, r.ms);
+        }
+    }
+    unlink(cachePath.c_str());
+    unlink(f32Path.c_str());
+    unlink(i8Path.c_str());
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    int repeats = 10;
+    std::string dir = "/tmp";
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            repeats = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (inputs.empty()) {
+        inputs = {"1000", "10000", "50000"};
+    }
+    int result = 0;
+    for (const std::string& input : inputs) {
+        char* end;
+        long rows = strtol(input.c_str(), &end, 10);
+        if (*end == '\0' && rows > 0) {
+            std::string path = dir + "/navfingerprintbench-" + input + ".txt";
+            if (!writeSynthetic(path, (int)rows)) {
+                fprintf(stderr, "Could not write %s\n", path.c_str());
+                result = 1;
+                continue;
+            }
+            result |= benchmark(path, dir, repeats);
+            unlink(path.c_str());
+        } else {
+            result |= benchmark(input, dir, repeats);
+        }
+    }
+    return result;
+}
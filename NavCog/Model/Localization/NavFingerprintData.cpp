@@ -0,0 +1,478 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavFingerprintData.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unordered_map>
+
+using namespace std;
+
+namespace {
+
+    const size_t kBlockAlign = 16;
+
+    inline size_t alignUp(size_t v)
+    {
+        return (v + kBlockAlign - 1) & ~(kBlockAlign - 1);
+    }
+
+    struct BinaryLayout {
+        size_t minorOffset;
+        size_t featureOffset;
+        size_t positionOffset;
+        size_t totalLength;
+    };
+
+    BinaryLayout layoutFor(size_t sampleNum, size_t beaconNum, uint32_t featureType)
+    {
+        size_t elem = featureType == NavFingerprintFeatureInt8 ? sizeof(int8_t) : sizeof(float);
+        BinaryLayout l;
+        l.minorOffset = alignUp(sizeof(NavFingerprintBinaryHeader));
+        l.featureOffset = alignUp(l.minorOffset + beaconNum * sizeof(int32_t));
+        l.positionOffset = alignUp(l.featureOffset + sampleNum * beaconNum * elem);
+        l.totalLength = l.positionOffset + sampleNum * 2 * sizeof(float);
+        return l;
+    }
+
+    // read-only view of a whole file, released on scope exit
+    struct MappedFile {
+        void *data;
+        size_t length;
+        MappedFile() : data(NULL), length(0) {}
+        ~MappedFile() { release(); }
+        bool open(const string& path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+                ::close(fd);
+                return false;
+            }
+            void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (p == MAP_FAILED) {
+                return false;
+            }
+            data = p;
+            length = (size_t)st.st_size;
+            return true;
+        }
+        void release() {
+            if (data) {
+                munmap(data, length);
+                data = NULL;
+                length = 0;
+            }
+        }
+        void* detach() {
+            void *p = data;
+            data = NULL;
+            return p;
+        }
+    };
+
+    // Minimal bounded number scanner for the text format. Separators are
+    // anything that cannot start a number, which covers ',', ':' and newlines.
+    struct TextCursor {
+        const char *p;
+        const char *end;
+
+        inline bool skipToNumber() {
+            while (p < end) {
+                char c = *p;
+                if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.') {
+                    return true;
+                }
+                p++;
+            }
+            return false;
+        }
+
+        inline bool readInt(int &out) {
+            if (!skipToNumber()) {
+                return false;
+            }
+            bool neg = false;
+            if (*p == '-' || *p == '+') {
+                neg = *p == '-';
+                p++;
+            }
+            long v = 0;
+            const char *start = p;
+            while (p < end && *p >= '0' && *p <= '9') {
+                v = v * 10 + (*p - '0');
+                p++;
+            }
+            if (p == start) {
+                return false;
+            }
+            out = (int)(neg ? -v : v);
+            return true;
+        }
+
+        inline bool readFloat(float &out) {
+            if (!skipToNumber()) {
+                return false;
+            }
+            bool neg = false;
+            if (*p == '-' || *p == '+') {
+                neg = *p == '-';
+                p++;
+            }
+            double v = 0;
+            int digits = 0;
+            while (p < end && *p >= '0' && *p <= '9') {
+                v = v * 10 + (*p - '0');
+                p++;
+                digits++;
+            }
+            if (p < end && *p == '.') {
+                p++;
+                double scale = 0.1;
+                while (p < end && *p >= '0' && *p <= '9') {
+                    v += (*p - '0') * scale;
+                    scale *= 0.1;
+                    p++;
+                    digits++;
+                }
+            }
+            if (digits == 0) {
+                return false;
+            }
+            if (p < end && (*p == 'e' || *p == 'E')) {
+                p++;
+                int e = 0;
+                if (!readInt(e)) {
+                    return false;
+                }
+                v *= pow(10.0, e);
+            }
+            out = (float)(neg ? -v : v);
+            return true;
+        }
+    };
+}
+
+NavFingerprintData::NavFingerprintData()
+: mSampleNum(0), mBeaconNum(0), mSourceHash(0), mMinors(NULL), mFeatures(NULL), mPositions(NULL), mMapped(NULL), mMappedLength(0)
+{
+}
+
+NavFingerprintData::~NavFingerprintData()
+{
+    clear();
+}
+
+void NavFingerprintData::clear()
+{
+    if (mMapped) {
+        munmap(mMapped, mMappedLength);
+        mMapped = NULL;
+        mMappedLength = 0;
+    }
+    vector<int32_t>().swap(mMinorStore);
+    vector<float>().swap(mFeatureStore);
+    vector<float>().swap(mPositionStore);
+    mMinors = NULL;
+    mFeatures = NULL;
+    mPositions = NULL;
+    mSampleNum = mBeaconNum = 0;
+    mSourceHash = 0;
+}
+
+uint64_t NavFingerprintData::hashBytes(const void* data, size_t len, uint64_t seed)
+{
+    // FNV-1a 64
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t h = seed;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+bool NavFingerprintData::parseText(const char* data, size_t len)
+{
+    clear();
+    static const char *kHeader = "MinorID of";
+    size_t hlen = strlen(kHeader);
+    if (len < hlen || strncmp(data, kHeader, hlen) != 0) {
+        return false;
+    }
+    TextCursor c = { data + hlen, data + len };
+    int beaconNum;
+    if (!c.readInt(beaconNum) || beaconNum <= 0) {
+        return false;
+    }
+    // skip " Beacon Used : "
+    while (c.p < c.end && *c.p != ':') {
+        c.p++;
+    }
+
+    unordered_map<int, int> columnOfMinor;
+    mMinorStore.resize(beaconNum);
+    for (int i = 0; i < beaconNum; i++) {
+        int minor;
+        if (!c.readInt(minor)) {
+            return false;
+        }
+        mMinorStore[i] = minor;
+        columnOfMinor[minor] = i;
+    }
+
+    float x, y;
+    int validBeaconNum;
+    while (c.readFloat(x)) {
+        if (!c.readFloat(y) || !c.readInt(validBeaconNum)) {
+            return false;
+        }
+        mPositionStore.push_back(x);
+        mPositionStore.push_back(y);
+        size_t row = mFeatureStore.size();
+        mFeatureStore.resize(row + beaconNum, NAV_FINGERPRINT_NO_SIGNAL);
+        float *feat = &mFeatureStore[row];
+        for (int j = 0; j < validBeaconNum; j++) {
+            int major, minor, rssi;
+            if (!c.readInt(major) || !c.readInt(minor) || !c.readInt(rssi)) {
+                return false;
+            }
+            unordered_map<int, int>::const_iterator it = columnOfMinor.find(minor);
+            if (it != columnOfMinor.end()) {
+                feat[it->second] = rssi;
+            }
+        }
+    }
+
+    mBeaconNum = beaconNum;
+    mSampleNum = (int)(mPositionStore.size() / 2);
+    mMinors = &mMinorStore[0];
+    mFeatures = mFeatureStore.empty() ? NULL : &mFeatureStore[0];
+    mPositions = mPositionStore.empty() ? NULL : &mPositionStore[0];
+    mSourceHash = hashBytes(data, len);
+    return true;
+}
+
+bool NavFingerprintData::readBinary(const char* base, size_t len, uint64_t expectedHash, bool checkHash, bool copy)
+{
+    clear();
+    if (len < sizeof(NavFingerprintBinaryHeader)) {
+        return false;
+    }
+    NavFingerprintBinaryHeader h;
+    memcpy(&h, base, sizeof(h));
+    if (memcmp(h.magic, NAV_FINGERPRINT_MAGIC, 4) != 0 || h.version != NAV_FINGERPRINT_VERSION) {
+        return false;
+    }
+    if (h.featureType != NavFingerprintFeatureFloat32 && h.featureType != NavFingerprintFeatureInt8) {
+        return false;
+    }
+    if (checkHash && h.sourceHash != expectedHash) {
+        return false;
+    }
+    BinaryLayout l = layoutFor(h.sampleNum, h.beaconNum, h.featureType);
+    if (l.totalLength > len) {
+        return false;
+    }
+
+    mSampleNum = h.sampleNum;
+    mBeaconNum = h.beaconNum;
+    mSourceHash = h.sourceHash;
+    size_t n = (size_t)mSampleNum * mBeaconNum;
+    if (copy) {
+        mMinorStore.assign((const int32_t *)(base + l.minorOffset), (const int32_t *)(base + l.minorOffset) + mBeaconNum);
+        mPositionStore.assign((const float *)(base + l.positionOffset), (const float *)(base + l.positionOffset) + mSampleNum * 2);
+        mMinors = mMinorStore.empty() ? NULL : &mMinorStore[0];
+        mPositions = mPositionStore.empty() ? NULL : &mPositionStore[0];
+    } else {
+        mMinors = (const int32_t *)(base + l.minorOffset);
+        mPositions = (const float *)(base + l.positionOffset);
+    }
+    if (h.featureType == NavFingerprintFeatureInt8) {
+        // int8 keeps the file small; expand once since cv::flann needs CV_32F
+        const int8_t *src = (const int8_t *)(base + l.featureOffset);
+        mFeatureStore.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            mFeatureStore[i] = src[i];
+        }
+        mFeatures = n ? &mFeatureStore[0] : NULL;
+    } else if (copy) {
+        mFeatureStore.assign((const float *)(base + l.featureOffset), (const float *)(base + l.featureOffset) + n);
+        mFeatures = n ? &mFeatureStore[0] : NULL;
+    } else {
+        mFeatures = (const float *)(base + l.featureOffset);
+    }
+    return true;
+}
+
+bool NavFingerprintData::mapBinary(const std::string& path, uint64_t expectedHash, bool checkHash)
+{
+    clear();
+    MappedFile file;
+    if (!file.open(path) || !readBinary((const char *)file.data, file.length, expectedHash, checkHash, false)) {
+        return false;
+    }
+    mMappedLength = file.length;
+    mMapped = file.detach();
+    return true;
+}
+
+bool NavFingerprintData::loadFile(const std::string& path)
+{
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    if (isBinary(file.data, file.length)) {
+        file.release();
+        return mapBinary(path, 0, false);
+    }
+    return parseText((const char *)file.data, file.length);
+}
+
+bool NavFingerprintData::loadBytes(const char* data, size_t len)
+{
+    if (isBinary(data, len)) {
+        return readBinary(data, len, 0, false, true);
+    }
+    return parseText(data, len);
+}
+
+bool NavFingerprintData::isBinary(const void* data, size_t len)
+{
+    return len >= 4 && memcmp(data, NAV_FINGERPRINT_MAGIC, 4) == 0;
+}
+
+bool NavFingerprintData::loadFileWithCache(const std::string& path, const std::string& cacheDir)
+{
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+    if (isBinary(file.data, file.length)) {
+        file.release();
+        return mapBinary(path, 0, false);
+    }
+    return loadBytesWithCache((const char *)file.data, file.length, cacheDir);
+}
+
+bool NavFingerprintData::loadBytesWithCache(const char* data, size_t len, const std::string& cacheDir)
+{
+    if (isBinary(data, len)) {
+        return readBinary(data, len, 0, false, true);
+    }
+
+    uint64_t hash = hashBytes(data, len);
+    char name[64];
+    snprintf(name, sizeof(name), "/fingerprint-%016llx.nvfp", (unsigned long long)hash);
+    string cachePath = cacheDir + name;
+    if (mapBinary(cachePath, hash, true)) {
+        return true;
+    }
+
+    if (!parseText(data, len)) {
+        return false;
+    }
+    // prefer clean file-backed pages over the heap copy once the cache exists
+    if (writeBinary(cachePath, NavFingerprintFeatureFloat32)) {
+        NavFingerprintData mapped;
+        if (mapped.mapBinary(cachePath, hash, true)) {
+            clear();
+            mSampleNum = mapped.mSampleNum;
+            mBeaconNum = mapped.mBeaconNum;
+            mSourceHash = mapped.mSourceHash;
+            mMinors = mapped.mMinors;
+            mFeatures = mapped.mFeatures;
+            mPositions = mapped.mPositions;
+            mMapped = mapped.mMapped;
+            mMappedLength = mapped.mMappedLength;
+            mapped.mMapped = NULL;
+        }
+    }
+    return true;
+}
+
+bool NavFingerprintData::writeBinary(const std::string& path, NavFingerprintFeatureType type) const
+{
+    if (mBeaconNum <= 0) {
+        return false;
+    }
+    NavFingerprintBinaryHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, NAV_FINGERPRINT_MAGIC, 4);
+    h.version = NAV_FINGERPRINT_VERSION;
+    h.sampleNum = mSampleNum;
+    h.beaconNum = mBeaconNum;
+    h.featureType = type;
+    h.sourceHash = mSourceHash;
+    BinaryLayout l = layoutFor(mSampleNum, mBeaconNum, type);
+
+    vector<char> buf(l.totalLength, 0);
+    memcpy(&buf[0], &h, sizeof(h));
+    memcpy(&buf[l.minorOffset], mMinors, mBeaconNum * sizeof(int32_t));
+    size_t n = (size_t)mSampleNum * mBeaconNum;
+    if (type == NavFingerprintFeatureInt8) {
+        int8_t *dst = (int8_t *)&buf[l.featureOffset];
+        for (size_t i = 0; i < n; i++) {
+            float v = roundf(mFeatures[i]);
+            dst[i] = (int8_t)(v < -128 ? -128 : (v > 127 ? 127 : v));
+        }
+    } else if (n) {
+        memcpy(&buf[l.featureOffset], mFeatures, n * sizeof(float));
+    }
+    if (mSampleNum) {
+        memcpy(&buf[l.positionOffset], mPositions, mSampleNum * 2 * sizeof(float));
+    }
+
+    // write next to the target and rename so readers never see a partial file
+    string tmpPath = path + ".tmp";
+    FILE *fp = fopen(tmpPath.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fwrite(&buf[0], 1, buf.size(), fp) == buf.size();
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool NavFingerprintData::convertTextToBinary(const std::string& textPath, const std::string& binaryPath,
+                                             NavFingerprintFeatureType type)
+{
+    NavFingerprintData data;
+    if (!data.loadFile(textPath)) {
+        return false;
+    }
+    return data.writeBinary(binaryPath, type);
+}
@@ -0,0 +1,119 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavFingerprintData_hpp
+#define NavFingerprintData_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Fingerprint table used by KDTreeLocalization.
+//
+// Two on-disk formats are understood:
+//
+//  * text   "MinorID of N Beacon Used : m1,m2,...,mN,"
+//           followed by one row per line "x,y,k,major,minor,rssi,...(k times)"
+//  * binary NavFingerprintBinaryHeader, int32 minor table, row-major feature
+//           block (float32 or int8, sampleNum x beaconNum) and row-major
+//           float32 position block (sampleNum x 2). Every block starts on a
+//           16 byte boundary so the float blocks can be wrapped by cv::Mat
+//           directly from the mapped file.
+//
+// Cells without an observation hold NAV_FINGERPRINT_NO_SIGNAL.
+
+#define NAV_FINGERPRINT_NO_SIGNAL (-100.0f)
+#define NAV_FINGERPRINT_MAGIC "NVFP"
+#define NAV_FINGERPRINT_VERSION 1
+
+enum NavFingerprintFeatureType {
+    NavFingerprintFeatureFloat32 = 0,
+    NavFingerprintFeatureInt8 = 1
+};
+
+struct NavFingerprintBinaryHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t sampleNum;
+    uint32_t beaconNum;
+    uint32_t featureType;
+    uint32_t reserved;
+    uint64_t sourceHash; // hash of the text file this was converted from
+};
+
+class NavFingerprintData {
+public:
+    NavFingerprintData();
+    ~NavFingerprintData();
+
+    // Loads either format, detected by the magic number.
+    bool loadFile(const std::string& path);
+    // Loads text from memory with a single pass over the bytes.
+    bool parseText(const char* data, size_t len);
+
+    // Loads either format from memory, binary data is copied.
+    bool loadBytes(const char* data, size_t len);
+
+    // Loads the text file at path through a binary cache file in cacheDir.
+    // The cache is reused while its source hash matches the text contents.
+    bool loadFileWithCache(const std::string& path, const std::string& cacheDir);
+    bool loadBytesWithCache(const char* data, size_t len, const std::string& cacheDir);
+
+    bool writeBinary(const std::string& path, NavFingerprintFeatureType type) const;
+    static bool convertTextToBinary(const std::string& textPath, const std::string& binaryPath,
+                                    NavFingerprintFeatureType type);
+
+    static bool isBinary(const void* data, size_t len);
+    static uint64_t hashBytes(const void* data, size_t len, uint64_t seed = 14695981039346656037ULL);
+
+    int sampleNum() const { return mSampleNum; }
+    int beaconNum() const { return mBeaconNum; }
+    const int32_t* minors() const { return mMinors; }
+    const float* features() const { return mFeatures; }   // sampleNum x beaconNum
+    const float* positions() const { return mPositions; } // sampleNum x 2
+    bool isMapped() const { return mMapped != NULL; }
+    uint64_t sourceHash() const { return mSourceHash; }
+
+private:
+    NavFingerprintData(const NavFingerprintData&);
+    NavFingerprintData& operator=(const NavFingerprintData&);
+
+    void clear();
+    bool readBinary(const char* base, size_t len, uint64_t expectedHash, bool checkHash, bool copy);
+    bool mapBinary(const std::string& path, uint64_t expectedHash, bool checkHash);
+
+    int mSampleNum;
+    int mBeaconNum;
+    uint64_t mSourceHash;
+    const int32_t* mMinors;
+    const float* mFeatures;
+    const float* mPositions;
+
+    void* mMapped;
+    size_t mMappedLength;
+    std::vector<int32_t> mMinorStore;
+    std::vector<float> mFeatureStore;
+    std::vector<float> mPositionStore;
+};
+
+#endif /* NavFingerprintData_hpp */
@@ -0,0 +1,195 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavFingerprintLocalizer.hpp"
+#include <math.h>
+#include <stdio.h>
+
+#define SMOOTHING_WEIGHT 0.6
+#define JUMPING_BOUND 3
+#define SPARSE_FLOOR 0.5 // smoothed values this close to -100 count as unheard in sparse mode
+
+NavFingerprintLocalizer::NavFingerprintLocalizer(std::shared_ptr<NavFingerprintData> fingerprint,
+                                                 std::shared_ptr<NavKNNSearch> searcher)
+: mFingerprint(fingerprint), mSearcher(searcher)
+{
+    mSparseSearcher = dynamic_cast<NavSparseKNN*>(mSearcher.get());
+    mSampleNum = fingerprint->sampleNum();
+    mBeaconNum = fingerprint->beaconNum();
+    mPositions.assign(fingerprint->positions(), fingerprint->positions() + mSampleNum * 2);
+    for (int i = 0; i < mBeaconNum; i++) {
+        mBeaconIndexMap[fingerprint->minors()[i]] = i;
+    }
+    if (mSparseSearcher) {
+        // the inverted index holds everything needed for matching
+        mFingerprint.reset();
+    }
+    mFeatVec.assign(mBeaconNum, -100);
+    mPreFeatVec.assign(mBeaconNum, -100);
+    mColumnActive.assign(mBeaconNum, 0);
+    reset();
+}
+
+std::shared_ptr<NavKNNSearch> NavFingerprintLocalizer::createSearcher(const NavFingerprintData& fingerprint,
+                                                                      const std::string& backend)
+{
+    const float* features = fingerprint.features();
+    int rows = fingerprint.sampleNum(), cols = fingerprint.beaconNum();
+    std::string type = backend;
+    if (type == "auto") {
+        type = NavSparseKNN::isPreferredFor(features, rows, cols, NAV_FINGERPRINT_NO_SIGNAL) ? "sparse" : "bruteforce";
+    }
+    if (type == "sparse") {
+        return std::make_shared<NavSparseKNN>(features, rows, cols, NAV_FINGERPRINT_NO_SIGNAL);
+    }
+    if (type == "bruteforce") {
+        return std::make_shared<NavBruteForceKNN>(features, rows, cols);
+    }
+    return nullptr;
+}
+
+// when you restart navigation for another path
+// you need to clean the history knowledge
+void NavFingerprintLocalizer::reset()
+{
+    for (int col : mActiveColumns) {
+        mFeatVec[col] = -100;
+        mPreFeatVec[col] = -100;
+        mColumnActive[col] = 0;
+    }
+    mActiveColumns.clear();
+    mStarted = false;
+    mJumpTime = -1;
+    mPrePoint.x = mPrePoint.y = mPrePoint.knndist = 0;
+    mResult = mPrePoint;
+}
+
+void NavFingerprintLocalizer::putBeacons(const NavBeaconFrame& frame)
+{
+    double now = frame.timestamp();
+    float jump = JUMPING_BOUND, smooth = SMOOTHING_WEIGHT;
+    if (mStarted && mJumpTime >= 0) {
+        double duration = (now - mJumpTime) / 1000;
+        if (duration > 10) {
+            // Adjust jump & smooth parameter based on jumping duration
+            jump = jump * duration;
+            if (mLogHandler) {
+                char line[128];
+                snprintf(line, sizeof(line), "duration=%f, jump=%f, smooth=%f", duration, jump, smooth);
+                mLogHandler(line);
+            }
+        }
+    }
+    // columns that are -100 in both this and the previous scan stay -100 through
+    // smoothing, so only the active columns are reset, smoothed and copied
+    for (int col : mActiveColumns) {
+        mFeatVec[col] = -100;
+    }
+    for (const NavBeaconReading& beacon : frame.readings()) {
+        auto it = mBeaconIndexMap.find(beacon.minor);
+        if (it != mBeaconIndexMap.end()) {
+            mFeatVec[it->second] = (beacon.rssi == 0 ? -100 : beacon.rssi);
+            if (!mColumnActive[it->second]) {
+                mColumnActive[it->second] = 1;
+                mActiveColumns.push_back(it->second);
+            }
+        }
+    }
+    
+    if (mStarted) {
+        for (int col : mActiveColumns) {
+            mFeatVec[col] = mFeatVec[col] * smooth + mPreFeatVec[col] * (1 - smooth);
+        }
+    }
+    
+    if (mSparseSearcher) {
+        // without this the tail of every beacon ever heard would stay in the query
+        mActiveValues.clear();
+        for (int col : mActiveColumns) {
+            if (mFeatVec[col] <= -100 + SPARSE_FLOOR) {
+                mFeatVec[col] = -100;
+            }
+            mActiveValues.push_back(mFeatVec[col]);
+        }
+        mSparseSearcher->knnSearchSparse(mActiveColumns.data(), mActiveValues.data(), (int)mActiveColumns.size(),
+                                         kKNNNum, mIndices, mDists);
+    } else {
+        mSearcher->knnSearch(mFeatVec.data(), kKNNNum, mIndices, mDists);
+    }
+    Result result;
+    result.knndist = mDists[0];
+    result.x = 0;
+    result.y = 0;
+    float distSum = 0;
+    for (int i = 0; i < kKNNNum && mIndices[i] >= 0; i++) {
+        result.x += mPositions[mIndices[i] * 2] / (mDists[i] + 1e-20);
+        result.y += mPositions[mIndices[i] * 2 + 1] / (mDists[i] + 1e-20);
+        distSum += 1 / (mDists[i] + 1e-20);
+    }
+    result.x /= (distSum + 1e-20);
+    result.y /= (distSum + 1e-20);
+    
+    size_t activeNum = 0;
+    for (int col : mActiveColumns) {
+        mPreFeatVec[col] = mFeatVec[col];
+        if (mFeatVec[col] == -100) {
+            mColumnActive[col] = 0;
+        } else {
+            mActiveColumns[activeNum++] = col;
+        }
+    }
+    mActiveColumns.resize(activeNum);
+    
+    if (mStarted) {
+        if (fabs(result.x - mPrePoint.x) > jump || fabs(result.y - mPrePoint.y) > jump) {
+            if (mJumpTime < 0) {
+                mJumpTime = now;
+            }
+        } else {
+            mJumpTime = -1;
+        }
+        if (result.x - mPrePoint.x > jump) {
+            result.x = mPrePoint.x + jump;
+        } else if (result.x - mPrePoint.x < -jump) {
+            result.x = mPrePoint.x - jump;
+        }
+        
+        if (result.y - mPrePoint.y > jump) {
+            result.y = mPrePoint.y + jump;
+        } else if (result.y - mPrePoint.y < -jump) {
+            result.y = mPrePoint.y - jump;
+        }
+        
+        result.x = result.x * smooth + mPrePoint.x * (1 - smooth);
+        result.y = result.y * smooth + mPrePoint.y * (1 - smooth);
+    } else {
+        mJumpTime = -1;
+    }
+    mPrePoint.x = result.x;
+    mPrePoint.y = result.y;
+    mPrePoint.knndist = result.knndist;
+    
+    mStarted = true;
+    mResult.x = result.x * 3;
+    mResult.y = result.y * 3;
+    mResult.knndist = result.knndist;
+}
@@ -0,0 +1,98 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavFingerprintLocalizer_hpp
+#define NavFingerprintLocalizer_hpp
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "NavBeaconFrame.hpp"
+#include "NavFingerprintData.hpp"
+#include "NavKNNSearch.hpp"
+
+// Per-scan kNN fingerprint localization behind KDTreeLocalization, free of
+// Foundation so it can also run headless (see NavLogReplay).
+//
+// Each scan is smoothed with the previous one, matched against the
+// fingerprint rows and the inverse distance weighted position of the nearest
+// rows is smoothed and clamped against the previous position.
+class NavFingerprintLocalizer {
+public:
+    struct Result {
+        float x, y;    // in feet
+        float knndist; // squared distance to the nearest row
+    };
+
+    // diagnostic lines, e.g. to NSLog in the app, nothing is logged without one
+    typedef std::function<void(const char* line)> LogHandler;
+
+    static const int kKNNNum = 5;
+
+    // the searcher must be built over fingerprint's features, the fingerprint
+    // is only kept while the searcher may reference it
+    NavFingerprintLocalizer(std::shared_ptr<NavFingerprintData> fingerprint,
+                            std::shared_ptr<NavKNNSearch> searcher);
+
+    // backend is "bruteforce", "sparse" or "auto" to choose by the shape of
+    // the data, returns nullptr for anything else
+    static std::shared_ptr<NavKNNSearch> createSearcher(const NavFingerprintData& fingerprint,
+                                                        const std::string& backend);
+
+    void reset();
+    void putBeacons(const NavBeaconFrame& frame);
+    void logHandler(LogHandler handler) { mLogHandler = handler; }
+
+    bool hasResult() const { return mStarted; }
+    const Result& result() const { return mResult; }
+    const NavKNNSearch& searcher() const { return *mSearcher; }
+    int sampleNum() const { return mSampleNum; }
+    int beaconNum() const { return mBeaconNum; }
+
+private:
+    std::shared_ptr<NavFingerprintData> mFingerprint;
+    std::shared_ptr<NavKNNSearch> mSearcher;
+    NavSparseKNN* mSparseSearcher;
+    int mSampleNum;
+    int mBeaconNum;
+    std::vector<float> mPositions;
+    std::unordered_map<int, int> mBeaconIndexMap;
+
+    std::vector<float> mFeatVec;
+    std::vector<float> mPreFeatVec;
+    std::vector<int> mActiveColumns; // columns not at -100 in mFeatVec or mPreFeatVec
+    std::vector<char> mColumnActive;
+    std::vector<float> mActiveValues;
+    int mIndices[kKNNNum];
+    float mDists[kKNNNum];
+
+    bool mStarted;
+    Result mPrePoint;
+    double mJumpTime; // ms, negative while not jumping
+    Result mResult;
+    LogHandler mLogHandler;
+};
+
+#endif /* NavFingerprintLocalizer_hpp */
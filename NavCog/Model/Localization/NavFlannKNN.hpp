@@ -0,0 +1,53 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavFlannKNN_hpp
+#define NavFlannKNN_hpp
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/flann/flann.hpp>
+#include "NavKNNSearch.hpp"
+
+// cv::flann KD-forest behind the NavKNNSearch interface, the search
+// KDTreeLocalization used before the exact backends. The data is referenced,
+// not copied, and must outlive the searcher.
+class NavFlannKNN : public NavKNNSearch {
+public:
+    static const int kTreeNum = 5;
+
+    NavFlannKNN(const cv::Mat& data, int cols) : mCols(cols) {
+        mIndex.build(data, cv::flann::KDTreeIndexParams(kTreeNum));
+    }
+    void knnSearch(const float* query, int k, int* indices, float* dists) {
+        cv::Mat q(1, mCols, CV_32F, (void *)query);
+        cv::Mat ind(1, k, CV_32S, indices);
+        cv::Mat dst(1, k, CV_32F, dists);
+        mIndex.knnSearch(q, ind, dst, k);
+    }
+    const char* name() const { return "kdtree"; }
+
+private:
+    cv::flann::Index mIndex;
+    int mCols;
+};
+
+#endif /* NavFlannKNN_hpp */
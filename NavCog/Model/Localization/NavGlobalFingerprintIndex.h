@@ -0,0 +1,50 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#import <Foundation/Foundation.h>
+#import "NavBeaconScan.h"
+
+#ifdef __cplusplus
+#include <memory>
+class NavFingerprintData;
+#endif
+
+// One sparse kNN index over the fingerprints of all 1D_Beacon localizers.
+// Rows are tagged with the localizer they came from, so a single query per
+// beacon scan gives the nearest-neighbour distance every KDTreeLocalization
+// would report, and the current location search only needs to evaluate the
+// best edges. Scans are smoothed the same way as in KDTreeLocalization.
+@interface NavGlobalFingerprintIndex : NSObject <NavBeaconScanReceiver>
+
+- (void)initializeState;
+- (void)inputBeaconScan:(NavBeaconScan *)scan;
+// squared distance to the nearest row of the localizer for the last scan,
+// negative if the localizer is not indexed
+- (double)knnDistanceForLocalizerID:(NSString *)idStr;
+- (BOOL)containsLocalizerID:(NSString *)idStr;
+
+#ifdef __cplusplus
+// replaces the rows of a localizer registered with the same ID
+- (void)addFingerprint:(std::shared_ptr<NavFingerprintData>)fingerprint forLocalizerID:(NSString *)idStr;
+#endif
+
+@end
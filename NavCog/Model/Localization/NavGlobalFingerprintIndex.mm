@@ -0,0 +1,195 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#import "NavGlobalFingerprintIndex.h"
+#import "NavFingerprintData.hpp"
+#import "NavKNNSearch.hpp"
+#import <CoreLocation/CoreLocation.h>
+#import <unordered_map>
+#import <vector>
+#import <string>
+
+#define KNN_NUM 5
+#define SMOOTHING_WEIGHT 0.6
+#define SPARSE_FLOOR 0.5
+
+using namespace std;
+
+@interface NavGlobalFingerprintIndex ()
+
+@property (nonatomic) NSMutableDictionary *pending; // idStr -> index in fingerprints
+@property (nonatomic) vector<shared_ptr<NavFingerprintData>> fingerprints;
+@property (nonatomic) shared_ptr<NavGroupedSparseKNN> index;
+@property (nonatomic) NSMutableDictionary *groups; // idStr -> group
+@property (nonatomic) unordered_map<int, int> columnOfMinor;
+@property (nonatomic) vector<float> featVec;
+@property (nonatomic) vector<int> activeColumns;
+@property (nonatomic) vector<char> columnActive;
+@property (nonatomic) vector<float> activeValues;
+@property (nonatomic) vector<NavGroupedSparseKNN::Match> matches;
+@property (nonatomic) Boolean bStart;
+@property (nonatomic) Boolean hasResult;
+
+@end
+
+@implementation NavGlobalFingerprintIndex
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _pending = [@{} mutableCopy];
+        _groups = [@{} mutableCopy];
+    }
+    return self;
+}
+
+- (void)addFingerprint:(shared_ptr<NavFingerprintData>)fingerprint forLocalizerID:(NSString *)idStr
+{
+    if (!fingerprint || !idStr) {
+        return;
+    }
+    NSNumber *i = _pending[idStr];
+    if (i) {
+        _fingerprints[[i intValue]] = fingerprint;
+    } else {
+        _pending[idStr] = @(_fingerprints.size());
+        _fingerprints.push_back(fingerprint);
+    }
+    _index.reset();
+}
+
+// the index is built at the first scan after localizers were added
+- (void)build
+{
+    NSDate *start = [NSDate date];
+    _index = make_shared<NavGroupedSparseKNN>(NAV_FINGERPRINT_NO_SIGNAL);
+    _columnOfMinor.clear();
+    [_groups removeAllObjects];
+    vector<int> columns;
+    for (NSString *idStr in _pending) {
+        const NavFingerprintData &fp = *_fingerprints[[_pending[idStr] intValue]];
+        columns.resize(fp.beaconNum());
+        for (int j = 0; j < fp.beaconNum(); j++) {
+            auto it = _columnOfMinor.find(fp.minors()[j]);
+            if (it == _columnOfMinor.end()) {
+                it = _columnOfMinor.insert(make_pair(fp.minors()[j], (int)_columnOfMinor.size())).first;
+            }
+            columns[j] = it->second;
+        }
+        int group = _index->addGroup(fp.features(), fp.positions(), fp.sampleNum(), columns.data(), fp.beaconNum());
+        _groups[idStr] = @(group);
+    }
+    _index->build();
+    
+    // everything is copied into the index
+    _fingerprints.clear();
+    [_pending removeAllObjects];
+    
+    _featVec.assign(_columnOfMinor.size(), -100);
+    _columnActive.assign(_columnOfMinor.size(), 0);
+    _activeColumns.clear();
+    _bStart = false;
+    _hasResult = false;
+    NSLog(@"GlobalFingerprintIndex,%d,%d,%d,%f", _index->groupNum(), _index->rowNum(), (int)_columnOfMinor.size(),
+          [[NSDate date] timeIntervalSinceDate:start] * 1000);
+}
+
+- (void)initializeState
+{
+    for (int col : _activeColumns) {
+        _featVec[col] = -100;
+        _columnActive[col] = 0;
+    }
+    _activeColumns.clear();
+    _bStart = false;
+    _hasResult = false;
+}
+
+- (void)inputBeaconScan:(NavBeaconScan *)scan
+{
+    if (!_index) {
+        if (_fingerprints.empty()) {
+            return;
+        }
+        [self build];
+    }
+    
+    // same feature smoothing as KDTreeLocalization, over the union of beacons
+    vector<float> preValues(_activeColumns.size());
+    for (size_t i = 0; i < _activeColumns.size(); i++) {
+        preValues[i] = _featVec[_activeColumns[i]];
+        _featVec[_activeColumns[i]] = -100;
+    }
+    size_t preNum = _activeColumns.size();
+    for (const NavBeaconReading &beacon : scan.frame.readings()) {
+        auto it = _columnOfMinor.find(beacon.minor);
+        if (it != _columnOfMinor.end()) {
+            _featVec[it->second] = (beacon.rssi == 0 ? -100 : beacon.rssi);
+            if (!_columnActive[it->second]) {
+                _columnActive[it->second] = 1;
+                _activeColumns.push_back(it->second);
+            }
+        }
+    }
+    _activeValues.clear();
+    for (size_t i = 0; i < _activeColumns.size(); i++) {
+        int col = _activeColumns[i];
+        if (_bStart) {
+            float pre = i < preNum ? preValues[i] : -100;
+            _featVec[col] = _featVec[col] * SMOOTHING_WEIGHT + pre * (1 - SMOOTHING_WEIGHT);
+        }
+        if (_featVec[col] <= -100 + SPARSE_FLOOR) {
+            _featVec[col] = -100;
+        }
+        _activeValues.push_back(_featVec[col]);
+    }
+    _index->search(_activeColumns.data(), _activeValues.data(), (int)_activeColumns.size(), KNN_NUM, _matches);
+    
+    size_t activeNum = 0;
+    for (int col : _activeColumns) {
+        if (_featVec[col] == -100) {
+            _columnActive[col] = 0;
+        } else {
+            _activeColumns[activeNum++] = col;
+        }
+    }
+    _activeColumns.resize(activeNum);
+    _bStart = true;
+    _hasResult = true;
+}
+
+- (BOOL)containsLocalizerID:(NSString *)idStr
+{
+    return idStr && (_groups[idStr] != nil || _pending[idStr] != nil);
+}
+
+- (double)knnDistanceForLocalizerID:(NSString *)idStr
+{
+    NSNumber *group = idStr ? _groups[idStr] : nil;
+    if (!_hasResult || !group) {
+        return -1;
+    }
+    return _matches[[group intValue]].dist;
+}
+
+@end
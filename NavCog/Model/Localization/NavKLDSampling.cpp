@@ -0,0 +1,68 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavKLDSampling.hpp"
+#include <algorithm>
+#include <math.h>
+
+NavKLDSampling::NavKLDSampling(int minStateNum, int maxStateNum, double binSize, double epsilon, double z)
+: mMinStateNum(std::max(1, minStateNum)), mMaxStateNum(std::max(minStateNum, maxStateNum)),
+  mBinSize(binSize), mEpsilon(epsilon), mZ(z), mBinNum(-1)
+{
+}
+
+void NavKLDSampling::add(double x, double y, double floorIndex)
+{
+    // 24 bits per axis (16000 km at 1 m) and 16 bits for the floor
+    int64_t ix = (int64_t)floor(x / mBinSize) & 0xFFFFFF;
+    int64_t iy = (int64_t)floor(y / mBinSize) & 0xFFFFFF;
+    int64_t iz = (int64_t)lround(floorIndex) & 0xFFFF;
+    mBins.push_back((iz << 48) | (iy << 24) | ix);
+    mBinNum = -1;
+}
+
+int NavKLDSampling::binNum()
+{
+    if (mBinNum < 0) {
+        std::sort(mBins.begin(), mBins.end());
+        mBinNum = (int)(std::unique(mBins.begin(), mBins.end()) - mBins.begin());
+        mBins.resize(mBinNum);
+    }
+    return mBinNum;
+}
+
+int NavKLDSampling::stateNum()
+{
+    double n = bound(binNum(), mEpsilon, mZ);
+    return (int)std::min((double)mMaxStateNum, std::max((double)mMinStateNum, ceil(n)));
+}
+
+double NavKLDSampling::bound(int binNum, double epsilon, double z)
+{
+    if (binNum <= 1) {
+        return 0;
+    }
+    double k = binNum - 1;
+    double a = 2 / (9 * k);
+    double b = 1 - a + sqrt(a) * z;
+    return k / (2 * epsilon) * b * b * b;
+}
@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavKLDSampling_hpp
+#define NavKLDSampling_hpp
+
+#include <stdint.h>
+#include <vector>
+
+// Number of particles by KLD-sampling (Fox, 2003).
+//
+// The states of the current posterior are counted into grid bins of binSize
+// meters per floor. With k occupied bins, the number of samples needed so
+// that the KL divergence between the sample based and the true posterior
+// stays below epsilon with probability 1 - delta is
+//   n = (k - 1) / (2 epsilon) * (1 - 2 / (9 (k - 1)) + sqrt(2 / (9 (k - 1))) z)^3
+// where z is the upper 1 - delta quantile of the standard normal. The filter
+// uses n, clamped to [minStateNum, maxStateNum], from its next resampling on,
+// so a spread posterior grows the set and a converged one shrinks it.
+class NavKLDSampling {
+public:
+    NavKLDSampling(int minStateNum, int maxStateNum, double binSize = 1.0,
+                   double epsilon = 0.05, double z = 2.326);
+
+    int minStateNum() const { return mMinStateNum; }
+    int maxStateNum() const { return mMaxStateNum; }
+
+    void clear() { mBins.clear(); mBinNum = -1; }
+    void add(double x, double y, double floorIndex);
+    // occupied bins of the states added since clear(), the first call sorts
+    int binNum();
+    // clamped bound for binNum()
+    int stateNum();
+
+    static double bound(int binNum, double epsilon, double z);
+
+private:
+    int mMinStateNum, mMaxStateNum;
+    double mBinSize, mEpsilon, mZ;
+    std::vector<int64_t> mBins;
+    int mBinNum;
+};
+
+#endif /* NavKLDSampling_hpp */
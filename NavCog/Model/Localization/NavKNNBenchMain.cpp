@@ -0,0 +1,199 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+// kNN latency and recall benchmark of the NavKNNSearch backends against the
+// cv::flann KD-forest KDTreeLocalization used before. It is not part of the
+// app target, on Linux or macOS build it with
+//
+//   c++ -std=c++11 -O2 -INavCog/Model/Localization
+//       NavCog/Model/Localization/NavKNNBenchMain.cpp NavCog/Model/Localization/NavKNNSearch.cpp
+//       NavCog/Model/Localization/NavFingerprintData.cpp
+//       $(pkg-config --cflags --libs opencv4) -o navknnbench
+//
+// usage: navknnbench [-q queries] [-k neighbours] [rows... | fingerprint files...]
+//        (default 1000 4000 16000 synthetic rows, 200 queries, k = 5)
+//
+// A synthetic fingerprint has a sample every 2 m on a square floor with a
+// beacon every 10 m, a beacon is seen within 30 m with log distance RSSI and
+// 4 dB noise, like a survey. Files are loaded with NavFingerprintData in
+// either format. Queries are spread over the rows with uniform +-5 dB noise
+// on the observed cells. Recall is against the exact scan.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "NavFingerprintData.hpp"
+#include "NavKNNSearch.hpp"
+#include "NavFlannKNN.hpp"
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double elapsedUs(BenchClock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(BenchClock::now() - start).count();
+}
+
+struct Fingerprint {
+    std::string name;
+    int rows;
+    int cols;
+    std::vector<float> features; // rows x cols
+};
+
+static Fingerprint synthesize(int rows)
+{
+    Fingerprint fp;
+    int side = std::max(1, (int)ceil(sqrt((double)rows)));
+    int beaconSide = std::max(1, side * 2 / 10 + 1);
+    fp.name = "synthetic";
+    fp.rows = rows;
+    fp.cols = beaconSide * beaconSide;
+    fp.features.assign((size_t)fp.rows * fp.cols, NAV_FINGERPRINT_NO_SIGNAL);
+    std::mt19937 rng(rows);
+    std::normal_distribution<float> noise(0, 4);
+    for (int r = 0; r < rows; r++) {
+        double x = (r % side) * 2.0, y = (r / side) * 2.0;
+        for (int b = 0; b < fp.cols; b++) {
+            double d = std::max(1.0, hypot(x - (b % beaconSide) * 10.0, y - (b / beaconSide) * 10.0));
+            if (d <= 30) {
+                float rssi = (float)(-60 - 20 * log10(d)) + noise(rng);
+                fp.features[(size_t)r * fp.cols + b] = std::max(rssi, NAV_FINGERPRINT_NO_SIGNAL + 1);
+            }
+        }
+    }
+    return fp;
+}
+
+static bool load(const char* path, Fingerprint& fp)
+{
+    NavFingerprintData data;
+    if (!data.loadFile(path)) {
+        return false;
+    }
+    fp.name = path;
+    fp.rows = data.sampleNum();
+    fp.cols = data.beaconNum();
+    fp.features.assign(data.features(), data.features() + (size_t)fp.rows * fp.cols);
+    return true;
+}
+
+static std::vector<float> makeQueries(const Fingerprint& fp, int queryNum)
+{
+    std::vector<float> queries((size_t)queryNum * fp.cols);
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> noise(-5, 5);
+    for (int q = 0; q < queryNum; q++) {
+        const float* row = &fp.features[(size_t)q * fp.rows / queryNum * fp.cols];
+        for (int j = 0; j < fp.cols; j++) {
+            queries[(size_t)q * fp.cols + j] = row[j] > NAV_FINGERPRINT_NO_SIGNAL ? row[j] + noise(rng) : row[j];
+        }
+    }
+    return queries;
+}
+
+static int benchmark(const Fingerprint& fp, int queryNum, int k)
+{
+    queryNum = std::min(queryNum, fp.rows);
+    if (queryNum == 0 || fp.cols == 0) {
+        fprintf(stderr, "%s: no samples\n", fp.name.c_str());
+        return 1;
+    }
+    std::vector<float> queries = makeQueries(fp, queryNum);
+    const float* data = fp.features.data();
+    cv::Mat mat(fp.rows, fp.cols, CV_32F, (void *)data);
+    
+    const char* names[] = {"bruteforce", "sparse", "kdtree"};
+    std::vector<int> exact((size_t)queryNum * k);
+    std::vector<int> indices(k);
+    std::vector<float> dists(k);
+    printf("%s: %d rows, %d beacons, %d queries, k = %d\n", fp.name.c_str(), fp.rows, fp.cols, queryNum, k);
+    for (const char* name : names) {
+        BenchClock::time_point start = BenchClock::now();
+        std::shared_ptr<NavKNNSearch> searcher;
+        if (strcmp(name, "bruteforce") == 0) {
+            searcher = std::make_shared<NavBruteForceKNN>(data, fp.rows, fp.cols);
+        } else if (strcmp(name, "sparse") == 0) {
+            searcher = std::make_shared<NavSparseKNN>(data, fp.rows, fp.cols, NAV_FINGERPRINT_NO_SIGNAL);
+        } else {
+            searcher = std::make_shared<NavFlannKNN>(mat, fp.cols);
+        }
+        double buildUs = elapsedUs(start);
+        
+        int hit = 0;
+        start = BenchClock::now();
+        for (int q = 0; q < queryNum; q++) {
+            searcher->knnSearch(&queries[(size_t)q * fp.cols], k, indices.data(), dists.data());
+            int* truth = &exact[(size_t)q * k];
+            if (strcmp(name, "bruteforce") == 0) {
+                std::copy(indices.begin(), indices.end(), truth);
+            }
+            for (int i = 0; i < k; i++) {
+                hit += indices[i] >= 0 && std::find(truth, truth + k, indices[i]) != truth + k;
+            }
+        }
+        double searchUs = elapsedUs(start);
+        int valid = std::min(k, fp.rows) * queryNum;
+        printf("  %-10s build %.1f ms, %.2f us/query, recall %.4f\n", name, buildUs / 1000, searchUs / queryNum,
+               (double)hit / valid);
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    int queryNum = 200, k = 5;
+    std::vector<std::string> inputs;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            queryNum = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            k = std::max(1, atoi(argv[++i]));
+        } else {
+            inputs.push_back(argv[i]);
+        }
+    }
+    if (inputs.empty()) {
+        inputs = {"1000", "4000", "16000"};
+    }
+    int result = 0;
+    for (const std::string& input : inputs) {
+        Fingerprint fp;
+        char* end;
+        long rows = strtol(input.c_str(), &end, 10);
+        if (*end == '\0' && rows > 0) {
+            fp = synthesize((int)rows);
+        } else if (!load(input.c_str(), fp)) {
+            fprintf(stderr, "Could not load %s\n", input.c_str());
+            result = 1;
+            continue;
+        }
+        result |= benchmark(fp, queryNum, k);
+    }
+    return result;
+}
@@ -0,0 +1,429 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavKNNSearch.hpp"
+
+#include <float.h>
+#include <algorithm>
+
+using namespace std;
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NAV_KNN_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define NAV_KNN_SSE 1
+#endif
+
+namespace {
+
+    // squared L2 of four rows against one query, sharing the query loads
+    inline void dist4(const float* q, const float* r0, const float* r1, const float* r2, const float* r3,
+                      int cols, float* out)
+    {
+        int j = 0;
+#if NAV_KNN_NEON
+        float32x4_t a0 = vdupq_n_f32(0), a1 = a0, a2 = a0, a3 = a0;
+        for (; j + 4 <= cols; j += 4) {
+            float32x4_t qv = vld1q_f32(q + j);
+            float32x4_t d0 = vsubq_f32(vld1q_f32(r0 + j), qv);
+            float32x4_t d1 = vsubq_f32(vld1q_f32(r1 + j), qv);
+            float32x4_t d2 = vsubq_f32(vld1q_f32(r2 + j), qv);
+            float32x4_t d3 = vsubq_f32(vld1q_f32(r3 + j), qv);
+            a0 = vmlaq_f32(a0, d0, d0);
+            a1 = vmlaq_f32(a1, d1, d1);
+            a2 = vmlaq_f32(a2, d2, d2);
+            a3 = vmlaq_f32(a3, d3, d3);
+        }
+        float s[4][4];
+        vst1q_f32(s[0], a0); vst1q_f32(s[1], a1); vst1q_f32(s[2], a2); vst1q_f32(s[3], a3);
+        for (int i = 0; i < 4; i++) {
+            out[i] = s[i][0] + s[i][1] + s[i][2] + s[i][3];
+        }
+#elif NAV_KNN_SSE
+        __m128 a0 = _mm_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+        for (; j + 4 <= cols; j += 4) {
+            __m128 qv = _mm_loadu_ps(q + j);
+            __m128 d0 = _mm_sub_ps(_mm_loadu_ps(r0 + j), qv);
+            __m128 d1 = _mm_sub_ps(_mm_loadu_ps(r1 + j), qv);
+            __m128 d2 = _mm_sub_ps(_mm_loadu_ps(r2 + j), qv);
+            __m128 d3 = _mm_sub_ps(_mm_loadu_ps(r3 + j), qv);
+            a0 = _mm_add_ps(a0, _mm_mul_ps(d0, d0));
+            a1 = _mm_add_ps(a1, _mm_mul_ps(d1, d1));
+            a2 = _mm_add_ps(a2, _mm_mul_ps(d2, d2));
+            a3 = _mm_add_ps(a3, _mm_mul_ps(d3, d3));
+        }
+        float s[4][4];
+        _mm_storeu_ps(s[0], a0); _mm_storeu_ps(s[1], a1); _mm_storeu_ps(s[2], a2); _mm_storeu_ps(s[3], a3);
+        for (int i = 0; i < 4; i++) {
+            out[i] = s[i][0] + s[i][1] + s[i][2] + s[i][3];
+        }
+#else
+        out[0] = out[1] = out[2] = out[3] = 0;
+#endif
+        for (; j < cols; j++) {
+            float d0 = r0[j] - q[j], d1 = r1[j] - q[j], d2 = r2[j] - q[j], d3 = r3[j] - q[j];
+            out[0] += d0 * d0;
+            out[1] += d1 * d1;
+            out[2] += d2 * d2;
+            out[3] += d3 * d3;
+        }
+    }
+
+    inline float dist1(const float* q, const float* r, int cols)
+    {
+        float s = 0;
+        for (int j = 0; j < cols; j++) {
+            float d = r[j] - q[j];
+            s += d * d;
+        }
+        return s;
+    }
+
+    // keeps the k best in ascending order, k is small (KNN_NUM)
+    inline void pushCandidate(int index, float dist, int k, int* indices, float* dists)
+    {
+        if (dist >= dists[k - 1]) {
+            return;
+        }
+        int i = k - 1;
+        while (i > 0 && dists[i - 1] > dist) {
+            dists[i] = dists[i - 1];
+            indices[i] = indices[i - 1];
+            i--;
+        }
+        dists[i] = dist;
+        indices[i] = index;
+    }
+}
+
+NavBruteForceKNN::NavBruteForceKNN(const float* data, int rows, int cols)
+: mData(data), mRows(rows), mCols(cols)
+{
+}
+
+void NavBruteForceKNN::knnSearch(const float* query, int k, int* indices, float* dists)
+{
+    if (k <= 0) {
+        return;
+    }
+    for (int i = 0; i < k; i++) {
+        indices[i] = -1;
+        dists[i] = FLT_MAX;
+    }
+    const size_t stride = (size_t)mCols;
+    int i = 0;
+    float d[4];
+    for (; i + 4 <= mRows; i += 4) {
+        const float *r = mData + i * stride;
+        dist4(query, r, r + stride, r + 2 * stride, r + 3 * stride, mCols, d);
+        pushCandidate(i, d[0], k, indices, dists);
+        pushCandidate(i + 1, d[1], k, indices, dists);
+        pushCandidate(i + 2, d[2], k, indices, dists);
+        pushCandidate(i + 3, d[3], k, indices, dists);
+    }
+    for (; i < mRows; i++) {
+        pushCandidate(i, dist1(query, mData + i * stride, mCols), k, indices, dists);
+    }
+}
+
+NavSparseKNN::NavSparseKNN(const float* data, int rows, int cols, float noSignal)
+: mRows(rows), mCols(cols), mNoSignal(noSignal), mGeneration(0)
+{
+    mColumnStart.assign(cols + 1, 0);
+    for (size_t i = 0, n = (size_t)rows * cols; i < n; i++) {
+        if (data[i] != noSignal) {
+            mColumnStart[i % cols + 1]++;
+        }
+    }
+    for (int j = 0; j < cols; j++) {
+        mColumnStart[j + 1] += mColumnStart[j];
+    }
+    mPostingRow.resize(mColumnStart[cols]);
+    mPostingValue.resize(mColumnStart[cols]);
+    mRowNorm.assign(rows, 0);
+    vector<int32_t> fill(mColumnStart.begin(), mColumnStart.end() - 1);
+    for (int i = 0; i < rows; i++) {
+        const float *row = data + (size_t)i * cols;
+        for (int j = 0; j < cols; j++) {
+            if (row[j] != noSignal) {
+                float v = row[j] - noSignal;
+                mPostingRow[fill[j]] = i;
+                mPostingValue[fill[j]] = v;
+                fill[j]++;
+                mRowNorm[i] += v * v;
+            }
+        }
+    }
+    mRowsByNorm.resize(rows);
+    for (int i = 0; i < rows; i++) {
+        mRowsByNorm[i] = i;
+    }
+    sort(mRowsByNorm.begin(), mRowsByNorm.end(), [this](int32_t a, int32_t b) {
+        return mRowNorm[a] < mRowNorm[b];
+    });
+    mDot.resize(rows);
+    mStamp.assign(rows, 0);
+    mTouched.reserve(rows);
+}
+
+bool NavSparseKNN::isPreferredFor(const float* data, int rows, int cols, float noSignal)
+{
+    if (cols < 64) {
+        return false;
+    }
+    size_t n = (size_t)rows * cols, nonZero = 0;
+    for (size_t i = 0; i < n; i++) {
+        nonZero += data[i] != noSignal;
+    }
+    return nonZero * 10 < n;
+}
+
+void NavSparseKNN::knnSearch(const float* query, int k, int* indices, float* dists)
+{
+    mQueryColumns.clear();
+    mQueryValues.clear();
+    for (int j = 0; j < mCols; j++) {
+        if (query[j] != mNoSignal) {
+            mQueryColumns.push_back(j);
+            mQueryValues.push_back(query[j]);
+        }
+    }
+    knnSearchSparse(mQueryColumns.data(), mQueryValues.data(), (int)mQueryColumns.size(), k, indices, dists);
+}
+
+void NavSparseKNN::knnSearchSparse(const int* columns, const float* values, int n, int k, int* indices, float* dists)
+{
+    if (k <= 0) {
+        return;
+    }
+    for (int i = 0; i < k; i++) {
+        indices[i] = -1;
+        dists[i] = FLT_MAX;
+    }
+    if (++mGeneration == 0) {
+        fill(mStamp.begin(), mStamp.end(), 0);
+        mGeneration = 1;
+    }
+    mTouched.clear();
+
+    double queryNorm = 0;
+    for (int q = 0; q < n; q++) {
+        float qv = values[q] - mNoSignal;
+        if (qv == 0 || columns[q] < 0 || columns[q] >= mCols) {
+            continue;
+        }
+        queryNorm += (double)qv * qv;
+        for (int p = mColumnStart[columns[q]], end = mColumnStart[columns[q] + 1]; p < end; p++) {
+            int32_t r = mPostingRow[p];
+            if (mStamp[r] != mGeneration) {
+                mStamp[r] = mGeneration;
+                mDot[r] = 0;
+                mTouched.push_back(r);
+            }
+            mDot[r] += qv * mPostingValue[p];
+        }
+    }
+
+    for (size_t t = 0; t < mTouched.size(); t++) {
+        int32_t r = mTouched[t];
+        double d = queryNorm + mRowNorm[r] - 2.0 * mDot[r];
+        pushCandidate(r, (float)(d < 0 ? 0 : d), k, indices, dists);
+    }
+    for (int i = 0; i < mRows; i++) {
+        int32_t r = mRowsByNorm[i];
+        float d = (float)(queryNorm + mRowNorm[r]);
+        if (d >= dists[k - 1]) {
+            break;
+        }
+        if (mStamp[r] != mGeneration) {
+            pushCandidate(r, d, k, indices, dists);
+        }
+    }
+}
+
+NavGroupedSparseKNN::NavGroupedSparseKNN(float noSignal)
+: mNoSignal(noSignal), mColumnNum(0), mGeneration(0)
+{
+    mGroupRowStart.push_back(0);
+    mEntryRowStart.push_back(0);
+}
+
+int NavGroupedSparseKNN::addGroup(const float* data, const float* positions, int rows, const int* columns, int cols)
+{
+    int group = groupNum();
+    mGroupColumns.push_back(vector<int32_t>(columns, columns + cols));
+    for (int j = 0; j < cols; j++) {
+        mColumnNum = max(mColumnNum, columns[j] + 1);
+    }
+    for (int i = 0; i < rows; i++) {
+        const float *row = data + (size_t)i * cols;
+        float norm = 0;
+        for (int j = 0; j < cols; j++) {
+            if (row[j] != mNoSignal) {
+                float v = row[j] - mNoSignal;
+                mEntryColumn.push_back(columns[j]);
+                mEntryValue.push_back(v);
+                norm += v * v;
+            }
+        }
+        mEntryRowStart.push_back((int32_t)mEntryColumn.size());
+        mRowGroup.push_back(group);
+        mRowNorm.push_back(norm);
+        mPositions.push_back(positions[i * 2]);
+        mPositions.push_back(positions[i * 2 + 1]);
+    }
+    mGroupRowStart.push_back((int32_t)mRowNorm.size());
+    return group;
+}
+
+void NavGroupedSparseKNN::build()
+{
+    int rows = rowNum(), groups = groupNum();
+
+    mColumnStart.assign(mColumnNum + 1, 0);
+    for (size_t e = 0; e < mEntryColumn.size(); e++) {
+        mColumnStart[mEntryColumn[e] + 1]++;
+    }
+    for (int j = 0; j < mColumnNum; j++) {
+        mColumnStart[j + 1] += mColumnStart[j];
+    }
+    mPostingRow.resize(mEntryColumn.size());
+    mPostingValue.resize(mEntryColumn.size());
+    vector<int32_t> fill(mColumnStart.begin(), mColumnStart.end() - 1);
+    for (int i = 0; i < rows; i++) {
+        for (int e = mEntryRowStart[i]; e < mEntryRowStart[i + 1]; e++) {
+            int32_t p = fill[mEntryColumn[e]]++;
+            mPostingRow[p] = i;
+            mPostingValue[p] = mEntryValue[e];
+        }
+    }
+
+    mColumnGroupStart.assign(mColumnNum + 1, 0);
+    for (int g = 0; g < groups; g++) {
+        for (size_t j = 0; j < mGroupColumns[g].size(); j++) {
+            mColumnGroupStart[mGroupColumns[g][j] + 1]++;
+        }
+    }
+    for (int j = 0; j < mColumnNum; j++) {
+        mColumnGroupStart[j + 1] += mColumnGroupStart[j];
+    }
+    mColumnGroup.resize(mColumnGroupStart[mColumnNum]);
+    fill.assign(mColumnGroupStart.begin(), mColumnGroupStart.end() - 1);
+    for (int g = 0; g < groups; g++) {
+        for (size_t j = 0; j < mGroupColumns[g].size(); j++) {
+            mColumnGroup[fill[mGroupColumns[g][j]]++] = g;
+        }
+    }
+
+    mRowsByNorm.resize(rows);
+    for (int i = 0; i < rows; i++) {
+        mRowsByNorm[i] = i;
+    }
+    for (int g = 0; g < groups; g++) {
+        sort(mRowsByNorm.begin() + mGroupRowStart[g], mRowsByNorm.begin() + mGroupRowStart[g + 1], [this](int32_t a, int32_t b) {
+            return mRowNorm[a] < mRowNorm[b];
+        });
+    }
+
+    vector<int32_t>().swap(mEntryRowStart);
+    vector<int32_t>().swap(mEntryColumn);
+    vector<float>().swap(mEntryValue);
+    vector<vector<int32_t> >().swap(mGroupColumns);
+
+    mDot.resize(rows);
+    mStamp.assign(rows, 0);
+    mTouched.reserve(rows);
+    mGroupQueryNorm.resize(groups);
+}
+
+void NavGroupedSparseKNN::search(const int* columns, const float* values, int n, int k, std::vector<Match>& out)
+{
+    int groups = groupNum();
+    out.resize(groups);
+    if (k <= 0 || groups == 0) {
+        return;
+    }
+    if (++mGeneration == 0) {
+        std::fill(mStamp.begin(), mStamp.end(), 0);
+        mGeneration = 1;
+    }
+    mTouched.clear();
+    std::fill(mGroupQueryNorm.begin(), mGroupQueryNorm.end(), 0.0);
+    mTopIndex.assign((size_t)groups * k, -1);
+    mTopDist.assign((size_t)groups * k, FLT_MAX);
+
+    for (int q = 0; q < n; q++) {
+        int c = columns[q];
+        float qv = values[q] - mNoSignal;
+        if (qv == 0 || c < 0 || c >= mColumnNum) {
+            continue;
+        }
+        for (int p = mColumnGroupStart[c]; p < mColumnGroupStart[c + 1]; p++) {
+            mGroupQueryNorm[mColumnGroup[p]] += (double)qv * qv;
+        }
+        for (int p = mColumnStart[c]; p < mColumnStart[c + 1]; p++) {
+            int32_t r = mPostingRow[p];
+            if (mStamp[r] != mGeneration) {
+                mStamp[r] = mGeneration;
+                mDot[r] = 0;
+                mTouched.push_back(r);
+            }
+            mDot[r] += qv * mPostingValue[p];
+        }
+    }
+
+    for (size_t t = 0; t < mTouched.size(); t++) {
+        int32_t r = mTouched[t];
+        int g = mRowGroup[r];
+        double d = mGroupQueryNorm[g] + mRowNorm[r] - 2.0 * mDot[r];
+        pushCandidate(r, (float)(d < 0 ? 0 : d), k, &mTopIndex[g * k], &mTopDist[g * k]);
+    }
+    for (int g = 0; g < groups; g++) {
+        int *indices = &mTopIndex[g * k];
+        float *dists = &mTopDist[g * k];
+        for (int i = mGroupRowStart[g]; i < mGroupRowStart[g + 1]; i++) {
+            int32_t r = mRowsByNorm[i];
+            float d = (float)(mGroupQueryNorm[g] + mRowNorm[r]);
+            if (d >= dists[k - 1]) {
+                break;
+            }
+            if (mStamp[r] != mGeneration) {
+                pushCandidate(r, d, k, indices, dists);
+            }
+        }
+
+        Match &m = out[g];
+        m.group = g;
+        m.dist = dists[0];
+        m.x = m.y = 0;
+        float distSum = 0;
+        for (int i = 0; i < k && indices[i] >= 0; i++) {
+            m.x += mPositions[indices[i] * 2] / (dists[i] + 1e-20);
+            m.y += mPositions[indices[i] * 2 + 1] / (dists[i] + 1e-20);
+            distSum += 1 / (dists[i] + 1e-20);
+        }
+        m.x /= (distSum + 1e-20);
+        m.y /= (distSum + 1e-20);
+    }
+}
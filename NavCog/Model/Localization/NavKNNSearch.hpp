@@ -0,0 +1,157 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavKNNSearch_hpp
+#define NavKNNSearch_hpp
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// kNN search over a row-major float matrix. Distances are squared L2 to match
+// what cv::flann::Index reports for KDTreeLocalization's knndist.
+class NavKNNSearch {
+public:
+    virtual ~NavKNNSearch() {}
+    // fills indices/dists with k neighbours ordered by distance,
+    // unused slots (k > rows) get index -1 and FLT_MAX
+    virtual void knnSearch(const float* query, int k, int* indices, float* dists) = 0;
+    virtual const char* name() const = 0;
+};
+
+// Exact scan over all rows. The query stays in registers/L1 while rows are
+// streamed four at a time, using NEON or SSE when available.
+// The data is referenced, not copied, and must outlive the searcher.
+class NavBruteForceKNN : public NavKNNSearch {
+public:
+    NavBruteForceKNN(const float* data, int rows, int cols);
+    void knnSearch(const float* query, int k, int* indices, float* dists);
+    const char* name() const { return "bruteforce"; }
+
+    // up to this many rows the exact scan is expected to beat the KD-forest
+    static const int kPreferredMaxRows = 4096;
+
+private:
+    const float* mData;
+    int mRows;
+    int mCols;
+};
+
+// Exact search over a sparse copy of the matrix. Cells equal to noSignal are
+// dropped and every other cell is kept as (value - noSignal) in a per-column
+// inverted index. With q' and r' shifted that way
+//   |q - r|^2 = |q'|^2 + |r'|^2 - 2 q'.r'
+// where only columns present in both contribute to q'.r', so a query only
+// visits rows sharing a column with it. Rows sharing nothing have distance
+// |q'|^2 + |r'|^2 and are taken in ascending |r'|^2 order until they can no
+// longer beat the k-th candidate. The dense data is not referenced after
+// construction.
+class NavSparseKNN : public NavKNNSearch {
+public:
+    NavSparseKNN(const float* data, int rows, int cols, float noSignal);
+    void knnSearch(const float* query, int k, int* indices, float* dists);
+    // values for the listed columns, every other column is noSignal
+    void knnSearchSparse(const int* columns, const float* values, int n, int k, int* indices, float* dists);
+    const char* name() const { return "sparse"; }
+
+    size_t nonZeroNum() const { return mPostingRow.size(); }
+    // the sparse index pays off once most cells are filler
+    static bool isPreferredFor(const float* data, int rows, int cols, float noSignal);
+
+private:
+    int mRows;
+    int mCols;
+    float mNoSignal;
+    std::vector<int32_t> mColumnStart;  // cols + 1 offsets into the postings
+    std::vector<int32_t> mPostingRow;
+    std::vector<float> mPostingValue;   // shifted by -noSignal
+    std::vector<float> mRowNorm;        // |r'|^2
+    std::vector<int32_t> mRowsByNorm;
+
+    // per query scratch
+    std::vector<float> mDot;
+    std::vector<uint32_t> mStamp;
+    std::vector<int32_t> mTouched;
+    std::vector<int> mQueryColumns;
+    std::vector<float> mQueryValues;
+    uint32_t mGeneration;
+};
+
+// Sparse search over several fingerprint tables at once (one group per
+// table) sharing a global column space. Every group only sees its own
+// columns, so a group's distances equal those of a NavSparseKNN built on that
+// table alone: query energy in columns the group does not have is not counted.
+// One search returns the k nearest rows of every group.
+class NavGroupedSparseKNN {
+public:
+    struct Match {
+        int group;
+        float x, y;  // inverse distance weighted position of the k nearest rows
+        float dist;  // distance to the nearest row, FLT_MAX for an empty group
+    };
+
+    explicit NavGroupedSparseKNN(float noSignal);
+
+    // columns maps the table's columns into the global column space
+    int addGroup(const float* data, const float* positions, int rows, const int* columns, int cols);
+    void build();
+
+    // fills out with one Match per group in group order
+    void search(const int* columns, const float* values, int n, int k, std::vector<Match>& out);
+
+    int groupNum() const { return (int)mGroupRowStart.size() - 1; }
+    int rowNum() const { return (int)mRowNorm.size(); }
+
+private:
+    float mNoSignal;
+    int mColumnNum;
+
+    // rows in insertion order, grouped contiguously
+    std::vector<int32_t> mGroupRowStart;
+    std::vector<int32_t> mRowGroup;
+    std::vector<float> mPositions;
+    std::vector<float> mRowNorm;
+    std::vector<int32_t> mRowsByNorm;      // sorted by norm within each group range
+
+    // build input, row major triplets
+    std::vector<int32_t> mEntryRowStart;
+    std::vector<int32_t> mEntryColumn;
+    std::vector<float> mEntryValue;
+    std::vector<std::vector<int32_t> > mGroupColumns;
+
+    std::vector<int32_t> mColumnStart;     // postings per global column
+    std::vector<int32_t> mPostingRow;
+    std::vector<float> mPostingValue;
+    std::vector<int32_t> mColumnGroupStart; // groups owning each global column
+    std::vector<int32_t> mColumnGroup;
+
+    // per query scratch
+    std::vector<float> mDot;
+    std::vector<uint32_t> mStamp;
+    std::vector<int32_t> mTouched;
+    std::vector<double> mGroupQueryNorm;
+    std::vector<int> mTopIndex;
+    std::vector<float> mTopDist;
+    uint32_t mGeneration;
+};
+
+#endif /* NavKNNSearch_hpp */
@@ -64,6 +64,7 @@
 @property(nonatomic) NSString* edgeID;
 @property NSArray<NavLineSegment*> *lineSegments;
 @property int floor;
+@property (readonly) NSData *packedSegments; // double x1, y1, x2, y2 per segment for NavPolylineDistance
 
 - (id) initWithEdge: (NavEdge*) edge;
 - (NavLineSegment*) getNearestSegmentFromPoint:(Nav2DPoint*) p;
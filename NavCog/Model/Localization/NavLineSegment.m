@@ -160,6 +160,16 @@
     }
     
     _lineSegments = lineSegments;
+    
+    NSMutableData *packed = [NSMutableData dataWithLength:sizeof(double) * 4 * lineSegments.count];
+    double *p = (double *)packed.mutableBytes;
+    for (NavLineSegment *seg in lineSegments) {
+        *p++ = seg.point1.x;
+        *p++ = seg.point1.y;
+        *p++ = seg.point2.x;
+        *p++ = seg.point2.y;
+    }
+    _packedSegments = packed;
     return self;
 }
 
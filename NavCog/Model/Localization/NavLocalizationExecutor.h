@@ -0,0 +1,45 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#import <Foundation/Foundation.h>
+#import "NavBeaconScan.h"
+
+// Runs all localizer work off the main thread.
+//
+// Localizer state is only touched on one serial localization queue, so
+// sensor input, initialization and result queries never interleave. Within
+// one beacon scan the independent localizers are updated in parallel on a
+// fixed pool of worker threads.
+@interface NavLocalizationExecutor : NSObject
+
++ (instancetype)sharedInstance;
+
+// run the block on the localization queue, inline if already on it
+- (void)performSync:(dispatch_block_t)block;
+- (void)performAsync:(dispatch_block_t)block;
+- (BOOL)isCurrentQueue;
+
+// feeds the scan to every receiver in parallel and returns when all are
+// done, must be called on the localization queue
+- (void)inputBeaconScan:(NavBeaconScan *)scan toReceivers:(NSArray *)receivers;
+
+@end
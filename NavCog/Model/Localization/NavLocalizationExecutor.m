@@ -0,0 +1,89 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#import "NavLocalizationExecutor.h"
+
+@interface NavLocalizationExecutor ()
+
+@property (nonatomic) dispatch_queue_t queue;
+@property (nonatomic) dispatch_queue_t workers;
+
+@end
+
+@implementation NavLocalizationExecutor
+
+static void *queueKey = &queueKey;
+
++ (instancetype)sharedInstance
+{
+    static NavLocalizationExecutor *instance;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        instance = [[NavLocalizationExecutor alloc] init];
+    });
+    return instance;
+}
+
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _queue = dispatch_queue_create("com.navcog.localization", DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(_queue, queueKey, queueKey, NULL);
+        // dispatch_apply does not use more threads than there are active cores
+        _workers = dispatch_queue_create("com.navcog.localization.workers", DISPATCH_QUEUE_CONCURRENT);
+    }
+    return self;
+}
+
+- (BOOL)isCurrentQueue
+{
+    return dispatch_get_specific(queueKey) == queueKey;
+}
+
+- (void)performSync:(dispatch_block_t)block
+{
+    if ([self isCurrentQueue]) {
+        block();
+    } else {
+        dispatch_sync(_queue, block);
+    }
+}
+
+- (void)performAsync:(dispatch_block_t)block
+{
+    dispatch_async(_queue, block);
+}
+
+- (void)inputBeaconScan:(NavBeaconScan *)scan toReceivers:(NSArray *)receivers
+{
+    NSAssert([self isCurrentQueue], @"%@ is called outside of the localization queue", NSStringFromSelector(_cmd));
+    if (receivers.count == 1) {
+        [(id<NavBeaconScanReceiver>)receivers[0] inputBeaconScan:scan];
+        return;
+    }
+    dispatch_apply(receivers.count, _workers, ^(size_t i) {
+        [(id<NavBeaconScanReceiver>)receivers[i] inputBeaconScan:scan];
+    });
+}
+
+@end
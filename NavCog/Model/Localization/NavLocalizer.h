@@ -23,23 +23,39 @@
 #import <Foundation/Foundation.h>
 #import <CoreMotion/CoreMotion.h>
 #import "NavLocalizeResult.h"
+#import "NavBeaconScan.h"
 
 @class NavLocalizeResult;
 
-@interface NavLocalizer : NSObject
+@interface NavLocalizer : NSObject <NavBeaconScanReceiver>
 
 @property (readonly) NSString *idStr;
 
 - (instancetype) initWithID:(NSString*) idStr;
 
+// localizers may defer building their search structures until they are first
+// needed, unprepared localizers do not need to be fed sensor data
+@property (readonly) BOOL prepared;
+- (void) prepare;
+
 - (void) initializeState:(NSDictionary*) options;
 - (void) inputBeacons: (NSArray *) beacons;
+// one scan is shared by all localizers, the default forwards scan.beacons
+- (void) inputBeaconScan: (NavBeaconScan *) scan;
 - (void) inputAcceleration: (NSDictionary*) data;
 - (void) inputMotion: (NSDictionary*) data;
 
 - (NavLocalizeResult*)getLocation;
 - (double) computeDistanceScoreWithOptions: (NSDictionary*) options;
 
+// Scores for {edgeID} options are memoized by edge and mode until the
+// localizer gets new input. Callers feeding input begin a new epoch, motion
+// only does so for localizers whose scores depend on it.
+- (void) beginInputEpoch;
+- (double) cachedDistanceScoreWithOptions: (NSDictionary*) options;
+@property (readonly) BOOL distanceScoreDependsOnMotion;
+@property (readonly) NSInteger distanceScoreMode;
+
 @end
 
 
@@ -23,8 +23,21 @@
 #import <Foundation/Foundation.h>
 #import "NavLocalizer.h"
 
+@interface NavLocalizer ()
+
+@property NSUInteger inputEpoch;
+@property NSUInteger scoreCacheEpoch;
+@property NSMutableDictionary *scoreCache; // edgeID -> @[mode, score]
+
+@end
+
 @implementation NavLocalizer
 
+// shared by all localizers, only used on the localization queue
+static NSUInteger scoreCacheHits = 0;
+static NSUInteger scoreCacheMisses = 0;
+static NSTimeInterval scoreCacheMissTime = 0;
+
 - (instancetype) initWithID: (NSString*) idStr
 {
     self = [super init];
@@ -32,6 +45,15 @@
     return self;
 }
 
+- (BOOL)prepared
+{
+    return YES;
+}
+
+- (void)prepare
+{
+}
+
 - (void)initializeState:(NSDictionary*) options
 {
     [NSException raise:NSInternalInconsistencyException
@@ -51,6 +73,11 @@
                 format:@"%@ is not override", NSStringFromSelector(_cmd)];
 }
 
+- (void) inputBeaconScan:(NavBeaconScan *)scan
+{
+    [self inputBeacons:scan.beacons];
+}
+
 - (void) inputAcceleration: (NSDictionary*) data
 {
 }
@@ -63,4 +90,51 @@
     return 100;
 }
 
+- (void) beginInputEpoch
+{
+    _inputEpoch++;
+}
+
+- (BOOL) distanceScoreDependsOnMotion
+{
+    return NO;
+}
+
+- (NSInteger) distanceScoreMode
+{
+    return 0;
+}
+
+- (double) cachedDistanceScoreWithOptions: (NSDictionary*) options
+{
+    NSString *edgeID = options[@"edgeID"];
+    if (!edgeID || options.count != 1) {
+        return [self computeDistanceScoreWithOptions:options];
+    }
+    if (!_scoreCache || _scoreCacheEpoch != _inputEpoch) {
+        _scoreCache = [@{} mutableCopy];
+        _scoreCacheEpoch = _inputEpoch;
+    }
+    NSInteger mode = self.distanceScoreMode;
+    NSArray *entry = _scoreCache[edgeID];
+    double score;
+    if (entry && [entry[0] integerValue] == mode) {
+        score = [entry[1] doubleValue];
+        scoreCacheHits++;
+    } else {
+        NSDate *start = [NSDate date];
+        score = [self computeDistanceScoreWithOptions:options];
+        scoreCacheMissTime += [[NSDate date] timeIntervalSinceDate:start];
+        scoreCacheMisses++;
+        _scoreCache[edgeID] = @[@(mode), @(score)];
+    }
+    NSUInteger total = scoreCacheHits + scoreCacheMisses;
+    if (total % 1000 == 0) {
+        // a hit saves what a miss costs on average
+        NSLog(@"ScoreCache,%lu,%lu,%f,%f", (unsigned long)scoreCacheHits, (unsigned long)scoreCacheMisses,
+              (double)scoreCacheHits / total, scoreCacheHits * scoreCacheMissTime * 1000 / scoreCacheMisses);
+    }
+    return score;
+}
+
 @end
\ No newline at end of file
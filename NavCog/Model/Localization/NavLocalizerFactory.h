@@ -25,10 +25,15 @@
 #import "NavEdgeLocalizer.h"
 #import "TopoMap.h"
 
+@class NavGlobalFingerprintIndex;
+
 @interface NavLocalizerFactory : NSObject
 
 + (void) reset;
 
+// index over all 1D_Beacon fingerprints, see NavCurrentLocationManager
++ (NavGlobalFingerprintIndex*) globalFingerprintIndex;
+
 + (NSArray*) allCoreLocalizers;
 + (NSArray*) allEdgeLocalizers;
 
@@ -38,11 +43,10 @@
 + (NavLocalizer*) localizerForID:(NSString*)idStr withEdgeInfo:(NavLightEdge*) edgeInfo andOptions:(NSDictionary*)options;
 + (NavLocalizer*) createLocalizer:(NSDictionary*)loc;
 + (NavLocalizer*) create1D_KNN_LocalizerForID:(NSString*) idStr FromFile:(NSString*)path;
++ (NavLocalizer*) create1D_KNN_LocalizerForID:(NSString**) idStr FromData:(NSString*)dataStr;
 + (NavLocalizer*) create2D_PF_PDR_LocalizerForID:(NSString*) idStr FromFile:(NSString*)path;
 + (NavLocalizer*) create2D_PF_PDR_LocalizerForID:(NSString *)idStr onFloor:(int) floor;
 
 + (NavLocalizer*) create1D_PF_PDR_LocalizerForID:(NSString*) idStr FromFile:(NSString*)path;
 
-+ (NavEdgeLocalizer*) cloneLocalizerForEdge:(NSString*) edgeID withEdgeInfo:(NavLightEdge*) edgeInfo;
-
 @end
@@ -27,23 +27,48 @@
 #import "TwoDFloorLocalizer.h"
 #import "NavEdgeLocalizer.h"
 #import "NavUtil.h"
+#import "NavGlobalFingerprintIndex.h"
+#import "NavFingerprintData.hpp"
+
+using namespace std;
 
 @implementation NavLocalizerFactory
 
 static const NSMutableDictionary *navLocalizers = [[NSMutableDictionary alloc] init];
 static const NSMutableDictionary *floorLocalizers = [[NSMutableDictionary alloc] init];
 static const NSMutableDictionary *edgeLocalizers = [[NSMutableDictionary alloc] init];
+static const NSMutableDictionary *knnLocalizersByContent = [[NSMutableDictionary alloc] init];
+static NSArray *uniqueCoreLocalizers = nil;
+static NavGlobalFingerprintIndex *globalIndex = [[NavGlobalFingerprintIndex alloc] init];
 
 + (void) reset
 {
     [navLocalizers removeAllObjects];
     [floorLocalizers removeAllObjects];
     [edgeLocalizers removeAllObjects];
+    [knnLocalizersByContent removeAllObjects];
+    uniqueCoreLocalizers = nil;
+    globalIndex = [[NavGlobalFingerprintIndex alloc] init];
+}
+
++ (void) setCoreLocalizer:(NavLocalizer*)loc forID:(NSString*)idStr
+{
+    [navLocalizers setObject:loc forKey:idStr];
+    uniqueCoreLocalizers = nil;
+}
+
++ (NavGlobalFingerprintIndex*) globalFingerprintIndex
+{
+    return globalIndex;
 }
 
+// IDs sharing one localizer (same fingerprint content) are listed once
 + (NSArray*) allCoreLocalizers
 {
-    return [navLocalizers allValues];
+    if (!uniqueCoreLocalizers) {
+        uniqueCoreLocalizers = [[NSOrderedSet orderedSetWithArray:[navLocalizers allValues]] array];
+    }
+    return uniqueCoreLocalizers;
 }
 
 + (NSArray*) allEdgeLocalizers
@@ -92,6 +117,11 @@ static const NSMutableDictionary *edgeLocalizers = [[NSMutableDictionary alloc]
 {
     NSString *idStr = [loc objectForKey:@"id"];
     NSString *type = [loc objectForKey:@"type"];
+    if ([type isEqualToString:@"1D_Beacon"]) {
+        NavLocalizer *localizer = [NavLocalizerFactory create1D_KNN_LocalizerForID:&idStr FromData:[loc objectForKey:@"dataFile"]];
+        [loc removeObjectForKey:@"dataFile"];
+        return localizer;
+    }
     NSString *path = [NavUtil createTempFile:[loc objectForKey:@"dataFile"] forID:&idStr];
     [loc removeObjectForKey:@"dataFile"];
     
@@ -107,31 +137,58 @@ static const NSMutableDictionary *edgeLocalizers = [[NSMutableDictionary alloc]
     else if ([type isEqualToString:@"1D_Beacon_PDR"]) {
         return [NavLocalizerFactory create1D_PF_PDR_LocalizerForID:idStr FromFile:path];
     }
-    else if ([type isEqualToString:@"1D_Beacon"]) {
-        return [NavLocalizerFactory create1D_KNN_LocalizerForID:idStr FromFile:path];
-    }
     return nil;
 }
 
 + (NavLocalizer*) create1D_KNN_LocalizerForID:(NSString *)idStr FromFile:(NSString *)path
 {
-    KDTreeLocalization *loc = [[KDTreeLocalization alloc] init];
+    KDTreeLocalization *loc = [[KDTreeLocalization alloc] initWithID:idStr];
     
-    [loc initializeWithAbsolutePath:path];
+    shared_ptr<NavFingerprintData> fingerprint = [KDTreeLocalization loadFingerprint:path];
+    if (fingerprint) {
+        [loc initializeWithFingerprint:fingerprint];
+        [globalIndex addFingerprint:fingerprint forLocalizerID:idStr];
+    }
     
     if (idStr) {
-        [navLocalizers setObject:loc forKey:idStr];
+        [NavLocalizerFactory setCoreLocalizer:loc forID:idStr];
     }
     return loc;
 }
 
+// Edges with identical fingerprint data share one localizer, keyed by a hash
+// of the data. Without an ID the content key becomes the ID. The data is
+// parsed in memory and the kNN index is built when the localizer is prepared.
++ (NavLocalizer*) create1D_KNN_LocalizerForID:(NSString**) idStr FromData:(NSString*)dataStr
+{
+    NSData *data = [NavUtil dataFromDataString:dataStr type:nil];
+    NSString *contentKey = [NSString stringWithFormat:@"knn-%016llx-%lu",
+                            (unsigned long long)NavFingerprintData::hashBytes(data.bytes, data.length), (unsigned long)data.length];
+    if (*idStr == nil) {
+        *idStr = contentKey;
+    }
+    
+    KDTreeLocalization *loc = knnLocalizersByContent[contentKey];
+    if (!loc) {
+        loc = [[KDTreeLocalization alloc] initWithID:*idStr];
+        shared_ptr<NavFingerprintData> fingerprint = [KDTreeLocalization loadFingerprintFromData:data];
+        if (fingerprint) {
+            [loc initializeWithFingerprint:fingerprint];
+            [globalIndex addFingerprint:fingerprint forLocalizerID:loc.idStr];
+        }
+        [knnLocalizersByContent setObject:loc forKey:contentKey];
+    }
+    [NavLocalizerFactory setCoreLocalizer:loc forID:*idStr];
+    return loc;
+}
+
 + (NavLocalizer*) create1D_PF_PDR_LocalizerForID:(NSString*) idStr FromFile:(NSString*)path
 {
     OneDLocalizer *loc = [[OneDLocalizer alloc] initWithID:idStr];
     [loc initializeWithFile: path];
     
     if (idStr && loc) {
-        [navLocalizers setObject:loc forKey:idStr];
+        [NavLocalizerFactory setCoreLocalizer:loc forID:idStr];
     }
     return loc;
 }
@@ -154,7 +211,7 @@ static const NSMutableDictionary *edgeLocalizers = [[NSMutableDictionary alloc]
     [loc initializeWithJSON: json];
 
     if (idStr && loc) {
-        [navLocalizers setObject:loc forKey:idStr];
+        [NavLocalizerFactory setCoreLocalizer:loc forID:idStr];
     }
     return loc;
 }
@@ -173,12 +230,4 @@ static const NSMutableDictionary *edgeLocalizers = [[NSMutableDictionary alloc]
     return [floorLocalizers objectForKey:idStrFloor];
 }
 
-+ (NavEdgeLocalizer *)cloneLocalizerForEdge:(NSString *)edgeID withEdgeInfo:(NavLightEdge *)edgeInfo
-{
-    NavEdgeLocalizer *nel = [[edgeLocalizers objectForKey:edgeID] cloneWithEdgeInfo:edgeInfo];
-    
-    [edgeLocalizers setObject:nel forKey:edgeInfo.edgeID];
-    return nel;
-}
-
 @end
@@ -0,0 +1,98 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavMahalanobisTable.hpp"
+#include <algorithm>
+
+static const double kProbeCenter = -75;
+static const double kProbeStep = 25;
+
+NavMahalanobisTable::NavMahalanobisTable(int stateNum, const Probe& probe)
+: mStateNum(stateNum), mProbe(probe), mDists(stateNum)
+{
+}
+
+int NavMahalanobisTable::column(int major, int minor)
+{
+    int64_t key = ((int64_t)major << 32) | (uint32_t)minor;
+    auto it = mColumnOf.find(key);
+    if (it == mColumnOf.end()) {
+        int col = (int)mKnown.size();
+        std::vector<double> lo(mStateNum), mid(mStateNum), hi(mStateNum);
+        bool known = mProbe(major, minor, kProbeCenter - kProbeStep, lo.data()) &&
+                     mProbe(major, minor, kProbeCenter, mid.data()) &&
+                     mProbe(major, minor, kProbeCenter + kProbeStep, hi.data());
+        mKnown.push_back(known);
+        mA.push_back(std::vector<double>());
+        mB.push_back(std::vector<double>());
+        mC.push_back(std::vector<double>());
+        if (known) {
+            std::vector<double>& a = mA.back();
+            std::vector<double>& b = mB.back();
+            a.resize(mStateNum);
+            b.resize(mStateNum);
+            for (int s = 0; s < mStateNum; s++) {
+                a[s] = (lo[s] + hi[s] - 2 * mid[s]) / (2 * kProbeStep * kProbeStep);
+                b[s] = (hi[s] - lo[s]) / (2 * kProbeStep);
+            }
+            mC.back().swap(mid);
+        }
+        it = mColumnOf.insert(std::make_pair(key, col)).first;
+    }
+    return mKnown[it->second] ? it->second : -1;
+}
+
+void NavMahalanobisTable::distances(const int* columns, const double* rssi, int n, double* dists) const
+{
+    std::fill(dists, dists + mStateNum, 0.0);
+    for (int i = 0; i < n; i++) {
+        if (columns[i] < 0) {
+            continue;
+        }
+        const double* a = mA[columns[i]].data();
+        const double* b = mB[columns[i]].data();
+        const double* c = mC[columns[i]].data();
+        const double t = rssi[i] - kProbeCenter;
+        // contiguous and branch free, vectorized by the compiler
+        for (int s = 0; s < mStateNum; s++) {
+            dists[s] += c[s] + t * (b[s] + t * a[s]);
+        }
+    }
+}
+
+int NavMahalanobisTable::nearest(const int* columns, const double* rssi, int n, double* dist)
+{
+    if (mStateNum == 0) {
+        return -1;
+    }
+    distances(columns, rssi, n, mDists.data());
+    int best = 0;
+    for (int s = 1; s < mStateNum; s++) {
+        if (mDists[s] < mDists[best]) {
+            best = s;
+        }
+    }
+    if (dist) {
+        *dist = mDists[best];
+    }
+    return best;
+}
@@ -0,0 +1,70 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavMahalanobisTable_hpp
+#define NavMahalanobisTable_hpp
+
+#include <stdint.h>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// Mahalanobis distances of beacon scans over a fixed set of states.
+//
+// For a Gaussian RSSI model the term a beacon adds to the distance,
+// ((rssi - mean) / stdev)^2, is quadratic in the observed rssi. A beacon's
+// column is probed from the model at three RSSI values the first time the
+// beacon is observed and kept as coefficients per state (one contiguous array
+// per coefficient and column), so evaluating a scan over all states is a few
+// multiply-adds per state and beacon instead of a model prediction.
+class NavMahalanobisTable {
+public:
+    // fills dists (one per state) with the distance of a scan holding only
+    // the given beacon, returns false if the model does not know the beacon
+    typedef std::function<bool(int major, int minor, double rssi, double* dists)> Probe;
+
+    NavMahalanobisTable(int stateNum, const Probe& probe);
+
+    int stateNum() const { return mStateNum; }
+    int columnNum() const { return (int)mKnown.size(); }
+
+    // column of a beacon, probed on first use, -1 if the model does not know it
+    int column(int major, int minor);
+
+    // dists[s] = sum of the terms of the observations at state s
+    void distances(const int* columns, const double* rssi, int n, double* dists) const;
+    // state with the smallest distance, the first one on ties
+    int nearest(const int* columns, const double* rssi, int n, double* dist);
+    // distances of all states computed by the last nearest()
+    const double* lastDistances() const { return mDists.data(); }
+
+private:
+    int mStateNum;
+    Probe mProbe;
+    std::unordered_map<int64_t, int> mColumnOf;
+    std::vector<char> mKnown;
+    // term(rssi) = c + t * (b + t * a) with t = rssi - kProbeCenter
+    std::vector<std::vector<double> > mA, mB, mC;
+    std::vector<double> mDists;
+};
+
+#endif /* NavMahalanobisTable_hpp */
@@ -0,0 +1,65 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavMemoryStream_hpp
+#define NavMemoryStream_hpp
+
+#include <stddef.h>
+#include <istream>
+#include <streambuf>
+
+// std::istream over bytes owned by someone else (a mapped file, an NSData),
+// for loaders that take a stream. Nothing is copied, the bytes must outlive
+// the stream.
+class NavMemoryStreamBuf : public std::streambuf {
+public:
+    NavMemoryStreamBuf(const char* data, size_t len) {
+        char* p = const_cast<char*>(data);
+        setg(p, p, p + len);
+    }
+
+protected:
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+        char* p = dir == std::ios_base::beg ? eback() : (dir == std::ios_base::end ? egptr() : gptr());
+        p += off;
+        if (!(which & std::ios_base::in) || p < eback() || p > egptr()) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), p, egptr());
+        return pos_type(p - eback());
+    }
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which) {
+        return seekoff(off_type(pos), std::ios_base::beg, which);
+    }
+};
+
+class NavMemoryStream : public std::istream {
+public:
+    NavMemoryStream(const char* data, size_t len) : std::istream(NULL), mBuf(data, len) {
+        rdbuf(&mBuf);
+    }
+
+private:
+    NavMemoryStreamBuf mBuf;
+};
+
+#endif /* NavMemoryStream_hpp */
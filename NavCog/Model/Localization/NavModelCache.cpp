@@ -0,0 +1,115 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavModelCache.hpp"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sstream>
+
+NavModelCacheFile::NavModelCacheFile()
+: mMapped(NULL), mMappedLength(0), mPayload(NULL), mPayloadLength(0)
+{
+}
+
+NavModelCacheFile::~NavModelCacheFile()
+{
+    close();
+}
+
+bool NavModelCacheFile::open(const std::string& path, uint64_t key)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(NavModelCacheHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) {
+        return false;
+    }
+    mMapped = p;
+    mMappedLength = (size_t)st.st_size;
+    
+    NavModelCacheHeader h;
+    memcpy(&h, p, sizeof(h));
+    if (memcmp(h.magic, NAV_MODEL_CACHE_MAGIC, 4) != 0 || h.version != NAV_MODEL_CACHE_VERSION ||
+        h.key != key || h.length != mMappedLength - sizeof(h)) {
+        close();
+        return false;
+    }
+    // the payload is read once from start to end
+    madvise(mMapped, mMappedLength, MADV_SEQUENTIAL);
+    mPayload = (const char*)mMapped + sizeof(h);
+    mPayloadLength = (size_t)h.length;
+    return true;
+}
+
+void NavModelCacheFile::close()
+{
+    if (mMapped) {
+        munmap(mMapped, mMappedLength);
+    }
+    mMapped = NULL;
+    mMappedLength = 0;
+    mPayload = NULL;
+    mPayloadLength = 0;
+}
+
+bool NavModelCacheFile::write(const std::string& path, uint64_t key, const std::function<void(std::ostream&)>& save)
+{
+    std::ostringstream os;
+    save(os);
+    if (!os) {
+        return false;
+    }
+    std::string payload = os.str();
+    
+    NavModelCacheHeader h;
+    memcpy(h.magic, NAV_MODEL_CACHE_MAGIC, 4);
+    h.version = NAV_MODEL_CACHE_VERSION;
+    h.key = key;
+    h.length = payload.size();
+    
+    std::string tmpPath = path + ".tmp";
+    FILE* fp = fopen(tmpPath.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+    bool ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+              fwrite(payload.data(), 1, payload.size(), fp) == payload.size();
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
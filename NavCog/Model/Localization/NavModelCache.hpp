@@ -0,0 +1,78 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavModelCache_hpp
+#define NavModelCache_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <ostream>
+#include <string>
+
+// Cache file of a serialized model keyed by a hash of everything the model
+// was trained from, so a changed map never picks up a stale model.
+//
+// File: NavModelCacheHeader followed by the payload as written by the
+// model's save(). The payload is read through a mapping of the file, the
+// model's load() gets a NavMemoryStream over it.
+//
+// The container saves the file I/O but not the parse: bleloc's models only
+// serialize to and from streams in their text format, so a payload of raw
+// parameter arrays needs a binary save()/load() in bleloc first. The version
+// is there to switch the payload format then.
+
+#define NAV_MODEL_CACHE_MAGIC "NVMC"
+#define NAV_MODEL_CACHE_VERSION 1
+
+struct NavModelCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint64_t length; // of the payload
+};
+
+class NavModelCacheFile {
+public:
+    NavModelCacheFile();
+    ~NavModelCacheFile();
+
+    // maps the file, fails unless it is complete and written for key
+    bool open(const std::string& path, uint64_t key);
+    void close();
+    const char* payload() const { return mPayload; }
+    size_t payloadLength() const { return mPayloadLength; }
+
+    // writes next to path and renames, readers never see a partial file
+    static bool write(const std::string& path, uint64_t key, const std::function<void(std::ostream&)>& save);
+
+private:
+    NavModelCacheFile(const NavModelCacheFile&);
+    NavModelCacheFile& operator=(const NavModelCacheFile&);
+
+    void* mMapped;
+    size_t mMappedLength;
+    const char* mPayload;
+    size_t mPayloadLength;
+};
+
+#endif /* NavModelCache_hpp */
@@ -0,0 +1,424 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavParticleLocalizer.hpp"
+#include "NavPolylineDistance.hpp"
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sstream>
+
+#include <bleloc/PoseRandomWalker.hpp>
+#include <bleloc/GridResampler.hpp>
+#include <bleloc/PedometerWalkingState.hpp>
+#include <bleloc/Building.hpp>
+#include <bleloc/PoseRandomWalkerInBuilding.hpp>
+#include <bleloc/CleansingBeaconFilter.hpp>
+#include <bleloc/StrongestBeaconFilter.hpp>
+#include <bleloc/MetropolisSampler.hpp>
+
+using namespace loc;
+
+static const double kFeetInMeter = 0.3048;
+
+NavParticleLocalizer::Config NavParticleLocalizer::Config::oneD()
+{
+    Config c;
+    // The initial velocity of a particle is sampled from a truncated normal distribution
+    c.meanVelocity = 1.0;
+    c.stdVelocity = 0.6;
+    c.diffusionVelocity = 0.30; // noise added to the velocity of a particle [m/s/s]
+    // without effective beacon information the average speed stays around (min+max)/2
+    c.minVelocity = 0.1;
+    c.maxVelocity = 3.0;
+    c.stdOrientation = 3.0/180.0*M_PI; // noise added to the orientation from the sensor
+    c.stdX = 0; // zero in 1D
+    c.stdY = 2;
+    c.meanRssiBias = 0.0;
+    c.stdRssiBias = 2.0;
+    c.diffusionRssiBias = 0.2; // [dBm/s]
+    c.diffusionOrientationBias = 1.0/180*M_PI; // [rad/s]
+    c.walkDetectSigmaThreshold = 0;
+    c.locationStdLowerBound = 0;
+    c.mixtureProbability = 0;
+    c.cleansesBeacons = true;
+    c.samplesByObservation = false;
+    c.usesAttitude = false; // ignore gyro sensor
+    c.resetStdX = 0.25;
+    c.resetStdY = 0.25;
+    c.resetStdOrientation = 1.0/180.0*M_PI;
+    return c;
+}
+
+NavParticleLocalizer::Config NavParticleLocalizer::Config::twoD()
+{
+    Config c;
+    c.meanVelocity = 1.0;
+    c.stdVelocity = 0.3;
+    c.diffusionVelocity = 0.1;
+    c.minVelocity = 0.1;
+    c.maxVelocity = 1.5;
+    c.stdOrientation = 3.0/180.0*M_PI;
+    c.stdX = 2.0;
+    c.stdY = 2.0;
+    c.meanRssiBias = -2.0;
+    c.stdRssiBias = 2.0;
+    c.diffusionRssiBias = 0.2;
+    c.diffusionOrientationBias = 10.0/180*M_PI;
+    c.walkDetectSigmaThreshold = 0;
+    c.locationStdLowerBound = 0.5;
+    c.mixtureProbability = 0.001;
+    c.cleansesBeacons = false;
+    c.samplesByObservation = true;
+    c.usesAttitude = true;
+    c.resetStdX = 0.25;
+    c.resetStdY = 0.25;
+    c.resetStdOrientation = 30.0/180.0*M_PI;
+    return c;
+}
+
+NavParticleLocalizer::NavParticleLocalizer(const std::string& name, const Config& config)
+: mName(name), mConfig(config), mStateNum(1000), mPreviousAccTimestamp(0), mPreviousAttTimestamp(0)
+{
+}
+
+void NavParticleLocalizer::initialize(std::shared_ptr<DataStoreImpl> dataStore)
+{
+    mDataStore = dataStore;
+    mFilter = std::make_shared<StreamParticleFilter>();
+    mFilter->updateHandler(updated, this);
+    mFilter->numStates(mStateNum);
+    mFilter->alphaWeaken(0.3);
+    if (mConfig.locationStdLowerBound > 0) {
+        Location locLB(mConfig.locationStdLowerBound, mConfig.locationStdLowerBound, 0, 0);
+        mFilter->locationStandardDeviationLowerBound(locLB);
+    }
+    
+    // Orientation
+    OrientationMeterAverageParameters orientationMeterAverageParameters;
+    orientationMeterAverageParameters.interval(0.1);
+    orientationMeterAverageParameters.windowAveraging(0.1);
+    mOrientationMeter.reset(new OrientationMeterAverage(orientationMeterAverageParameters));
+    
+    // Pedometer
+    PedometerWalkingStateParameters pedometerWSParams;
+    pedometerWSParams.updatePeriod(0.1);
+    if (mConfig.walkDetectSigmaThreshold > 0) {
+        pedometerWSParams.walkDetectSigmaThreshold(mConfig.walkDetectSigmaThreshold);
+    }
+    std::shared_ptr<Pedometer> pedometer(new PedometerWalkingState(pedometerWSParams));
+    
+    mFilter->orientationMeter(mOrientationMeter);
+    mFilter->pedometer(pedometer);
+    
+    // System model
+    PoseProperty poseProperty;
+    StateProperty stateProperty;
+    poseProperty.meanVelocity(mConfig.meanVelocity);
+    poseProperty.stdVelocity(mConfig.stdVelocity);
+    poseProperty.diffusionVelocity(mConfig.diffusionVelocity);
+    poseProperty.minVelocity(mConfig.minVelocity);
+    poseProperty.maxVelocity(mConfig.maxVelocity);
+    poseProperty.stdOrientation(mConfig.stdOrientation);
+    poseProperty.stdX(mConfig.stdX);
+    poseProperty.stdY(mConfig.stdY);
+    
+    stateProperty.meanRssiBias(mConfig.meanRssiBias);
+    stateProperty.stdRssiBias(mConfig.stdRssiBias);
+    stateProperty.diffusionRssiBias(mConfig.diffusionRssiBias);
+    stateProperty.diffusionOrientationBias(mConfig.diffusionOrientationBias);
+    
+    PoseRandomWalkerProperty poseRandomWalkerProperty;
+    std::shared_ptr<PoseRandomWalker> poseRandomWalker(new PoseRandomWalker());
+    poseRandomWalkerProperty.orientationMeter(mOrientationMeter.get());
+    poseRandomWalkerProperty.pedometer(pedometer.get());
+    poseRandomWalkerProperty.angularVelocityLimit(30.0/180.0*M_PI);
+    poseRandomWalker->setProperty(poseRandomWalkerProperty);
+    poseRandomWalker->setPoseProperty(poseProperty);
+    poseRandomWalker->setStateProperty(stateProperty);
+    
+    // Combine poseRandomWalker and building
+    PoseRandomWalkerInBuildingProperty prwBuildingProperty;
+    prwBuildingProperty.maxIncidenceAngle(45.0/180.0*M_PI);
+    prwBuildingProperty.weightDecayRate(0.9);
+    Building building = mDataStore->getBuilding();
+    std::shared_ptr<PoseRandomWalkerInBuilding> poseRandomWalkerInBuilding(new PoseRandomWalkerInBuilding());
+    poseRandomWalkerInBuilding->poseRandomWalker(*poseRandomWalker);
+    poseRandomWalkerInBuilding->building(building);
+    poseRandomWalkerInBuilding->poseRandomWalkerInBuildingProperty(prwBuildingProperty);
+    mFilter->systemModel(poseRandomWalkerInBuilding);
+    
+    std::shared_ptr<Resampler<State>> resampler(new GridResampler<State>());
+    mFilter->resampler(resampler);
+    
+    mStatusInitializer.reset(new StatusInitializerImpl());
+    mStatusInitializer->dataStore(mDataStore)
+    .poseProperty(poseProperty).stateProperty(stateProperty);
+    mFilter->statusInitializer(mStatusInitializer);
+    
+    // The number of the strongest RSSI beacons used to evaluate likelihoods
+    std::shared_ptr<StrongestBeaconFilter> strongestBeaconFilter(new StrongestBeaconFilter());
+    strongestBeaconFilter->nStrongest(10);
+    if (mConfig.cleansesBeacons) {
+        std::shared_ptr<BeaconFilterChain> chain(new BeaconFilterChain());
+        chain->addFilter(std::make_shared<CleansingBeaconFilter>());
+        chain->addFilter(strongestBeaconFilter);
+        mBeaconFilter = chain;
+    } else {
+        mBeaconFilter = strongestBeaconFilter;
+    }
+    mFilter->beaconFilter(mBeaconFilter);
+    
+    if (mConfig.mixtureProbability > 0) {
+        StreamParticleFilter::MixtureParameters mixParams;
+        mixParams.mixtureProbability = mConfig.mixtureProbability;
+        mFilter->mixtureParameters(mixParams);
+    }
+    if (mModel) {
+        observationModel(mModel);
+    }
+}
+
+void NavParticleLocalizer::observationModel(std::shared_ptr<ObservationModel> model)
+{
+    mModel = model;
+    if (!mFilter) {
+        return;
+    }
+    mFilter->observationModel(model);
+    if (mConfig.samplesByObservation) {
+        std::shared_ptr<MetropolisSampler<State, Beacons>> obsDepInitializer(new MetropolisSampler<State, Beacons>());
+        MetropolisSampler<State, Beacons>::Parameters msParams;
+        obsDepInitializer->observationModel(model);
+        obsDepInitializer->statusInitializer(mStatusInitializer);
+        msParams.burnIn = 1000;
+        msParams.radius2D = 10; // 10[m]
+        msParams.interval = 1;
+        msParams.withOrdering = true;
+        obsDepInitializer->parameters(msParams);
+        mFilter->observationDependentInitializer(obsDepInitializer);
+    }
+}
+
+void NavParticleLocalizer::stateNumRange(int minNum, int maxNum)
+{
+    if (minNum > 0) {
+        mKLDSampling = std::make_shared<NavKLDSampling>(minNum, maxNum);
+        mStateNum = mKLDSampling->maxStateNum();
+    } else {
+        mKLDSampling.reset();
+        mStateNum = maxNum;
+    }
+    if (mFilter) {
+        mFilter->numStates(mStateNum);
+    }
+}
+
+void NavParticleLocalizer::resetStateNum()
+{
+    if (mKLDSampling && mStateNum != mKLDSampling->maxStateNum()) {
+        mStateNum = mKLDSampling->maxStateNum();
+        mFilter->numStates(mStateNum);
+    }
+}
+
+void NavParticleLocalizer::adaptStateNum(const States& states)
+{
+    if (!mKLDSampling) {
+        return;
+    }
+    mKLDSampling->clear();
+    for (const State& s : states) {
+        mKLDSampling->add(s.x(), s.y(), s.floor());
+    }
+    int n = mKLDSampling->stateNum();
+    if (n != mStateNum) {
+        log("KLDSampling,%s,%d,%d,%d", mName.c_str(), mKLDSampling->binNum(), (int)states.size(), n);
+        mStateNum = n;
+        mFilter->numStates(n);
+    }
+}
+
+void NavParticleLocalizer::updated(void* userData, Status* status)
+{
+    NavParticleLocalizer* self = (NavParticleLocalizer*)userData;
+    self->mMeanLocation = status->meanLocation();
+    self->mMeanPose = status->meanPose();
+    self->mStates = status->states();
+    self->adaptStateNum(*self->mStates);
+    if (self->mUpdateHandler) {
+        self->mUpdateHandler(*status);
+    }
+}
+
+void NavParticleLocalizer::log(const char* format, ...)
+{
+    if (!mLogHandler) {
+        return;
+    }
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    mLogHandler(line);
+}
+
+Beacons NavParticleLocalizer::beacons(const NavBeaconFrame& frame)
+{
+    Beacons beacons;
+    beacons.reserve(frame.size());
+    for (const NavBeaconReading& b : frame.readings()) {
+        beacons.push_back(Beacon(b.major, b.minor, b.rssi < 0 ? b.rssi : -100));
+    }
+    beacons.timestamp(frame.timestamp());
+    return beacons;
+}
+
+void NavParticleLocalizer::putBeacons(const Beacons& beacons)
+{
+    if (mFilter && mModel) {
+        mFilter->putBeacons(beacons);
+    }
+}
+
+void NavParticleLocalizer::putAcceleration(long timestamp, double x, double y, double z)
+{
+    if (timestamp != mPreviousAccTimestamp && mFilter) {
+        Acceleration acc(timestamp, x, y, z);
+        mFilter->putAcceleration(acc);
+    }
+    mPreviousAccTimestamp = timestamp;
+}
+
+void NavParticleLocalizer::putAttitude(long timestamp, double pitch, double roll, double yaw)
+{
+    if (timestamp != mPreviousAttTimestamp && mFilter) {
+        Attitude att = mConfig.usesAttitude ? Attitude(timestamp, pitch, roll, yaw) : Attitude(timestamp, 0, 0, 0);
+        mFilter->putAttitude(att);
+    }
+    mPreviousAttTimestamp = timestamp;
+}
+
+void NavParticleLocalizer::resetStatus()
+{
+    if (mFilter) {
+        mFilter->resetStatus();
+    }
+}
+
+void NavParticleLocalizer::resetStatus(const Pose& pose)
+{
+    if (mFilter) {
+        Pose stdevPose;
+        stdevPose.x(mConfig.resetStdX).y(mConfig.resetStdY).orientation(mConfig.resetStdOrientation);
+        mFilter->resetStatus(pose, stdevPose);
+    }
+}
+
+void NavParticleLocalizer::resetStatus(const Beacons& beacons)
+{
+    if (mFilter && mModel) {
+        mFilter->resetStatus(beacons);
+    }
+}
+
+bool NavParticleLocalizer::readOneDSamples(std::istream& is, double unitToMeter,
+                                           Samples& samples, std::vector<std::string>& beaconIDs)
+{
+    std::string line;
+    if (!std::getline(is, line)) {
+        return false;
+    }
+    size_t colon = line.find(" : ");
+    if (colon == std::string::npos) {
+        return false;
+    }
+    // the list ends with a comma
+    beaconIDs.clear();
+    std::istringstream ids(line.substr(colon + 3));
+    std::string id;
+    while (std::getline(ids, id, ',')) {
+        beaconIDs.push_back(id);
+    }
+    if (!beaconIDs.empty()) {
+        beaconIDs.pop_back();
+    }
+    
+    std::vector<std::string> items;
+    while (std::getline(is, line)) {
+        items.clear();
+        std::istringstream fields(line);
+        std::string item;
+        while (std::getline(fields, item, ',')) {
+            items.push_back(item);
+        }
+        if (items.size() < 3) {
+            continue;
+        }
+        double x = atof(items[0].c_str()) * 3 * unitToMeter;
+        double y = atof(items[1].c_str()) * 3 * unitToMeter;
+        int n = atoi(items[2].c_str());
+        if (n < 0 || items.size() < 3 + (size_t)n * 3) {
+            return false;
+        }
+        Beacons beacons;
+        for (int i = 0; i < n; i++) {
+            int major = atoi(items[3+i*3].c_str());
+            int minor = atoi(items[4+i*3].c_str());
+            float rssi = (float)atof(items[5+i*3].c_str());
+            beacons.push_back(Beacon(major, minor, rssi));
+        }
+        Sample sample;
+        sample.beacons(beacons)->location(Location(x, y, 0, 0));
+        samples.push_back(sample);
+    }
+    return true;
+}
+
+double NavParticleLocalizer::meanDistance(const double* segments, int segmentNum)
+{
+    if (!mStates) {
+        return 0;
+    }
+    size_t n = mStates->size();
+    mParticleX.resize(n);
+    mParticleY.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        mParticleX[i] = mStates->at(i).x() / kFeetInMeter;
+        mParticleY[i] = mStates->at(i).y() / kFeetInMeter;
+    }
+    return NavPolylineDistance::meanDistance(segments, segmentNum, mParticleX.data(), mParticleY.data(), (int)n);
+}
+
+double NavParticleLocalizer::particleDistanceScore(const double* segments, int segmentNum)
+{
+    if (!mStates) {
+        return 100 * 1000; // far while not ready
+    }
+    Location stdloc = Location::standardDeviation(*mStates);
+    double distanceMean = meanDistance(segments, segmentNum);
+    double stdx = stdloc.x()*3;
+    double stdy = stdloc.y()*3;
+    return fmax(distanceMean, sqrt(pow(stdx,2) + pow(stdy,2)))/6.0;
+}
@@ -0,0 +1,159 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavParticleLocalizer_hpp
+#define NavParticleLocalizer_hpp
+
+#include <functional>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "NavBeaconFrame.hpp"
+#include "NavKLDSampling.hpp"
+
+#include <bleloc/StreamParticleFilter.hpp>
+#include <bleloc/DataStoreImpl.hpp>
+#include <bleloc/StatusInitializerImpl.hpp>
+#include <bleloc/OrientationMeterAverage.hpp>
+#include <bleloc/GaussianProcessLDPLMultiModel.hpp>
+#include <bleloc/BeaconFilterChain.hpp>
+
+// The particle filter behind OneDLocalizer and TwoDLocalizer, free of
+// Foundation so it can also run headless (see NavLogReplay).
+//
+// It builds the StreamParticleFilter with its sensor processors and system
+// model, converts beacon frames, skips sensor samples with the timestamp of
+// the previous one and keeps the mean and the states of the last update.
+// With stateNumRange() the number of states follows KLD-sampling.
+class NavParticleLocalizer {
+public:
+    typedef loc::GaussianProcessLDPLMultiModel<loc::State, loc::Beacons> ObservationModel;
+    // called after every update of the filter, the mean and states are set
+    typedef std::function<void(loc::Status& status)> UpdateHandler;
+    // diagnostic lines, e.g. to NSLog in the app
+    typedef std::function<void(const char* line)> LogHandler;
+
+    // what differs between the 1D and the 2D localizer, in meters and radians
+    struct Config {
+        double meanVelocity, stdVelocity, diffusionVelocity, minVelocity, maxVelocity;
+        double stdOrientation;
+        double stdX, stdY;              // noise of the initial locations around the samples
+        double meanRssiBias, stdRssiBias, diffusionRssiBias;
+        double diffusionOrientationBias;
+        double walkDetectSigmaThreshold; // 0 keeps the pedometer default
+        double locationStdLowerBound;    // 0 for none
+        double mixtureProbability;       // 0 for none
+        bool cleansesBeacons;            // CleansingBeaconFilter before the 10 strongest
+        bool samplesByObservation;       // MetropolisSampler for resetStatus(beacons)
+        bool usesAttitude;               // false feeds zero attitudes
+        double resetStdX, resetStdY, resetStdOrientation; // of resetStatus(pose)
+
+        static Config oneD();
+        static Config twoD();
+    };
+
+    NavParticleLocalizer(const std::string& name, const Config& config);
+
+    // the building and the samples must be in dataStore, the beacons can
+    // follow until the observation model is set
+    void initialize(std::shared_ptr<loc::DataStoreImpl> dataStore);
+    void observationModel(std::shared_ptr<ObservationModel> model);
+    // KLD-sampling between minNum and maxNum states, maxNum states with minNum <= 0
+    void stateNumRange(int minNum, int maxNum);
+    // back to the maximum number of states, e.g. before a reset
+    void resetStateNum();
+
+    void updateHandler(UpdateHandler handler) { mUpdateHandler = handler; }
+    void logHandler(LogHandler handler) { mLogHandler = handler; }
+
+    // as the localizers take them, unknown RSSI (0) becomes -100
+    static loc::Beacons beacons(const NavBeaconFrame& frame);
+    void putBeacons(const loc::Beacons& beacons);
+    // timestamps in ms
+    void putAcceleration(long timestamp, double x, double y, double z);
+    void putAttitude(long timestamp, double pitch, double roll, double yaw);
+
+    void resetStatus();
+    // around pose with the reset deviation of the config
+    void resetStatus(const loc::Pose& pose);
+    void resetStatus(const loc::Beacons& beacons);
+
+    // samples of the 1D format, a header "... : id,id,...," and lines of
+    // x,y,n,major,minor,rssi,... with x and y in map units / 3
+    static bool readOneDSamples(std::istream& is, double unitToMeter,
+                                loc::Samples& samples, std::vector<std::string>& beaconIDs);
+
+    // mean distance in feet of the states to a polyline in feet, see
+    // NavPolylineDistance, all states are taken as on the polyline's floor
+    double meanDistance(const double* segments, int segmentNum);
+    // max(meanDistance, 3 sigma of the states) / 6, large without states
+    double particleDistanceScore(const double* segments, int segmentNum);
+
+    const std::string& name() const { return mName; }
+    const Config& config() const { return mConfig; }
+    bool initialized() const { return mFilter != nullptr; }
+    bool hasObservationModel() const { return mModel != nullptr; }
+    bool orientationUpdated() const { return mOrientationMeter && mOrientationMeter->isUpdated(); }
+    int stateNum() const { return mStateNum; }
+
+    loc::StreamParticleFilter* filter() const { return mFilter.get(); }
+    std::shared_ptr<loc::DataStoreImpl> dataStore() const { return mDataStore; }
+    std::shared_ptr<loc::StatusInitializerImpl> statusInitializer() const { return mStatusInitializer; }
+    std::shared_ptr<loc::BeaconFilter> beaconFilter() const { return mBeaconFilter; }
+    std::shared_ptr<ObservationModel> observationModel() const { return mModel; }
+
+    // of the last update, nullptr before the first one
+    std::shared_ptr<loc::Location> meanLocation() const { return mMeanLocation; }
+    std::shared_ptr<loc::Pose> meanPose() const { return mMeanPose; }
+    std::shared_ptr<loc::States> states() const { return mStates; }
+
+private:
+    static void updated(void* userData, loc::Status* status);
+    void adaptStateNum(const loc::States& states);
+    void log(const char* format, ...);
+
+    std::string mName;
+    Config mConfig;
+    std::shared_ptr<loc::StreamParticleFilter> mFilter;
+    std::shared_ptr<loc::DataStoreImpl> mDataStore;
+    std::shared_ptr<loc::OrientationMeter> mOrientationMeter;
+    std::shared_ptr<loc::StatusInitializerImpl> mStatusInitializer;
+    std::shared_ptr<loc::BeaconFilter> mBeaconFilter;
+    std::shared_ptr<ObservationModel> mModel;
+
+    std::shared_ptr<NavKLDSampling> mKLDSampling;
+    int mStateNum;
+    long mPreviousAccTimestamp;
+    long mPreviousAttTimestamp;
+
+    std::shared_ptr<loc::Location> mMeanLocation;
+    std::shared_ptr<loc::Pose> mMeanPose;
+    std::shared_ptr<loc::States> mStates;
+    std::vector<double> mParticleX; // in feet, for NavPolylineDistance
+    std::vector<double> mParticleY;
+
+    UpdateHandler mUpdateHandler;
+    LogHandler mLogHandler;
+};
+
+#endif /* NavParticleLocalizer_hpp */
@@ -0,0 +1,153 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavPolylineDistance.hpp"
+#include <math.h>
+#include <float.h>
+#include <utility>
+
+static const int kBlockSize = 256;
+
+// squared distances of a block of points, the projection parameter t is
+// clamped to the segment, a zero length segment projects to its first point
+static void squaredDistances(const double* segments, int segmentNum,
+                             const double* x, const double* y, int n, double* d2)
+{
+    for (int i = 0; i < n; i++) {
+        d2[i] = DBL_MAX;
+    }
+    for (int s = 0; s < segmentNum; s++) {
+        const double* seg = segments + s * 4;
+        double x1 = seg[0], y1 = seg[1];
+        double dx = seg[2] - x1, dy = seg[3] - y1;
+        double len2 = dx * dx + dy * dy;
+        double inv = len2 > 0 ? 1 / len2 : 0;
+        for (int i = 0; i < n; i++) {
+            double px = x[i] - x1, py = y[i] - y1;
+            double t = (px * dx + py * dy) * inv;
+            t = t < 0 ? 0 : t;
+            t = t > 1 ? 1 : t;
+            double ex = px - t * dx, ey = py - t * dy;
+            double e2 = ex * ex + ey * ey;
+            d2[i] = e2 < d2[i] ? e2 : d2[i];
+        }
+    }
+}
+
+void NavPolylineDistance::distances(const double* segments, int segmentNum,
+                                    const double* x, const double* y, int n, double* dists)
+{
+    squaredDistances(segments, segmentNum, x, y, n, dists);
+    for (int i = 0; i < n; i++) {
+        dists[i] = sqrt(dists[i]);
+    }
+}
+
+double NavPolylineDistance::meanDistance(const double* segments, int segmentNum,
+                                         const double* x, const double* y, int n)
+{
+    if (n <= 0) {
+        return 0;
+    }
+    double block[kBlockSize];
+    double sum = 0;
+    for (int i = 0; i < n; i += kBlockSize) {
+        int m = n - i < kBlockSize ? n - i : kBlockSize;
+        distances(segments, segmentNum, x + i, y + i, m, block);
+        for (int j = 0; j < m; j++) {
+            sum += block[j];
+        }
+    }
+    return sum / n;
+}
+
+// nearest point on one segment, the squared distance to it is returned
+static double nearestPoint(const double* seg, double x, double y, double& qx, double& qy)
+{
+    double dx = seg[2] - seg[0], dy = seg[3] - seg[1];
+    double len2 = dx * dx + dy * dy;
+    double t = len2 > 0 ? ((x - seg[0]) * dx + (y - seg[1]) * dy) / len2 : 0;
+    t = t < 0 ? 0 : (t > 1 ? 1 : t);
+    qx = seg[0] + t * dx;
+    qy = seg[1] + t * dy;
+    return (x - qx) * (x - qx) + (y - qy) * (y - qy);
+}
+
+double NavPolylineDistance::distance(const double* segments, int segmentNum, double x, double y,
+                                     double* nearestX, double* nearestY)
+{
+    double min = DBL_MAX, nx = x, ny = y;
+    for (int s = 0; s < segmentNum; s++) {
+        double qx, qy;
+        double d2 = nearestPoint(segments + s * 4, x, y, qx, qy);
+        if (d2 < min) {
+            min = d2;
+            nx = qx;
+            ny = qy;
+        }
+    }
+    if (nearestX) {
+        *nearestX = nx;
+    }
+    if (nearestY) {
+        *nearestY = ny;
+    }
+    return segmentNum > 0 ? sqrt(min) : 0;
+}
+
+int NavPolylineDistance::nearestSegment(const double* segments, int segmentNum, double x, double y)
+{
+    double min = DBL_MAX;
+    int nearest = -1;
+    for (int s = 0; s < segmentNum; s++) {
+        double qx, qy;
+        double d2 = nearestPoint(segments + s * 4, x, y, qx, qy);
+        if (d2 < min) {
+            min = d2;
+            nearest = s;
+        }
+    }
+    return nearest;
+}
+
+double NavPolylineDistance::pathDistance(const double* segments, int segmentNum,
+                                         double fromX, double fromY, double toX, double toY)
+{
+    int i1 = nearestSegment(segments, segmentNum, fromX, fromY);
+    int i2 = nearestSegment(segments, segmentNum, toX, toY);
+    if (i1 == i2) {
+        return hypot(toX - fromX, toY - fromY);
+    }
+    if (i2 < i1) {
+        std::swap(i1, i2);
+        std::swap(fromX, toX);
+        std::swap(fromY, toY);
+    }
+    const double* s1 = segments + i1 * 4;
+    const double* s2 = segments + i2 * 4;
+    double d = hypot(s1[2] - fromX, s1[3] - fromY) + hypot(toX - s2[0], toY - s2[1]);
+    for (int i = i1 + 1; i < i2; i++) {
+        const double* seg = segments + i * 4;
+        d += hypot(seg[2] - seg[0], seg[3] - seg[1]);
+    }
+    return d;
+}
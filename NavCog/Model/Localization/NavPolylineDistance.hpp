@@ -0,0 +1,52 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavPolylineDistance_hpp
+#define NavPolylineDistance_hpp
+
+// Distances from points to a polyline given as packed segments
+// (x1, y1, x2, y2 per segment).
+//
+// Points are passed as separate x and y arrays and processed one segment at
+// a time over all points, so the inner loops are branch free and vectorize.
+// Nothing is allocated, aggregates work through a block on the stack.
+class NavPolylineDistance {
+public:
+    // dists[i] = distance from (x[i], y[i]) to the nearest segment
+    static void distances(const double* segments, int segmentNum,
+                          const double* x, const double* y, int n, double* dists);
+    // mean of distances(), 0 for no points
+    static double meanDistance(const double* segments, int segmentNum,
+                               const double* x, const double* y, int n);
+    // distance from one point, the nearest point on the polyline is returned
+    // in nearestX and nearestY if they are not NULL
+    static double distance(const double* segments, int segmentNum, double x, double y,
+                           double* nearestX, double* nearestY);
+    // index of the nearest segment, the first of equally near ones, -1 for none
+    static int nearestSegment(const double* segments, int segmentNum, double x, double y);
+    // distance along the polyline as NavLightEdge distanceFrom:To:, the
+    // points are taken on their nearest segments but not projected onto them
+    static double pathDistance(const double* segments, int segmentNum,
+                               double fromX, double fromY, double toX, double toY);
+};
+
+#endif /* NavPolylineDistance_hpp */
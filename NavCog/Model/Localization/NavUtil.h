@@ -22,16 +22,20 @@
 
 #import <Foundation/Foundation.h>
 
+@class NavPath;
+
 @interface NavUtil : NSObject
 + (NSString*) createTempFile:(NSString*) dataStr forID:(NSString**)idStr;
 + (NSString*) createTempFileFromData:(NSData*) data withType:(NSString*) type forID:(NSString**)idStr;
+/// decodes a "data:<mime>;base64," string in memory, other strings are returned as UTF-8
++ (NSData*) dataFromDataString:(NSString*) dataStr type:(NSString**)type;
 
 /// clips the angle between 0 and 360
 + (double) clipAngle:(double) x;
 /// clips the angle between -180 and 180
 + (double) clipAngle2:(double) x;
 + (double) clipAngle:(double) x withLimit:(double) l;
-+ (NSArray*) buildPath:(NSArray*) pathNodes;
++ (NSArray*) buildPath:(NavPath*) path;
 
 @end
 
@@ -23,6 +23,7 @@
 #import "NavUtil.h"
 #import <zlib.h>
 #import "NavNode.h"
+#import "NavPath.h"
 
 
 
@@ -39,49 +40,36 @@
     NSString *tempPath = NSTemporaryDirectory();
     
     
-    NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:@"^data:([a-z]+/[a-z]+);base64," options:NSRegularExpressionCaseInsensitive error:nil];
-    NSTextCheckingResult *result = [regex firstMatchInString:dataStr options:NSMatchingReportProgress range:NSMakeRange(0, dataStr.length)];
     NSString *type = nil;
     @autoreleasepool {
-        NSData *data = nil;
-        
-        if (result != nil) {
-            type = [dataStr substringWithRange:[result rangeAtIndex:1]];
-            type = [type stringByReplacingOccurrencesOfString:@"^[^/]+/(x-)?" withString:@"" options:NSRegularExpressionSearch range:NSMakeRange(0, type.length)];
-            dataStr = [dataStr stringByReplacingCharactersInRange:[result rangeAtIndex:0] withString:@""];
-            data = [[NSData alloc] initWithBase64EncodedString:dataStr options:NSDataBase64DecodingIgnoreUnknownCharacters];
-            
-            tempPath = [tempPath stringByAppendingPathComponent: [NSString stringWithFormat:@"%@.%@", *idStr, type]];
-            [data writeToFile:tempPath atomically:YES];
-        } else {
-            type = @"txt";
-            tempPath = [tempPath stringByAppendingPathComponent: [NSString stringWithFormat:@"%@.%@", *idStr, type]];
-            [dataStr writeToFile:tempPath atomically:true encoding:NSUTF8StringEncoding error:nil];
-            /*
-            NSFileManager* fileManager = [NSFileManager defaultManager];
-            
-            if (![fileManager fileExistsAtPath:tempPath]) {
-                [fileManager createFileAtPath:tempPath
-                                     contents:[NSData data]
-                                   attributes:nil];
-            }
-            
-            NSFileHandle* fileHandle = [NSFileHandle fileHandleForWritingAtPath:tempPath];
-            long s = 0;
-            while (s + 1024 < dataStr.length) {
-                @autoreleasepool {
-                    [fileHandle writeData:[[dataStr substringWithRange:NSMakeRange(s, 1024)] dataUsingEncoding:NSUTF8StringEncoding]];
-                }
-                s+=1024;
-            }
-            [fileHandle writeData:[[dataStr substringFromIndex:s] dataUsingEncoding:NSUTF8StringEncoding]];
-             */
-        }
+        NSData *data = [NavUtil dataFromDataString:dataStr type:&type];
+        tempPath = [tempPath stringByAppendingPathComponent: [NSString stringWithFormat:@"%@.%@", *idStr, type]];
+        [data writeToFile:tempPath atomically:YES];
     }
     
     return tempPath;
 }
 
++ (NSData *)dataFromDataString:(NSString *)dataStr type:(NSString**)type
+{
+    NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:@"^data:([a-z]+/[a-z]+);base64," options:NSRegularExpressionCaseInsensitive error:nil];
+    NSTextCheckingResult *result = [regex firstMatchInString:dataStr options:NSMatchingReportProgress range:NSMakeRange(0, dataStr.length)];
+    
+    if (result != nil) {
+        NSString *t = [dataStr substringWithRange:[result rangeAtIndex:1]];
+        t = [t stringByReplacingOccurrencesOfString:@"^[^/]+/(x-)?" withString:@"" options:NSRegularExpressionSearch range:NSMakeRange(0, t.length)];
+        if (type) {
+            *type = t;
+        }
+        dataStr = [dataStr stringByReplacingCharactersInRange:[result rangeAtIndex:0] withString:@""];
+        return [[NSData alloc] initWithBase64EncodedString:dataStr options:NSDataBase64DecodingIgnoreUnknownCharacters];
+    }
+    if (type) {
+        *type = @"txt";
+    }
+    return [dataStr dataUsingEncoding:NSUTF8StringEncoding];
+}
+
 
 + (double) clipAngle:(double) x
 {
@@ -111,12 +99,12 @@
         return x;
 }
 
-+ (NSArray *)buildPath:(NSArray *)pathNodes
++ (NSArray *)buildPath:(NavPath *)path
 {
     NSMutableArray *result = [@[] mutableCopy];
-    for(int i = (int)pathNodes.count-1; i>=0; i--) {
-        NavNode *node = pathNodes[i];
-        NavEdge *edge = node.preEdgeInPath;
+    for(int i = (int)path.count-1; i>=0; i--) {
+        NavNode *node = [path nodeAtIndex:i];
+        NavEdge *edge = [path edgeToNodeAtIndex:i];
         if (edge != nil && edge.path != nil) {
             if ([edge.node2.nodeID isEqualToString:node.nodeID]) {
                 for(int i = 0; i < (int)edge.path.count; i++) {
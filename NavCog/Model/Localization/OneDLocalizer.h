@@ -22,6 +22,7 @@
 
 #import <Foundation/Foundation.h>
 #import "NavLocalizer.h"
+#import "NavLineSegment.h"
 #include <bleloc/StreamParticleFilter.hpp>
 
 #define Meter2Feet(meter) (meter/0.3048)
@@ -34,5 +35,7 @@
 - (instancetype) initWithID: (NSString*) idStr;
 - (void) initializeWithFile:(NSString*) path;
 - (void) setBeacons:(NSDictionary*) beacons;
+// precomputes what scoring the edge needs, called after setBeacons:
+- (void) prepareForEdge:(NavLightEdge*) edge;
 
 @end
@@ -32,58 +32,56 @@
 #import "NavLocalizeResult.h"
 #import "NavLineSegment.h"
 #import "TopoMap.h"
+#import "NavMahalanobisTable.hpp"
+#import "NavModelCache.hpp"
+#import "NavMemoryStream.hpp"
+#import "NavPolylineDistance.hpp"
+#import "NavStatusFrame.hpp"
+#import "NavParticleLocalizer.hpp"
+#import "NavFingerprintData.hpp"
+#import "NavLocalizationExecutor.h"
+#import <mutex>
+#import <tuple>
+
+#define OBS_MODEL_CACHE_TAG "GaussianProcessLDPLMultiModel-1"
 
 #import <bleloc/StreamLocalizer.hpp>
 #import <bleloc/StreamParticleFilter.hpp>
 
-#import <bleloc/PoseRandomWalker.hpp>
-
-#import <bleloc/GridResampler.hpp>
-#import <bleloc/StatusInitializerStub.hpp>
 #import <bleloc/StatusInitializerImpl.hpp>
 
 #import <bleloc/DataStore.hpp>
 #import <bleloc/DataStoreImpl.hpp>
 
-#import <bleloc/OrientationMeterAverage.hpp>
-#import <bleloc/PedometerWalkingState.hpp>
-
 #import <bleloc/GaussianProcessLDPLMultiModel.hpp>
 
-// for pose random walker in building
 #import <bleloc/Building.hpp>
-#import <bleloc/PoseRandomWalkerInBuilding.hpp>
 
-#import <bleloc/BeaconFilterChain.hpp>
-#import <bleloc/CleansingBeaconFilter.hpp>
 #import <bleloc/StrongestBeaconFilter.hpp>
 
 using namespace loc;
 
-typedef struct LocalizerData {
-    OneDLocalizer* localizer;
-} LocalizerData;
+// states evaluated for every scan and the observation model tabulated over them
+struct NavStateTable {
+    std::shared_ptr<States> states;
+    std::shared_ptr<NavMahalanobisTable> mahalanobis;
+    bool checked = false; // reproduced the model once
+};
 
 @interface OneDLocalizer ()
-@property NSArray *beaconIDs;
-@property std::shared_ptr<OrientationMeter> orientationMeter;
+@property std::shared_ptr<NavParticleLocalizer> particle;
 @property std::shared_ptr<DataStoreImpl> dataStore;
 @property NSTimer *tryResetTimer;
 @property NSDictionary *currentOptions;
 
-@property NSArray *previousBeaconInput;
+@property NavBeaconScan *previousBeaconInput;
 @property NavLocalizeResult *result;
-@property long previousAttTimestamp;
-@property long previousAccTimestamp;
-@property LocalizerData userData;
 
 @property std::shared_ptr<Location> d1meanLoc;
 @property std::shared_ptr<Pose> d1meanPose;
 @property std::shared_ptr<States> d1states;
 
 @property std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel;
-@property std::shared_ptr<BeaconFilterChain> beaconFilter;
-@property std::shared_ptr<StatusInitializerImpl> statusInitializer;
 @property Beacons cbeacons;
 @property int minCountKnownBeacons;
 @property double alphaObsModel;
@@ -93,17 +91,41 @@ typedef struct LocalizerData {
 @property double cumProba;
 @property BOOL readyForBeacons;
 
+// transit mode evaluates every scan at the same states, sampled once per model,
+// edges are scored at their knots, tabulated when the edge is prepared
+@property std::shared_ptr<NavStateTable> transitTable;
+@property std::unordered_map<std::string, std::shared_ptr<NavStateTable>> edgeTables;
+@property std::vector<std::pair<int, int>> beaconKeys; // major, minor of setBeacons:
+@property BOOL mahalanobisTableDisabled;
+@property std::vector<int> tableColumns;
+@property std::vector<double> tableRssi;
+@property std::vector<double> chiSquaredQuantiles; // by degree of freedom, for quantileCumulative
+@property double quantileCumulative;
+@property BOOL benchmarkTransit;
+@property BOOL benchmarkEdgeScore;
+@property BOOL benchmarkModelCache;
+@property BOOL particleScore; // score edges by the particles instead of the beacons
+@property uint64_t samplesHash;
+@property uint64_t modelKey;
+@property NSMutableArray *pendingEdges; // waiting for the model
+@property int edgeScoreCount;
+@property NSTimeInterval edgeScoreTableTime;
+@property NSTimeInterval edgeScoreModelTime;
+@property std::shared_ptr<NavStatusFrame> statusFrame;
+
 @end
 
 @implementation OneDLocalizer
 static OneDLocalizer *activeLocalizer;
+static std::mutex obsModelsMutex;
+static std::unordered_map<uint64_t, std::weak_ptr<GaussianProcessLDPLMultiModel<State, Beacons>>> obsModels;
+static std::unordered_map<uint64_t, NSMutableArray*> pendingObsModels; // handlers of models in flight
+static int trainingTaskNum = 0;
+static int trainingDoneNum = 0;
+static NSTimeInterval trainingTaskTime = 0;
+static NSDate *trainingBatchStart;
 
 
-- (void)dealloc
-{
-    delete _localizer;
-}
-
 
 - (id) init
 {
@@ -115,50 +137,51 @@ static OneDLocalizer *activeLocalizer;
 - (instancetype) initWithID: (NSString*) idStr
 {
     self = [super initWithID: idStr];
+    _particleScore = [[NSUserDefaults standardUserDefaults] boolForKey:@"particle_score_preference"];
     [self initDebug];
     return self;
 }
 
 - (void) initDebug {
     NSDictionary* env = [[NSProcessInfo processInfo] environment];
+    _benchmarkTransit = [env valueForKey:@"transitbenchmark"] != nil;
+    _benchmarkEdgeScore = [env valueForKey:@"edgebenchmark"] != nil;
+    _benchmarkModelCache = [env valueForKey:@"modelcachebenchmark"] != nil;
 }
 
-void d1calledWhenUpdated(void *userData, Status * pStatus){
-    
-    LocalizerData *localizerData = (LocalizerData*)userData;
-    OneDLocalizer *loc = localizerData->localizer;
+- (void) particleUpdated: (Status&) status{
     
     //NSLog(@"location updated");
-    loc.d1meanLoc = pStatus->meanLocation();
-    loc.d1meanPose = pStatus->meanPose();
-    loc.d1states = pStatus->states();
+    _d1meanLoc = _particle->meanLocation();
+    _d1meanPose = _particle->meanPose();
+    _d1states = _particle->states();
     
     NSDictionary *data = @{
-                           @"x": @(loc.d1meanLoc->x()),
-                           @"y": @(loc.d1meanLoc->y()),
-                           @"z": @(loc.d1meanLoc->z()),
-                           @"floor": @(loc.d1meanLoc->floor()),
-                           @"orientation": @(loc.d1meanPose->orientation()),
-                           @"velocity":@(loc.d1meanPose->velocity())
+                           @"x": @(_d1meanLoc->x()),
+                           @"y": @(_d1meanLoc->y()),
+                           @"z": @(_d1meanLoc->z()),
+                           @"floor": @(_d1meanLoc->floor()),
+                           @"orientation": @(_d1meanPose->orientation()),
+                           @"velocity":@(_d1meanPose->velocity())
                            };
     
     [[P2PManager sharedInstance] send:data withType:@"2d-position" ];
-    [loc sendStatusByP2P: *loc.localizer->getStatus()];
+    [self sendStatusByP2P: status];
     
-    NSLog(@"%@ 1D %f, %f, %f, %f, %f\n", loc, loc.d1meanLoc->x(), loc.d1meanLoc->y(), loc.d1meanLoc->floor(), loc.d1meanPose->orientation(), loc.d1meanPose->velocity());
+    NSLog(@"%@ 1D %f, %f, %f, %f, %f\n", self, _d1meanLoc->x(), _d1meanLoc->y(), _d1meanLoc->floor(), _d1meanPose->orientation(), _d1meanPose->velocity());
     //std::cout << meanLoc->toString() << std::endl;
     
     
-    if (loc.transiting) {
-        for(int i = 0; i < loc.d1states->size(); i++) {
+    if (_transiting) {
+        for(int i = 0; i < _d1states->size(); i++) {
             //double v = (rand()%360-180)/180.0*M_PI;
             double d1 = (rand()%100-50)/100.0;
             double d2 = (rand()%100-50)/100.0;
             //NSLog(@"i=%d v=%f", i, v);
-            //loc.d1states->at(i).orientationBias(v);
-            //loc.d1states->at(i).orientation(v);
-            loc.d1states->at(i).x(fmin(2,fmax(-2,loc.d1states->at(i).x()+d1)));
-            loc.d1states->at(i).y(loc.d1states->at(i).y()+d2);
+            //_d1states->at(i).orientationBias(v);
+            //_d1states->at(i).orientation(v);
+            _d1states->at(i).x(fmin(2,fmax(-2,_d1states->at(i).x()+d1)));
+            _d1states->at(i).y(_d1states->at(i).y()+d2);
         }
     }
 }
@@ -166,26 +189,27 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
 - (void)initializeWithFile:(NSString *)path
 {
     _readyForBeacons = false;
-    NSString *data = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:nil];
-    NSArray *lines = [data componentsSeparatedByString:@"\n"];
-    
-    NSArray *beacons = [[lines[0] componentsSeparatedByString:@" : "][1] componentsSeparatedByString:@","];
-    
-    _beaconIDs = [beacons subarrayWithRange:NSMakeRange(0, [beacons count]-1)];
-    
-    NSLog(@"%@", [_beaconIDs componentsJoinedByString:@","]);
-    
+    NSData *data = [NSData dataWithContentsOfFile:path];
+    _samplesHash = data.length ? NavFingerprintData::hashBytes(data.bytes, data.length) : 0;
     
     _nEvalPoint = 1000;
     _cumProba = 0.99;
-    
-    _localizer = new StreamParticleFilter();
-    _userData.localizer = self;
-    _localizer->updateHandler(d1calledWhenUpdated, &_userData);
-    _localizer->numStates(1000);
-    _localizer->alphaWeaken(0.3);
-    
     _alphaObsModel = 1.0;
+    _minCountKnownBeacons = 3;
+    
+    NavParticleLocalizer::Config config = NavParticleLocalizer::Config::oneD();
+    if ([[NSUserDefaults standardUserDefaults] boolForKey:@"wheelmode_preference"]) {
+        NSString *tstr = [[NSUserDefaults standardUserDefaults] objectForKey:@"wheelmode_threthold_preference"];
+        config.walkDetectSigmaThreshold = tstr?[tstr doubleValue]:0.05;
+    }
+    _particle = std::make_shared<NavParticleLocalizer>(self.idStr ? [self.idStr UTF8String] : "", config);
+    __weak OneDLocalizer *weakSelf = self;
+    _particle->updateHandler([weakSelf](Status &status) {
+        [weakSelf particleUpdated:status];
+    });
+    _particle->logHandler([](const char *line) {
+        NSLog(@"%s", line);
+    });
     
     _dataStore = std::shared_ptr<DataStoreImpl>(new DataStoreImpl());
     
@@ -229,144 +253,39 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
     [[P2PManager sharedInstance] addJSON:buildingJSON withKey:@"building"];
     
     Samples samples;
-    
-    for(NSString* line: [lines subarrayWithRange:NSMakeRange(1, [lines count]-1)]) {
-        NSArray *items = [line componentsSeparatedByString:@","];
-        if ([items count] < 3) continue;
-        double x = [TopoMap unit2meter:[items[0] doubleValue]*3];
-        double y = [TopoMap unit2meter:[items[1] doubleValue]*3];
-        Location location = Location(x, y, 0, 0);
-        int n = [items[2] intValue];
-        Beacons beacons;
-        for(int i = 0; i < n; i++) {
-            int major = [items[3+i*3] intValue];
-            int minor = [items[4+i*3] intValue];
-            float rssi = [items[5+i*3] floatValue];
-            Beacon beacon = Beacon(major, minor, rssi);
-            beacons.push_back(beacon);
-        }
-        Sample sample = Sample();
-        sample.beacons(beacons)->location(location);
-        samples.push_back(sample);
+    std::vector<std::string> beaconIDs;
+    NavMemoryStream is((const char *)data.bytes, data.length);
+    if (!NavParticleLocalizer::readOneDSamples(is, [TopoMap unit2meter:1], samples, beaconIDs)) {
+        NSLog(@"Could not read samples %@", path);
     }
+    NSMutableArray *ids = [@[] mutableCopy];
+    for (const std::string &beaconID : beaconIDs) {
+        [ids addObject:@(beaconID.c_str())];
+    }
+    NSLog(@"%@", [ids componentsJoinedByString:@","]);
     _dataStore->samples(samples);
     
-    // Instantiate sensor data processors
-    // Orientation
-    OrientationMeterAverageParameters orientationMeterAverageParameters;
-    orientationMeterAverageParameters.interval(0.1);
-    orientationMeterAverageParameters.windowAveraging(0.1);
-    std::shared_ptr<OrientationMeter> orientationMeter(new OrientationMeterAverage(orientationMeterAverageParameters));
-    
-    self.orientationMeter = orientationMeter;
-    
-    // Pedometer
-    PedometerWalkingStateParameters pedometerWSParams;
-    // TODO
-    pedometerWSParams.updatePeriod(0.1);
-    //pedometerWSParams.walkDetectSigmaThreshold(0.1);
-    
-    if ([[NSUserDefaults standardUserDefaults] boolForKey:@"wheelmode_preference"]) {
-        NSString *tstr = [[NSUserDefaults standardUserDefaults] objectForKey:@"wheelmode_threthold_preference"];
-        double t = tstr?[tstr doubleValue]:0.05;
-        pedometerWSParams.walkDetectSigmaThreshold(t);
-    }
-    
-    // END TODO
-    std::shared_ptr<Pedometer> pedometer(new PedometerWalkingState(pedometerWSParams));
-    
-    // Set dependency
-    _localizer->orientationMeter(orientationMeter);
-    _localizer->pedometer(pedometer);
-    
-    // Build System Model
-    // TODO (PoseProperty and StateProperty)
-    PoseProperty poseProperty;
-    StateProperty stateProperty;
-    // The initial velocity of a particle is sampled from a truncated normal distribution defined by a mean, a standard deviation, a lower bound and an upper bound.
-    poseProperty.meanVelocity(1.0); // mean
-    poseProperty.stdVelocity(0.6); // standard deviation
-    
-    // if no effective beacon information, the average speed will be stable aroud (min+max)/2
-    poseProperty.minVelocity(0.1); // lower bound
-    poseProperty.maxVelocity(3.0); // upper bound
-    poseProperty.diffusionVelocity(0.30); // standard deviation of a noise added to the velocity of a particle [m/s/s]
-    
-    poseProperty.stdOrientation(3.0/180.0*M_PI); // standard deviation of a noise added to the orientation obtained from the smartphone sensor.
-
-    // The initial location of a particle is generated by adding a noise to a location where sampling data were collected. These are parameters of the noise.
-    poseProperty.stdX(0); // standard deviation in x axis. (Zero in 1D cases.)
-    poseProperty.stdY(2); // standard deviation in y axis.
-    
-    // The difference between the observed and the predicted RSSI is described by a RSSI bias parameter. The initial value is sampled from a normal distribution.
-    stateProperty.meanRssiBias(0.0); // mean
-    stateProperty.stdRssiBias(2.0); // standard deviation
-    stateProperty.diffusionRssiBias(0.2); // standard deviation of a noise added to the rssi bias [dBm/s]
-    // The difference between the observed and the actual orientation is described by a orientation bias parameter.
-    stateProperty.diffusionOrientationBias(1.0/180*M_PI); // standard deviation of a noise added to the orientation bias [rad/s]
-    // END TODO
-    
-    // Build poseRandomWalker
-    PoseRandomWalkerProperty poseRandomWalkerProperty;
-    std::shared_ptr<PoseRandomWalker>poseRandomWalker(new PoseRandomWalker());
-    poseRandomWalkerProperty.orientationMeter(orientationMeter.get());
-    poseRandomWalkerProperty.pedometer(pedometer.get());
-    poseRandomWalkerProperty.angularVelocityLimit(30.0/180.0*M_PI);
-    poseRandomWalker->setProperty(poseRandomWalkerProperty);
-    poseRandomWalker->setPoseProperty(poseProperty);
-    poseRandomWalker->setStateProperty(stateProperty);
-    
-    // Combine poseRandomWalker and building
-    PoseRandomWalkerInBuildingProperty prwBuildingProperty;
-    // TODO
-    prwBuildingProperty.maxIncidenceAngle(45.0/180.0*M_PI);
-    prwBuildingProperty.weightDecayRate(0.9);
-    // END TODO
-    Building building = _dataStore->getBuilding();
-    std::shared_ptr<PoseRandomWalkerInBuilding> poseRandomWalkerInBuilding(new PoseRandomWalkerInBuilding());
-    poseRandomWalkerInBuilding->poseRandomWalker(*poseRandomWalker);
-    poseRandomWalkerInBuilding->building(building);
-    poseRandomWalkerInBuilding->poseRandomWalkerInBuildingProperty(prwBuildingProperty);
-    
-    
-    std::shared_ptr<SystemModel<State, PoseRandomWalkerInput>> sysModel = poseRandomWalkerInBuilding;
-    
-    _localizer->systemModel(poseRandomWalkerInBuilding);
-    
-    // set resampler
-    std::shared_ptr<Resampler<State>> resampler(new GridResampler<State>());
-    _localizer->resampler(resampler);
-    
-    // Set status initializer
-    ////PoseProperty poseProperty;
-    ////StateProperty stateProperty;
-    
-    std::shared_ptr<StatusInitializerImpl> statusInitializer(new StatusInitializerImpl());
-    statusInitializer->dataStore(_dataStore)
-    .poseProperty(poseProperty).stateProperty(stateProperty);
-    _localizer->statusInitializer(statusInitializer);
-    _statusInitializer = statusInitializer;
-    
-    // Set localizer
-    //_localizer->observationModel(deserializedModel);
-    
-    // Beacon filter
-    std::shared_ptr<CleansingBeaconFilter> cleansingBeaconFilter(new CleansingBeaconFilter());
-    std::shared_ptr<StrongestBeaconFilter> strongestBeaconFilter(new StrongestBeaconFilter());
-    
-    int nStrongest = 10; // The number of the strongest RSSI beacons used to evaluate likelihoods in a localizer.
-    _minCountKnownBeacons = 3;
-    strongestBeaconFilter->nStrongest(nStrongest);
-    _beaconFilter.reset(new BeaconFilterChain());
-    _beaconFilter->addFilter(cleansingBeaconFilter);
-    _beaconFilter->addFilter(strongestBeaconFilter);
-    
-    _localizer->beaconFilter(_beaconFilter);
-    
+    _particle->initialize(_dataStore);
+    _localizer = _particle->filter();
+    [self initStateNum];
+}
+
+// adaptive number of states, same preferences as TwoDLocalizer
+- (void) initStateNum
+{
+    NSUserDefaults *ud = [NSUserDefaults standardUserDefaults];
+    if ([ud boolForKey:@"adaptive_states_preference"]) {
+        int minNum = (int)[ud integerForKey:@"min_states_preference"];
+        int maxNum = (int)[ud integerForKey:@"max_states_preference"];
+        _particle->stateNumRange(minNum > 0 ? minNum : 100, maxNum > 0 ? maxNum : 1000);
+    } else {
+        _particle->stateNumRange(0, 1000);
+    }
 }
 
 - (void)initializeState:(NSDictionary *)options;
 {
+    _particle->resetStateNum();
     self.currentOptions = options;
     if (options == nil) {
         return;
@@ -374,17 +293,17 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
     _transiting = true;
     if ([options[@"type"] isEqualToString:@"transition"]) {
         NSLog(@"1D localizer is all reset for transition");
-        self.localizer->resetStatus();
+        _particle->resetStatus();
         return;
     }
     if ([options[@"type"] isEqualToString:@"end"]) {
         NSLog(@"1D localizer is all reset for end");
-        self.localizer->resetStatus();
+        _particle->resetStatus();
         return;
     }
     if (options[@"allreset"]) {
         NSLog(@"1D localizer is all reset");
-        self.localizer->resetStatus();
+        _particle->resetStatus();
         return;
     }
     if (self.tryResetTimer != nil) {
@@ -423,12 +342,8 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
     std::cout << "Sending reset request to the localizer.";
     std::cout << ", resetPose = " << pose << std::endl;
     
-    // Set standard deviation of Pose
-    loc::Pose stdevPose;
-    stdevPose.x(0.25).y(0.25).orientation(1.0/180.0*M_PI);
-    // stdevPose.normalVelocity(0.2); // TODO
-    
-    self.localizer->resetStatus(pose, stdevPose);
+    // with the standard deviation of the 1D config
+    _particle->resetStatus(pose);
     NSLog(@"Reset %f %f %f %f", pose.x(), pose.y(), pose.floor(), pose.orientation());
 }
 
@@ -439,18 +354,27 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
 }
 
 - (void) inputBeacons:(NSArray*) beacons
+{
+    if (_previousBeaconInput && beacons == _previousBeaconInput.beacons) {
+        return;
+    }
+    [self inputBeaconScan:[[NavBeaconScan alloc] initWithBeacons:beacons]];
+}
+
+- (void) inputBeaconScan:(NavBeaconScan *)scan
 {
     if (!_readyForBeacons) {
         return;
     }
-    if (beacons == _previousBeaconInput) {
+    if (scan == _previousBeaconInput) {
         return;
     }
-    _previousBeaconInput = beacons;
+    _previousBeaconInput = scan;
+    const NavBeaconFrame &frame = scan.frame;
     NavLocalizeResult *r = [[NavLocalizeResult alloc] init];
     
     // for run test
-    if ([beacons count] == 1 && [[beacons objectAtIndex:0] isKindOfClass:[NSString class]]) {
+    if (frame.isRunTest()) {
         if (_d1meanLoc) {
             r.x = Meter2Feet(_d1meanLoc->x());
             r.y = Meter2Feet(_d1meanLoc->y());
@@ -460,7 +384,7 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
         return;
     }
     
-    if ([beacons count] == 0) {
+    if (frame.empty()) {
         if (_d1meanLoc) {
             r.x = Meter2Feet(_d1meanLoc->x());
             r.y = Meter2Feet(_d1meanLoc->y());
@@ -470,20 +394,7 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
         return;
     }
     
-    Beacons cbeacons;
-    
-    for(int i = 0; i < [beacons count]; i++) {
-        CLBeacon *b = [beacons objectAtIndex: i];
-        int rssi = -100;
-        if (b.rssi < 0) {
-            rssi = b.rssi;
-        }
-        NSString *key = [NSString stringWithFormat:@"%d", b.minor.intValue];
-        Beacon cb(b.major.intValue, b.minor.intValue, rssi);
-        cbeacons.push_back(cb);
-    }
-    
-    cbeacons.timestamp([[NSDate date] timeIntervalSince1970]*1000);
+    Beacons cbeacons = NavParticleLocalizer::beacons(frame);
     _cbeacons = cbeacons;
     
     if(_transiting){
@@ -491,8 +402,7 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
         return;
     }
     
-    _localizer->putBeacons(cbeacons);
-    //[self sendStatusByP2P: *_localizer->getStatus()];
+    _particle->putBeacons(cbeacons);
     
     if (_d1meanLoc) {
         r.x = Meter2Feet(_d1meanLoc->x());
@@ -511,9 +421,18 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
  
 - (void) inputBeaconsTransit: (Beacons) beacons{
     
-    States states = _statusInitializer->initializeStates(self.nEvalPoint);
+    if (!_transitTable) {
+        NSDate *start = [NSDate date];
+        _transitTable = [self stateTableForStates:std::make_shared<States>(_particle->statusInitializer()->initializeStates(self.nEvalPoint))];
+        NSLog(@"TransitStates,%@,%d,%f", self.idStr, (int)_transitTable->states->size(), [[NSDate date] timeIntervalSinceDate:start] * 1000);
+    }
+    const States &states = *_transitTable->states;
+    
+    if (_benchmarkTransit) {
+        [self benchmarkTransit:beacons];
+    }
 
-    State maxLLState = [self findMaximumLikelihoodLocation:beacons Given:states With: self.cumProba];
+    State maxLLState = [self findMaximumLikelihoodLocation:beacons Given:states With: self.cumProba Table:_transitTable.get()];
     NavLocalizeResult *r = [[NavLocalizeResult alloc] init];
     
     r.x = Meter2Feet(maxLLState.x());
@@ -540,9 +459,91 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
     _result = r;
 }
 
-- (State) findMaximumLikelihoodLocation: (Beacons) beacons Given: (States) states With:(double) cumulative{
+// columns are added to the table as beacons show up, each costs three model
+// evaluations of a single beacon over all states
+- (std::shared_ptr<NavStateTable>) stateTableForStates: (std::shared_ptr<States>) states{
+    std::shared_ptr<NavStateTable> table = std::make_shared<NavStateTable>();
+    table->states = states;
+    std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel = _obsModel;
+    table->mahalanobis = std::make_shared<NavMahalanobisTable>((int)states->size(), [obsModel, states](int major, int minor, double rssi, double *dists) {
+        Beacons probe;
+        probe.push_back(Beacon(major, minor, rssi));
+        std::vector<std::vector<double>> values = obsModel->computeLogLikelihoodRelatedValues(*states, probe);
+        if (values.empty() || values.at(0).at(2) == 0) {
+            return false;
+        }
+        for (size_t i = 0; i < values.size(); i++) {
+            dists[i] = values[i].at(1);
+        }
+        return true;
+    });
+    return table;
+}
+
+// knots of the edge at every foot with the predicted RSSI of all beacons tabulated
+- (void) prepareForEdge: (NavLightEdge*) edge{
+    [[NavLocalizationExecutor sharedInstance] performSync:^{
+        [self prepareForEdgeOnLocalizationQueue:edge];
+    }];
+}
+
+- (void) prepareForEdgeOnLocalizationQueue: (NavLightEdge*) edge{
+    if (!edge.edgeID) {
+        return;
+    }
+    if (!_readyForBeacons) {
+        // prepared when the model is there
+        if (!_pendingEdges) {
+            _pendingEdges = [@[] mutableCopy];
+        }
+        if (![_pendingEdges containsObject:edge]) {
+            [_pendingEdges addObject:edge];
+        }
+        return;
+    }
+    NSDate *start = [NSDate date];
+    std::shared_ptr<NavStateTable> table = [self stateTableForStates:std::make_shared<States>([self navEdgeLightToKnotStates:edge ByFeet:1])];
+    if (!_mahalanobisTableDisabled) {
+        for (const std::pair<int, int> &key : _beaconKeys) {
+            table->mahalanobis->column(key.first, key.second);
+        }
+    }
+    _edgeTables[[edge.edgeID UTF8String]] = table;
+    NSLog(@"EdgeKnots,%@,%@,%d,%d,%f", self.idStr, edge.edgeID, table->mahalanobis->stateNum(), table->mahalanobis->columnNum(),
+          [[NSDate date] timeIntervalSinceDate:start] * 1000);
+}
+
+// compares the cached states and table against sampling and evaluating the model for each scan
+- (void) benchmarkTransit: (const Beacons&) beacons{
+    NSDate *start = [NSDate date];
+    States sampled = _particle->statusInitializer()->initializeStates(self.nEvalPoint);
+    State modelState = [self findMaximumLikelihoodLocation:beacons Given:sampled With:self.cumProba Table:NULL];
+    NSTimeInterval modelTime = [[NSDate date] timeIntervalSinceDate:start];
+    start = [NSDate date];
+    State tableState = [self findMaximumLikelihoodLocation:beacons Given:*_transitTable->states With:self.cumProba Table:_transitTable.get()];
+    NSTimeInterval tableTime = [[NSDate date] timeIntervalSinceDate:start];
+    NSLog(@"TransitBenchmark,%@,%d,model,%f,%f,table,%f,%f", self.idStr, (int)beacons.size(),
+          modelTime * 1000, modelState.mahalanobisDistance(), tableTime * 1000, tableState.mahalanobisDistance());
+}
+
+- (double) chiSquaredQuantile: (int) dof With: (double) cumulative{
+    if (cumulative != _quantileCumulative) {
+        _chiSquaredQuantiles.clear();
+        _quantileCumulative = cumulative;
+    }
+    if (dof >= _chiSquaredQuantiles.size()) {
+        _chiSquaredQuantiles.resize(dof + 1, -1);
+    }
+    if (_chiSquaredQuantiles[dof] < 0) {
+        _chiSquaredQuantiles[dof] = MathUtils::quantileChiSquaredDistribution(dof, cumulative);
+    }
+    return _chiSquaredQuantiles[dof];
+}
+
+// table is optional, it has to be built over states
+- (State) findMaximumLikelihoodLocation: (const Beacons&) beacons Given: (const States&) states With:(double) cumulative Table:(NavStateTable*) table{
     _obsModel->fillsUnknownBeaconRssi(false);
-    Beacons beaconsFiltered = _beaconFilter->filter(beacons);
+    Beacons beaconsFiltered = _particle->beaconFilter()->filter(beacons);
     
     StrongestBeaconFilter sbf;
 //    double cutoffRssiForCurrentLocation = -100;
@@ -553,24 +554,38 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
     double countKnown = 0, countUnknown = 0;
     double minMahaDist = std::numeric_limits<double>::max();
     State stateMinMD;
-    // Count how many beacons the observation model knows
-    std::vector<double> logLLAndMahaDistsFor1stState = _obsModel->computeLogLikelihoodRelatedValues(states.at(0), beaconsFiltered);
-    countKnown = logLLAndMahaDistsFor1stState.at(2);
-    countUnknown = logLLAndMahaDistsFor1stState.at(3);
-    // If the observation model knows no beacon, likelihood evaluation for all the states is skipped.
-    if(countKnown==0){
-        stateMinMD = states.at(0);
+    if (_mahalanobisTableDisabled) {
+        table = NULL;
+    }
+    if (table && table->checked) {
+        // the table knows the same beacons as the model, nothing to evaluate
+        countKnown = [self findMinimumMahalanobisDistance:&minMahaDist State:&stateMinMD For:beaconsFiltered Table:table];
+        countUnknown = beaconsFiltered.size() - countKnown;
+        if(countKnown==0){
+            stateMinMD = states.at(0);
+        }
     }else{
-        std::vector<std::vector<double>> logLLAndMahaDists = _obsModel->computeLogLikelihoodRelatedValues(states, beaconsFiltered);
-        for(int i=0; i<states.size(); i++){
-            std::vector<double> logLLAndMahaDist = logLLAndMahaDists.at(i);
-            double logLikelihood = _alphaObsModel * logLLAndMahaDist.at(0);
-            double mahaDist = _alphaObsModel * logLLAndMahaDist.at(1);
-            countKnown = logLLAndMahaDist.at(2);
-            countUnknown = logLLAndMahaDist.at(3);
-            if(mahaDist < minMahaDist){
-                minMahaDist = mahaDist;
-                stateMinMD = states.at(i);
+        // Count how many beacons the observation model knows
+        std::vector<double> logLLAndMahaDistsFor1stState = _obsModel->computeLogLikelihoodRelatedValues(states.at(0), beaconsFiltered);
+        countKnown = logLLAndMahaDistsFor1stState.at(2);
+        countUnknown = logLLAndMahaDistsFor1stState.at(3);
+        // If the observation model knows no beacon, likelihood evaluation for all the states is skipped.
+        if(countKnown==0){
+            stateMinMD = states.at(0);
+        }else if(table && [self checkTable:table For:beaconsFiltered Known:countKnown FirstDistance:logLLAndMahaDistsFor1stState.at(1)]){
+            [self findMinimumMahalanobisDistance:&minMahaDist State:&stateMinMD For:beaconsFiltered Table:table];
+        }else{
+            std::vector<std::vector<double>> logLLAndMahaDists = _obsModel->computeLogLikelihoodRelatedValues(states, beaconsFiltered);
+            for(int i=0; i<states.size(); i++){
+                std::vector<double> logLLAndMahaDist = logLLAndMahaDists.at(i);
+                double logLikelihood = _alphaObsModel * logLLAndMahaDist.at(0);
+                double mahaDist = _alphaObsModel * logLLAndMahaDist.at(1);
+                countKnown = logLLAndMahaDist.at(2);
+                countUnknown = logLLAndMahaDist.at(3);
+                if(mahaDist < minMahaDist){
+                    minMahaDist = mahaDist;
+                    stateMinMD = states.at(i);
+                }
             }
         }
     }
@@ -579,7 +594,7 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
     double quantile = 0.0;
     if(self.minCountKnownBeacons<=countKnown){
         dof = countKnown;
-        quantile = MathUtils::quantileChiSquaredDistribution(dof, cumulative);
+        quantile = [self chiSquaredQuantile:dof With:cumulative];
     }else{
         dof = 0;
         minMahaDist = 1000; // large value
@@ -595,12 +610,50 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
     return stateMinMD;
 }
 
-- (double) computeNormalizedMahalanobisDistance: (Beacons) beacons Given: (States) states With:(double) quantile{
-    State stateMinMD = [self findMaximumLikelihoodLocation:beacons Given:states With:quantile];
+// returns the number of beacons known to the table, minMahaDist and
+// stateMinMD are only set if there is any
+- (int) findMinimumMahalanobisDistance: (double*) minMahaDist State: (State*) stateMinMD For: (const Beacons&) beacons Table:(NavStateTable*) table{
+    _tableColumns.clear();
+    _tableRssi.clear();
+    for (const Beacon &b : beacons) {
+        int col = table->mahalanobis->column(b.major(), b.minor());
+        if (col >= 0) {
+            _tableColumns.push_back(col);
+            _tableRssi.push_back(b.rssi());
+        }
+    }
+    if (_tableColumns.empty()) {
+        return 0;
+    }
+    double dist;
+    int i = table->mahalanobis->nearest(_tableColumns.data(), _tableRssi.data(), (int)_tableColumns.size(), &dist);
+    *minMahaDist = _alphaObsModel * dist;
+    *stateMinMD = table->states->at(i);
+    return (int)_tableColumns.size();
+}
+
+// the first use of a table is checked against the model's own values for the
+// first state, tables are not used any more if they differ
+- (BOOL) checkTable: (NavStateTable*) table For: (const Beacons&) beacons Known: (double) countKnown FirstDistance:(double) firstMahaDist{
+    double dist;
+    State state;
+    int known = [self findMinimumMahalanobisDistance:&dist State:&state For:beacons Table:table];
+    double tableDist = known > 0 ? table->mahalanobis->lastDistances()[0] : 0;
+    if (known != countKnown || fabs(tableDist - firstMahaDist) > 1e-6 * fmax(1, fabs(firstMahaDist))) {
+        NSLog(@"MahalanobisTable,%@,mismatch,%d,%f,%f,%f", self.idStr, known, countKnown, tableDist, firstMahaDist);
+        _mahalanobisTableDisabled = YES;
+        return NO;
+    }
+    table->checked = true;
+    return YES;
+}
+
+- (double) computeNormalizedMahalanobisDistance: (const Beacons&) beacons Given: (const States&) states With:(double) quantile Table:(NavStateTable*) table{
+    State stateMinMD = [self findMaximumLikelihoodLocation:beacons Given:states With:quantile Table:table];
     return stateMinMD.mahalanobisDistance();
 }
 
-- (NSDictionary*) statusToNSData: (Status) status{
+- (NSDictionary*) statusToNSData: (const Status&) status{
     bool outputState = true;
     picojson::object json =  DataUtils::statusToJSONObject(status, outputState);
     std::string cppstr = picojson::value(json).serialize();
@@ -616,65 +669,73 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
 }
 
 
-- (void) sendStatusByP2P: (Status) status{
-    if (self != activeLocalizer) {
+// binary status for the monitor, see NavStatusFrame.hpp
+- (NSData*) statesToFrame: (const States&) states Mean: (const Pose*) mean{
+    if (!_statusFrame) {
+        int n = (int)[[NSUserDefaults standardUserDefaults] integerForKey:@"p2p_status_particles_preference"];
+        _statusFrame = std::make_shared<NavStatusFrame>(n > 0 ? n : 200);
+    }
+    std::vector<uint8_t> frame;
+    _statusFrame->encodeStates((int64_t)([[NSDate date] timeIntervalSince1970] * 1000), mean, states, frame);
+    return [NSData dataWithBytes:frame.data() length:frame.size()];
+}
+
+// status is streamed at the P2PManager rate as JSON, as binary frames
+// with p2p_status_frame_preference once the monitor decodes them
+- (void) sendStatusByP2P: (const Status&) status{
+    if (self != activeLocalizer || !status.states()) {
         return;
     }
-    if([[P2PManager sharedInstance] isActive]){
-        NSDictionary* data = [self statusToNSData: status];
-        [[P2PManager sharedInstance] send:data withType:@"2d-status" ];
+    P2PManager *p2p = [P2PManager sharedInstance];
+    if ([[NSUserDefaults standardUserDefaults] boolForKey:@"p2p_status_frame_preference"]) {
+        if ([p2p isStreamDue:@"2d-status-frame"]) {
+            [p2p stream:[self statesToFrame:*status.states() Mean:status.meanPose().get()] withType:@"2d-status-frame"];
+        }
+    } else if ([p2p isStreamDue:@"2d-status"]) {
+        [p2p stream:[self statusToNSData: status] withType:@"2d-status"];
     }
 }
 
-- (void) sendStatesByP2P: (States) states{
-    Status status;
-    States* statesNew = new States(states);
-    status.states(statesNew);
-    [self sendStatusByP2P:status];
+- (void) sendStatesByP2P: (const States&) states{
+    if (self != activeLocalizer) {
+        return;
+    }
+    P2PManager *p2p = [P2PManager sharedInstance];
+    if ([[NSUserDefaults standardUserDefaults] boolForKey:@"p2p_status_frame_preference"]) {
+        if ([p2p isStreamDue:@"2d-status-frame"]) {
+            [p2p stream:[self statesToFrame:states Mean:NULL] withType:@"2d-status-frame"];
+        }
+    } else if ([p2p isStreamDue:@"2d-status"]) {
+        Status status;
+        status.states(new States(states));
+        [p2p stream:[self statusToNSData: status] withType:@"2d-status"];
+    }
 }
 
 
 - (void)inputAcceleration:(NSDictionary *)data
 {
     activeLocalizer = self;
-    long timestamp = [data[@"timestamp"] doubleValue]*1000;
-    
-    if(timestamp!=_previousAccTimestamp){
-        
-        Acceleration acc = Acceleration([data[@"timestamp"] doubleValue]*1000,
-                                        [data[@"x"] doubleValue ],
-                                        [data[@"y"] doubleValue ],
-                                        [data[@"z"] doubleValue ]);
-        
-        //NSLog(@"input acc");
-        if(!_transiting){
-            _localizer->putAcceleration(acc);
-        }
+    if(!_transiting){
+        _particle->putAcceleration([data[@"timestamp"] doubleValue]*1000,
+                                   [data[@"x"] doubleValue],
+                                   [data[@"y"] doubleValue],
+                                   [data[@"z"] doubleValue]);
     }
-    _previousAccTimestamp = timestamp;
 }
 
 - (void) inputMotion: (NSDictionary*) data
 {
     activeLocalizer = self;
-    long timestamp = [data[@"timestamp"] doubleValue]*1000;
-    
-    if(timestamp!=_previousAttTimestamp){
-//        Attitude att = Attitude([data[@"timestamp"] doubleValue]*1000,
-//                                [data[@"pitch"] doubleValue ],
-//                                [data[@"roll"] doubleValue ],
-//                                [data[@"yaw"] doubleValue ]);
-        // ignore gyro sensor
-        Attitude att = Attitude([data[@"timestamp"] doubleValue]*1000, 0, 0, 0);
-        
-        [[P2PManager sharedInstance] send:@{@"value":@(-[data[@"yaw"] doubleValue]/M_PI*180)} withType:@"orientation"];
-        
-        //NSLog(@"input att");
-        if(!_transiting){
-            _localizer->putAttitude(att);
-        }
+    [[P2PManager sharedInstance] send:@{@"value":@(-[data[@"yaw"] doubleValue]/M_PI*180)} withType:@"orientation"];
+    
+    // the 1D config ignores the gyro sensor
+    if(!_transiting){
+        _particle->putAttitude([data[@"timestamp"] doubleValue]*1000,
+                               [data[@"pitch"] doubleValue],
+                               [data[@"roll"] doubleValue],
+                               [data[@"yaw"] doubleValue]);
     }
-    _previousAttTimestamp = timestamp;
 }
 
 - (std::vector<State>) navEdgeLightToKnotStates: (NavLightEdge*) edge ByFeet: (double) feet{
@@ -714,10 +775,24 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
 }
 
 
+// the particles move with every acceleration input
+- (BOOL) distanceScoreDependsOnMotion
+{
+    return _particleScore;
+}
+
+- (NSInteger) distanceScoreMode
+{
+    return _transiting;
+}
+
 - (double) computeDistanceScoreWithOptions: (NSDictionary*) options{
     if (_transiting) {
         return _result.knndist;
     }
+    if (_particleScore) {
+        return [self computeParticleBasedDistanceScoreWithOptions:options];
+    }
     return [self computeBeaconBasedDistanceScoreWithOptions:options];
 }
 
@@ -727,69 +802,63 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
     NavLightEdgeHolder* holder = [NavLightEdgeHolder sharedInstance];
     NavLightEdge* edge = [holder getNavLightEdgeByEdgeID:edgeID];
     
-    States states = [self navEdgeLightToKnotStates:edge ByFeet:intervalInFeet];
+    auto it = edgeID ? _edgeTables.find([edgeID UTF8String]) : _edgeTables.end();
+    if (it == _edgeTables.end() && edge.edgeID) {
+        [self prepareForEdge:edge];
+        it = _edgeTables.find([edge.edgeID UTF8String]);
+    }
+    std::shared_ptr<NavStateTable> table;
+    States states;
+    if (it != _edgeTables.end()) {
+        table = it->second;
+    } else {
+        states = [self navEdgeLightToKnotStates:edge ByFeet:intervalInFeet];
+    }
     double v = 100;
     
-    Beacons beaconsFiltered = _beaconFilter->filter(_cbeacons);
+    Beacons beaconsFiltered = _particle->beaconFilter()->filter(_cbeacons);
     
     if(_cbeacons.size()>0){
-        v = [self computeNormalizedMahalanobisDistance:beaconsFiltered Given:states With: self.cumProba];
+        NSDate *start = [NSDate date];
+        v = [self computeNormalizedMahalanobisDistance:beaconsFiltered Given:table ? *table->states : states With: self.cumProba Table:table.get()];
+        if (_benchmarkEdgeScore && table) {
+            [self benchmarkEdgeScore:edge Beacons:beaconsFiltered Table:[[NSDate date] timeIntervalSinceDate:start]];
+        }
     }
     //double v = _normalizedMahalanobisDistance;
     //NSLog(@"2D knnDist: eid=%@, dist=%.2f, dof=%d", edgeID, v, dof);
     return v;
 }
 
+// compares scoring from the knot table against building the knots and
+// evaluating the model at each of them
+- (void) benchmarkEdgeScore: (NavLightEdge*) edge Beacons: (const Beacons&) beacons Table: (NSTimeInterval) tableTime{
+    NSDate *start = [NSDate date];
+    States states = [self navEdgeLightToKnotStates:edge ByFeet:1];
+    [self computeNormalizedMahalanobisDistance:beacons Given:states With:self.cumProba Table:NULL];
+    _edgeScoreModelTime += [[NSDate date] timeIntervalSinceDate:start];
+    _edgeScoreTableTime += tableTime;
+    if (++_edgeScoreCount % 100 == 0) {
+        NSLog(@"EdgeScoreBenchmark,%@,%d,%d,table,%f,model,%f", self.idStr, (int)_edgeTables.size(), _edgeScoreCount,
+              _edgeScoreTableTime * 1e6 / _edgeScoreCount, _edgeScoreModelTime * 1e6 / _edgeScoreCount);
+    }
+}
+
 - (double) computeParticleBasedDistanceScoreWithOptions: (NSDictionary*) options{
     NSString* edgeID = options[@"edgeID"];
     NavLightEdgeHolder* holder = [NavLightEdgeHolder sharedInstance];
     NavLightEdge* edge = [holder getNavLightEdgeByEdgeID:edgeID];
     
-    double distanceSum = 0;
-    if (!_d1states) {
-        return 100 * 1000; // return far distance if not ready
-    }
-    assert(_d1states);
-    
-    loc::Location stdloc = loc::Location::standardDeviation(*_d1states);
-    
-    for(State state: *_d1states){
-        double distance = [self computeDistanceBetweenState:state AndEdge:edge];
-        distanceSum += distance;
-    }
-    double edgeLength = [edge length];
-    
-    double distanceMean = distanceSum/_d1states->size();
-    double stdx = stdloc.x()*3;
-    double stdy = stdloc.y()*3;
-    double v = fmax(distanceMean, sqrt(pow(stdx,2) + pow(stdy,2)))/6.0;
+    // all states are assumed on the floor of the edge
+    NSData *segments = edge.packedSegments;
+    double v = _particle->particleDistanceScore((const double *)segments.bytes, (int)(segments.length / sizeof(double) / 4));
     
-    //NSLog(@"2D knnDist: %@, %.2f, %.2f, %.2f, %.2f, %.2f", edgeID, v, distanceMean, stdx, stdy, edgeLength);
+    //NSLog(@"2D knnDist: %@, %.2f", edgeID, v);
     
     return v;
 }
 
 
-- (double) computeDistanceBetweenState: (State) state AndEdge:(NavLightEdge*) edge{
-    static double distanceByFloorDiff = 100;
-    static double floorDifferenceTolerance = 0.1;
-    
-    double distance = 0;
-    double x = Meter2Feet(state.x());
-    double y = Meter2Feet(state.y());
-    //double floor = state.floor() + 1;
-    Nav2DPoint* point = [[Nav2DPoint alloc] initWithX:x Y:y];
-    
-    //double floorDifference = fabs(floor-edge.floor);
-    double floorDifference = 0; // assume on same floor
-    if(floorDifference>floorDifferenceTolerance){
-        distance += floorDifference*distanceByFloorDiff;
-    }
-    
-    distance += [[edge getNearestSegmentFromPoint:point] getDistanceNearestPointOnLineSegmentFromPoint:point];
-    return distance;
-}
-
 //- (double) computeDistanceScoreWithOptions: (NSDictionary*) options{
 //    return [self computeAverageNegativeLogLikelihood];
 //}
@@ -803,11 +872,159 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
     return sum/_d1states->size();
 }
 
+// Trained models are shared by all localizers with the same samples and
+// beacon layout and cached in NSTemporaryDirectory under a hash of both.
+// Models are loaded or trained as independent tasks on a concurrent queue,
+// a model requested again while in flight is not built twice. The handler is
+// called on the training queue (or inline if the model is already there).
+- (void) observationModelForKey: (uint64_t) key handler: (void (^)(std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>>)) handler
+{
+    {
+        std::lock_guard<std::mutex> lock(obsModelsMutex);
+        std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> shared = obsModels[key].lock();
+        if (!shared) {
+            NSMutableArray *handlers = pendingObsModels[key];
+            if (handlers) {
+                [handlers addObject:handler];
+                return;
+            }
+            pendingObsModels[key] = [NSMutableArray arrayWithObject:handler];
+        } else {
+            NSLog(@"ObsModel,%@,%016llx,shared", self.idStr, key);
+            handler(shared);
+            return;
+        }
+    }
+    
+    static dispatch_queue_t trainingQueue;
+    static dispatch_semaphore_t trainingWidth;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        trainingQueue = dispatch_queue_create("hulop.navcog.training", DISPATCH_QUEUE_CONCURRENT);
+        // trainbenchmark=n limits training to n threads and ignores cached models
+        NSString *threads = [[[NSProcessInfo processInfo] environment] valueForKey:@"trainbenchmark"];
+        if (threads) {
+            trainingWidth = dispatch_semaphore_create(MAX(1, [threads intValue]));
+        }
+    });
+    
+    // trained from a snapshot, later setBeacons: calls may change the data store
+    std::shared_ptr<DataStoreImpl> dataStore = std::make_shared<DataStoreImpl>(*_dataStore);
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"obsmodel-%016llx.navmodel", key]];
+    {
+        std::lock_guard<std::mutex> lock(obsModelsMutex);
+        if (trainingTaskNum++ == 0) {
+            trainingBatchStart = [NSDate date];
+        }
+    }
+    dispatch_async(trainingQueue, ^{
+        if (trainingWidth) {
+            dispatch_semaphore_wait(trainingWidth, DISPATCH_TIME_FOREVER);
+        }
+        NSDate *start = [NSDate date];
+        std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel(new GaussianProcessLDPLMultiModel<State, Beacons>());
+        NSString *source;
+        NavModelCacheFile file;
+        if (!trainingWidth && file.open([path UTF8String], key)) {
+            NavMemoryStream is(file.payload(), file.payloadLength());
+            obsModel->load(is);
+            source = @"loaded";
+            if (_benchmarkModelCache) {
+                [self benchmarkModelCache:path Key:key];
+            }
+        } else {
+            // Train observation model
+            std::shared_ptr<GaussianProcessLDPLMultiModelTrainer<State, Beacons>>obsModelTrainer( new GaussianProcessLDPLMultiModelTrainer<State, Beacons>());
+            obsModelTrainer->dataStore(dataStore);
+            obsModel.reset(obsModelTrainer->train());
+            source = @"trained";
+            
+            // Seriealize observation model
+            if (!NavModelCacheFile::write([path UTF8String], key, [obsModel](std::ostream &os) { obsModel->save(os); })) {
+                NSLog(@"Could not write %@", path);
+            }
+        }
+        NSTimeInterval time = [[NSDate date] timeIntervalSinceDate:start];
+        if (trainingWidth) {
+            dispatch_semaphore_signal(trainingWidth);
+        }
+        NSLog(@"ObsModel,%@,%016llx,%@,%f", self.idStr, key, source, time * 1000);
+        
+        NSArray *handlers;
+        {
+            std::lock_guard<std::mutex> lock(obsModelsMutex);
+            obsModels[key] = obsModel;
+            handlers = pendingObsModels[key];
+            pendingObsModels.erase(key);
+            trainingTaskTime += time;
+            if (++trainingDoneNum == trainingTaskNum) {
+                // all models requested so far are there, e.g. the whole map is loaded
+                NSLog(@"ModelTraining,%d,%@,%f,%f", trainingDoneNum, trainingWidth ? @"limited" : @"unlimited",
+                      [[NSDate date] timeIntervalSinceDate:trainingBatchStart] * 1000, trainingTaskTime * 1000);
+                trainingTaskNum = trainingDoneNum = 0;
+                trainingTaskTime = 0;
+            }
+        }
+        for (void (^h)(std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>>) in handlers) {
+            h(obsModel);
+        }
+    });
+}
+
+// splits loading a cached model into mapping the payload and parsing it, and
+// compares with reading it through std::ifstream as before. The payload is
+// bleloc's text serialization: GaussianProcessLDPLMultiModel only saves to and
+// loads from streams, so the parse remains until bleloc has a binary format.
+- (void) benchmarkModelCache: (NSString*) path Key: (uint64_t) key
+{
+    NSDate *start = [NSDate date];
+    NavModelCacheFile file;
+    if (!file.open([path UTF8String], key)) {
+        return;
+    }
+    volatile char touched = 0;
+    for (size_t i = 0; i < file.payloadLength(); i += 4096) {
+        touched += file.payload()[i];
+    }
+    NSTimeInterval mapTime = [[NSDate date] timeIntervalSinceDate:start];
+    start = [NSDate date];
+    {
+        std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel(new GaussianProcessLDPLMultiModel<State, Beacons>());
+        NavMemoryStream is(file.payload(), file.payloadLength());
+        obsModel->load(is);
+    }
+    NSTimeInterval parseTime = [[NSDate date] timeIntervalSinceDate:start];
+    
+    NSString *textPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"obsmodel-benchmark.json"];
+    {
+        std::ofstream ofs([textPath UTF8String]);
+        ofs.write(file.payload(), file.payloadLength());
+    }
+    start = [NSDate date];
+    {
+        std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel(new GaussianProcessLDPLMultiModel<State, Beacons>());
+        std::ifstream ifs([textPath UTF8String]);
+        obsModel->load(ifs);
+    }
+    NSLog(@"ModelCacheBenchmark,%@,%lu,map,%f,parse,%f,ifstream,%f", self.idStr, (unsigned long)file.payloadLength(),
+          mapTime * 1000, parseTime * 1000, [[NSDate date] timeIntervalSinceDate:start] * 1000);
+    [[NSFileManager defaultManager] removeItemAtPath:textPath error:nil];
+}
+
 - (void)setBeacons:(NSDictionary *)beacons
+{
+    [[NavLocalizationExecutor sharedInstance] performSync:^{
+        [self setBeaconsOnLocalizationQueue:beacons];
+    }];
+}
+
+- (void)setBeaconsOnLocalizationQueue:(NSDictionary *)beacons
 {
     // BLE beacon locations
     
     BLEBeacons bleBeacons;
+    std::vector<std::tuple<int, int, double, double, uint64_t>> layout;
+    _beaconKeys.clear();
     for(NSString *key: beacons) {
         NSDictionary *beacon = beacons[key];
         std::string uuid = [beacon[@"uuid"] UTF8String];
@@ -819,44 +1036,54 @@ void d1calledWhenUpdated(void *userData, Status * pStatus){
         double floor = 0;
         BLEBeacon b = BLEBeacon(uuid, major, minor, x, y, z, floor);
         bleBeacons.push_back(b);
+        _beaconKeys.push_back(std::make_pair(major, minor));
+        layout.push_back(std::make_tuple(major, minor, x, y, NavFingerprintData::hashBytes(uuid.data(), uuid.size())));
     }
     _dataStore->bleBeacons(bleBeacons);
     
+    std::sort(layout.begin(), layout.end());
+    uint64_t key = NavFingerprintData::hashBytes(OBS_MODEL_CACHE_TAG, strlen(OBS_MODEL_CACHE_TAG), _samplesHash);
+    for (const std::tuple<int, int, double, double, uint64_t> &t : layout) {
+        // field by field, the tuple's layout may have padding
+        int32_t ids[] = {std::get<0>(t), std::get<1>(t)};
+        double xy[] = {std::get<2>(t), std::get<3>(t)};
+        uint64_t uuidHash = std::get<4>(t);
+        key = NavFingerprintData::hashBytes(ids, sizeof(ids), key);
+        key = NavFingerprintData::hashBytes(xy, sizeof(xy), key);
+        key = NavFingerprintData::hashBytes(&uuidHash, sizeof(uuidHash), key);
+    }
     
-    NSString *tempPath = NSTemporaryDirectory();
-    tempPath = [tempPath stringByAppendingPathComponent:[NSString stringWithFormat:@"%@-obsmodel.json", super.idStr]];
-    NSFileManager *fm = [NSFileManager defaultManager];
-    std::string serializedModelPath = [tempPath UTF8String];
-    std::cout << "serializedModelPath: " << serializedModelPath << std::endl;
-    
-    std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel;
-    if ([fm fileExistsAtPath:tempPath]) {
-        //std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> deserializedModel(new GaussianProcessLDPLMultiModel<State, Beacons>());
-        obsModel.reset(new GaussianProcessLDPLMultiModel<State, Beacons>());
-        {
-            std::ifstream ifs(serializedModelPath);
-            obsModel->load(ifs);
-        }
-        _localizer->observationModel(obsModel);
-        _obsModel = obsModel;
-    } else {
-        // Train observation model
-        std::shared_ptr<GaussianProcessLDPLMultiModelTrainer<State, Beacons>>obsModelTrainer( new GaussianProcessLDPLMultiModelTrainer<State, Beacons>());
-        obsModelTrainer->dataStore(_dataStore);
-        obsModel.reset(obsModelTrainer->train());
-        ////std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel( obsModelTrainer->train());
-        _localizer->observationModel(obsModel);
-        _obsModel = obsModel;
-        
-        // Seriealize observation model
-        std::cout << "Serializing observationModel" <<std::endl;
-        {
-            std::ofstream ofs(serializedModelPath);
-            obsModel->save(ofs);
-        }
+    // the localizer becomes ready when its model is there, until then
+    // (or a newer model is there) beacons are ignored or the old model is used
+    _modelKey = key;
+    __weak OneDLocalizer *weakSelf = self;
+    [self observationModelForKey:key handler:^(std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> obsModel) {
+        [[NavLocalizationExecutor sharedInstance] performAsync:^{
+            [weakSelf setObservationModel:obsModel forKey:key];
+        }];
+    }];
+}
+
+- (void)setObservationModel: (std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>>) obsModel forKey: (uint64_t) key
+{
+    if (key != _modelKey) {
+        return;
     }
+    // the same key gives the same model, tables built over it stay valid
+    BOOL modelChanged = obsModel != _obsModel;
+    _particle->observationModel(obsModel);
+    _obsModel = obsModel;
     obsModel->fillsUnknownBeaconRssi(false);
+    if (modelChanged) {
+        _transitTable.reset();
+        _edgeTables.clear();
+        _mahalanobisTableDisabled = NO;
+    }
     _readyForBeacons = true;
+    for (NavLightEdge *edge in _pendingEdges) {
+        [self prepareForEdge:edge];
+    }
+    [_pendingEdges removeAllObjects];
 }
 
 @end
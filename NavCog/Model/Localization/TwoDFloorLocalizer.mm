@@ -52,6 +52,11 @@
     [self.localizer inputBeacons:beacons];
 }
 
+- (void) inputBeaconScan:(NavBeaconScan *)scan
+{
+    [self.localizer inputBeaconScan:scan];
+}
+
 - (void) inputAcceleration: (NSDictionary*) data
 {
     [self.localizer inputAcceleration:data];
@@ -66,4 +71,20 @@
     return [self.localizer computeDistanceScoreWithOptions:options];
 }
 
+// scores are the floor independent ones of the 2D localizer, so is the cache
+- (void) beginInputEpoch
+{
+    [self.localizer beginInputEpoch];
+}
+
+- (double) cachedDistanceScoreWithOptions:(NSDictionary *)options
+{
+    return [self.localizer cachedDistanceScoreWithOptions:options];
+}
+
+- (BOOL) distanceScoreDependsOnMotion
+{
+    return self.localizer.distanceScoreDependsOnMotion;
+}
+
 @end
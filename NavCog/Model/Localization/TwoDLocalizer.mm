@@ -31,39 +31,26 @@
 #import "NavNode.h"
 #import "NavLocalizeResult.h"
 #import "NavLineSegment.h"
+#import "NavLocalizationExecutor.h"
+#import "NavMemoryStream.hpp"
+#import "NavStatusFrame.hpp"
+#import "NavParticleLocalizer.hpp"
+#import <mach/mach.h>
 
 #include <bleloc/StreamLocalizer.hpp>
 #include <bleloc/StreamParticleFilter.hpp>
 
-#include <bleloc/PoseRandomWalker.hpp>
-
-#include <bleloc/GridResampler.hpp>
-#include <bleloc/StatusInitializerImpl.hpp>
-
 #include <bleloc/DataStore.hpp>
 #include <bleloc/DataStoreImpl.hpp>
 
-#include <bleloc/OrientationMeterAverage.hpp>
-#include <bleloc/PedometerWalkingState.hpp>
-
 #include <bleloc/GaussianProcessLDPLMultiModel.hpp>
 
-// for pose random walker in building
 #include <bleloc/Building.hpp>
-#include <bleloc/PoseRandomWalkerInBuilding.hpp>
-
-#include <bleloc/StrongestBeaconFilter.hpp>
-
-#include <bleloc/MetropolisSampler.hpp>
 
 #import "NavLineSegment.h"
 
 using namespace loc;
 
-typedef struct LocalizerData2 {
-    TwoDLocalizer* localizer;
-} LocalizerData;
-
 enum ResetMode{
     reset,
     allReset
@@ -71,33 +58,26 @@ enum ResetMode{
 
 @interface TwoDLocalizer ()
 @property NavEdge *currentEdge;
-@property std::shared_ptr<OrientationMeter> orientationMeter;
+@property std::shared_ptr<NavParticleLocalizer> particle;
 @property NSMutableArray *buildingJSON;
 @property NSTimer *tryResetTimer;
 @property NSDictionary *currentOptions;
-@property LocalizerData2 userData;
 
 @property std::shared_ptr<Location> meanLoc;
 @property std::shared_ptr<Pose> meanPose;
 @property std::shared_ptr<States> states;
 
-@property loc::Pose stdevPose;
-@property NSArray *previousBeaconInput;
+@property NavBeaconScan *previousBeaconInput;
 @property NavLocalizeResult *result;
 
-@property long previousTimestamp;
 @property ResetMode resetMode;
 @property double minDistAfterAllReset;
+@property std::shared_ptr<NavStatusFrame> statusFrame;
 
 @end
 
 @implementation TwoDLocalizer
 
-- (void)dealloc
-{
-    delete _localizer;
-}
-
 - (id) init
 {
     self = [super init];
@@ -116,8 +96,24 @@ enum ResetMode{
     NSDictionary* env = [[NSProcessInfo processInfo] environment];
 }
 
+// The number of states is fixed unless adaptive_states_preference is on, then
+// it follows the KLD-sampling bound of the posterior between the min and max
+// preferences and goes back to the max at every reset.
+- (void) initStateNum
+{
+    NSUserDefaults *ud = [NSUserDefaults standardUserDefaults];
+    if ([ud boolForKey:@"adaptive_states_preference"]) {
+        int minNum = (int)[ud integerForKey:@"min_states_preference"];
+        int maxNum = (int)[ud integerForKey:@"max_states_preference"];
+        _particle->stateNumRange(minNum > 0 ? minNum : 100, maxNum > 0 ? maxNum : 1000);
+    } else {
+        _particle->stateNumRange(0, 1000);
+    }
+}
+
 - (void)initializeState:(NSDictionary *)options;
 {
+    _particle->resetStateNum();
     _resetMode = ResetMode::reset;
     self.currentOptions = options;
     if (options == nil) {
@@ -127,17 +123,22 @@ enum ResetMode{
         NSLog(@"2D localizer is all reset");
         _resetMode = ResetMode::allReset;
         _minDistAfterAllReset = std::numeric_limits<double>::max();
-        self.localizer->resetStatus();
+        _particle->resetStatus();
         return;
     }
     if (!options[@"first"] || ![options[@"first"] boolValue]) {
         return;
     }
     
-    if (self.tryResetTimer != nil) {
-        [self.tryResetTimer invalidate];
-    }
-    self.tryResetTimer = [NSTimer scheduledTimerWithTimeInterval:0.3 target:self selector:@selector(tryReset:) userInfo:options repeats:YES];
+    // initializeState may run on the localization queue, timers are
+    // scheduled and invalidated on the main run loop
+    NSTimer *previous = self.tryResetTimer;
+    NSTimer *timer = [NSTimer timerWithTimeInterval:0.3 target:self selector:@selector(tryReset:) userInfo:options repeats:YES];
+    self.tryResetTimer = timer;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [previous invalidate];
+        [[NSRunLoop mainRunLoop] addTimer:timer forMode:NSDefaultRunLoopMode];
+    });
 }
 
 - (NavLocalizeResult *)getLocation
@@ -148,7 +149,14 @@ enum ResetMode{
 
 
 - (void) tryReset:(NSTimer *)timer {
-    if (self.orientationMeter->isUpdated()) {
+    // the localizer is only touched on the localization queue
+    [[NavLocalizationExecutor sharedInstance] performAsync:^{
+        [self tryResetWithTimer:timer];
+    }];
+}
+
+- (void) tryResetWithTimer:(NSTimer *)timer {
+    if (timer == self.tryResetTimer && _particle->orientationUpdated()) {
         NSDictionary *options = timer.userInfo;
         
         double x, y, z, floor, orientation;
@@ -173,26 +181,38 @@ enum ResetMode{
         
         std::cout << "Sending reset request to the localizer.";
         std::cout << ", resetPose = " << pose << std::endl;
-        self.localizer->resetStatus();
-        //        self.localizer->resetStatus(pose);
-        self.localizer->resetStatus(pose, _stdevPose);
+        _particle->resetStatus();
+        // with the standard deviation of the 2D config
+        _particle->resetStatus(pose);
         NSLog(@"Reset %f %f %f %f", pose.x(), pose.y(), pose.floor(), pose.orientation());
         
-        [timer invalidate];
+        self.tryResetTimer = nil;
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [timer invalidate];
+        });
     }
 }
 
 
 - (void) inputBeacons:(NSArray*) beacons
 {
-    if (beacons == _previousBeaconInput) {
+    if (_previousBeaconInput && beacons == _previousBeaconInput.beacons) {
+        return;
+    }
+    [self inputBeaconScan:[[NavBeaconScan alloc] initWithBeacons:beacons]];
+}
+
+- (void) inputBeaconScan:(NavBeaconScan *)scan
+{
+    if (scan == _previousBeaconInput) {
         return;
     }
-    _previousBeaconInput = beacons;
+    _previousBeaconInput = scan;
+    const NavBeaconFrame &frame = scan.frame;
     NavLocalizeResult *r = [[NavLocalizeResult alloc] init];
     
     // for run test
-    if ([beacons count] == 1 && [[beacons objectAtIndex:0] isKindOfClass:[NSString class]]) {
+    if (frame.isRunTest()) {
         if (_meanLoc) {
             r.x = Meter2Feet(_meanLoc->x());
             r.y = Meter2Feet(_meanLoc->y());
@@ -202,7 +222,7 @@ enum ResetMode{
         return;
     }
     
-    if ([beacons count] == 0) {
+    if (frame.empty()) {
         if (_meanLoc) {
             r.x = Meter2Feet(_meanLoc->x());
             r.y = Meter2Feet(_meanLoc->y());
@@ -213,27 +233,17 @@ enum ResetMode{
     }
     
     // convert NSArray* to loc::Beacons to input it into the localizer
-    Beacons cbeacons;
-    for(int i = 0; i < [beacons count]; i++) {
-        CLBeacon *b = [beacons objectAtIndex: i];
-        int rssi = -100;
-        if (b.rssi < 0) {
-            rssi = b.rssi;
-        }
-        Beacon cb(b.major.intValue, b.minor.intValue, rssi);
-        cbeacons.push_back(cb);
-    }
-    cbeacons.timestamp([[NSDate date] timeIntervalSince1970]*1000);
+    Beacons cbeacons = NavParticleLocalizer::beacons(frame);
     
     // reset status with observed beacons during allReset mode.
     if(_resetMode==allReset){
         if(1.0<_minDistAfterAllReset){
             std::cout << "resetMode=allReset" << std::endl;
-            _localizer->resetStatus(cbeacons);
+            _particle->resetStatus(cbeacons);
         }
     }
     
-    _localizer->putBeacons(cbeacons);
+    _particle->putBeacons(cbeacons);
     if (_meanLoc) {
         r.x = Meter2Feet(_meanLoc->x());
         r.y = Meter2Feet(_meanLoc->y());
@@ -250,7 +260,7 @@ enum ResetMode{
     _result = r;
 }
 
-- (NSDictionary*) statusToNSData: (Status) status{
+- (NSDictionary*) statusToNSData: (const Status&) status{
     bool outputState = true;
     picojson::object json =  DataUtils::statusToJSONObject(status, outputState);
     std::string cppstr = picojson::value(json).serialize();
@@ -265,48 +275,57 @@ enum ResetMode{
     return obj;
 }
 
-- (void) sendStatusByP2P: (Status) status{
-    if([[P2PManager sharedInstance] isActive]){
-        NSDictionary* data = [self statusToNSData: status];
-        [[P2PManager sharedInstance] send:data withType:@"2d-status" ];
+// binary status for the monitor, see NavStatusFrame.hpp
+- (NSData*) statesToFrame: (const States&) states Mean: (const Pose*) mean{
+    if (!_statusFrame) {
+        int n = (int)[[NSUserDefaults standardUserDefaults] integerForKey:@"p2p_status_particles_preference"];
+        _statusFrame = std::make_shared<NavStatusFrame>(n > 0 ? n : 200);
+    }
+    std::vector<uint8_t> frame;
+    _statusFrame->encodeStates((int64_t)([[NSDate date] timeIntervalSince1970] * 1000), mean, states, frame);
+    return [NSData dataWithBytes:frame.data() length:frame.size()];
+}
+
+// streamed at the P2PManager rate as JSON, as binary frames with
+// p2p_status_frame_preference once the monitor decodes them
+- (void) sendStatusByP2P: (const Status&) status{
+    P2PManager *p2p = [P2PManager sharedInstance];
+    if ([[NSUserDefaults standardUserDefaults] boolForKey:@"p2p_status_frame_preference"]) {
+        if ([p2p isStreamDue:@"2d-status-frame"] && status.states()) {
+            [p2p stream:[self statesToFrame:*status.states() Mean:status.meanPose().get()] withType:@"2d-status-frame"];
+        }
+    } else if ([p2p isStreamDue:@"2d-status"]) {
+        [p2p stream:[self statusToNSData: status] withType:@"2d-status"];
     }
 }
 
 - (void)inputAcceleration:(NSDictionary *)data
 {
-    
-    long timestamp = [data[@"timestamp"] doubleValue]*1000;
-    
-    if(timestamp!=_previousTimestamp){
-        
-        Acceleration acc = Acceleration([data[@"timestamp"] doubleValue]*1000,
-                                        [data[@"x"] doubleValue ],
-                                        [data[@"y"] doubleValue ],
-                                        [data[@"z"] doubleValue ]);
-        
-        //NSLog(@"input acc");
-        _localizer->putAcceleration(acc);
-    }
-    _previousTimestamp = timestamp;
+    _particle->putAcceleration([data[@"timestamp"] doubleValue]*1000,
+                               [data[@"x"] doubleValue],
+                               [data[@"y"] doubleValue],
+                               [data[@"z"] doubleValue]);
 }
 
 - (void) inputMotion: (NSDictionary*) data
 {
-    static long previousTimestamp = -1;
-    long timestamp = [data[@"timestamp"] doubleValue]*1000;
-    
-    if(timestamp!=previousTimestamp){
-        Attitude att = Attitude([data[@"timestamp"] doubleValue]*1000,
-                                [data[@"pitch"] doubleValue ],
-                                [data[@"roll"] doubleValue ],
-                                [data[@"yaw"] doubleValue ]);
-        
-        //NSLog(@"input att");
-        _localizer->putAttitude(att);
-    }
-    previousTimestamp = timestamp;
+    _particle->putAttitude([data[@"timestamp"] doubleValue]*1000,
+                           [data[@"pitch"] doubleValue],
+                           [data[@"roll"] doubleValue],
+                           [data[@"yaw"] doubleValue]);
+}
+
+
+// particles move with every acceleration and attitude input
+- (BOOL) distanceScoreDependsOnMotion
+{
+    return YES;
 }
 
+- (NSInteger) distanceScoreMode
+{
+    return (NSInteger)_resetMode;
+}
 
 - (double) computeDistanceScoreWithOptions: (NSDictionary*) options{
     if(_resetMode==allReset){
@@ -337,7 +356,7 @@ double floorDifferenceTolerance = 0.5;
     NSString* edgeID = options[@"edgeID"];
     NavLightEdgeHolder* holder = [NavLightEdgeHolder sharedInstance];
     NavLightEdge* edge = [holder getNavLightEdgeByEdgeID:edgeID];
-    double distance = Feet2Meter([self computeDistanceBetweenLocation:*_meanLoc AndEdge:edge]); // in meter;
+    double distance = Feet2Meter([self computeDistanceOfStatesToEdge:edge Floor:_meanLoc->floor()]); // in meter;
     loc::Location stdloc = loc::Location::standardDeviation(*_states); //in meter
     
     double distThreshold = distThresh95percentile;
@@ -362,7 +381,7 @@ double floorDifferenceTolerance = 0.5;
     NSString* edgeID = options[@"edgeID"];
     NavLightEdgeHolder* holder = [NavLightEdgeHolder sharedInstance];
     NavLightEdge* edge = [holder getNavLightEdgeByEdgeID:edgeID];
-    double distance = Feet2Meter([self computeDistanceBetweenLocation:*_meanPose AndEdge:edge]); // in meter
+    double distance = Feet2Meter([self computeDistanceOfStatesToEdge:edge Floor:_meanPose->floor()]); // in meter
     loc::Location stdloc = loc::Location::standardDeviation(*_states);
     
     double distThreshold = distThresholdForTransit; // meter
@@ -373,104 +392,77 @@ double floorDifferenceTolerance = 0.5;
     return v;
 }
 
-- (double) computeDistanceBetweenLocation: (Location) state AndEdge:(NavLightEdge*) edge{
+// mean distance in feet of the particles to the edge, plus the floor
+// difference of the mean location
+- (double) computeDistanceOfStatesToEdge:(NavLightEdge*) edge Floor:(double) meanFloor{
     
     double distance = 0;
-    // Convert state to Nav2DPoint (in feet)
-    double x = Meter2Feet(state.x());
-    double y = Meter2Feet(state.y());
-    double floor = state.floor() + 1;
-    Nav2DPoint* point = [[Nav2DPoint alloc] initWithX:x Y:y];
+    double floor = meanFloor + 1;
     
     double floorDifference = fabs(floor-edge.floor);
     if(floorDifference>floorDifferenceTolerance){
         distance += floorDifference*distanceByFloorDiff;
     }
     
-    Nav2DPoint* nearestPointOnEdge = [[edge getNearestSegmentFromPoint:point] getNearestPointOnLineSegmentFromPoint:point];
-    
-    // in meter
-    double xOnE = Feet2Meter(nearestPointOnEdge.x);
-    double yOnE = Feet2Meter(nearestPointOnEdge.y);
-    double zOnE = 0;
-    double floorOnE = edge.floor - 1;
-    Location nearestPointOnEdgeAsLoc = Location(xOnE, yOnE, zOnE, floorOnE);
-    double distMeter3D = Location::distance(state, nearestPointOnEdgeAsLoc);
-    
-    distance += Meter2Feet(distMeter3D);
+    NSData *segments = edge.packedSegments;
+    distance += _particle->meanDistance((const double *)segments.bytes, (int)(segments.length / sizeof(double) / 4));
     
     return distance;
 }
 
-void calledWhenUpdated(void *userData, Status * pStatus){
+- (void) particleUpdated: (Status&) status{
     //NSLog(@"location updated");
-    LocalizerData2 *localizerData = (LocalizerData2*)userData;
-    TwoDLocalizer *loc = localizerData->localizer;
-    
-    loc.meanLoc = pStatus->meanLocation();
-    loc.meanPose = pStatus->meanPose();
-    loc.states = pStatus->states();
+    _meanLoc = _particle->meanLocation();
+    _meanPose = _particle->meanPose();
+    _states = _particle->states();
     
     NSDictionary *data = @{
-                           @"x": @(loc.meanLoc->x()),
-                           @"y": @(loc.meanLoc->y()),
-                           @"z": @(loc.meanLoc->z()),
-                           @"floor": @(loc.meanLoc->floor()),
-                           @"orientation": @(loc.meanPose->orientation()),
-                           @"velocity":@(loc.meanPose->velocity())
+                           @"x": @(_meanLoc->x()),
+                           @"y": @(_meanLoc->y()),
+                           @"z": @(_meanLoc->z()),
+                           @"floor": @(_meanLoc->floor()),
+                           @"orientation": @(_meanPose->orientation()),
+                           @"velocity":@(_meanPose->velocity())
                            };
     
     [[P2PManager sharedInstance] send:data withType:@"2d-position" ];
-    [loc sendStatusByP2P: *loc.localizer->getStatus()];
+    [self sendStatusByP2P: status];
     
     // printf("2D %f, %f, %f, %f, %f\n", meanLoc->x(), meanLoc->y(), meanLoc->floor(), meanPose->orientation(), meanPose->velocity());
     //std::cout << meanLoc->toString() << std::endl;
 }
 
 
-- (void)initializeWithJSON:(NSMutableDictionary *)json
+// peak resident size of the app so far
+static double peakResidentMegabytes()
 {
-    // write data into temp file and remove from memory
-    NSString *idStr = @"ObservationModelParameters.json";
-    NSString *ObservationModelParametersPath = [NavUtil createTempFile:[json objectForKey:@"ObservationModelParameters"] forID:&idStr];
-    [json removeObjectForKey:@"ObservationModelParameters"];
-    
-    NSArray *samplesJson = [json objectForKey:@"samples"];
-    for(int i = 0; i < [samplesJson count]; i++) {
-        NSMutableDictionary *sample = [samplesJson objectAtIndex:i];
-        NSString *idStr = [NSString stringWithFormat:@"sample%d", i];
-        NSString *path = [NavUtil createTempFile:[sample objectForKey:@"data"] forID:&idStr];
-        [sample removeObjectForKey:@"data"];
-        [sample setObject:path forKey:@"dataPath"];
+    struct mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return -1;
     }
-    // end
-    
-    // observation model
-    NSLog(@"observation model: %@", ObservationModelParametersPath);
-    std::string serializedModelPath = [ObservationModelParametersPath UTF8String];
-    std::cout << serializedModelPath << std::endl;
+    return info.resident_size_max / 1e6;
+}
+
+// Map data is decoded into memory and read through a NavMemoryStream, each
+// buffer is released as soon as it has been read. Floor images still go
+// through files, the building and P2PManager take image paths.
+- (void)initializeWithJSON:(NSMutableDictionary *)json
+{
+    NSDate *start = [NSDate date];
+    double startPeak = peakResidentMegabytes();
     
     // De-serialize observation model
     std::cout << "De-serializing observationModel" <<std::endl;
     std::shared_ptr<GaussianProcessLDPLMultiModel<State, Beacons>> deserializedModel(new GaussianProcessLDPLMultiModel<State, Beacons>());
-    {
-        std::ifstream ifs(serializedModelPath);
-        deserializedModel->load(ifs);
+    @autoreleasepool {
+        NSData *data = [NavUtil dataFromDataString:[json objectForKey:@"ObservationModelParameters"] type:nil];
+        [json removeObjectForKey:@"ObservationModelParameters"];
+        NavMemoryStream is((const char *)data.bytes, data.length);
+        deserializedModel->load(is);
     }
     
-    
-    _localizer = new StreamParticleFilter();
-    _userData.localizer = self;
-    _localizer->updateHandler(calledWhenUpdated, &_userData);
-    
-    int nStates = 1000;
-    _localizer->numStates(nStates);
-    //double alphaWeaken = 0.5;
-    double alphaWeaken = 0.3;
-    //double alphaWeaken = 0.01;
-    _localizer->alphaWeaken(alphaWeaken);
-    Location locLB(0.5, 0.5, 0,0);
-    _localizer->locationStandardDeviationLowerBound(locLB);
+    NSArray *samplesJson = [json objectForKey:@"samples"];
     
     // Create data store
     std::shared_ptr<DataStoreImpl> dataStore(new DataStoreImpl());
@@ -512,13 +504,15 @@ void calledWhenUpdated(void *userData, Status * pStatus){
     //Samples samples;
     for(int i = 0; i < [samplesJson count]; i++) {
         NSMutableDictionary *sample = [samplesJson objectAtIndex:i];
-        NSString *path = [sample objectForKey:@"dataPath"];
-        NSLog(@"sample %d: %@", i, path);
-        std::string cppPath = [path UTF8String];
-        std::ifstream  istream(cppPath);
-        //Samples samplesTmp = DataUtils::csvSamplesToSamples(istream);
-        //samples.insert(samples.end(), samplesTmp.begin(), samplesTmp.end());
-        dataStore->readSamples(istream);
+        @autoreleasepool {
+            NSData *data = [NavUtil dataFromDataString:[sample objectForKey:@"data"] type:nil];
+            [sample removeObjectForKey:@"data"];
+            NSLog(@"sample %d: %lu bytes", i, (unsigned long)data.length);
+            NavMemoryStream istream((const char *)data.bytes, data.length);
+            //Samples samplesTmp = DataUtils::csvSamplesToSamples(istream);
+            //samples.insert(samples.end(), samplesTmp.begin(), samplesTmp.end());
+            dataStore->readSamples(istream);
+        }
     }
     //dataStore->samples(samples);
     
@@ -528,14 +522,13 @@ void calledWhenUpdated(void *userData, Status * pStatus){
     NSArray *beaconsJson = [json objectForKey:@"beacons"];
     for(int i = 0; i < [beaconsJson count]; i++) {
         NSDictionary *beacon = [beaconsJson objectAtIndex:i];
-        NSString *data = [beacon objectForKey:@"data"];
-        NSString *idStr = [NSString stringWithFormat:@"beacon%d", i];
-        NSString *path = [NavUtil createTempFile:data forID:&idStr];
-        NSLog(@"beacon %d: %@", i, path);
-        std::string cppPath = [path UTF8String];
-        std::ifstream bleBeaconIStream(cppPath);
-        BLEBeacons bleBeaconsTmp = DataUtils::csvBLEBeaconsToBLEBeacons(bleBeaconIStream);
-        bleBeacons.insert(bleBeacons.end(), bleBeaconsTmp.begin(), bleBeaconsTmp.end());
+        @autoreleasepool {
+            NSData *data = [NavUtil dataFromDataString:[beacon objectForKey:@"data"] type:nil];
+            NSLog(@"beacon %d: %lu bytes", i, (unsigned long)data.length);
+            NavMemoryStream bleBeaconIStream((const char *)data.bytes, data.length);
+            BLEBeacons bleBeaconsTmp = DataUtils::csvBLEBeaconsToBLEBeacons(bleBeaconIStream);
+            bleBeacons.insert(bleBeacons.end(), bleBeaconsTmp.begin(), bleBeaconsTmp.end());
+        }
     }
     dataStore->bleBeacons(bleBeacons);
     
@@ -549,6 +542,7 @@ void calledWhenUpdated(void *userData, Status * pStatus){
         //localizer->observationModel(obsModel);
         
         // Seriealize observation model
+        std::string serializedModelPath = [[NSTemporaryDirectory() stringByAppendingPathComponent:@"ObservationModelParameters.json"] UTF8String];
         std::cout << "Serializing observationModel at" << serializedModelPath << std::endl;
         {
             std::ofstream ofs(serializedModelPath);
@@ -556,115 +550,21 @@ void calledWhenUpdated(void *userData, Status * pStatus){
         }
     }
     
-    // Instantiate sensor data processors
-    // Orientation
-    OrientationMeterAverageParameters orientationMeterAverageParameters;
-    orientationMeterAverageParameters.interval(0.1);
-    orientationMeterAverageParameters.windowAveraging(0.1);
-    std::shared_ptr<OrientationMeter> orientationMeter(new OrientationMeterAverage(orientationMeterAverageParameters));
-    
-    self.orientationMeter = orientationMeter;
-    
-    // Pedometer
-    PedometerWalkingStateParameters pedometerWSParams;
-    // TODO
-    pedometerWSParams.updatePeriod(0.1);
-    // END TODO
-    std::shared_ptr<Pedometer> pedometer(new PedometerWalkingState(pedometerWSParams));
-    
-    // Set dependency
-    _localizer->orientationMeter(orientationMeter);
-    _localizer->pedometer(pedometer);
-    
-    // Build System Model
-    // TODO (PoseProperty and StateProperty)
-    PoseProperty poseProperty;
-    StateProperty stateProperty;
-    poseProperty.meanVelocity(1.0);
-    poseProperty.stdVelocity(0.3);
-    poseProperty.diffusionVelocity(0.1);
-    poseProperty.minVelocity(0.1);
-    poseProperty.maxVelocity(1.5);
-    poseProperty.stdOrientation(3.0/180.0*M_PI);
-    poseProperty.stdX(2.0);
-    poseProperty.stdY(2.0);
-    
-    //    stateProperty.meanRssiBias(0.0);
-    stateProperty.meanRssiBias(-2.0);
-    stateProperty.stdRssiBias(2.0);
-    stateProperty.diffusionRssiBias(0.2);
-    stateProperty.diffusionOrientationBias(10.0/180*M_PI);
-    
-    // END TODO
-    
-    // Build poseRandomWalker
-    PoseRandomWalkerProperty poseRandomWalkerProperty;
-    std::shared_ptr<PoseRandomWalker>poseRandomWalker(new PoseRandomWalker());
-    poseRandomWalkerProperty.orientationMeter(orientationMeter.get());
-    poseRandomWalkerProperty.pedometer(pedometer.get());
-    poseRandomWalkerProperty.angularVelocityLimit(30.0/180.0*M_PI);
-    poseRandomWalker->setProperty(poseRandomWalkerProperty);
-    poseRandomWalker->setPoseProperty(poseProperty);
-    poseRandomWalker->setStateProperty(stateProperty);
-    
-    // Combine poseRandomWalker and building
-    PoseRandomWalkerInBuildingProperty prwBuildingProperty;
-    // TODO
-    prwBuildingProperty.maxIncidenceAngle(45.0/180.0*M_PI);
-    prwBuildingProperty.weightDecayRate(0.9);
-    // END TODO
-    Building building = dataStore->getBuilding();
-    std::shared_ptr<PoseRandomWalkerInBuilding> poseRandomWalkerInBuilding(new PoseRandomWalkerInBuilding());
-    poseRandomWalkerInBuilding->poseRandomWalker(*poseRandomWalker);
-    poseRandomWalkerInBuilding->building(building);
-    poseRandomWalkerInBuilding->poseRandomWalkerInBuildingProperty(prwBuildingProperty);
-    
-    _localizer->systemModel(poseRandomWalkerInBuilding);
-    
-    // set resampler
-    std::shared_ptr<Resampler<State>> resampler(new GridResampler<State>());
-    _localizer->resampler(resampler);
-    
-    // Set status initializer
-    ////PoseProperty poseProperty;
-    ////StateProperty stateProperty;
-    
-    std::shared_ptr<StatusInitializerImpl> statusInitializer(new StatusInitializerImpl());
-    statusInitializer->dataStore(dataStore)
-    .poseProperty(poseProperty).stateProperty(stateProperty);
-    _localizer->statusInitializer(statusInitializer);
-    
-    // Set localizer
-    _localizer->observationModel(deserializedModel);
-    
-    // Beacon filter
-    std::shared_ptr<StrongestBeaconFilter> beaconFilter(new StrongestBeaconFilter());
-    beaconFilter->nStrongest(10);
-    _localizer->beaconFilter(beaconFilter);
-    
-    // Set standard deviation of Pose
-    double stdevX = 0.25;
-    double stdevY = 0.25;
-    _stdevPose.x(stdevX).y(stdevY).orientation(30.0/180.0*M_PI);
-    
-    // ObservationDependentInitializer
-    std::shared_ptr<MetropolisSampler<State, Beacons>> obsDepInitializer(new MetropolisSampler<State, Beacons>());
-    MetropolisSampler<State, Beacons>::Parameters msParams;
-    obsDepInitializer->observationModel(deserializedModel);
-    obsDepInitializer->statusInitializer(statusInitializer);
-    msParams.burnIn = 1000;
-    msParams.radius2D = 10; // 10[m]
-    msParams.interval = 1;
-    msParams.withOrdering = true;
-    obsDepInitializer->parameters(msParams);
-    _localizer->observationDependentInitializer(obsDepInitializer);
-    
-    // Mixture settings
-    double mixProba = 0.001;
-    StreamParticleFilter::MixtureParameters mixParams;
-    mixParams.mixtureProbability = mixProba;
-    _localizer->mixtureParameters(mixParams);
-    
+    _particle = std::make_shared<NavParticleLocalizer>(self.idStr ? [self.idStr UTF8String] : "", NavParticleLocalizer::Config::twoD());
+    __weak TwoDLocalizer *weakSelf = self;
+    _particle->updateHandler([weakSelf](Status &status) {
+        [weakSelf particleUpdated:status];
+    });
+    _particle->logHandler([](const char *line) {
+        NSLog(@"%s", line);
+    });
+    _particle->initialize(dataStore);
+    _particle->observationModel(deserializedModel);
+    _localizer = _particle->filter();
+    [self initStateNum];
+    
+    NSLog(@"TwoDSetup,%d,%d,%f,%f,%f", (int)[samplesJson count], (int)[beaconsJson count],
+          [[NSDate date] timeIntervalSinceDate:start] * 1000, startPeak, peakResidentMegabytes());
 }
 
 @end
@@ -53,7 +53,7 @@
 - (void)repeatInstruction;
 - (void)announceSurroundInfo;
 - (void)announceAccessibilityInfo;
-- (NSArray *)getPathNodes;
+- (NavPath *)getPath;
 - (NavState*)getWalkingState;
 - (NavState*)getCurrentState;
 - (NavCurrentLocationManager*) getCurrentLocationManager;
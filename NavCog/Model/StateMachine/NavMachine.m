@@ -31,6 +31,8 @@
 #import "NavCogFuncViewController.h"
 #import "NavLog.h"
 #import "NavUtil.h"
+#import "NavLocalizerFactory.h"
+#import "NavLineSegment.h"
 
 #define clipAngle(angle) [NavUtil clipAngle:(angle)]
 #define clipAngle2(angle) [NavUtil clipAngle2:(angle)]
@@ -49,7 +51,7 @@
 @property (nonatomic) Boolean isStartFromCurrentLocation;
 @property (nonatomic) Boolean isNavigationStarted;
 @property (strong, nonatomic) NSString *destNodeName;
-@property (strong, atomic) NSArray *pathNodes;
+@property (strong, atomic) NavPath *path;
 @property (strong, nonatomic) TopoMap *topoMap;
 @property (strong, nonatomic) NSString *lastPre, *lastAccess, *lastSurround;
 
@@ -92,14 +94,16 @@
 }
 
 
-// initialize the state machine with a new path of nodes
-- (void)initializeWithPathNodes:(NSArray *)pathNodes {
+// initialize the state machine with a new path
+- (void)initializeWithPath:(NavPath *)path {
     _initialState = nil;
     _currentState = nil;
     _navState = NAV_STATE_IDLE;
-    for (int i = (int)[pathNodes count] - 1; i >= 1; i--) {
-        NavNode *node1 = [pathNodes objectAtIndex:i];
-        NavNode *node2 = [pathNodes objectAtIndex:i-1];
+    for (int i = (int)[path count] - 1; i >= 1; i--) {
+        NavNode *node1 = [path nodeAtIndex:i];
+        NavNode *node2 = [path nodeAtIndex:i-1];
+        NavEdge *edge1 = [path edgeToNodeAtIndex:i];
+        NavEdge *edge2 = [path edgeToNodeAtIndex:i-1];
         NSMutableString *startInfo = [[NSMutableString alloc] init];
 
         NavState *newState = [[NavState alloc] init];
@@ -112,17 +116,18 @@
             newState.surroundInfo = [node1 getTransitInfoToNode:node2];
             // targetEdge is used to check if we arrive at next edge or not
             // in our project, we presume that there's no Destination node with transition
-            // so we depend on node3's preEdgeInPath to get node2' position
+            // so we depend on the edge to node3 to get node2' position
             if (i >= 2) {
-                NavNode *node3 = [pathNodes objectAtIndex:i - 2];
-                newState.targetEdge = node3.preEdgeInPath;
-                newState.tx = [node2 getXInEdgeWithID:node3.preEdgeInPath.edgeID];
-                newState.ty = [node2 getYInEdgeWithID:node3.preEdgeInPath.edgeID];
-                newState.sx = [node3 getXInEdgeWithID:node3.preEdgeInPath.edgeID];// fix for snap min/max
-                newState.sy = [node3 getYInEdgeWithID:node3.preEdgeInPath.edgeID];// fix for snap min/max
+                NavNode *node3 = [path nodeAtIndex:i - 2];
+                NavEdge *edge3 = [path edgeToNodeAtIndex:i - 2];
+                newState.targetEdge = edge3;
+                newState.tx = [node2 getXInEdgeWithID:edge3.edgeID];
+                newState.ty = [node2 getYInEdgeWithID:edge3.edgeID];
+                newState.sx = [node3 getXInEdgeWithID:edge3.edgeID];// fix for snap min/max
+                newState.sy = [node3 getYInEdgeWithID:edge3.edgeID];// fix for snap min/max
                 newState.floor = node2.floor;
             }
-            [startInfo appendString:[node1 getInfoComingFromEdgeWithID:node1.preEdgeInPath.edgeID]];
+            [startInfo appendString:[node1 getInfoComingFromEdgeWithID:edge1.edgeID]];
             switch (node1.type) {
                 case NODE_TYPE_DOOR_TRANSIT:
                     break;
@@ -139,30 +144,31 @@
             }
         } else {
             newState.type = STATE_TYPE_WALKING;
-            newState.walkingEdge = node2.preEdgeInPath;
-            newState.surroundInfo = [node2.preEdgeInPath getInfoFromNode:node1];
-            newState.isTricky = [node2 isTrickyComingFromEdgeWithID:node2.preEdgeInPath.edgeID];
-            newState.trickyInfo = newState.isTricky ? [node2 getTrickyInfoComingFromEdgeWithID:node2.preEdgeInPath.edgeID] : nil;
-            newState.path = node2.preEdgeInPath.path;
-            newState.distMsg = [self getDistMessage:newState withLen:node2.preEdgeInPath.len withName:node2.name];
-            float curOri = [node2.preEdgeInPath getOriFromNode:node1];
-            float lastOri = clipAngle2([node2.preEdgeInPath getOriFromNode:node2] + 180);
+            newState.walkingEdge = edge2;
+            newState.surroundInfo = [edge2 getInfoFromNode:node1];
+            newState.isTricky = [node2 isTrickyComingFromEdgeWithID:edge2.edgeID];
+            newState.trickyInfo = newState.isTricky ? [node2 getTrickyInfoComingFromEdgeWithID:edge2.edgeID] : nil;
+            newState.path = edge2.path;
+            newState.distMsg = [self getDistMessage:newState withLen:edge2.len withName:node2.name];
+            float curOri = [edge2 getOriFromNode:node1];
+            float lastOri = clipAngle2([edge2 getOriFromNode:node2] + 180);
             newState.ori = curOri;
             newState.lastOri = lastOri;
-            newState.sx = [node1 getXInEdgeWithID:node2.preEdgeInPath.edgeID];
-            newState.sy = [node1 getYInEdgeWithID:node2.preEdgeInPath.edgeID];
-            newState.tx = [node2 getXInEdgeWithID:node2.preEdgeInPath.edgeID];
-            newState.ty = [node2 getYInEdgeWithID:node2.preEdgeInPath.edgeID];
+            newState.sx = [node1 getXInEdgeWithID:edge2.edgeID];
+            newState.sy = [node1 getYInEdgeWithID:edge2.edgeID];
+            newState.tx = [node2 getXInEdgeWithID:edge2.edgeID];
+            newState.ty = [node2 getYInEdgeWithID:edge2.edgeID];
             newState.floor = node1.floor;
             if (i >= 2) {
-                NavNode *node3 = [pathNodes objectAtIndex:i - 2];
+                NavNode *node3 = [path nodeAtIndex:i - 2];
+                NavEdge *edge3 = [path edgeToNodeAtIndex:i - 2];
                 [startInfo appendString:NSLocalizedString(@"and", "Simple and used to join two nodes.")];
                 if ([node2 transitEnabledToNode:node3]) { // next state is a transition
                     switch (node2.type) {
                         case NODE_TYPE_DOOR_TRANSIT:
                             // for door transition node, we use node information
-                            newState.nextActionInfo = [node2 getInfoComingFromEdgeWithID:node2.preEdgeInPath.edgeID];
-                            [startInfo appendString:[node2 getInfoComingFromEdgeWithID:node2.preEdgeInPath.edgeID]];
+                            newState.nextActionInfo = [node2 getInfoComingFromEdgeWithID:edge2.edgeID];
+                            [startInfo appendString:[node2 getInfoComingFromEdgeWithID:edge2.edgeID]];
                             break;
                         case NODE_TYPE_STAIR_TRANSIT:
                             if (node2.floor < node3.floor) {
@@ -186,10 +192,10 @@
                             break;
                     }
                 } else { // if next state is normal walking state, then pre-tell the turn
-                    float nextOri = [node3.preEdgeInPath getOriFromNode:node2];
+                    float nextOri = [edge3 getOriFromNode:node2];
                     [startInfo appendString:[self getTurnStringFromOri:lastOri toOri:nextOri]];
                     if (![node2 hasTransition] && node2.type != NODE_TYPE_DESTINATION) {
-                        newState.arrivedInfo = [node2 getInfoComingFromEdgeWithID:node2.preEdgeInPath.edgeID];
+                        newState.arrivedInfo = [node2 getInfoComingFromEdgeWithID:edge2.edgeID];
                     }
                     newState.nextActionInfo = [self getTurnStringFromOri:lastOri toOri:nextOri];
                     if (lastOri != nextOri) {
@@ -197,9 +203,9 @@
                     }
                 }
             } else {
-                newState.nextActionInfo = [NSString stringWithFormat:NSLocalizedString(@"destinationFormat", @"Format string for destination alert"), [node2 getInfoComingFromEdgeWithID:node2.preEdgeInPath.edgeID]];
-                newState.arrivedInfo = [node2 getDestInfoComingFromEdgeWithID:node2.preEdgeInPath.edgeID];
-                [startInfo appendString:[node2 getInfoComingFromEdgeWithID:node2.preEdgeInPath.edgeID]];
+                newState.nextActionInfo = [NSString stringWithFormat:NSLocalizedString(@"destinationFormat", @"Format string for destination alert"), [node2 getInfoComingFromEdgeWithID:edge2.edgeID]];
+                newState.arrivedInfo = [node2 getDestInfoComingFromEdgeWithID:edge2.edgeID];
+                [startInfo appendString:[node2 getInfoComingFromEdgeWithID:edge2.edgeID]];
                 [startInfo appendString:NSLocalizedString(@"destination", @"Destination alert")];
             }
             newState.plusMsg = startInfo; [startInfo setString:@""];
@@ -215,7 +221,7 @@
 
         newState.infoMsg = startInfo;
         newState.stateStartInfo = [NSString stringWithFormat:@"%@%@%@", newState.distMsg, newState.plusMsg, newState.infoMsg];
-        if (i == (int)[pathNodes count] - 1) {
+        if (i == (int)[path count] - 1) {
             _initialState = newState;
             newState.isFirst = YES;
         } else {
@@ -225,6 +231,7 @@
         _currentState = newState;
     }
     [self combineEdges:_initialState];
+    [self logStates];
 
     _currentState = _initialState;
     // check if we need a initial turning
@@ -375,14 +382,14 @@
 
     // search a path
     _topoMap = topoMap;
-    _pathNodes = nil;
+    _path = nil;
     _navState = NAV_STATE_INIT;
     if (![fromNodeName isEqualToString:NSLocalizedString(@"currentLocation", @"Current Location")]) {
-        _pathNodes = [_topoMap findShortestPathFromNodeWithName:fromNodeName toNodeWithName:toNodeName];
-        if (_pathNodes == nil) {
+        _path = [_topoMap findShortestPathFromNodeWithName:fromNodeName toNodeWithName:toNodeName];
+        if (_path == nil) {
             return NO;
         }
-        [self initializeWithPathNodes:_pathNodes];
+        [self initializeWithPath:_path];
         _isStartFromCurrentLocation = false;
         _isNavigationStarted = true;
         [_delegate navigationReadyToGo];
@@ -432,20 +439,20 @@
     
     // search a path
     _topoMap = topoMap;
-    _pathNodes = nil;
+    _path = nil;
     _navState = NAV_STATE_INIT;
     
     [_currentLocationManager simulateSensorFromLogFile:logFile];
-    _pathNodes = [_topoMap findShortestPathFromNodeWithName:logFile.fromNodeName toNodeWithName:logFile.toNodeName];
+    _path = [_topoMap findShortestPathFromNodeWithName:logFile.fromNodeName toNodeWithName:logFile.toNodeName];
     
-    if (_pathNodes == nil) {
+    if (_path == nil) {
         return NO;
     }
     // wait a short period for motion sensor data (initial _curOri should be updated from log)
     dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.5 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
         if (![logFile.fromNodeName isEqualToString:NSLocalizedString(@"currentLocation", @"Current Location")]) {
 
-            [self initializeWithPathNodes:_pathNodes];
+            [self initializeWithPath:_path];
             _isStartFromCurrentLocation = false;
             _isNavigationStarted = true;
             [_delegate navigationReadyToGo];
@@ -464,7 +471,7 @@
     [_currentLocationManager stopAccSensor];
     [_currentLocationManager reset];
     [_currentLocationManager stopSimulation];
-    [_topoMap cleanTmpNodeAndEdges];
+    [NavLog stopLog];
     _navState = NAV_STATE_IDLE;
     _initialState = nil;
     _currentState = nil;
@@ -505,8 +512,8 @@
         if (_currentLocation.edgeID == nil)
             return;
 
-        _pathNodes = [_topoMap findShortestPathFromCurrentLocation:_currentLocation toNodeWithName:_destNodeName];
-        [self initializeWithPathNodes:_pathNodes];
+        _path = [_topoMap findShortestPathFromCurrentLocation:_currentLocation toNodeWithName:_destNodeName];
+        [self initializeWithPath:_path];
         _isNavigationStarted = true;
         [_delegate navigationReadyToGo];
         NSLog(@"***********************************************");
@@ -551,7 +558,7 @@
                     [_currentLocationManager stopBeaconSensor];
                     [_currentLocationManager stopAccSensor];
                     [_currentLocationManager reset];
-                    [_topoMap cleanTmpNodeAndEdges];
+                    [NavLog stopLog];
                 } else if (_currentState.type == STATE_TYPE_WALKING) {
                     // Attempt to do gyro drift updates only while moving. however the localization is not reliable enough to use it
                     //                    if(_previousLocation != nil) {
@@ -614,8 +621,8 @@
     }
 }
 
-- (NSArray *)getPathNodes {
-    return _pathNodes;
+- (NavPath *)getPath {
+    return _path;
 }
 
 - (void)stopAudio {
@@ -662,6 +669,40 @@
     [NavLog logArray:data withType:type];
 }
 
+// the planned states for NavLogReplay, see NavLogState
+- (void)logStates {
+    int index = 0;
+    for (NavState *state = _initialState; state != nil; state = state.nextState) {
+        BOOL walking = state.type == STATE_TYPE_WALKING;
+        NavEdge *edge = walking ? state.walkingEdge : state.targetEdge;
+        NavNode *node = state.targetNode;
+        int transit = 0;
+        if (!walking && (node.type == NODE_TYPE_DOOR_TRANSIT || node.type == NODE_TYPE_STAIR_TRANSIT)) {
+            transit = 1;
+        } else if (!walking && node.type == NODE_TYPE_ELEVATOR_TRANSIT) {
+            transit = 2;
+        }
+        NSString *localizerID = edge ? [NavLocalizerFactory localizerForEdge:edge.edgeID].parent.idStr : nil;
+        NSData *segments = edge ? [[NavLightEdgeHolder sharedInstance] getNavLightEdgeByEdgeID:edge.edgeID].packedSegments : nil;
+        int segmentNum = (int)(segments.length / sizeof(double) / 4);
+        
+        NSMutableArray *data = [[NSMutableArray alloc] init];
+        [data addObject:@(index++)];
+        [data addObject:walking ? @"walking" : @"transition"];
+        [data addObject:edge.edgeID ?: @""];
+        [data addObject:localizerID ?: @""];
+        [data addObjectsFromArray:@[@(state.sx), @(state.sy), @(state.tx), @(state.ty), @(state.floor)]];
+        [data addObjectsFromArray:@[@(edge.len), @(state.extraEdgeLength), @(state.isCombined ? 1 : 0)]];
+        [data addObjectsFromArray:@[@(transit), @(node.transitKnnDistThres), @(node.transitPosThres)]];
+        [data addObjectsFromArray:@[@(edge.minKnnDist), @(edge.maxKnnDist), @(segmentNum)]];
+        const double *p = (const double *)segments.bytes;
+        for (int i = 0; i < segmentNum * 4; i++) {
+            [data addObject:@(p[i])];
+        }
+        [NavLog logArray:data withType:@"State"];
+    }
+}
+
 - (NavState*)getWalkingState {
     if ((_navState == NAV_STATE_WALKING) && (_currentState.type != STATE_TYPE_TRANSITION))
         return _currentState;
@@ -32,23 +32,22 @@
 #import "NavNotificationSpeaker.h"
 #import "NavLog.h"
 #import "NavUtil.h"
+#import "NavStateProgress.hpp"
 
 #define clipAngle2(angle) [NavUtil clipAngle2:(angle)]
 
 @interface NavState ()
 
-@property (nonatomic) Boolean bstarted;
-@property (nonatomic) float preAnnounceDist;
-@property (nonatomic) Boolean did40feet;
-@property (nonatomic) Boolean didApproaching;
 @property (nonatomic) Boolean didTrickyNotification;
-@property (nonatomic) int longDistAnnounceCount;
-@property (nonatomic) int targetLongDistAnnounceCount;
 @property (strong, nonatomic) NSTimer *audioTimer;
 
+- (NavStateProgress *)progress;
+
 @end
 
-@implementation NavState
+@implementation NavState {
+    NavStateProgress _progress;
+}
 
 - (BOOL)isMeter {
     return [[NSUserDefaults standardUserDefaults] boolForKey:@"meter_preference"];
@@ -82,10 +81,6 @@
 {
     self = [super init];
     if (self) {
-        _bstarted = false;
-        _preAnnounceDist = INT_MAX;
-        _did40feet = false;
-        _didApproaching = false;
         _nextState = nil;
         _isTricky = false;
         _didTrickyNotification = false;
@@ -98,29 +93,49 @@
     return self;
 }
 
+- (NavStateProgress *)progress {
+    return &_progress;
+}
+
+- (void)setType:(enum StateType)type {
+    _type = type;
+    _progress.type(type == STATE_TYPE_WALKING ? NavStateProgress::Walking : NavStateProgress::Transition);
+}
+
+- (void)setIsCombined:(BOOL)isCombined {
+    _isCombined = isCombined;
+    _progress.combined(isCombined);
+}
+
+- (void)setExtraEdgeLength:(int)extraEdgeLength {
+    _extraEdgeLength = extraEdgeLength;
+    _progress.extraEdgeLength(extraEdgeLength);
+}
+
 - (void)setWalkingEdge:(NavEdge *)walkingEdge {
     _walkingEdge = walkingEdge;
-    _preAnnounceDist = walkingEdge.len + _extraEdgeLength;
-    _longDistAnnounceCount = _preAnnounceDist / 30;
-    if (ABS(_preAnnounceDist - _longDistAnnounceCount * 30) <= 10) {
-        _longDistAnnounceCount --;
+    _progress.walkingEdge(walkingEdge.len);
+}
+
+- (void)setTargetEdge:(NavEdge *)targetEdge {
+    _targetEdge = targetEdge;
+    _progress.targetEdge(targetEdge.len, targetEdge.minKnnDist, targetEdge.maxKnnDist);
+}
+
+- (void)setTargetNode:(NavNode *)targetNode {
+    _targetNode = targetNode;
+    NavStateProgress::Transit transit = NavStateProgress::TransitNone;
+    if (targetNode.type == NODE_TYPE_DOOR_TRANSIT || targetNode.type == NODE_TYPE_STAIR_TRANSIT) {
+        transit = NavStateProgress::TransitDoorOrStair;
+    } else if (targetNode.type == NODE_TYPE_ELEVATOR_TRANSIT) {
+        transit = NavStateProgress::TransitElevator;
     }
-    _targetLongDistAnnounceCount = _longDistAnnounceCount;
+    _progress.transit(transit, targetNode.transitKnnDistThres, targetNode.transitPosThres);
 }
 
 - (Boolean)checkStateStatusUsingLocationManager:(NavCurrentLocationManager *)man withSpeechOn:(Boolean)isSpeechEnabled withClickOn:(Boolean)isClickEnabled {
-    if (!_bstarted) {
-        _bstarted = true;
-        if (!_isCombined) { // do not re-init for combined state
-            if (_type == STATE_TYPE_WALKING && (_walkingEdge.len + _extraEdgeLength) < 40) {
-                _did40feet = true;
-            }
-            
-            // if the distance is less than 30, then it's not necessary to announce 20
-            if (_type == STATE_TYPE_WALKING && (_walkingEdge.len + _extraEdgeLength) <= 20) {
-                _didApproaching = true;
-            }
-        }
+    if (!_progress.started()) {
+        _progress.start();
 
         if (_type == STATE_TYPE_TRANSITION) {
             [man initLocalizationOnEdge:_targetEdge.edgeID withOptions:@{@"type":@"transition"}];
@@ -203,20 +218,14 @@
         _didTrickyNotification = true;
         [NavNotificationSpeaker speakImmediatelyAndSlowly:NSLocalizedString(@"accessNotif", @"Alert that an accessibility notification is available")];
     }
-    float threshold = 5;
-    if (edge.len < 10 + 7) {
-        threshold = MAX(1, (edge.len - 7) / 2); // Adjust threshold for very short edge
-    }
     if (_type == STATE_TYPE_WALKING) {
         // snap y within edge
-        float targetDist = [self getTargetDistance:pos];
-        if (targetDist < 0) {
-            NSLog(@"SnapDistance,%f",targetDist);
-            dist = 0;
+        if (dist < 0) {
+            NSLog(@"SnapDistance,%f",dist);
         }
         
-        _closestDist = MIN(dist, _closestDist);
-        if(dist > 0 && _didApproaching && _nextState != nil && _nextState.type == STATE_TYPE_WALKING) {
+        BOOL forceNext = NO;
+        if(_progress.checksNextEdge(dist) && _nextState != nil && _nextState.type == STATE_TYPE_WALKING) {
             // check if we already on the next edge
             NavEdge *nextEdge = _nextState.walkingEdge;
             if ([@"KDTreeLocalization" isEqualToString:[man getLocalizerNameForEdge:nextEdge.edgeID]]) {
@@ -227,39 +236,28 @@
                 float nextStartDist = [_nextState getStartDistance:nextPos];
                 float nextStartRatio = [_nextState getStartRatio:nextPos];
                 if (/*norm_dist <= 1 &&*/ (nextStartDist > 25 || (nextStartDist > 10 && nextStartRatio > 0.25))) {
-                    NSLog(@"ForceNextState,%f,%f,%f,%f",_closestDist, pos.knndist, nextStartDist, nextPos.knndist);
-                    dist = 0;
+                    NSLog(@"ForceNextState,%f,%f,%f,%f",MIN(dist, _progress.closestDist()), pos.knndist, nextStartDist, nextPos.knndist);
+                    forceNext = YES;
                 }
             }
         }
         
+        NavStateProgress::Action action = _progress.update(dist, pos.knndist, forceNext, _nextState.isCombined ? [_nextState progress] : NULL);
+        _closestDist = _progress.closestDist();
+        
         NSString *distFormat = NSLocalizedString([self isMeter]?@"meterFormat":@"feetFormat", @"Use to express a distance in feet");
-        dist += _extraEdgeLength; // dist is distance to the target node
-        // if you're walking, check distance to target node
-        if (dist < _preAnnounceDist + threshold) {
-            if (dist > 40.0) { // announce every 30 feet
-                if (dist <= 30 * _longDistAnnounceCount + threshold) {
-                    NSString *ann = [NSString stringWithFormat:distFormat,[self isMeter]?[self toMeter:_longDistAnnounceCount * 30]:_longDistAnnounceCount * 30];
-                    if (isSpeechEnabled) {
-                        [self speakInstructionImmediately:ann];
-                    } else {
-                        _previousInstruction = ann;
-                    }
-                    _preAnnounceDist = _longDistAnnounceCount * 30;
-                    _longDistAnnounceCount --;
-                    return false;
-                }
-            } else if (!_did40feet && dist <= 40 + threshold) {
-                NSString *ann = [NSString stringWithFormat:distFormat,[self isMeter]?[self toMeter:40]:40];
+        switch (action) {
+            case NavStateProgress::AnnounceDistance: { // every 30 feet, then 40 feet
+                int feet = _progress.announcedDistance();
+                NSString *ann = [NSString stringWithFormat:distFormat,[self isMeter]?[self toMeter:feet]:feet];
                 if (isSpeechEnabled) {
                     [self speakInstructionImmediately:ann];
                 } else {
                     _previousInstruction = ann;
                 }
-                _preAnnounceDist = 40;
-                _did40feet = true;
                 return false;
-            } else if (!_didApproaching && dist <= MIN(20 + threshold, (_walkingEdge.len + _extraEdgeLength) / 2)) {
+            }
+            case NavStateProgress::Approaching:
                 if (isClickEnabled) {
                     [self stopAudios];
                     _audioTimer = [NSTimer scheduledTimerWithTimeInterval:0.5 target:self selector:@selector(playClickSound) userInfo:nil repeats:YES];
@@ -279,22 +277,8 @@
                         _previousInstruction = approaching;
                     }
                 }
-                _didApproaching = true;
                 return false;
-            }
-            if ((dist - _extraEdgeLength) <= 2 + threshold) {
-                if (_nextState != nil && _nextState.isCombined) {
-                    // combined edge: copy current navigation status to next state
-                    _nextState.preAnnounceDist = _preAnnounceDist;
-                    _nextState.longDistAnnounceCount = _longDistAnnounceCount;
-                    _nextState.targetLongDistAnnounceCount = _targetLongDistAnnounceCount;
-                    _nextState.did40feet = _did40feet;
-                    _nextState.didApproaching = _didApproaching;
-                }
-                _bstarted = false;
-                _longDistAnnounceCount = _targetLongDistAnnounceCount;
-                _did40feet = _walkingEdge.len < 40 ? true : false;
-                _didApproaching = _walkingEdge.len < 20 ? true : false;
+            case NavStateProgress::Arrived: {
                 [self stopAudios];
                 if (_arrivedInfo != nil) {
                     [self speakInstructionImmediately:_arrivedInfo];
@@ -306,9 +290,12 @@
                 [man initLocalizationOnEdge:_walkingEdge.edgeID withOptions:@{@"type":@"end"}];
                 return true;
             }
+            default:
+                break;
         }
     } else if (_type == STATE_TYPE_TRANSITION) {
-        pos.knndist = (pos.knndist - _targetEdge.minKnnDist) / (_targetEdge.maxKnnDist - _targetEdge.minKnnDist);
+        float knndist = pos.knndist;
+        pos.knndist = _progress.normalizedKnnDist(knndist);
 /*        if (_prevState != nil && _prevState.type == STATE_TYPE_WALKING) {
             float nextKnndist = pos.knndist;
             // compare knn distance to previous and next edge
@@ -329,23 +316,13 @@
         
         NSLog(@"type=%d pos(%f, %f) target(%f, %f) likelihood=%f threth=%f dist=%f threth=%f", _type, pos.xInEdge, pos.yInEdge, _tx, _ty, pos.knndist, _targetNode.transitKnnDistThres, dist, _targetNode.transitPosThres);
 
-        if (_targetNode.type == NODE_TYPE_DOOR_TRANSIT || _targetNode.type == NODE_TYPE_STAIR_TRANSIT) {
-            if (pos.knndist < _targetNode.transitKnnDistThres && dist < _targetNode.transitPosThres) {
-                NSString *cmd = [NSString stringWithFormat:@"switchToLayerWithID('%@')", _targetNode.layerZIndex];
-                [[NavCogFuncViewController sharedNavCogFuntionViewController] runCmdWithString:cmd];
-                [self stopAudios];
-                return true;
-            }
-            return false;
-        } else if (_targetNode.type == NODE_TYPE_ELEVATOR_TRANSIT) {
-            if (pos.knndist < _targetNode.transitKnnDistThres) {
-                NSString *cmd = [NSString stringWithFormat:@"switchToLayerWithID('%@')", _targetNode.layerZIndex];
-                [[NavCogFuncViewController sharedNavCogFuntionViewController] runCmdWithString:cmd];
-                [self stopAudios];
-                return true;
-            }
-            return false;
+        if (_progress.update(dist, knndist, false, NULL) == NavStateProgress::Transited) {
+            NSString *cmd = [NSString stringWithFormat:@"switchToLayerWithID('%@')", _targetNode.layerZIndex];
+            [[NavCogFuncViewController sharedNavCogFuntionViewController] runCmdWithString:cmd];
+            [self stopAudios];
+            return true;
         }
+        return false;
     }
     return false;
 }
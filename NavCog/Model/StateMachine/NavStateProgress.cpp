@@ -0,0 +1,145 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavStateProgress.hpp"
+#include <limits.h>
+#include <math.h>
+#include <algorithm>
+
+NavStateProgress::NavStateProgress()
+: mType(Walking), mCombined(false), mExtraEdgeLength(0), mEdgeLength(0),
+  mMinKnnDist(0), mMaxKnnDist(1), mTransit(TransitNone), mKnnDistThres(0), mPosThres(0),
+  mStarted(false), mPreAnnounceDist(INT_MAX), mDid40feet(false), mDidApproaching(false),
+  mLongDistAnnounceCount(0), mTargetLongDistAnnounceCount(0), mClosestDist(INT_MAX), mAnnouncedDistance(0)
+{
+}
+
+void NavStateProgress::walkingEdge(int length)
+{
+    mEdgeLength = length;
+    mPreAnnounceDist = length + mExtraEdgeLength;
+    mLongDistAnnounceCount = mPreAnnounceDist / 30;
+    if (fabsf(mPreAnnounceDist - mLongDistAnnounceCount * 30) <= 10) {
+        mLongDistAnnounceCount --;
+    }
+    mTargetLongDistAnnounceCount = mLongDistAnnounceCount;
+}
+
+void NavStateProgress::targetEdge(int length, float minKnnDist, float maxKnnDist)
+{
+    mEdgeLength = length;
+    mMinKnnDist = minKnnDist;
+    mMaxKnnDist = maxKnnDist;
+}
+
+void NavStateProgress::transit(Transit transit, float knnDistThres, float posThres)
+{
+    mTransit = transit;
+    mKnnDistThres = knnDistThres;
+    mPosThres = posThres;
+}
+
+void NavStateProgress::start()
+{
+    mStarted = true;
+    if (!mCombined) { // do not re-init for combined state
+        if (mType == Walking && (mEdgeLength + mExtraEdgeLength) < 40) {
+            mDid40feet = true;
+        }
+        // if the distance is less than 30, then it's not necessary to announce 20
+        if (mType == Walking && (mEdgeLength + mExtraEdgeLength) <= 20) {
+            mDidApproaching = true;
+        }
+    }
+}
+
+float NavStateProgress::threshold() const
+{
+    float threshold = 5;
+    if (mEdgeLength < 10 + 7) {
+        threshold = std::max(1, (mEdgeLength - 7) / 2); // Adjust threshold for very short edge
+    }
+    return threshold;
+}
+
+float NavStateProgress::normalizedKnnDist(float knndist) const
+{
+    return (knndist - mMinKnnDist) / (mMaxKnnDist - mMinKnnDist);
+}
+
+NavStateProgress::Action NavStateProgress::update(float targetDist, float knndist, bool forceNext,
+                                                  NavStateProgress* combinedNext)
+{
+    float threshold = this->threshold();
+    if (mType == Transition) {
+        knndist = normalizedKnnDist(knndist);
+        if (mTransit == TransitDoorOrStair) {
+            return knndist < mKnnDistThres && targetDist < mPosThres ? Transited : None;
+        } else if (mTransit == TransitElevator) {
+            return knndist < mKnnDistThres ? Transited : None;
+        }
+        return None;
+    }
+    
+    // snap within edge
+    float dist = targetDist < 0 ? 0 : targetDist;
+    mClosestDist = std::min(dist, mClosestDist);
+    if (forceNext && checksNextEdge(dist)) {
+        dist = 0;
+    }
+    
+    dist += mExtraEdgeLength; // dist is distance to the target node
+    if (dist < mPreAnnounceDist + threshold) {
+        if (dist > 40.0) { // announce every 30 feet
+            if (dist <= 30 * mLongDistAnnounceCount + threshold) {
+                mAnnouncedDistance = mLongDistAnnounceCount * 30;
+                mPreAnnounceDist = mLongDistAnnounceCount * 30;
+                mLongDistAnnounceCount --;
+                return AnnounceDistance;
+            }
+        } else if (!mDid40feet && dist <= 40 + threshold) {
+            mAnnouncedDistance = 40;
+            mPreAnnounceDist = 40;
+            mDid40feet = true;
+            return AnnounceDistance;
+        } else if (!mDidApproaching && dist <= std::min(20 + threshold, (float)((mEdgeLength + mExtraEdgeLength) / 2))) {
+            mDidApproaching = true;
+            return Approaching;
+        }
+        if ((dist - mExtraEdgeLength) <= 2 + threshold) {
+            if (combinedNext) {
+                // combined edge: copy current navigation status to next state
+                combinedNext->mPreAnnounceDist = mPreAnnounceDist;
+                combinedNext->mLongDistAnnounceCount = mLongDistAnnounceCount;
+                combinedNext->mTargetLongDistAnnounceCount = mTargetLongDistAnnounceCount;
+                combinedNext->mDid40feet = mDid40feet;
+                combinedNext->mDidApproaching = mDidApproaching;
+            }
+            mStarted = false;
+            mLongDistAnnounceCount = mTargetLongDistAnnounceCount;
+            mDid40feet = mEdgeLength < 40;
+            mDidApproaching = mEdgeLength < 20;
+            return Arrived;
+        }
+    }
+    return None;
+}
@@ -0,0 +1,96 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavStateProgress_hpp
+#define NavStateProgress_hpp
+
+// When a NavState announces, arrives or finishes its transition, free of
+// UIKit and speech so the state machine can also run headless (see
+// NavLogReplay). NavState speaks and updates the map for the actions.
+//
+// Distances are in feet along the edge. A walking state announces every 30
+// feet beyond 40, then 40 feet and approaching once each, and arrives within
+// 2 feet plus a threshold of the target. A transition finishes when the
+// normalized knn distance (and for doors and stairs the distance) is below
+// the thresholds of the target node.
+class NavStateProgress {
+public:
+    enum Type { Walking, Transition };
+    enum Transit { TransitNone, TransitDoorOrStair, TransitElevator };
+    enum Action {
+        None,
+        AnnounceDistance, // announcedDistance() feet left
+        Approaching,
+        Arrived,          // walking state done, ready to start again
+        Transited         // transition done
+    };
+
+    NavStateProgress();
+
+    void type(Type type) { mType = type; }
+    Type type() const { return mType; }
+    // continued from the previous state, started() keeps the announcements
+    void combined(bool combined) { mCombined = combined; }
+    // of the combined states that follow, used from the next walkingEdge() on
+    void extraEdgeLength(int length) { mExtraEdgeLength = length; }
+    int extraEdgeLength() const { return mExtraEdgeLength; }
+    // sets up the announcements for the walking edge
+    void walkingEdge(int length);
+    // the edge the transition arrives on
+    void targetEdge(int length, float minKnnDist, float maxKnnDist);
+    void transit(Transit transit, float knnDistThres, float posThres);
+
+    bool started() const { return mStarted; }
+    void start();
+    // targetDist to the target node, forceNext if the next state's edge
+    // already has the user (see checksNextEdge()), combinedNext gets the
+    // announcements on arrival if the next state is combined
+    Action update(float targetDist, float knndist, bool forceNext, NavStateProgress* combinedNext);
+    // whether update() takes forceNext into account
+    bool checksNextEdge(float targetDist) const { return targetDist > 0 && mDidApproaching; }
+
+    int announcedDistance() const { return mAnnouncedDistance; }
+    float closestDist() const { return mClosestDist; }
+    float normalizedKnnDist(float knndist) const;
+    // arrival and announcement slack, smaller for very short edges
+    float threshold() const;
+
+private:
+    Type mType;
+    bool mCombined;
+    int mExtraEdgeLength;
+    int mEdgeLength;
+    float mMinKnnDist, mMaxKnnDist;
+    Transit mTransit;
+    float mKnnDistThres, mPosThres;
+
+    bool mStarted;
+    float mPreAnnounceDist;
+    bool mDid40feet;
+    bool mDidApproaching;
+    int mLongDistAnnounceCount;
+    int mTargetLongDistAnnounceCount;
+    float mClosestDist;
+    int mAnnouncedDistance;
+};
+
+#endif /* NavStateProgress_hpp */
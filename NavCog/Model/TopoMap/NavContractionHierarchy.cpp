@@ -0,0 +1,405 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavContractionHierarchy.hpp"
+#include <algorithm>
+#include "NavIndexedHeap.hpp"
+
+// a witness search gives up after this many nodes and the shortcut is added
+static const int kWitnessSettleLimit = 500;
+
+namespace {
+
+struct ContractArc {
+    int32_t node;
+    int32_t length;
+    int32_t middle;
+    int32_t edge;
+};
+
+// the graph of the nodes not contracted yet, with the shortcuts added so far
+class Contractor {
+public:
+    explicit Contractor(const NavGraph& g)
+    : mOut(g.nodeNum()), mIn(g.nodeNum()), mContracted(g.nodeNum(), 0), mDeleted(g.nodeNum(), 0),
+      mDist(g.nodeNum(), INT32_MAX)
+    {
+        for (int n = 0; n < g.nodeNum(); n++) {
+            for (const NavGraph::Arc* a = g.arcBegin(n); a != g.arcEnd(n); a++) {
+                if (a->node != n) {
+                    add(n, {a->node, a->length, -1, a->edge});
+                }
+            }
+        }
+        mHeap.resize(g.nodeNum());
+    }
+
+    std::vector<std::vector<ContractArc>> mOut, mIn; // in arcs keep the tail as node
+    std::vector<char> mContracted;
+    std::vector<int> mDeleted;
+
+    // keeps the shorter of parallel arcs
+    void add(int from, const ContractArc& arc)
+    {
+        if (put(mOut[from], arc)) {
+            ContractArc in = arc;
+            in.node = from;
+            put(mIn[arc.node], in);
+        }
+    }
+
+    // shortcuts that contracting v needs, as (from, arc) pairs
+    void shortcuts(int v, std::vector<std::pair<int, ContractArc>>& result)
+    {
+        result.clear();
+        for (const ContractArc& in : mIn[v]) {
+            int u = in.node, maxLength = -1;
+            for (const ContractArc& out : mOut[v]) {
+                if (out.node != u) {
+                    maxLength = std::max(maxLength, in.length + out.length);
+                }
+            }
+            if (maxLength < 0) {
+                continue;
+            }
+            witness(u, v, maxLength);
+            for (const ContractArc& out : mOut[v]) {
+                int length = in.length + out.length;
+                if (out.node != u && mDist[out.node] > length) {
+                    result.push_back(std::make_pair(u, ContractArc{out.node, length, v, -1}));
+                }
+            }
+            resetWitness();
+        }
+    }
+
+    // shortcuts count twice, it keeps the core of grid like floors sparse
+    // and preprocessing about twice as fast as the plain edge difference
+    int priority(int v)
+    {
+        shortcuts(v, mScratch);
+        return 2 * (int)mScratch.size() - (int)(mIn[v].size() + mOut[v].size()) + mDeleted[v];
+    }
+
+    void remove(int v)
+    {
+        for (const ContractArc& out : mOut[v]) {
+            erase(mIn[out.node], v);
+            mDeleted[out.node]++;
+        }
+        for (const ContractArc& in : mIn[v]) {
+            erase(mOut[in.node], v);
+            mDeleted[in.node]++;
+        }
+        mContracted[v] = 1;
+    }
+
+private:
+    static bool put(std::vector<ContractArc>& arcs, const ContractArc& arc)
+    {
+        for (ContractArc& a : arcs) {
+            if (a.node == arc.node) {
+                if (arc.length < a.length) {
+                    a = arc;
+                    return true;
+                }
+                return false;
+            }
+        }
+        arcs.push_back(arc);
+        return true;
+    }
+
+    static void erase(std::vector<ContractArc>& arcs, int node)
+    {
+        arcs.erase(std::remove_if(arcs.begin(), arcs.end(), [node](const ContractArc& a) { return a.node == node; }),
+                   arcs.end());
+    }
+
+    // distances from u avoiding v, exact up to maxLength unless the limit hits
+    void witness(int u, int v, int maxLength)
+    {
+        mDist[u] = 0;
+        mTouched.push_back(u);
+        mHeap.push(u, 0);
+        int settled = 0;
+        while (!mHeap.empty() && mHeap.topKey() <= maxLength && settled < kWitnessSettleLimit) {
+            int n = mHeap.pop();
+            settled++;
+            for (const ContractArc& a : mOut[n]) {
+                if (a.node == v) {
+                    continue;
+                }
+                int d = mDist[n] + a.length;
+                if (d < mDist[a.node]) {
+                    if (mDist[a.node] == INT32_MAX) {
+                        mTouched.push_back(a.node);
+                    }
+                    mDist[a.node] = d;
+                    mHeap.push(a.node, d);
+                }
+            }
+        }
+    }
+
+    void resetWitness()
+    {
+        for (int n : mTouched) {
+            mDist[n] = INT32_MAX;
+        }
+        mTouched.clear();
+        mHeap.clear();
+    }
+
+    std::vector<int> mDist;
+    std::vector<int> mTouched;
+    NavIndexedHeap mHeap;
+    std::vector<std::pair<int, ContractArc>> mScratch;
+};
+
+}
+
+// search state of one query, taken from the hierarchy's pool
+class NavContractionHierarchy::Search {
+public:
+    explicit Search(int nodeNum)
+    : mDist{std::vector<int32_t>(nodeNum, INT32_MAX), std::vector<int32_t>(nodeNum, INT32_MAX)},
+      mPred{std::vector<int32_t>(nodeNum, -1), std::vector<int32_t>(nodeNum, -1)},
+      mPredArc{std::vector<int32_t>(nodeNum, -1), std::vector<int32_t>(nodeNum, -1)}
+    {
+        mHeap[0].resize(nodeNum);
+        mHeap[1].resize(nodeNum);
+    }
+
+    void reset()
+    {
+        for (int n : mTouched) {
+            for (int d = 0; d < 2; d++) {
+                mDist[d][n] = INT32_MAX;
+                mPred[d][n] = -1;
+                mPredArc[d][n] = -1;
+            }
+        }
+        mTouched.clear();
+        mHeap[0].clear();
+        mHeap[1].clear();
+    }
+
+    void push(int d, int node, int dist, int pred, int predArc)
+    {
+        if (dist < mDist[d][node]) {
+            if (mDist[0][node] == INT32_MAX && mDist[1][node] == INT32_MAX) {
+                mTouched.push_back(node);
+            }
+            mDist[d][node] = dist;
+            mPred[d][node] = pred;
+            mPredArc[d][node] = predArc;
+            mHeap[d].push(node, dist);
+        }
+    }
+
+    // 0 forward from the sources, 1 backward from the targets
+    std::vector<int32_t> mDist[2];
+    std::vector<int32_t> mPred[2], mPredArc[2];
+    NavIndexedHeap mHeap[2];
+    std::vector<int32_t> mTouched;
+};
+
+NavContractionHierarchy::NavContractionHierarchy(std::shared_ptr<const NavGraph> graph)
+: mGraph(graph), mShortcutNum(0)
+{
+    const NavGraph& g = *mGraph;
+    int nodeNum = g.nodeNum();
+    Contractor c(g);
+    
+    // lazy updates, a node whose priority went up since it was queued is
+    // queued again instead of contracted
+    NavIndexedHeap queue;
+    queue.resize(nodeNum);
+    for (int n = 0; n < nodeNum; n++) {
+        queue.push(n, c.priority(n));
+    }
+    std::vector<std::vector<ContractArc>> up(nodeNum), down(nodeNum);
+    std::vector<std::pair<int, ContractArc>> shortcuts;
+    std::vector<int> neighbors;
+    while (!queue.empty()) {
+        int v = queue.pop();
+        int priority = c.priority(v);
+        if (!queue.empty() && priority > queue.topKey()) {
+            queue.push(v, priority);
+            continue;
+        }
+        c.shortcuts(v, shortcuts);
+        up[v] = c.mOut[v];
+        down[v] = c.mIn[v];
+        for (const auto& s : shortcuts) {
+            c.add(s.first, s.second);
+        }
+        mShortcutNum += (int)shortcuts.size();
+        
+        neighbors.clear();
+        for (const ContractArc& a : c.mOut[v]) {
+            neighbors.push_back(a.node);
+        }
+        for (const ContractArc& a : c.mIn[v]) {
+            neighbors.push_back(a.node);
+        }
+        c.remove(v);
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for (int n : neighbors) {
+            if (queue.contains(n)) {
+                queue.push(n, c.priority(n));
+            }
+        }
+    }
+    
+    mUpBegin.assign(nodeNum + 1, 0);
+    mDownBegin.assign(nodeNum + 1, 0);
+    for (int n = 0; n < nodeNum; n++) {
+        mUpBegin[n + 1] = mUpBegin[n] + (int)up[n].size();
+        mDownBegin[n + 1] = mDownBegin[n] + (int)down[n].size();
+        for (const ContractArc& a : up[n]) {
+            mUp.push_back({a.node, a.length, a.middle, a.edge});
+        }
+        for (const ContractArc& a : down[n]) {
+            mDown.push_back({a.node, a.length, a.middle, a.edge});
+        }
+    }
+}
+
+NavContractionHierarchy::~NavContractionHierarchy()
+{
+}
+
+std::unique_ptr<NavContractionHierarchy::Search> NavContractionHierarchy::acquire() const
+{
+    {
+        std::lock_guard<std::mutex> lock(mPoolMutex);
+        if (!mPool.empty()) {
+            std::unique_ptr<Search> search = std::move(mPool.back());
+            mPool.pop_back();
+            return search;
+        }
+    }
+    return std::unique_ptr<Search>(new Search(mGraph->nodeNum()));
+}
+
+void NavContractionHierarchy::release(std::unique_ptr<Search> search) const
+{
+    search->reset();
+    std::lock_guard<std::mutex> lock(mPoolMutex);
+    mPool.push_back(std::move(search));
+}
+
+const NavContractionHierarchy::Arc* NavContractionHierarchy::find(const std::vector<int32_t>& begin,
+                                                                  const std::vector<Arc>& arcs, int at, int node) const
+{
+    for (int i = begin[at]; i < begin[at + 1]; i++) {
+        if (arcs[i].node == node) {
+            return &arcs[i];
+        }
+    }
+    return nullptr;
+}
+
+// appends the nodes and edges of an arc after from, shortcuts recursively
+void NavContractionHierarchy::unpack(int from, const Arc& arc, NavRoute& route) const
+{
+    if (arc.middle < 0) {
+        route.nodes.push_back(arc.node);
+        route.edges.push_back(arc.edge);
+        return;
+    }
+    const Arc* first = find(mDownBegin, mDown, arc.middle, from);
+    const Arc* second = find(mUpBegin, mUp, arc.middle, arc.node);
+    Arc in = *first;
+    in.node = arc.middle;
+    unpack(from, in, route);
+    unpack(arc.middle, *second, route);
+}
+
+bool NavContractionHierarchy::route(const NavRouteEndpoint* sources, int sourceNum, const NavRouteEndpoint* targets,
+                                    int targetNum, NavRoute& route) const
+{
+    std::unique_ptr<Search> search = acquire();
+    for (int i = 0; i < sourceNum; i++) {
+        search->push(0, sources[i].node, sources[i].cost, -1, -1);
+    }
+    for (int i = 0; i < targetNum; i++) {
+        search->push(1, targets[i].node, targets[i].cost, -1, -1);
+    }
+    
+    // both sides go up until neither can beat the best meeting node
+    int best = INT32_MAX, meet = -1, settled = 0;
+    while (true) {
+        bool forward = !search->mHeap[0].empty() && search->mHeap[0].topKey() < best;
+        bool backward = !search->mHeap[1].empty() && search->mHeap[1].topKey() < best;
+        if (!forward && !backward) {
+            break;
+        }
+        int d = forward && (!backward || search->mHeap[0].topKey() <= search->mHeap[1].topKey()) ? 0 : 1;
+        int n = search->mHeap[d].pop();
+        settled++;
+        int dist = search->mDist[d][n];
+        if (search->mDist[1 - d][n] != INT32_MAX && dist + search->mDist[1 - d][n] < best) {
+            best = dist + search->mDist[1 - d][n];
+            meet = n;
+        }
+        const std::vector<int32_t>& begin = d == 0 ? mUpBegin : mDownBegin;
+        const std::vector<Arc>& arcs = d == 0 ? mUp : mDown;
+        for (int i = begin[n]; i < begin[n + 1]; i++) {
+            search->push(d, arcs[i].node, dist + arcs[i].length, n, i);
+        }
+    }
+    
+    route.nodes.clear();
+    route.edges.clear();
+    route.settledNum = settled;
+    if (meet < 0) {
+        route.length = INT32_MAX;
+        release(std::move(search));
+        return false;
+    }
+    
+    // forward arcs from the source up to the meeting node, then the backward
+    // arcs from there down to the target
+    std::vector<int> chain;
+    for (int n = meet; search->mPred[0][n] >= 0; n = search->mPred[0][n]) {
+        chain.push_back(n);
+    }
+    int from = chain.empty() ? meet : search->mPred[0][chain.back()];
+    route.nodes.push_back(from);
+    route.edges.push_back(-1);
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        int pred = search->mPred[0][*it];
+        unpack(pred, mUp[search->mPredArc[0][*it]], route);
+    }
+    for (int n = meet; search->mPred[1][n] >= 0; n = search->mPred[1][n]) {
+        Arc arc = mDown[search->mPredArc[1][n]];
+        arc.node = search->mPred[1][n];
+        unpack(n, arc, route);
+    }
+    route.length = best;
+    release(std::move(search));
+    return true;
+}
@@ -0,0 +1,85 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavContractionHierarchy_hpp
+#define NavContractionHierarchy_hpp
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "NavGraph.hpp"
+#include "NavRouter.hpp"
+
+// Contraction hierarchy over a NavGraph, for routes on large maps.
+//
+// Preprocessing contracts the nodes one by one, least important first by
+// the shortcuts they would add, the arcs they remove and contracted neighbors. When a node is contracted, a
+// shortcut replaces each shortest path through it unless a bounded witness
+// search finds one as short around it. Every arc is then kept only at its
+// lower ranked end: arcs up from a node for the forward search, arcs into it
+// from above for the backward search.
+//
+// A query runs Dijkstra upward from the sources and from the targets at
+// once, and stops when neither side can improve the best meeting node. It
+// settles a few hundred nodes where a plain search settles a large part of
+// the campus. Shortcuts are unpacked into the original edges, so the route is
+// the same as NavRouter gives. Like NavRouter, queries take a pooled scratch
+// and may run at once on different threads.
+class NavContractionHierarchy {
+public:
+    explicit NavContractionHierarchy(std::shared_ptr<const NavGraph> graph);
+    ~NavContractionHierarchy();
+
+    const NavGraph& graph() const { return *mGraph; }
+    int shortcutNum() const { return mShortcutNum; }
+    int arcNum() const { return (int)(mUp.size() + mDown.size()); }
+
+    // shortest route from any source to any target, as NavRouter::route()
+    bool route(const NavRouteEndpoint* sources, int sourceNum, const NavRouteEndpoint* targets, int targetNum,
+               NavRoute& route) const;
+
+private:
+    struct Arc {
+        int32_t node;
+        int32_t length;
+        int32_t middle; // contracted node of a shortcut, -1 for an arc of the graph
+        int32_t edge;   // edge of an arc of the graph, -1 for transits and shortcuts
+    };
+    class Search;
+
+    void unpack(int from, const Arc& arc, NavRoute& route) const;
+    const Arc* find(const std::vector<int32_t>& begin, const std::vector<Arc>& arcs, int at, int node) const;
+    std::unique_ptr<Search> acquire() const;
+    void release(std::unique_ptr<Search> search) const;
+
+    std::shared_ptr<const NavGraph> mGraph;
+    std::vector<int32_t> mUpBegin, mDownBegin; // arcs of node n are [begin[n], begin[n + 1])
+    std::vector<Arc> mUp;   // from n to higher ranked nodes
+    std::vector<Arc> mDown; // into n from higher ranked nodes, node is the tail
+    int mShortcutNum;
+
+    mutable std::mutex mPoolMutex;
+    mutable std::vector<std::unique_ptr<Search>> mPool;
+};
+
+#endif /* NavContractionHierarchy_hpp */
@@ -62,6 +62,7 @@ enum EdgeType {EDGE_NORMAL, EDGE_NON_NAVIGATIONAL};
 
 @property (nonatomic) NSString *language;
 @property (strong, nonatomic) NSArray *path;
+@property (nonatomic) int graphIndex; // edge index in TopoMap's NavGraph, -1 if not in it (clones)
 
 
 // moved to CurrentLocationManager
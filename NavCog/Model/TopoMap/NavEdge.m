@@ -37,6 +37,15 @@
 
 @implementation NavEdge
 
+- (instancetype)init
+{
+    self = [super init];
+    if (self) {
+        _graphIndex = -1;
+    }
+    return self;
+}
+
 - (float)getOriFromNode:(NavNode *)node {
     if (node == _node1) {
         return _ori1;
@@ -0,0 +1,79 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavGraph.hpp"
+
+int NavGraphBuilder::addNode(int layer, int floor, int type, double lat, double lng)
+{
+    NavGraph& g = *mGraph;
+    g.mLayers.push_back(layer);
+    g.mFloors.push_back(floor);
+    g.mTypes.push_back((uint8_t)type);
+    g.mLats.push_back(lat);
+    g.mLngs.push_back(lng);
+    return (int)g.mLayers.size() - 1;
+}
+
+int NavGraphBuilder::addEdge(int node1, int node2, int length)
+{
+    NavGraph& g = *mGraph;
+    g.mEdgeNodes.push_back(node1);
+    g.mEdgeNodes.push_back(node2);
+    g.mEdgeLengths.push_back(length);
+    return (int)g.mEdgeLengths.size() - 1;
+}
+
+void NavGraphBuilder::addArc(int from, int to, int edge, int length)
+{
+    NavGraph::Arc arc = {to, edge, length};
+    mArcTails.push_back(from);
+    mArcs.push_back(arc);
+}
+
+std::shared_ptr<NavGraph> NavGraphBuilder::build()
+{
+    NavGraph& g = *mGraph;
+    int nodeNum = g.nodeNum();
+    // counting sort of the arcs by tail, stable within a node
+    g.mOffsets.assign(nodeNum + 1, 0);
+    for (int32_t tail : mArcTails) {
+        g.mOffsets[tail + 1]++;
+    }
+    for (int n = 0; n < nodeNum; n++) {
+        g.mOffsets[n + 1] += g.mOffsets[n];
+    }
+    std::vector<int32_t> next(g.mOffsets.begin(), g.mOffsets.end() - 1);
+    g.mArcs.resize(mArcs.size());
+    g.mTransitNum = 0;
+    for (size_t i = 0; i < mArcs.size(); i++) {
+        g.mArcs[next[mArcTails[i]]++] = mArcs[i];
+        if (mArcs[i].edge < 0) {
+            g.mTransitNum++;
+        }
+    }
+    
+    std::shared_ptr<NavGraph> graph = mGraph;
+    mGraph = std::make_shared<NavGraph>();
+    mArcTails.clear();
+    mArcs.clear();
+    return graph;
+}
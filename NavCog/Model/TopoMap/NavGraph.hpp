@@ -0,0 +1,91 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavGraph_hpp
+#define NavGraph_hpp
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+// Immutable routing graph of a TopoMap.
+//
+// Nodes and edges get dense indices in load order. The arcs leaving a node
+// are stored contiguously in compressed sparse row form: arcs of node n are
+// [arcBegin(n), arcEnd(n)). An arc either follows an edge, or is an enabled
+// transit link to a node on another layer, with edge -1 and length 0. All
+// per node and per edge data are plain arrays, so searches over the graph do
+// not touch the Objective-C objects.
+class NavGraph {
+public:
+    struct Arc {
+        int32_t node;   // head of the arc
+        int32_t edge;   // -1 for transit
+        int32_t length; // feet
+    };
+
+    int nodeNum() const { return (int)mLayers.size(); }
+    int edgeNum() const { return (int)mEdgeLengths.size(); }
+    int arcNum() const { return (int)mArcs.size(); }
+    int transitNum() const { return mTransitNum; }
+
+    const Arc* arcBegin(int node) const { return mArcs.data() + mOffsets[node]; }
+    const Arc* arcEnd(int node) const { return mArcs.data() + mOffsets[node + 1]; }
+
+    int layer(int node) const { return mLayers[node]; }
+    int floor(int node) const { return mFloors[node]; }
+    int type(int node) const { return mTypes[node]; }
+    double lat(int node) const { return mLats[node]; }
+    double lng(int node) const { return mLngs[node]; }
+
+    int edgeNode1(int edge) const { return mEdgeNodes[edge * 2]; }
+    int edgeNode2(int edge) const { return mEdgeNodes[edge * 2 + 1]; }
+    int edgeLength(int edge) const { return mEdgeLengths[edge]; }
+
+private:
+    friend class NavGraphBuilder;
+
+    std::vector<int32_t> mOffsets;
+    std::vector<Arc> mArcs;
+    std::vector<int32_t> mLayers, mFloors;
+    std::vector<uint8_t> mTypes;
+    std::vector<double> mLats, mLngs;
+    std::vector<int32_t> mEdgeNodes, mEdgeLengths;
+    int mTransitNum = 0;
+};
+
+class NavGraphBuilder {
+public:
+    int addNode(int layer, int floor, int type, double lat, double lng);
+    int addEdge(int node1, int node2, int length);
+    // arcs keep their order per node, edge -1 adds a transit arc
+    void addArc(int from, int to, int edge, int length);
+
+    std::shared_ptr<NavGraph> build();
+
+private:
+    std::shared_ptr<NavGraph> mGraph = std::make_shared<NavGraph>();
+    std::vector<int32_t> mArcTails;
+    std::vector<NavGraph::Arc> mArcs;
+};
+
+#endif /* NavGraph_hpp */
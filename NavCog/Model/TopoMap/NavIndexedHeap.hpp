@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavIndexedHeap_hpp
+#define NavIndexedHeap_hpp
+
+#include <stdint.h>
+#include <vector>
+
+// Min heap of node indices keyed by integer distances, for graph searches.
+//
+// The heap is 4-ary over one flat array, and the position of every node in
+// it is indexed so a key can be decreased in place. Memory is sized once
+// for the node count; clear() only touches the entries still queued, so
+// reusing the heap across searches costs nothing per node of the graph.
+class NavIndexedHeap {
+public:
+    void resize(int nodeNum) { mPos.assign(nodeNum, -1); mItems.clear(); }
+
+    bool empty() const { return mItems.empty(); }
+    int size() const { return (int)mItems.size(); }
+    bool contains(int node) const { return mPos[node] >= 0; }
+    int topNode() const { return mItems[0].node; }
+    int topKey() const { return mItems[0].key; }
+    int key(int node) const { return mItems[mPos[node]].key; }
+
+    // inserts the node or lowers its key, a higher key is ignored
+    void push(int node, int key)
+    {
+        int i = mPos[node];
+        if (i < 0) {
+            i = (int)mItems.size();
+            Item item = {key, node};
+            mItems.push_back(item);
+            mPos[node] = i;
+        } else if (key < mItems[i].key) {
+            mItems[i].key = key;
+        } else {
+            return;
+        }
+        up(i);
+    }
+
+    int pop()
+    {
+        int node = mItems[0].node;
+        mPos[node] = -1;
+        Item last = mItems.back();
+        mItems.pop_back();
+        if (!mItems.empty()) {
+            mItems[0] = last;
+            mPos[last.node] = 0;
+            down(0);
+        }
+        return node;
+    }
+
+    void clear()
+    {
+        for (const Item& item : mItems) {
+            mPos[item.node] = -1;
+        }
+        mItems.clear();
+    }
+
+private:
+    struct Item {
+        int32_t key;
+        int32_t node;
+    };
+    static const int kArity = 4;
+
+    void up(int i)
+    {
+        Item item = mItems[i];
+        while (i > 0) {
+            int parent = (i - 1) / kArity;
+            if (mItems[parent].key <= item.key) {
+                break;
+            }
+            mItems[i] = mItems[parent];
+            mPos[mItems[i].node] = i;
+            i = parent;
+        }
+        mItems[i] = item;
+        mPos[item.node] = i;
+    }
+
+    void down(int i)
+    {
+        Item item = mItems[i];
+        int n = (int)mItems.size();
+        while (true) {
+            int first = i * kArity + 1;
+            if (first >= n) {
+                break;
+            }
+            int last = first + kArity < n ? first + kArity : n;
+            int min = first;
+            for (int c = first + 1; c < last; c++) {
+                if (mItems[c].key < mItems[min].key) {
+                    min = c;
+                }
+            }
+            if (item.key <= mItems[min].key) {
+                break;
+            }
+            mItems[i] = mItems[min];
+            mPos[mItems[i].node] = i;
+            i = min;
+        }
+        mItems[i] = item;
+        mPos[item.node] = i;
+    }
+
+    std::vector<Item> mItems;
+    std::vector<int32_t> mPos;
+};
+
+#endif /* NavIndexedHeap_hpp */
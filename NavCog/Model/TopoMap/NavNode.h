@@ -50,11 +50,8 @@ enum NodeType {NODE_TYPE_NORMAL, NODE_TYPE_DOOR_TRANSIT, NODE_TYPE_STAIR_TRANSIT
 @property (nonatomic) double lng;
 @property (weak, nonatomic) NavLayer *parentLayer;
 
-@property (strong, nonatomic) NSMutableArray *neighbors; // used for Dijsktra's Algorithm
-@property (weak, nonatomic) NavNode *preNodeInPath; // used for Dijsktra's Algorithm for tracing back shortest path
-@property (weak, nonatomic) NavEdge *preEdgeInPath; // used to easy state machine generation
-@property (nonatomic) int distFromStartNode; // used for Dijsktra's Algorithm for searching shortest path
-@property (nonatomic) int indexInHeap; // used for heap management in Dijsktra's Algorithm
+@property (strong, nonatomic) NSMutableArray *neighbors; // used to build the NavGraph
+@property (nonatomic) int graphIndex; // node index in TopoMap's NavGraph, -1 if not in it
 
 @property (nonatomic) NSString *language;
 
@@ -40,6 +40,7 @@
     if (self) {
         _neighbors = [[NSMutableArray alloc] init];
         _infoFromEdges = [[NSMutableDictionary alloc] init];
+        _graphIndex = -1;
     }
     return self;
 }
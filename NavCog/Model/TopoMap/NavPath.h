@@ -0,0 +1,49 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#import <Foundation/Foundation.h>
+#import "NavNode.h"
+#import "NavEdge.h"
+
+@class NavNode;
+@class NavEdge;
+
+// A route as the state machine walks it. It holds its own nodes and the edge
+// walked to each, so routes do not share anything through the map nodes and
+// any number of them can be searched or kept at once.
+//
+// Nodes are ordered from the end back to the start, as the state machine
+// reads them.
+@interface NavPath : NSObject
+
+@property (readonly) NSArray *nodes;
+@property (readonly) int length; // feet including the start and end costs
+
+- (instancetype)initWithNodes:(NSArray *)nodes edges:(NSArray *)edges length:(int)length;
+- (NSUInteger)count;
+- (NavNode *)nodeAtIndex:(NSUInteger)index;
+// the edge walked from node index + 1 to node index, nil for transits and the start
+- (NavEdge *)edgeToNodeAtIndex:(NSUInteger)index;
+- (NavNode *)startNode;
+- (NavNode *)endNode;
+
+@end
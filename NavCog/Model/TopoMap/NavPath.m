@@ -0,0 +1,70 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#import "NavPath.h"
+
+@interface NavPath ()
+
+@property (strong, nonatomic) NSArray *edges; // NavEdge or NSNull, aligned with nodes
+
+@end
+
+@implementation NavPath
+
+- (instancetype)initWithNodes:(NSArray *)nodes edges:(NSArray *)edges length:(int)length
+{
+    self = [super init];
+    if (self) {
+        _nodes = [nodes copy];
+        _edges = [edges copy];
+        _length = length;
+    }
+    return self;
+}
+
+- (NSUInteger)count
+{
+    return _nodes.count;
+}
+
+- (NavNode *)nodeAtIndex:(NSUInteger)index
+{
+    return index < _nodes.count ? _nodes[index] : nil;
+}
+
+- (NavEdge *)edgeToNodeAtIndex:(NSUInteger)index
+{
+    id edge = index < _edges.count ? _edges[index] : nil;
+    return edge == [NSNull null] ? nil : edge;
+}
+
+- (NavNode *)startNode
+{
+    return [_nodes lastObject];
+}
+
+- (NavNode *)endNode
+{
+    return [_nodes firstObject];
+}
+
+@end
@@ -0,0 +1,394 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+// Route latency benchmark on synthetic campus maps. It is not part of the app
+// target, on Linux or macOS build it with
+//
+//   c++ -std=c++11 -O2 -INavCog/Model/TopoMap
+//       NavCog/Model/TopoMap/NavRouteBenchMain.cpp NavCog/Model/TopoMap/NavGraph.cpp
+//       NavCog/Model/TopoMap/NavRouter.cpp NavCog/Model/TopoMap/NavContractionHierarchy.cpp
+//       -pthread -o navroutebench
+//
+// usage: navroutebench [-q queries] [-t threads] [nodes...]   (default 1000 10000 100000, all cores)
+//
+// A campus is a grid of buildings of 4 floors, each floor a 16 x 16 grid of
+// corridor nodes 40 ft apart with edges up to 30% longer than the straight
+// line. Two elevators per building link the floors by transits, and the
+// ground floors are linked to the neighboring buildings by outdoor edges.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include "NavGraph.hpp"
+#include "NavRouter.hpp"
+#include "NavContractionHierarchy.hpp"
+
+static const int kFloors = 4, kSide = 16;
+static const double kSpacing = 40, kBuildingGap = 200;
+static const double kLat0 = 35.0, kLng0 = 139.0;
+static const int kDestinations = 300;
+
+struct Campus {
+    std::shared_ptr<NavGraph> graph;
+    int buildingNum;
+};
+
+static Campus buildCampus(int nodeNum, std::mt19937& rng)
+{
+    Campus campus;
+    int perBuilding = kFloors * kSide * kSide;
+    campus.buildingNum = std::max(1, (nodeNum + perBuilding / 2) / perBuilding);
+    int columns = (int)ceil(sqrt((double)campus.buildingNum));
+    double ky = 6371000 / 0.3048 * M_PI / 180, kx = ky * cos(kLat0 * M_PI / 180);
+    std::uniform_real_distribution<double> detour(1.0, 1.3);
+    
+    NavGraphBuilder builder;
+    auto node = [&](int b, int f, int i, int j) { return ((b * kFloors + f) * kSide + i) * kSide + j; };
+    auto link = [&](int n1, int n2, double straight) {
+        int len = (int)ceil(straight * detour(rng));
+        int e = builder.addEdge(n1, n2, len);
+        builder.addArc(n1, n2, e, len);
+        builder.addArc(n2, n1, e, len);
+    };
+    for (int b = 0; b < campus.buildingNum; b++) {
+        double ox = (b % columns) * (kSide * kSpacing + kBuildingGap);
+        double oy = (b / columns) * (kSide * kSpacing + kBuildingGap);
+        for (int f = 0; f < kFloors; f++) {
+            for (int i = 0; i < kSide; i++) {
+                for (int j = 0; j < kSide; j++) {
+                    double x = ox + j * kSpacing, y = oy + i * kSpacing;
+                    builder.addNode(b * kFloors + f, f + 1, 0, kLat0 + y / ky, kLng0 + x / kx);
+                }
+            }
+        }
+    }
+    for (int b = 0; b < campus.buildingNum; b++) {
+        for (int f = 0; f < kFloors; f++) {
+            for (int i = 0; i < kSide; i++) {
+                for (int j = 0; j < kSide; j++) {
+                    if (j + 1 < kSide) {
+                        link(node(b, f, i, j), node(b, f, i, j + 1), kSpacing);
+                    }
+                    if (i + 1 < kSide) {
+                        link(node(b, f, i, j), node(b, f, i + 1, j), kSpacing);
+                    }
+                }
+            }
+            if (f + 1 < kFloors) {
+                int elevators[2][2] = {{2, 3}, {kSide - 3, kSide - 2}};
+                for (auto& e : elevators) {
+                    builder.addArc(node(b, f, e[0], e[1]), node(b, f + 1, e[0], e[1]), -1, 0);
+                    builder.addArc(node(b, f + 1, e[0], e[1]), node(b, f, e[0], e[1]), -1, 0);
+                }
+            }
+        }
+        // outdoor paths from the east and north doors
+        if (b % columns + 1 < columns && b + 1 < campus.buildingNum) {
+            link(node(b, 0, kSide / 2, kSide - 1), node(b + 1, 0, kSide / 2, 0), kBuildingGap + kSpacing);
+        }
+        if (b + columns < campus.buildingNum) {
+            link(node(b, 0, kSide - 1, kSide / 2), node(b + columns, 0, 0, kSide / 2), kBuildingGap + kSpacing);
+        }
+    }
+    campus.graph = builder.build();
+    return campus;
+}
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double elapsedUs(BenchClock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(BenchClock::now() - start).count();
+}
+
+// length of the route walked over the graph arcs, -1 if it does not follow them
+static int walkedLength(const NavGraph& g, const NavRoute& route)
+{
+    int length = 0;
+    for (size_t i = 1; i < route.nodes.size(); i++) {
+        int best = -1;
+        for (const NavGraph::Arc* a = g.arcBegin(route.nodes[i - 1]); a != g.arcEnd(route.nodes[i - 1]); a++) {
+            if (a->node == route.nodes[i] && a->edge == route.edges[i] && (best < 0 || a->length < best)) {
+                best = a->length;
+            }
+        }
+        if (best < 0) {
+            return -1;
+        }
+        length += best;
+    }
+    return length;
+}
+
+// contraction hierarchy preprocessing, then random pairs and the current
+// location case of two sources against Dijkstra
+static int benchmarkHierarchy(const std::shared_ptr<NavGraph>& graph, const NavRouter& router, int queryNum, std::mt19937& rng)
+{
+    const NavGraph& g = *graph;
+    BenchClock::time_point start = BenchClock::now();
+    NavContractionHierarchy hierarchy(graph);
+    double buildUs = elapsedUs(start);
+    
+    std::uniform_int_distribution<int> pick(0, g.nodeNum() - 1);
+    std::uniform_int_distribution<int> pickEdge(0, std::max(0, g.edgeNum() - 1));
+    NavRoute route;
+    double timeUs[2] = {0, 0};
+    long settled[2] = {0, 0};
+    int mismatch = 0, broken = 0;
+    for (int q = 0; q < queryNum; q++) {
+        NavRouteEndpoint sources[2] = {{pick(rng), 0}, {0, 0}}, target = {pick(rng), 0};
+        int sourceNum = 1;
+        if (q % 2 == 1 && g.edgeNum() > 0) {
+            int edge = pickEdge(rng);
+            NavRouter::edgeEndpoints(g, edge, g.edgeLength(edge) / 3, sources);
+            sourceNum = 2;
+        }
+        int length[2] = {-1, -1};
+        for (int m = 0; m < 2; m++) {
+            start = BenchClock::now();
+            bool ok = m == 0 ? router.route(sources, sourceNum, &target, 1, NavRouter::Dijkstra, route)
+                             : hierarchy.route(sources, sourceNum, &target, 1, route);
+            timeUs[m] += elapsedUs(start);
+            settled[m] += route.settledNum;
+            length[m] = ok ? route.length : -1;
+        }
+        mismatch += length[0] != length[1];
+        if (length[1] >= 0) {
+            int cost = route.nodes[0] == sources[0].node ? sources[0].cost : sources[1].cost;
+            broken += walkedLength(g, route) + cost != length[1];
+        }
+    }
+    printf("  hierarchy %.1f ms, %d shortcuts, %d arcs; dijkstra %.1f us/route, %.0f settled; hierarchy %.1f us/route, %.0f settled; %d mismatches, %d broken\n",
+           buildUs / 1000, hierarchy.shortcutNum(), hierarchy.arcNum(), timeUs[0] / queryNum, (double)settled[0] / queryNum,
+           timeUs[1] / queryNum, (double)settled[1] / queryNum, mismatch, broken);
+    return mismatch + broken;
+}
+
+// routes between locations inside edges against the route between their
+// endpoints, on one edge the walk between the offsets when it is shorter
+static int benchmarkEdges(const NavRouter& router, int queryNum, std::mt19937& rng)
+{
+    const NavGraph& g = router.graph();
+    if (g.edgeNum() == 0) {
+        return 0;
+    }
+    std::uniform_int_distribution<int> pickEdge(0, g.edgeNum() - 1);
+    NavRoute route, through;
+    double timeUs = 0;
+    int same = 0, mismatch = 0;
+    for (int q = 0; q < queryNum; q++) {
+        int sourceEdge = pickEdge(rng), targetEdge = q % 2 == 0 ? sourceEdge : pickEdge(rng);
+        std::uniform_int_distribution<int> sourceOffset(0, g.edgeLength(sourceEdge)), targetOffset(0, g.edgeLength(targetEdge));
+        int a = sourceOffset(rng), b = targetOffset(rng);
+        BenchClock::time_point start = BenchClock::now();
+        bool ok = router.edgeRoute(sourceEdge, a, targetEdge, b, NavRouter::AStar, route);
+        timeUs += elapsedUs(start);
+        
+        NavRouteEndpoint sources[2], targets[2];
+        NavRouter::edgeEndpoints(g, sourceEdge, a, sources);
+        NavRouter::edgeEndpoints(g, targetEdge, b, targets);
+        bool throughOk = router.route(sources, 2, targets, 2, NavRouter::Dijkstra, through);
+        if (sourceEdge == targetEdge) {
+            same++;
+            mismatch += !ok || route.length != (throughOk ? std::min(abs(a - b), through.length) : abs(a - b));
+        } else {
+            mismatch += ok != throughOk || (ok && route.length != through.length);
+        }
+    }
+    printf("  %d edge locations, %d on one edge: %.1f us/route; %d mismatches\n", queryNum, same, timeUs / queryNum, mismatch);
+    return mismatch;
+}
+
+// a curved corridor of 1000 ft whose ends are also joined by two edges of
+// 10 ft, on it the way out and back in by the other end is the shorter one
+// between offsets far apart
+static int checkEdgeDetour()
+{
+    double ky = 6371000 / 0.3048 * M_PI / 180, kx = ky * cos(kLat0 * M_PI / 180);
+    NavGraphBuilder builder;
+    int a = builder.addNode(0, 1, 0, kLat0, kLng0);
+    int b = builder.addNode(0, 1, 0, kLat0, kLng0 + 15 / kx);
+    int c = builder.addNode(0, 1, 0, kLat0 + 5 / ky, kLng0 + 7.5 / kx);
+    int corridor = -1;
+    int links[3][3] = {{a, b, 1000}, {a, c, 10}, {c, b, 10}};
+    for (auto& l : links) {
+        int e = builder.addEdge(l[0], l[1], l[2]);
+        builder.addArc(l[0], l[1], e, l[2]);
+        builder.addArc(l[1], l[0], e, l[2]);
+        corridor = corridor < 0 ? e : corridor;
+    }
+    NavRouter router(builder.build());
+    
+    // {source offset, target offset, length, walked}
+    int cases[4][4] = {{100, 900, 220, 0}, {900, 100, 220, 0}, {100, 300, 200, 1}, {0, 1000, 20, 0}};
+    int mismatch = 0;
+    NavRoute route;
+    for (auto& k : cases) {
+        for (int m = 0; m < 2; m++) {
+            bool ok = router.edgeRoute(corridor, k[0], corridor, k[1], m == 0 ? NavRouter::Dijkstra : NavRouter::AStar, route);
+            mismatch += !ok || route.length != k[2] || route.nodes.empty() != (k[3] == 1);
+        }
+    }
+    printf("edge with a shorter detour between its ends: %d mismatches\n", mismatch);
+    return mismatch;
+}
+
+// the same random pairs routed on one thread and on all cores, one router
+// shared by all threads
+static int benchmarkParallel(const NavRouter& router, int queryNum, int threadNum, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> pick(0, router.graph().nodeNum() - 1);
+    std::vector<NavRouteEndpoint> pairs(queryNum * 2);
+    for (NavRouteEndpoint& p : pairs) {
+        p = {pick(rng), 0};
+    }
+    std::vector<int> lengths[2];
+    double timeUs[2];
+    int threadNums[2] = {1, threadNum};
+    for (int t = 0; t < 2; t++) {
+        lengths[t].assign(queryNum, -1);
+        std::atomic<int> next(0);
+        auto worker = [&]() {
+            NavRoute route;
+            for (int q; (q = next++) < queryNum;) {
+                if (router.route(&pairs[q * 2], 1, &pairs[q * 2 + 1], 1, NavRouter::AStar, route)) {
+                    lengths[t][q] = route.length;
+                }
+            }
+        };
+        BenchClock::time_point start = BenchClock::now();
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadNums[t]; i++) {
+            threads.emplace_back(worker);
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        timeUs[t] = elapsedUs(start);
+    }
+    int mismatch = 0;
+    for (int q = 0; q < queryNum; q++) {
+        mismatch += lengths[0][q] != lengths[1][q];
+    }
+    printf("  %d routes: 1 thread %.0f routes/s; %d threads %.0f routes/s, %d scratches; %d mismatches\n",
+           queryNum, queryNum / timeUs[0] * 1e6, threadNums[1], queryNum / timeUs[1] * 1e6, router.scratchNum(), mismatch);
+    return mismatch;
+}
+
+static int benchmark(int nodeNum, int queryNum, int threadNum)
+{
+    std::mt19937 rng(nodeNum);
+    BenchClock::time_point start = BenchClock::now();
+    Campus campus = buildCampus(nodeNum, rng);
+    const NavGraph& g = *campus.graph;
+    double buildUs = elapsedUs(start);
+    start = BenchClock::now();
+    NavRouter router(campus.graph);
+    double routerUs = elapsedUs(start);
+    
+    std::uniform_int_distribution<int> pick(0, g.nodeNum() - 1);
+    NavRoute route;
+    double timeUs[2] = {0, 0};
+    long settled[2] = {0, 0};
+    int found = 0, mismatch = 0;
+    for (int q = 0; q < queryNum; q++) {
+        NavRouteEndpoint source = {pick(rng), 0}, target = {pick(rng), 0};
+        int length[2] = {-1, -1};
+        for (int m = 0; m < 2; m++) {
+            start = BenchClock::now();
+            bool ok = router.route(&source, 1, &target, 1, m == 0 ? NavRouter::Dijkstra : NavRouter::AStar, route);
+            timeUs[m] += elapsedUs(start);
+            settled[m] += route.settledNum;
+            length[m] = ok ? route.length : -1;
+        }
+        found += length[0] >= 0;
+        mismatch += length[0] != length[1];
+    }
+    printf("%d nodes (%d buildings), %d edges, %d transits: graph %.1f ms, router %.1f ms, heuristic scale %.3f\n",
+           g.nodeNum(), campus.buildingNum, g.edgeNum(), g.transitNum(), buildUs / 1000, routerUs / 1000, router.heuristicScale());
+    printf("  dijkstra %.1f us/route, %.0f settled; a* %.1f us/route, %.0f settled; %d/%d found, %d mismatches\n",
+           timeUs[0] / queryNum, (double)settled[0] / queryNum, timeUs[1] / queryNum, (double)settled[1] / queryNum,
+           found, queryNum, mismatch);
+    
+    // distances to every destination from one location, one tree against a
+    // route per destination
+    std::vector<int> destinations(std::min(kDestinations, g.nodeNum()));
+    for (int& d : destinations) {
+        d = pick(rng);
+    }
+    NavRouteEndpoint source = {pick(rng), 0};
+    NavRouteTree tree;
+    start = BenchClock::now();
+    router.tree(&source, 1, destinations.data(), (int)destinations.size(), tree);
+    double treeUs = elapsedUs(start);
+    start = BenchClock::now();
+    for (int d : destinations) {
+        NavRouteEndpoint target = {d, 0};
+        router.route(&source, 1, &target, 1, NavRouter::AStar, route);
+        mismatch += tree.distance(d) != route.length;
+    }
+    double routesUs = elapsedUs(start);
+    start = BenchClock::now();
+    size_t pathNodes = 0;
+    for (int d : destinations) {
+        tree.path(d, route);
+        pathNodes += route.nodes.size();
+    }
+    double pathUs = elapsedUs(start);
+    printf("  %d destinations: tree %.1f us, %d settled; a* per destination %.1f us; paths %.2f us each, %.0f nodes; %d mismatches\n",
+           (int)destinations.size(), treeUs, tree.settledNum(), routesUs, pathUs / destinations.size(),
+           (double)pathNodes / destinations.size(), mismatch);
+    
+    mismatch += benchmarkEdges(router, queryNum, rng);
+    mismatch += benchmarkParallel(router, queryNum * 8, threadNum, rng);
+    mismatch += benchmarkHierarchy(campus.graph, router, queryNum, rng);
+    return mismatch == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    int queryNum = 200, threadNum = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<int> sizes;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+            queryNum = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            threadNum = std::max(1, atoi(argv[++i]));
+        } else {
+            sizes.push_back(atoi(argv[i]));
+        }
+    }
+    if (sizes.empty()) {
+        sizes = {1000, 10000, 100000};
+    }
+    int result = checkEdgeDetour() == 0 ? 0 : 1;
+    for (int n : sizes) {
+        result |= benchmark(n, queryNum, threadNum);
+    }
+    return result;
+}
@@ -0,0 +1,382 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavRouter.hpp"
+#include <math.h>
+#include <float.h>
+#include <stdlib.h>
+#include <algorithm>
+
+static const double kEarthRadiusFeet = 6371000 / 0.3048;
+
+static int findRoot(std::vector<int>& parent, int n)
+{
+    while (parent[n] != n) {
+        parent[n] = parent[parent[n]];
+        n = parent[n];
+    }
+    return n;
+}
+
+// search state of one query, taken from the router's pool
+class NavRouter::Search {
+public:
+    explicit Search(const NavRouter& router);
+
+    void reset();
+    void addTarget(int node, int cost);
+    void push(const NavRouteEndpoint* sources, int sourceNum);
+    int settle();
+    bool visited(int node) const { return mVisited[node >> 6] & (1ULL << (node & 63)); }
+    void path(int node, NavRoute& route) const;
+
+    const NavRouter& mRouter;
+    std::vector<int32_t> mDist;
+    std::vector<int32_t> mPredNode, mPredEdge;
+    std::vector<int32_t> mTargetCost; // INT32_MAX if not a target
+    std::vector<uint64_t> mVisited;
+    std::vector<int32_t> mTouched;
+    NavIndexedHeap mHeap;
+    std::vector<NavRouteEndpoint> mHeuristicTargets;
+    int mSettledNum;
+
+private:
+    int estimate(int node) const;
+};
+
+NavRouter::NavRouter(std::shared_ptr<const NavGraph> graph)
+: mGraph(graph), mScale(0), mScratchNum(0)
+{
+    const NavGraph& g = *mGraph;
+    int nodeNum = g.nodeNum();
+    
+    // one position per group of transit linked nodes
+    std::vector<int> parent(nodeNum);
+    for (int n = 0; n < nodeNum; n++) {
+        parent[n] = n;
+    }
+    for (int n = 0; n < nodeNum; n++) {
+        for (const NavGraph::Arc* a = g.arcBegin(n); a != g.arcEnd(n); a++) {
+            if (a->edge < 0) {
+                parent[findRoot(parent, n)] = findRoot(parent, a->node);
+            }
+        }
+    }
+    double lat0 = 0, lng0 = 0;
+    for (int n = 0; n < nodeNum; n++) {
+        lat0 += g.lat(n) / nodeNum;
+        lng0 += g.lng(n) / nodeNum;
+    }
+    double kx = kEarthRadiusFeet * cos(lat0 * M_PI / 180) * M_PI / 180, ky = kEarthRadiusFeet * M_PI / 180;
+    mX.resize(nodeNum);
+    mY.resize(nodeNum);
+    for (int n = 0; n < nodeNum; n++) {
+        int root = findRoot(parent, n);
+        mX[n] = (g.lng(root) - lng0) * kx;
+        mY[n] = (g.lat(root) - lat0) * ky;
+    }
+    
+    // admissible if no arc is shorter than scale times its straight line
+    double scale = DBL_MAX;
+    for (int n = 0; n < nodeNum; n++) {
+        for (const NavGraph::Arc* a = g.arcBegin(n); a != g.arcEnd(n); a++) {
+            double d = hypot(mX[n] - mX[a->node], mY[n] - mY[a->node]);
+            if (d > 0) {
+                scale = std::min(scale, a->length / d);
+            }
+        }
+    }
+    // a little under the bound for rounding
+    mScale = scale == DBL_MAX ? 0 : scale * (1 - 1e-9);
+}
+
+NavRouter::~NavRouter()
+{
+}
+
+std::unique_ptr<NavRouter::Search> NavRouter::acquire() const
+{
+    {
+        std::lock_guard<std::mutex> lock(mPoolMutex);
+        if (!mPool.empty()) {
+            std::unique_ptr<Search> search = std::move(mPool.back());
+            mPool.pop_back();
+            return search;
+        }
+        mScratchNum++;
+    }
+    return std::unique_ptr<Search>(new Search(*this));
+}
+
+void NavRouter::release(std::unique_ptr<Search> search) const
+{
+    search->reset();
+    std::lock_guard<std::mutex> lock(mPoolMutex);
+    mPool.push_back(std::move(search));
+}
+
+int NavRouter::scratchNum() const
+{
+    std::lock_guard<std::mutex> lock(mPoolMutex);
+    return mScratchNum;
+}
+
+void NavRouter::edgeEndpoints(const NavGraph& graph, int edge, int offset, NavRouteEndpoint endpoints[2])
+{
+    int length = graph.edgeLength(edge);
+    offset = std::max(0, std::min(length, offset));
+    endpoints[0] = {graph.edgeNode1(edge), offset};
+    endpoints[1] = {graph.edgeNode2(edge), length - offset};
+}
+
+NavRouter::Search::Search(const NavRouter& router)
+: mRouter(router), mSettledNum(0)
+{
+    int nodeNum = router.mGraph->nodeNum();
+    mDist.assign(nodeNum, INT32_MAX);
+    mPredNode.assign(nodeNum, -1);
+    mPredEdge.assign(nodeNum, -1);
+    mTargetCost.assign(nodeNum, INT32_MAX);
+    mVisited.assign((nodeNum + 63) / 64, 0);
+    mHeap.resize(nodeNum);
+}
+
+int NavRouter::Search::estimate(int node) const
+{
+    const std::vector<double>& x = mRouter.mX;
+    const std::vector<double>& y = mRouter.mY;
+    double min = DBL_MAX;
+    for (const NavRouteEndpoint& t : mHeuristicTargets) {
+        double d = mRouter.mScale * hypot(x[node] - x[t.node], y[node] - y[t.node]) + t.cost;
+        min = std::min(min, d);
+    }
+    return min == DBL_MAX ? 0 : (int)floor(min);
+}
+
+void NavRouter::Search::reset()
+{
+    for (int n : mTouched) {
+        mDist[n] = INT32_MAX;
+        mPredNode[n] = -1;
+        mPredEdge[n] = -1;
+        mTargetCost[n] = INT32_MAX;
+        mVisited[n >> 6] = 0;
+    }
+    mTouched.clear();
+    mHeap.clear();
+    mHeuristicTargets.clear();
+    mSettledNum = 0;
+}
+
+void NavRouter::Search::addTarget(int node, int cost)
+{
+    if (mTargetCost[node] == INT32_MAX) {
+        mTouched.push_back(node);
+    }
+    mTargetCost[node] = std::min(mTargetCost[node], cost);
+}
+
+void NavRouter::Search::push(const NavRouteEndpoint* sources, int sourceNum)
+{
+    for (int i = 0; i < sourceNum; i++) {
+        int s = sources[i].node;
+        if (sources[i].cost < mDist[s]) {
+            if (mDist[s] == INT32_MAX) {
+                mTouched.push_back(s);
+            }
+            mDist[s] = sources[i].cost;
+            mPredNode[s] = -1;
+            mPredEdge[s] = -1;
+            mHeap.push(s, sources[i].cost + estimate(s));
+        }
+    }
+}
+
+// pops the nearest queued node and relaxes its arcs
+int NavRouter::Search::settle()
+{
+    const NavGraph& g = *mRouter.mGraph;
+    int n = mHeap.pop();
+    mVisited[n >> 6] |= 1ULL << (n & 63);
+    mSettledNum++;
+    int dist = mDist[n];
+    for (const NavGraph::Arc* a = g.arcBegin(n); a != g.arcEnd(n); a++) {
+        int m = a->node;
+        if (visited(m)) {
+            continue;
+        }
+        int d = dist + a->length;
+        if (d < mDist[m]) {
+            if (mDist[m] == INT32_MAX && mTargetCost[m] == INT32_MAX) {
+                mTouched.push_back(m);
+            }
+            mDist[m] = d;
+            mPredNode[m] = n;
+            mPredEdge[m] = a->edge;
+            mHeap.push(m, d + estimate(m));
+        }
+    }
+    return n;
+}
+
+void NavRouter::Search::path(int node, NavRoute& route) const
+{
+    route.nodes.clear();
+    route.edges.clear();
+    for (int n = node; n >= 0; n = mPredNode[n]) {
+        route.nodes.push_back(n);
+        route.edges.push_back(mPredEdge[n]);
+    }
+    std::reverse(route.nodes.begin(), route.nodes.end());
+    std::reverse(route.edges.begin(), route.edges.end());
+}
+
+bool NavRouter::route(const NavRouteEndpoint* sources, int sourceNum, const NavRouteEndpoint* targets, int targetNum,
+                      Mode mode, NavRoute& route) const
+{
+    std::unique_ptr<Search> search = acquire();
+    for (int i = 0; i < targetNum; i++) {
+        search->addTarget(targets[i].node, targets[i].cost);
+    }
+    if (mode == AStar && mScale > 0 && targetNum <= kMaxHeuristicTargets) {
+        search->mHeuristicTargets.assign(targets, targets + targetNum);
+    }
+    search->push(sources, sourceNum);
+    
+    // a target is settled with its finishing cost added, the search goes on
+    // until nothing queued can beat the best finish
+    int best = INT32_MAX, bestNode = -1;
+    while (!search->mHeap.empty() && search->mHeap.topKey() < best) {
+        int n = search->settle();
+        int cost = search->mTargetCost[n];
+        if (cost != INT32_MAX && search->mDist[n] + cost < best) {
+            best = search->mDist[n] + cost;
+            bestNode = n;
+        }
+    }
+    if (bestNode >= 0) {
+        search->path(bestNode, route);
+        route.length = best;
+    } else {
+        route.nodes.clear();
+        route.edges.clear();
+        route.length = INT32_MAX;
+    }
+    route.settledNum = search->mSettledNum;
+    release(std::move(search));
+    return bestNode >= 0;
+}
+
+bool NavRouter::edgeWalk(const NavGraph& graph, int edge, int sourceOffset, int targetOffset, NavRoute& route)
+{
+    int length = graph.edgeLength(edge);
+    sourceOffset = std::max(0, std::min(length, sourceOffset));
+    targetOffset = std::max(0, std::min(length, targetOffset));
+    int walk = abs(sourceOffset - targetOffset);
+    // leaving and coming back by the same end is never shorter
+    int around = std::min(sourceOffset + length - targetOffset, length - sourceOffset + targetOffset);
+    if (walk > around) {
+        return false;
+    }
+    route.nodes.clear();
+    route.edges.clear();
+    route.length = walk;
+    route.settledNum = 0;
+    return true;
+}
+
+bool NavRouter::edgeRoute(int sourceEdge, int sourceOffset, int targetEdge, int targetOffset, Mode mode, NavRoute& route) const
+{
+    if (sourceEdge == targetEdge && edgeWalk(*mGraph, sourceEdge, sourceOffset, targetOffset, route)) {
+        return true;
+    }
+    NavRouteEndpoint sources[2], targets[2];
+    edgeEndpoints(*mGraph, sourceEdge, sourceOffset, sources);
+    edgeEndpoints(*mGraph, targetEdge, targetOffset, targets);
+    bool found = this->route(sources, 2, targets, 2, mode, route);
+    if (sourceEdge == targetEdge) {
+        // the ends may be joined by a path shorter than the edge
+        int walk = abs(sources[0].cost - targets[0].cost);
+        if (!found || walk <= route.length) {
+            route.nodes.clear();
+            route.edges.clear();
+            route.length = walk;
+        }
+        return true;
+    }
+    return found;
+}
+
+void NavRouter::tree(const NavRouteEndpoint* sources, int sourceNum, const int* targets, int targetNum, NavRouteTree& tree) const
+{
+    std::unique_ptr<Search> search = acquire();
+    
+    // targets are only counted, their cost stays 0
+    int remaining = 0;
+    for (int i = 0; i < targetNum; i++) {
+        if (search->mTargetCost[targets[i]] == INT32_MAX) {
+            search->addTarget(targets[i], 0);
+            remaining++;
+        }
+    }
+    search->push(sources, sourceNum);
+    while (!search->mHeap.empty() && (targetNum == 0 || remaining > 0)) {
+        int n = search->settle();
+        if (search->mTargetCost[n] != INT32_MAX) {
+            remaining--;
+        }
+    }
+    
+    // only settled distances are final
+    int nodeNum = mGraph->nodeNum();
+    tree.mDist.assign(nodeNum, INT32_MAX);
+    tree.mPredNode.assign(nodeNum, -1);
+    tree.mPredEdge.assign(nodeNum, -1);
+    for (int n : search->mTouched) {
+        if (search->visited(n)) {
+            tree.mDist[n] = search->mDist[n];
+            tree.mPredNode[n] = search->mPredNode[n];
+            tree.mPredEdge[n] = search->mPredEdge[n];
+        }
+    }
+    tree.mSettledNum = search->mSettledNum;
+    release(std::move(search));
+}
+
+bool NavRouteTree::path(int node, NavRoute& route) const
+{
+    route.nodes.clear();
+    route.edges.clear();
+    route.settledNum = 0;
+    if (node < 0 || node >= nodeNum() || !reached(node)) {
+        route.length = INT32_MAX;
+        return false;
+    }
+    for (int n = node; n >= 0; n = mPredNode[n]) {
+        route.nodes.push_back(n);
+        route.edges.push_back(mPredEdge[n]);
+    }
+    std::reverse(route.nodes.begin(), route.nodes.end());
+    std::reverse(route.edges.begin(), route.edges.end());
+    route.length = mDist[node];
+    return true;
+}
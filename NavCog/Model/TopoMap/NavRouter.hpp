@@ -0,0 +1,138 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+#ifndef NavRouter_hpp
+#define NavRouter_hpp
+
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "NavGraph.hpp"
+#include "NavIndexedHeap.hpp"
+
+// A node where a route may start or end, with the cost of starting there or
+// of finishing from there (e.g. the rest of an edge), in feet.
+struct NavRouteEndpoint {
+    int node;
+    int cost;
+};
+
+// A route found by NavRouter, it owns all of its data.
+struct NavRoute {
+    std::vector<int> nodes; // from the source to the target
+    std::vector<int> edges; // edges[i] from nodes[i - 1] to nodes[i], -1 for transits and the first node
+    int length;             // including the endpoint costs
+    int settledNum;         // nodes settled by the search
+};
+
+// Shortest routes from a set of sources to every node a search settled, kept
+// after the search so that any of them can be routed to in O(path length).
+class NavRouteTree {
+public:
+    int nodeNum() const { return (int)mDist.size(); }
+    bool reached(int node) const { return mDist[node] != INT32_MAX; }
+    // walking distance from the sources including their costs, INT32_MAX if not reached
+    int distance(int node) const { return mDist[node]; }
+    int settledNum() const { return mSettledNum; }
+    // route from a source to node, settledNum is 0
+    bool path(int node, NavRoute& route) const;
+
+private:
+    friend class NavRouter;
+    std::vector<int32_t> mDist;
+    std::vector<int32_t> mPredNode, mPredEdge;
+    int mSettledNum = 0;
+};
+
+// Shortest routes over a NavGraph.
+//
+// The router itself only holds what is fixed for the graph, the search state
+// of a query lives in a scratch of flat arrays sized for the graph: distances,
+// predecessors, a visited bitset and an indexed 4-ary heap. Scratches are
+// pooled, a query takes one and gives it back, and only the entries a search
+// touched are reset. Queries therefore cost nothing per node of the graph,
+// allocate nothing once the pool and the route buffers have grown, and any
+// number of them may run at once on different threads.
+//
+// In AStar mode the search is guided by the straight line distance to the
+// nearest target, from node lat/lng projected to feet. Nodes linked by
+// transits share one position, so floors do not add to the estimate, and
+// the distance is scaled by the smallest length to straight line ratio over
+// all edges. The estimate therefore never exceeds a walking distance on this
+// graph, and routes are as short as with Dijkstra.
+class NavRouter {
+public:
+    enum Mode {
+        Dijkstra,
+        AStar
+    };
+
+    explicit NavRouter(std::shared_ptr<const NavGraph> graph);
+    ~NavRouter();
+
+    const NavGraph& graph() const { return *mGraph; }
+
+    // a location offset feet from the first node of an edge as the two ends
+    // of the edge, with the walk along the edge to each as its cost. These
+    // serve as sources or targets, so routes may start or end inside an edge
+    // without adding anything to the graph.
+    static void edgeEndpoints(const NavGraph& graph, int edge, int offset, NavRouteEndpoint endpoints[2]);
+
+    // the walk along an edge between two offsets as a route with no nodes,
+    // only if it is shorter than leaving by either end and coming back by the
+    // other whatever joins the ends, so that no search can beat it
+    static bool edgeWalk(const NavGraph& graph, int edge, int sourceOffset, int targetOffset, NavRoute& route);
+
+    // shortest route between locations offset feet from the first node of two
+    // edges, on one edge either the walk between them or a route through its ends
+    bool edgeRoute(int sourceEdge, int sourceOffset, int targetEdge, int targetOffset, Mode mode, NavRoute& route) const;
+
+    // shortest route from any source to any target
+    bool route(const NavRouteEndpoint* sources, int sourceNum, const NavRouteEndpoint* targets, int targetNum,
+               Mode mode, NavRoute& route) const;
+
+    // Dijkstra from the sources until every target is settled, or the whole
+    // reachable graph if targetNum is 0
+    void tree(const NavRouteEndpoint* sources, int sourceNum, const int* targets, int targetNum, NavRouteTree& tree) const;
+
+    // 0 if lat/lng do not give an admissible estimate, AStar is Dijkstra then
+    double heuristicScale() const { return mScale; }
+    // scratches created so far, at most the number of queries run at once
+    int scratchNum() const;
+
+private:
+    static const int kMaxHeuristicTargets = 16;
+    class Search;
+
+    std::unique_ptr<Search> acquire() const;
+    void release(std::unique_ptr<Search> search) const;
+
+    std::shared_ptr<const NavGraph> mGraph;
+    std::vector<double> mX, mY; // feet from the map center, shared by transit linked nodes
+    double mScale;
+
+    mutable std::mutex mPoolMutex;
+    mutable std::vector<std::unique_ptr<Search>> mPool;
+    mutable int mScratchNum;
+};
+
+#endif /* NavRouter_hpp */
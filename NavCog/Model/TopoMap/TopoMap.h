@@ -34,9 +34,12 @@
 #import "NavLayer.h"
 #import "NavLocation.h"
 #import "NavNeighbor.h"
-#import "NavMinHeap.h"
+#import "NavPath.h"
 #import "NavLog.h"
 #import "NavCogFuncViewController.h"
+#ifdef __cplusplus
+#import "NavGraph.hpp"
+#endif
 
 #define UNIT_METER @"meter"
 
@@ -60,13 +63,22 @@ UIKIT_EXTERN double TopoMapUnit; // base unit is feet (1 = 1 foot = 0.3048 meter
 - (NSString *)getUUIDString;
 - (NSString *)getMajorIDString;
 - (NSString *)initializaWithFile:(NSString *)filePath;
-- (NSArray *)findShortestPathFromNodeWithName:(NSString *)fromName toNodeWithName:(NSString *)toName;
+- (NavPath *)findShortestPathFromNodeWithName:(NSString *)fromName toNodeWithName:(NSString *)toName;
 - (NSArray *)getAllLocationNamesOnMap;
 - (NSArray *)getAllLocationNamesOnMapSorted:(bool)sorted;
 //- (NavLocation *)getCurrentLocationOnMapUsingBeacons:(NSArray *)beacons withInit:(Boolean)init;
 //- (NavLocation *)getLocationInEdges:(NSArray *)edges withBeacons:(NSArray *)beacons withKNNThreshold:(float)knnThreshold withInit:(Boolean)init;
-- (NSArray *)findShortestPathFromCurrentLocation:(NavLocation *)curLocation toNodeWithName:(NSString *)toNodeName;
-- (void)cleanTmpNodeAndEdges;
+- (NavPath *)findShortestPathFromCurrentLocation:(NavLocation *)curLocation toNodeWithName:(NSString *)toNodeName;
+// destinations ordered by walking distance, each a dictionary of name, distance and eta in seconds,
+// the distances are cached until the location moves to another edge and then reused for the path
+- (NSArray *)getDestinationsSortedByDistanceFromCurrentLocation:(NavLocation *)curLocation;
+
+// objects of NavGraph indices, see NavNode.graphIndex and NavEdge.graphIndex
+- (NavNode *)nodeAtGraphIndex:(int)index;
+- (NavEdge *)edgeAtGraphIndex:(int)index;
+#ifdef __cplusplus
+- (std::shared_ptr<const NavGraph>)graph;
+#endif
 
 @end
 
@@ -30,6 +30,16 @@
 #import "NavUtil.h"
 #import "NavI18nUtil.h"
 #import "NavLineSegment.h"
+#import "NavRouter.hpp"
+#import "NavContractionHierarchy.hpp"
+
+#define HIERARCHY_CHECK_NUM 100
+
+// distances from both ends of an edge to every destination
+struct NavDestinationTrees {
+    int edge;
+    NavRouteTree tree1, tree2; // from node1 and node2 of the edge
+};
 
 @interface TopoMap ()
 
@@ -38,9 +48,14 @@
 @property (strong, nonatomic) NSMutableDictionary *nodeNameLayerIDDict;
 @property (strong, nonatomic) NSString *uuidString;
 @property (strong, nonatomic) NSString *majoridString;
-@property (strong, nonatomic) NavNode *tmpNode;
-@property (strong, nonatomic) NavLayer *tmpNodeParentLayer;
-@property (strong, nonatomic) NavEdge *tmpNodeParentEdge;
+@property (strong, nonatomic) NSMutableArray *graphNodes; // graph index -> NavNode
+@property (strong, nonatomic) NSMutableArray *graphEdges; // graph index -> NavEdge
+@property (nonatomic) std::shared_ptr<const NavGraph> graph;
+@property (nonatomic) std::shared_ptr<NavRouter> router;
+@property (nonatomic) std::shared_ptr<const NavContractionHierarchy> hierarchy; // guarded by self
+@property (strong, nonatomic) NSMutableDictionary *graphNodesOfName; // name -> graph indices of the nodes
+@property (nonatomic) std::vector<int> graphDestinations; // graph indices of NODE_TYPE_DESTINATION nodes
+@property (nonatomic) std::shared_ptr<const NavDestinationTrees> destinationTrees; // guarded by self
 
 @end
 
@@ -48,6 +63,7 @@
 
 double TopoMapUnit = 1.0;  // 1 = 1 foot
 static const double FEET_IN_METER = 0.3048;
+static const double WALKING_FEET_PER_SECOND = 1.0 / FEET_IN_METER; // for ETAs, 1 m/s
 
 
 + (double)unit2feet:(double)value
@@ -84,7 +100,6 @@ static const double FEET_IN_METER = 0.3048;
         _layers = [[NSMutableDictionary alloc] init];
         _nodeNameNodeIDDict = [[NSMutableDictionary alloc] init];
         _nodeNameLayerIDDict = [[NSMutableDictionary alloc] init];
-        _tmpNode = nil;
     }
     return self;
 }
@@ -215,8 +230,7 @@ static const double FEET_IN_METER = 0.3048;
             NSMutableDictionary *temp = [edgeJson mutableCopy];
             temp[@"beacons"] = layerJson[@"beacons"]; // for 1D PDR
             if (!idStr || !advanced) {
-                NSString *path = [NavUtil createTempFile:[edgeJson objectForKey:@"dataFile"] forID:&idStr];
-                [NavLocalizerFactory create1D_KNN_LocalizerForID:idStr FromFile:path];
+                [NavLocalizerFactory create1D_KNN_LocalizerForID:&idStr FromData:[edgeJson objectForKey:@"dataFile"]];
             }else{ // for localizers with PDR
                 edge.minKnnDist = 0;
                 edge.maxKnnDist = 1;                
@@ -248,160 +262,194 @@ static const double FEET_IN_METER = 0.3048;
         
         [_layers setObject:layer forKey:layer.zIndex];
     }
+    [self buildGraph];
     NSMutableDictionary *temp = mapDataJson[@"layers"];
     //temp[@"localizations"] = nil;
     //return [[NSString alloc] initWithData:jsonData encoding:NSUTF8StringEncoding];
     return [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:temp options:0 error:nil] encoding:NSUTF8StringEncoding];
 }
 
-- (NSArray *)findShortestPathFromCurrentLocation:(NavLocation *)curLocation toNodeWithName:(NSString *)toNodeName{
-    NavEdge *curEdge = [self getEdgeFromLayer:curLocation.layerID withEdgeID:curLocation.edgeID];
-    NavLayer *curLayer = [_layers objectForKey:curLocation.layerID];
-    
-    // if your current location reach one of the ends of current edge
-    // then just do the same, not touching the topo map
-    if ([curEdge checkValidEndNodeAtLocation:curLocation] != nil) {
-        NavNode *node = [curEdge checkValidEndNodeAtLocation:curLocation];
-        return [self findShortestPathFromNode:node toNodeWithName:toNodeName];
-    } else {
-        // use a tmp node to split the edge into two
-        NavNode *tmpNode = [[NavNode alloc] init];
-        _tmpNode = tmpNode;
-        _tmpNodeParentLayer = curLayer;
-        _tmpNodeParentEdge = curEdge;
-        tmpNode.nodeID = @"tmp_node";
-        tmpNode.type = NODE_TYPE_NORMAL;
-        tmpNode.layerZIndex = curLocation.layerID;
-        tmpNode.buildingName = curEdge.node1.buildingName;
-        tmpNode.floor = curEdge.node1.floor;
-        
-        double slat = curEdge.node1.lat;
-        double slng = curEdge.node1.lng;
-        double tlat = curEdge.node2.lat;
-        double tlng = curEdge.node2.lng;
-
-        double sx = [curEdge.node1 getXInEdgeWithID:curEdge.edgeID];
-        double sy = [curEdge.node1 getYInEdgeWithID:curEdge.edgeID];
-        double tx = [curEdge.node2 getXInEdgeWithID:curEdge.edgeID];
-        double ty = [curEdge.node2 getYInEdgeWithID:curEdge.edgeID];
-        
-        double ax = tx-sx;
-        double ay = ty-sy;
-        double bx = curLocation.xInEdge - sx;
-        double by = curLocation.yInEdge - sy;
-        
-        double alen = sqrt(ax*ax+ay*ay);
-        double ratio = (ax*bx+ay*by)/alen/alen;
-        ratio = fmin(1, fmax(0, ratio));
-        
-        //double ratio = (curLocation.yInEdge - sy) / (ty - sy);
-        //ratio = ratio < 0 ? 0 : ratio;
-        //ratio = ratio > 1 ? 1 : ratio;
-        
-        //tmpNode.lat = slat + ratio * (tlat - slat);
-        //tmpNode.lng = slng + ratio * (tlng - slng);
-        tmpNode.lat = curLocation.lat;
-        tmpNode.lng = curLocation.lng;
-        tmpNode.parentLayer = curLayer;
-        
-        // the dynamic topo map looks lik this
-        //          tmp edge 1              tmp edge 2
-        // (node1)--------------(tmp node)--------------(node2)
-        //      \_________________________________________/
-        //                   current edge
-        // new two edges
-        NavEdge *tmpEdge1 = [curEdge clone];
-        tmpEdge1.edgeID = @"tmp_edge_1";
-        tmpEdge1.node2 = tmpNode;
-        tmpEdge1.nodeID2 = tmpNode.nodeID;
-        tmpEdge1.len = [curLocation distanceToNode:curEdge.node1];
-        tmpEdge1.path = [curLocation pathFromNode:curEdge.node1];
-        if (tmpEdge1.path) {
-            tmpEdge1.ori1 = [tmpEdge1.path[0][@"forward"] floatValue];
-            tmpEdge1.ori2 = [tmpEdge1.path[tmpEdge1.path.count-1][@"backward"] floatValue];
+// indexes the loaded layers into a NavGraph, the neighbor order of each node
+// is kept and only enabled transits become arcs
+- (void)buildGraph {
+    NSDate *start = [NSDate date];
+    NavGraphBuilder builder;
+    _graphNodes = [@[] mutableCopy];
+    _graphEdges = [@[] mutableCopy];
+    _graphNodesOfName = [@{} mutableCopy];
+    _graphDestinations.clear();
+    _destinationTrees.reset();
+    NSArray *layerIDs = [[_layers allKeys] sortedArrayUsingSelector:@selector(compare:)];
+    for (int l = 0; l < layerIDs.count; l++) {
+        NavLayer *layer = _layers[layerIDs[l]];
+        for (NSString *nodeID in [[layer.nodes allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+            NavNode *node = layer.nodes[nodeID];
+            node.graphIndex = builder.addNode(l, node.floor, node.type, node.lat, node.lng);
+            [_graphNodes addObject:node];
+            if (node.name != nil) {
+                NSMutableArray *indices = _graphNodesOfName[node.name];
+                if (indices == nil) {
+                    indices = [@[] mutableCopy];
+                    _graphNodesOfName[node.name] = indices;
+                }
+                [indices addObject:@(node.graphIndex)];
+            }
+            if (node.type == NODE_TYPE_DESTINATION) {
+                _graphDestinations.push_back(node.graphIndex);
+            }
+        }
+    }
+    for (NSString *layerID in layerIDs) {
+        NavLayer *layer = _layers[layerID];
+        for (NSString *edgeID in [[layer.edges allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+            NavEdge *edge = layer.edges[edgeID];
+            if (edge.node1 == nil || edge.node2 == nil) {
+                continue;
+            }
+            edge.graphIndex = builder.addEdge(edge.node1.graphIndex, edge.node2.graphIndex, edge.len);
+            [_graphEdges addObject:edge];
         }
-        //tmpEdge1.len = sqrt(pow(curLocation.yInEdge - sy,2)+pow(curLocation.xInEdge - sx,2));
-        NavEdge *tmpEdge2 = [curEdge clone];
-        tmpEdge2.edgeID = @"tmp_edge_2";
-        tmpEdge2.node1 = tmpNode;
-        tmpEdge2.nodeID1 = tmpNode.nodeID;
-        tmpEdge2.len = [curLocation distanceToNode:curEdge.node2];
-        tmpEdge2.path = [curLocation pathToNode:curEdge.node2];
-        if (tmpEdge2.path) {
-            tmpEdge2.ori1 = [tmpEdge2.path[0][@"forward"] floatValue];
-            tmpEdge2.ori2 = [tmpEdge2.path[tmpEdge2.path.count-1][@"backward"] floatValue];
+    }
+    for (NavNode *node in _graphNodes) {
+        for (NavNeighbor *neighbor in node.neighbors) {
+            if (neighbor.node != nil && neighbor.edge.graphIndex >= 0) {
+                builder.addArc(node.graphIndex, neighbor.node.graphIndex, neighbor.edge.graphIndex, neighbor.edge.len);
+            }
         }
-        //tmpEdge2.len = sqrt(pow(curLocation.yInEdge - ty,2)+pow(curLocation.xInEdge - tx,2));
-        
-        // add info from edges to tmp node
-        NSDictionary *infoDict = [self getNodeInfoDictFromEdgeWithID:tmpEdge1.edgeID andXInEdge:curLocation.xInEdge andYInEdge:curLocation.yInEdge];
-        [tmpNode.infoFromEdges setObject:infoDict forKey:tmpEdge1.edgeID];
-        infoDict = [self getNodeInfoDictFromEdgeWithID:tmpEdge2.edgeID andXInEdge:curLocation.xInEdge andYInEdge:curLocation.yInEdge];
-        [tmpNode.infoFromEdges setObject:infoDict forKey:tmpEdge2.edgeID];
-        
-        // add neighbor information
-        NavNeighbor *nb = [[NavNeighbor alloc] init];
-        nb.edge = tmpEdge1;
-        nb.node = curEdge.node1;
-        [tmpNode.neighbors addObject:nb];
-        nb = [[NavNeighbor alloc] init];
-        nb.edge = tmpEdge2;
-        nb.node = curEdge.node2;
-        [tmpNode.neighbors addObject:nb];
-        
-        // add neighbor information to node1 and node2 of curEdge
-        nb = [[NavNeighbor alloc] init];
-        nb.edge = tmpEdge1;
-        nb.node = tmpNode;
-        [curEdge.node1.neighbors addObject:nb];
-        nb = [[NavNeighbor alloc] init];
-        nb.edge = tmpEdge2;
-        nb.node = tmpNode;
-        
-        [tmpEdge1.node1.infoFromEdges setObject:[tmpEdge1.node1.infoFromEdges objectForKey:curEdge.edgeID] forKey:tmpEdge1.edgeID];
-        [tmpEdge2.node2.infoFromEdges setObject:[tmpEdge2.node2.infoFromEdges objectForKey:curEdge.edgeID] forKey:tmpEdge2.edgeID];
-        
-        // copy edge localization for temp edges
-        NavLightEdge* edgeInfo1 = [[NavLightEdge alloc] initWithEdge:tmpEdge1];
-        [[NavLightEdgeHolder sharedInstance] appendNavLightEdge:edgeInfo1];
-        NavEdgeLocalizer *nl1 = [NavLocalizerFactory cloneLocalizerForEdge:curEdge.edgeID withEdgeInfo:edgeInfo1];
+        for (NSString *layerID in node.transitInfo) {
+            NSDictionary *transitJson = [node.transitInfo objectForKey:layerID];
+            if (((NSNumber *)[transitJson objectForKey:@"enabled"]).boolValue) {
+                NavNode *nbNode = [self getNodeWithID:[transitJson objectForKey:@"node"] fromLayerWithID:layerID];
+                if (nbNode != nil) {
+                    builder.addArc(node.graphIndex, nbNode.graphIndex, -1, 0);
+                }
+            }
+        }
+    }
+    std::shared_ptr<const NavGraph> graph = builder.build();
+    @synchronized (self) {
+        _graph = graph;
+        _hierarchy.reset();
+    }
+    _router = std::make_shared<NavRouter>(_graph);
+    NSLog(@"TopoGraph,%d,%d,%d,%d,%f", _graph->nodeNum(), _graph->edgeNum(), _graph->arcNum(), _graph->transitNum(),
+          [[NSDate date] timeIntervalSinceDate:start] * 1000);
+    if ([[NSUserDefaults standardUserDefaults] boolForKey:@"contraction_hierarchy_preference"]) {
+        [self buildHierarchy];
+    }
+}
 
-        NavLightEdge* edgeInfo2 = [[NavLightEdge alloc] initWithEdge:tmpEdge2];
-        [[NavLightEdgeHolder sharedInstance] appendNavLightEdge:edgeInfo2];
-        NavEdgeLocalizer *nl2 = [NavLocalizerFactory cloneLocalizerForEdge:curEdge.edgeID withEdgeInfo:edgeInfo2];
+// preprocessing takes about a second for a large campus, routes use A* until
+// the hierarchy is ready
+- (void)buildHierarchy {
+    std::shared_ptr<const NavGraph> graph = _graph;
+    std::shared_ptr<NavRouter> router = _router;
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        NSDate *start = [NSDate date];
+        std::shared_ptr<const NavContractionHierarchy> hierarchy = std::make_shared<NavContractionHierarchy>(graph);
+        NSLog(@"TopoCH,%d,%d,%d,%f", graph->nodeNum(), hierarchy->shortcutNum(), hierarchy->arcNum(),
+              [[NSDate date] timeIntervalSinceDate:start] * 1000);
+        if ([[NSUserDefaults standardUserDefaults] boolForKey:@"devmode_preference"] && graph->nodeNum() > 0) {
+            int mismatchNum = 0;
+            for (int i = 0; i < HIERARCHY_CHECK_NUM; i++) {
+                NavRouteEndpoint source = {(int)arc4random_uniform(graph->nodeNum()), 0};
+                NavRouteEndpoint target = {(int)arc4random_uniform(graph->nodeNum()), 0};
+                NavRoute expected, route;
+                bool found = router->route(&source, 1, &target, 1, NavRouter::Dijkstra, expected);
+                if (hierarchy->route(&source, 1, &target, 1, route) != found || (found && route.length != expected.length)) {
+                    mismatchNum++;
+                }
+            }
+            NSLog(@"TopoCHCheck,%d,%d", HIERARCHY_CHECK_NUM, mismatchNum);
+        }
+        @synchronized (self) {
+            if (_graph == graph) {
+                _hierarchy = hierarchy;
+            }
+        }
+    });
+}
 
+- (NavNode *)nodeAtGraphIndex:(int)index {
+    return index >= 0 && index < _graphNodes.count ? _graphNodes[index] : nil;
+}
 
-        
-        // add info from tmp edges for node1 and node2
-        infoDict = [self getNodeInfoDictFromEdgeWithID:tmpEdge1.edgeID andXInEdge:[curEdge.node1 getXInEdgeWithID:curEdge.edgeID] andYInEdge:[curEdge.node1 getYInEdgeWithID:curEdge.edgeID]];
-        [curEdge.node1.infoFromEdges setObject:infoDict forKey:tmpEdge1.edgeID];
-        infoDict = [self getNodeInfoDictFromEdgeWithID:tmpEdge2.edgeID andXInEdge:[curEdge.node2 getXInEdgeWithID:curEdge.edgeID] andYInEdge:[curEdge.node2 getYInEdgeWithID:curEdge.edgeID]];
-        [curEdge.node2.infoFromEdges setObject:infoDict forKey:tmpEdge2.edgeID];
-        
-        [curLayer.nodes setObject:tmpNode forKey:tmpNode.nodeID];
-        [curLayer.edges setObject:tmpEdge1 forKey:tmpEdge1.edgeID];
-        [curLayer.edges setObject:tmpEdge2 forKey:tmpEdge2.edgeID];
-        return [self findShortestPathFromNode:tmpNode toNodeWithName:toNodeName];
-    }
+- (NavEdge *)edgeAtGraphIndex:(int)index {
+    return index >= 0 && index < _graphEdges.count ? _graphEdges[index] : nil;
 }
 
-- (void)cleanTmpNodeAndEdges {
-    [NavLog stopLog];
-    [_tmpNodeParentLayer.nodes removeObjectForKey:@"tmp_node"];
-    [_tmpNodeParentLayer.edges removeObjectForKey:@"tmp_edge_1"];
-    [_tmpNodeParentLayer.edges removeObjectForKey:@"tmp_edge_2"];
-    [_tmpNodeParentEdge.node1.infoFromEdges removeObjectForKey:@"tmp_edge_1"];
-    [_tmpNodeParentEdge.node2.infoFromEdges removeObjectForKey:@"tmp_edge_2"];
-    for (NavNeighbor *nb in _tmpNodeParentEdge.node1.neighbors) {
-        if ([nb.node.nodeID isEqualToString:@"tmp_node"]) {
-            [_tmpNodeParentEdge.node1.neighbors removeLastObject];
-        }
+- (NavPath *)findShortestPathFromCurrentLocation:(NavLocation *)curLocation toNodeWithName:(NSString *)toNodeName{
+    NavEdge *curEdge = [self getEdgeFromLayer:curLocation.layerID withEdgeID:curLocation.edgeID];
+    if (curEdge == nil || curEdge.graphIndex < 0) {
+        return nil;
     }
-    for (NavNeighbor *nb in _tmpNodeParentEdge.node2.neighbors) {
-        if ([nb.node.nodeID isEqualToString:@"tmp_node"]) {
-            [_tmpNodeParentEdge.node2.neighbors removeLastObject];
+    NavRoute route;
+    
+    // if your current location reach one of the ends of current edge
+    // then just start from that node
+    NavNode *endNode = [curEdge checkValidEndNodeAtLocation:curLocation];
+    if (endNode != nil) {
+        std::vector<NavRouteEndpoint> sources = {{endNode.graphIndex, 0}};
+        if (![self routeFromSources:sources onEdge:curEdge toNodeWithName:toNodeName route:route]) {
+            return nil;
         }
+        return [self pathFromStartNode:endNode firstEdge:nil withRoute:route];
     }
+    
+    // otherwise start from both ends of the edge with the walk to each as the
+    // cost, the current location and the part of the edge walked first exist
+    // only in the returned path, nothing is added to the map
+    //
+    //          part to node1            part to node2
+    // (node1)--------------(location)--------------(node2)
+    //      \_________________________________________/
+    //                   current edge
+    std::vector<NavRouteEndpoint> sources(2);
+    NavRouter::edgeEndpoints(*_graph, curEdge.graphIndex, (int)round([curLocation distanceToNode:curEdge.node1]), sources.data());
+    if (![self routeFromSources:sources onEdge:curEdge toNodeWithName:toNodeName route:route]) {
+        return nil;
+    }
+    NavNode *startNode = [self nodeAtLocation:curLocation onEdge:curEdge];
+    NavEdge *firstEdge = [self partOfEdge:curEdge fromLocation:curLocation atNode:startNode toNode:[_graphNodes objectAtIndex:route.nodes[0]]];
+    return [self pathFromStartNode:startNode firstEdge:firstEdge withRoute:route];
+}
+
+// a node at the location for the start of a path, it is not in the map and
+// only knows its position in the current edge
+- (NavNode *)nodeAtLocation:(NavLocation *)curLocation onEdge:(NavEdge *)curEdge {
+    NavNode *node = [[NavNode alloc] init];
+    node.nodeID = @"current_location";
+    node.type = NODE_TYPE_NORMAL;
+    node.layerZIndex = curLocation.layerID;
+    node.buildingName = curEdge.node1.buildingName;
+    node.floor = curEdge.node1.floor;
+    node.lat = curLocation.lat;
+    node.lng = curLocation.lng;
+    node.parentLayer = curEdge.parentLayer;
+    [node.infoFromEdges setObject:[self getNodeInfoDictFromEdgeWithID:curEdge.edgeID andXInEdge:curLocation.xInEdge andYInEdge:curLocation.yInEdge] forKey:curEdge.edgeID];
+    return node;
+}
+
+// the part of the edge between the location and one of its ends, it keeps the
+// ID of the edge so that the edge's localizer and node infos serve it as well
+- (NavEdge *)partOfEdge:(NavEdge *)curEdge fromLocation:(NavLocation *)curLocation atNode:(NavNode *)locationNode toNode:(NavNode *)node {
+    NavEdge *part = [curEdge clone];
+    if (node == curEdge.node1) {
+        part.node2 = locationNode;
+        part.nodeID2 = locationNode.nodeID;
+        part.len = [curLocation distanceToNode:curEdge.node1];
+        part.path = [curLocation pathFromNode:curEdge.node1];
+    } else {
+        part.node1 = locationNode;
+        part.nodeID1 = locationNode.nodeID;
+        part.len = [curLocation distanceToNode:curEdge.node2];
+        part.path = [curLocation pathToNode:curEdge.node2];
+    }
+    if (part.path) {
+        part.ori1 = [part.path[0][@"forward"] floatValue];
+        part.ori2 = [part.path[part.path.count-1][@"backward"] floatValue];
+    }
+    return part;
 }
 
 - (NSDictionary *)getNodeInfoDictFromEdgeWithID:(NSString *)edgeID andXInEdge:(double)x andYInEdge:(double)y {
@@ -435,180 +483,196 @@ static const double FEET_IN_METER = 0.3048;
     return a;
 }
 
-// search a shortest path
-- (NSArray *)findShortestPathFromNode:(NavNode *)startNode toNodeWithName:(NSString *)toName {
-    // get start node and end node of the path
-    NavNode *endNode = [self getNodeWithID:[_nodeNameNodeIDDict objectForKey:toName] fromLayerWithID:[_nodeNameLayerIDDict objectForKey:toName]];
-    if (startNode == nil || endNode == nil) {
+// search a shortest path to any node named toName
+- (NavPath *)findShortestPathFromNode:(NavNode *)startNode toNodeWithName:(NSString *)toName {
+    if (startNode == nil || startNode.graphIndex < 0) {
         return nil;
     }
-    
-    // visited nodes and nodes have been reachable from start node
-    NSMutableSet *visitedNodes = [[NSMutableSet alloc] init];
-    NSMutableSet *reachableNodes = [[NSMutableSet alloc] init];
-    
-    // initialize the Min-Heap, maximum size is number of nodes
-    NavMinHeap *heap = [[NavMinHeap alloc] init];
-    [heap initHeapWithSize:(int)[[_nodeNameNodeIDDict allKeys] count]];
-    
-    // initial the search from start node, start the search from start node's neighbors
-    startNode.distFromStartNode = 0;
-    startNode.preNodeInPath = nil;
-    [reachableNodes addObject:startNode];
-    [heap offer:startNode];
-    
-    // search for end node, O((N+E)*log(N)), N is total number of nodes, E is total number of edges
-    while ([heap getSize] > 0) {
-        NavNode *node = [heap poll];
-        [visitedNodes addObject:node];
-        [reachableNodes removeObject:node];
-        for (NavNeighbor *neighbor in node.neighbors) {
-            NavNode *nbNode = neighbor.node;
-            if ([visitedNodes containsObject:nbNode]) {
-                continue;
-            }
-            if ([reachableNodes containsObject:nbNode]) { // if the node has been reached
-                int newDist = node.distFromStartNode + neighbor.edge.len;
-                if (newDist < nbNode.distFromStartNode) { // sift up the node if its distance is less than before
-                    nbNode.preNodeInPath = node;
-                    nbNode.preEdgeInPath = neighbor.edge;
-                    [heap siftAndUpdateNode:nbNode withNewDist:newDist]; // nbNode.distFromStartNode will be updated to newDist
-                }
-            } else {
-                nbNode.distFromStartNode = node.distFromStartNode + neighbor.edge.len;
-                nbNode.preNodeInPath = node;
-                nbNode.preEdgeInPath = neighbor.edge;
-                if ([nbNode.name isEqualToString:endNode.name]) {
-                    return [self traceBackForPathFromNode:nbNode];
-                }
-                [heap offer:nbNode];
-                [reachableNodes addObject:nbNode];
-            }
+    std::vector<NavRouteEndpoint> sources = {{startNode.graphIndex, 0}};
+    NavRoute route;
+    if (![self routeFromSources:sources onEdge:nil toNodeWithName:toName route:route]) {
+        return nil;
+    }
+    return [self pathFromStartNode:startNode firstEdge:nil withRoute:route];
+}
+
+// graph route from the sources to any node named toName, out of the
+// destination trees if they were built for the edge and reach such a node,
+// else with the contraction hierarchy once it is ready or A*
+- (BOOL)routeFromSources:(const std::vector<NavRouteEndpoint> &)sources onEdge:(NavEdge *)edge toNodeWithName:(NSString *)toName
+                   route:(NavRoute &)route {
+    NSArray *targetIndices = [_graphNodesOfName objectForKey:toName];
+    if (targetIndices == nil || sources.empty() || !_router) {
+        return NO;
+    }
+    std::shared_ptr<const NavDestinationTrees> trees;
+    std::shared_ptr<const NavContractionHierarchy> hierarchy;
+    @synchronized (self) {
+        trees = _destinationTrees;
+        hierarchy = _hierarchy;
+    }
+    if (edge != nil && [self routeAlongEdge:edge fromSources:sources toNodes:targetIndices route:route]) {
+        return YES;
+    }
+    if (edge != nil && trees && trees->edge == edge.graphIndex &&
+        [self findPathInDestinationTrees:*trees fromSources:sources toNodes:targetIndices route:route]) {
+        return YES;
+    }
+    NSDate *start = [NSDate date];
+    std::vector<NavRouteEndpoint> targets;
+    for (NSNumber *index in targetIndices) {
+        targets.push_back({index.intValue, 0});
+    }
+    if (hierarchy) {
+        if (!hierarchy->route(sources.data(), (int)sources.size(), targets.data(), (int)targets.size(), route)) {
+            return NO;
         }
-        
-        for (NSString *layerID in node.transitInfo) {
-            NSDictionary *transitJson = [node.transitInfo objectForKey:layerID];
-            Boolean transitEnabled = ((NSNumber *)[transitJson objectForKey:@"enabled"]).boolValue;
-            if (transitEnabled) {
-                NavNode *nbNode = [self getNodeWithID:[transitJson objectForKey:@"node"] fromLayerWithID:layerID];
-                if (![visitedNodes containsObject:nbNode]) {
-                    if ([reachableNodes containsObject:nbNode]) { // if the node has been reached
-                        int newDist = node.distFromStartNode;
-                        if (newDist < nbNode.distFromStartNode) { // sift up the node if its distance is less than before
-                            nbNode.preNodeInPath = node;
-                            nbNode.preEdgeInPath = nil;
-                            [heap siftAndUpdateNode:nbNode withNewDist:newDist]; // nbNode.distFromStartNode will be updated to newDist
-                        }
-                    } else {
-                        nbNode.distFromStartNode = node.distFromStartNode;
-                        nbNode.preNodeInPath = node;
-                        nbNode.preEdgeInPath = nil;
-                        if ([nbNode.name isEqualToString:endNode.name]) {
-                            return [self traceBackForPathFromNode:nbNode];
-                        }
-                        [heap offer:nbNode];
-                        [reachableNodes addObject:nbNode];
-                    }
-                }
-            }
+    } else if (!_router->route(sources.data(), (int)sources.size(), targets.data(), (int)targets.size(), NavRouter::AStar, route)) {
+        return NO;
+    }
+    NSLog(@"RouteSearch,%d,%d,%d,%f", (int)route.nodes.size(), route.settledNum, route.length,
+          [[NSDate date] timeIntervalSinceDate:start] * 1000);
+    return YES;
+}
+
+// a target at an end of the edge is reached by walking the edge when no
+// route through the other end can be shorter, see NavRouter::edgeWalk
+- (BOOL)routeAlongEdge:(NavEdge *)edge fromSources:(const std::vector<NavRouteEndpoint> &)sources toNodes:(NSArray *)targetIndices
+                 route:(NavRoute &)route {
+    if (sources.size() != 2 || sources[0].node != edge.node1.graphIndex || sources[1].node != edge.node2.graphIndex) {
+        return NO;
+    }
+    int offset = sources[0].cost;
+    for (int i = 0; i < 2; i++) {
+        int end = i == 0 ? 0 : sources[0].cost + sources[1].cost;
+        if ([targetIndices containsObject:@(sources[i].node)] &&
+            NavRouter::edgeWalk(*_graph, edge.graphIndex, offset, end, route)) {
+            route.nodes.assign(1, sources[i].node);
+            route.edges.assign(1, -1);
+            return YES;
         }
     }
-    
-    return nil;
+    return NO;
 }
 
-// search a shortest path
-- (NSArray *)findShortestPathFromNodeWithName:(NSString *)fromName toNodeWithName:(NSString *)toName {
-    // get start node and end node of the path
-    NavNode *startNode = [self getNodeWithID:[_nodeNameNodeIDDict objectForKey:fromName] fromLayerWithID:[_nodeNameLayerIDDict objectForKey:fromName]];
-    NavNode *endNode = [self getNodeWithID:[_nodeNameNodeIDDict objectForKey:toName] fromLayerWithID:[_nodeNameLayerIDDict objectForKey:toName]];
-    if (startNode == nil || endNode == nil) {
+// the route as the state machine walks it, from the end back to the start.
+// A start node out of the graph comes last, with firstEdge from it to the
+// first node of the route.
+- (NavPath *)pathFromStartNode:(NavNode *)startNode firstEdge:(NavEdge *)firstEdge withRoute:(const NavRoute &)route {
+    NSMutableArray *nodes = [[NSMutableArray alloc] init];
+    NSMutableArray *edges = [[NSMutableArray alloc] init];
+    if (firstEdge != nil) {
+        [nodes addObject:startNode];
+        [edges addObject:[NSNull null]];
+    }
+    for (size_t i = 0; i < route.nodes.size(); i++) {
+        NavEdge *edge = i == 0 ? firstEdge : [self edgeAtGraphIndex:route.edges[i]];
+        [nodes insertObject:[_graphNodes objectAtIndex:route.nodes[i]] atIndex:0];
+        [edges insertObject:edge ? edge : [NSNull null] atIndex:0];
+    }
+    return [[NavPath alloc] initWithNodes:nodes edges:edges length:route.length];
+}
+
+// distances from both ends of the edge to every destination, kept until
+// another edge is asked for
+- (std::shared_ptr<const NavDestinationTrees>)destinationTreesForEdge:(NavEdge *)edge {
+    if (edge == nil || edge.graphIndex < 0 || !_router) {
+        return nullptr;
+    }
+    @synchronized (self) {
+        if (_destinationTrees && _destinationTrees->edge == edge.graphIndex) {
+            return _destinationTrees;
+        }
+    }
+    NSDate *start = [NSDate date];
+    std::shared_ptr<NavDestinationTrees> trees = std::make_shared<NavDestinationTrees>();
+    trees->edge = edge.graphIndex;
+    NavRouteEndpoint source1 = {edge.node1.graphIndex, 0}, source2 = {edge.node2.graphIndex, 0};
+    _router->tree(&source1, 1, _graphDestinations.data(), (int)_graphDestinations.size(), trees->tree1);
+    _router->tree(&source2, 1, _graphDestinations.data(), (int)_graphDestinations.size(), trees->tree2);
+    @synchronized (self) {
+        _destinationTrees = trees;
+    }
+    NSLog(@"DestinationTree,%@,%d,%d,%f", edge.edgeID, (int)_graphDestinations.size(),
+          trees->tree1.settledNum() + trees->tree2.settledNum(), [[NSDate date] timeIntervalSinceDate:start] * 1000);
+    return trees;
+}
+
+- (NSArray *)getDestinationsSortedByDistanceFromCurrentLocation:(NavLocation *)curLocation {
+    NavEdge *curEdge = [self getEdgeFromLayer:curLocation.layerID withEdgeID:curLocation.edgeID];
+    std::shared_ptr<const NavDestinationTrees> trees = [self destinationTreesForEdge:curEdge];
+    if (!trees) {
         return nil;
     }
+    double cost1 = [curLocation distanceToNode:curEdge.node1];
+    double cost2 = [curLocation distanceToNode:curEdge.node2];
     
-    // visited nodes and nodes have been reachable from start node
-    NSMutableSet *visitedNodes = [[NSMutableSet alloc] init];
-    NSMutableSet *reachableNodes = [[NSMutableSet alloc] init];
-    
-    // initialize the Min-Heap, maximum size is number of nodes
-    NavMinHeap *heap = [[NavMinHeap alloc] init];
-    [heap initHeapWithSize:(int)[[_nodeNameNodeIDDict allKeys] count]];
-    
-    // initial the search from start node, start the search from start node's neighbors
-    startNode.distFromStartNode = 0;
-    startNode.preNodeInPath = nil;
-    [reachableNodes addObject:startNode];
-    [heap offer:startNode];
-    
-    // search for end node, O((N+E)*log(N)), N is total number of nodes, E is total number of edges
-    while ([heap getSize] > 0) {
-        NavNode *node = [heap poll];
-        [visitedNodes addObject:node];
-        [reachableNodes removeObject:node];
-        for (NavNeighbor *neighbor in node.neighbors) {
-            NavNode *nbNode = neighbor.node;
-            if ([visitedNodes containsObject:nbNode]) {
-                continue;
-            }
-            if ([reachableNodes containsObject:nbNode]) { // if the node has been reached
-                int newDist = node.distFromStartNode + neighbor.edge.len;
-                if (newDist < nbNode.distFromStartNode) { // sift up the node if its distance is less than before
-                    nbNode.preNodeInPath = node;
-                    nbNode.preEdgeInPath = neighbor.edge;
-                    [heap siftAndUpdateNode:nbNode withNewDist:newDist]; // nbNode.distFromStartNode will be updated to newDist
-                }
-            } else {
-                nbNode.distFromStartNode = node.distFromStartNode + neighbor.edge.len;
-                nbNode.preNodeInPath = node;
-                nbNode.preEdgeInPath = neighbor.edge;
-                if ([nbNode.name isEqualToString:endNode.name]) {
-                    return [self traceBackForPathFromNode:nbNode];
-                }
-                [heap offer:nbNode];
-                [reachableNodes addObject:nbNode];
-            }
+    // nodes sharing a name are one destination at the nearest of them
+    NSMutableDictionary *distances = [[NSMutableDictionary alloc] init];
+    for (int index : _graphDestinations) {
+        double dist = DBL_MAX;
+        if (trees->tree1.reached(index)) {
+            dist = fmin(dist, cost1 + trees->tree1.distance(index));
         }
-        
-        for (NSString *layerID in node.transitInfo) {
-            NSDictionary *transitJson = [node.transitInfo objectForKey:layerID];
-            Boolean transitEnabled = ((NSNumber *)[transitJson objectForKey:@"enabled"]).boolValue;
-            if (transitEnabled) {
-                NavNode *nbNode = [self getNodeWithID:[transitJson objectForKey:@"node"] fromLayerWithID:layerID];
-                if (![visitedNodes containsObject:nbNode]) {
-                    if ([reachableNodes containsObject:nbNode]) { // if the node has been reached
-                        int newDist = node.distFromStartNode;
-                        if (newDist < nbNode.distFromStartNode) { // sift up the node if its distance is less than before
-                            nbNode.preNodeInPath = node;
-                            nbNode.preEdgeInPath = nil;
-                            [heap siftAndUpdateNode:nbNode withNewDist:newDist]; // nbNode.distFromStartNode will be updated to newDist
-                        }
-                    } else {
-                        nbNode.distFromStartNode = node.distFromStartNode;
-                        nbNode.preNodeInPath = node;
-                        nbNode.preEdgeInPath = nil;
-                        if ([nbNode.name isEqualToString:endNode.name]) {
-                            return [self traceBackForPathFromNode:nbNode];
-                        }
-                        [heap offer:nbNode];
-                        [reachableNodes addObject:nbNode];
-                    }
-                }
-            }
+        if (trees->tree2.reached(index)) {
+            dist = fmin(dist, cost2 + trees->tree2.distance(index));
+        }
+        NSString *name = ((NavNode *)[_graphNodes objectAtIndex:index]).name;
+        if (dist == DBL_MAX || name == nil) {
+            continue;
+        }
+        NSNumber *pre = distances[name];
+        if (pre == nil || dist < pre.doubleValue) {
+            distances[name] = @(dist);
         }
     }
-    
-    return nil;
+    NSArray *names = [[distances allKeys] sortedArrayUsingComparator:^NSComparisonResult(NSString *name1, NSString *name2) {
+        NSComparisonResult result = [distances[name1] compare:distances[name2]];
+        return result != NSOrderedSame ? result : [name1 compare:name2];
+    }];
+    NSMutableArray *destinations = [[NSMutableArray alloc] init];
+    for (NSString *name in names) {
+        double dist = [distances[name] doubleValue];
+        [destinations addObject:@{@"name":name,
+                                  @"distance":@([TopoMap feet2unit:dist]),
+                                  @"eta":@(dist / WALKING_FEET_PER_SECOND)}];
+    }
+    return destinations;
 }
 
-- (NSArray *)traceBackForPathFromNode:(NavNode *)node {
-    NSMutableArray *pathNodes = [[NSMutableArray alloc] init];
-    [pathNodes addObject:node];
-    NavNode *preNode = node.preNodeInPath;
-    while (preNode != nil) {
-        [pathNodes addObject:preNode];
-        preNode = preNode.preNodeInPath;
+// path out of the destination trees in O(path length), the sources are ends
+// of the edge the trees were built for
+- (BOOL)findPathInDestinationTrees:(const NavDestinationTrees &)trees fromSources:(const std::vector<NavRouteEndpoint> &)sources
+                           toNodes:(NSArray *)targetIndices route:(NavRoute &)route {
+    const NavGraph &g = *_graph;
+    const NavRouteTree *bestTree = nullptr;
+    int bestIndex = -1;
+    long best = LONG_MAX;
+    for (const NavRouteEndpoint &source : sources) {
+        const NavRouteTree *tree = source.node == g.edgeNode1(trees.edge) ? &trees.tree1 :
+                                   source.node == g.edgeNode2(trees.edge) ? &trees.tree2 : nullptr;
+        if (tree == nullptr) {
+            return NO;
+        }
+        for (NSNumber *index in targetIndices) {
+            if (tree->reached(index.intValue) && source.cost + tree->distance(index.intValue) < best) {
+                best = source.cost + tree->distance(index.intValue);
+                bestTree = tree;
+                bestIndex = index.intValue;
+            }
+        }
+    }
+    if (bestTree == nullptr || !bestTree->path(bestIndex, route)) {
+        return NO;
     }
-    return pathNodes;
+    route.length = (int)best;
+    return YES;
+}
+
+// search a shortest path
+- (NavPath *)findShortestPathFromNodeWithName:(NSString *)fromName toNodeWithName:(NSString *)toName {
+    NavNode *startNode = [self getNodeWithID:[_nodeNameNodeIDDict objectForKey:fromName] fromLayerWithID:[_nodeNameLayerIDDict objectForKey:fromName]];
+    return [self findShortestPathFromNode:startNode toNodeWithName:toName];
 }
 
 - (NavNode *)getNodeWithID:(NSString *)nodeID fromLayerWithID:(NSString *)layerID {
@@ -0,0 +1,482 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavBinaryLog.hpp"
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <chrono>
+
+// how often the writer drains the rings
+#define WRITER_INTERVAL_MS 20
+
+class NavBinaryLog::Ring {
+public:
+    static const uint64_t kCapacity = 1024; // records, power of two
+
+    Ring() : mRecords(kCapacity), mHead(0), mTail(0), mOrphaned(false) {}
+
+    // producer side, all or nothing
+    bool push(const NavBinaryLogRecord* records, size_t n)
+    {
+        uint64_t head = mHead.load(std::memory_order_relaxed);
+        if (head + n - mTail.load(std::memory_order_acquire) > kCapacity) {
+            return false;
+        }
+        for (size_t i = 0; i < n; i++) {
+            mRecords[(head + i) & (kCapacity - 1)] = records[i];
+        }
+        mHead.store(head + n, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    size_t pop(std::vector<NavBinaryLogRecord>& out)
+    {
+        uint64_t tail = mTail.load(std::memory_order_relaxed);
+        uint64_t head = mHead.load(std::memory_order_acquire);
+        for (uint64_t i = tail; i < head; i++) {
+            out.push_back(mRecords[i & (kCapacity - 1)]);
+        }
+        mTail.store(head, std::memory_order_release);
+        return (size_t)(head - tail);
+    }
+
+    void clear()
+    {
+        mTail.store(mHead.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    // set when the owning thread exits
+    std::atomic<bool>& orphaned() { return mOrphaned; }
+
+private:
+    std::vector<NavBinaryLogRecord> mRecords;
+    // head and tail on separate cache lines
+    char mPad0[64];
+    std::atomic<uint64_t> mHead;
+    char mPad1[64];
+    std::atomic<uint64_t> mTail;
+    std::atomic<bool> mOrphaned;
+};
+
+namespace {
+
+// days since 1970-01-01 to a proleptic Gregorian date
+void civilFromDays(int64_t z, int& y, int& m, int& d)
+{
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    y = (int)(yoe + era * 400 + (m <= 2));
+}
+
+// "2016-03-01 10:20:30.000 NavCog[123:4567] Route,A,B" -> "Route,A,B"
+size_t logPrefixLength(const std::string& line)
+{
+    if (line.empty() || line[0] < '0' || line[0] > '9') {
+        return 0;
+    }
+    size_t bracket = line.find('[');
+    size_t end = line.find("] ");
+    if (bracket == std::string::npos || end == std::string::npos || end < bracket || end > 80) {
+        return 0;
+    }
+    return end + 2;
+}
+
+} // namespace
+
+// called with the ring of a thread that exits
+void NavBinaryLog::orphanRing(void* ring)
+{
+    ((Ring*)ring)->orphaned().store(true, std::memory_order_release);
+}
+
+NavBinaryLog::NavBinaryLog()
+: mOpen(false), mStop(false), mSeq(0), mDropped(0), mFile(NULL), mStderrSave(-1), mCaptureFd(-1)
+{
+    pthread_key_create(&mRingKey, orphanRing);
+}
+
+NavBinaryLog::~NavBinaryLog()
+{
+    close();
+    pthread_key_delete(mRingKey);
+}
+
+int64_t NavBinaryLog::now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+bool NavBinaryLog::open(const std::string& path, int32_t timeZoneOffset)
+{
+    close();
+    mFile = fopen(path.c_str(), "wb");
+    if (mFile == NULL) {
+        return false;
+    }
+    NavBinaryLogHeader header;
+    memcpy(header.magic, NAV_BINARY_LOG_MAGIC, 4);
+    header.version = NAV_BINARY_LOG_VERSION;
+    header.recordSize = sizeof(NavBinaryLogRecord);
+    header.timeZoneOffset = timeZoneOffset;
+    if (fwrite(&header, sizeof(header), 1, mFile) != 1) {
+        fclose(mFile);
+        mFile = NULL;
+        return false;
+    }
+    {
+        // records that came in while closing belong to the previous log
+        std::lock_guard<std::mutex> lock(mRingsMutex);
+        for (auto& ring : mRings) {
+            ring->clear();
+        }
+    }
+    mDropped = 0;
+    mStop = false;
+    mOpen.store(true, std::memory_order_release);
+    mWriter = std::thread(&NavBinaryLog::run, this);
+    return true;
+}
+
+void NavBinaryLog::close()
+{
+    if (!mFile) {
+        return;
+    }
+    // lines still in the pipe are logged before the log stops accepting records
+    releaseStderr();
+    mOpen.store(false, std::memory_order_release);
+    mStop = true;
+    mWriter.join();
+    fclose(mFile);
+    mFile = NULL;
+}
+
+NavBinaryLog::Ring* NavBinaryLog::ring()
+{
+    Ring* ring = (Ring*)pthread_getspecific(mRingKey);
+    if (ring == NULL) {
+        std::lock_guard<std::mutex> lock(mRingsMutex);
+        mRings.push_back(std::unique_ptr<Ring>(new Ring()));
+        ring = mRings.back().get();
+        pthread_setspecific(mRingKey, ring);
+    }
+    return ring;
+}
+
+NavBinaryLogRecord* NavBinaryLog::begin(NavBinaryLogRecord* records, size_t n, uint8_t type)
+{
+    uint64_t seq = mSeq.fetch_add(1, std::memory_order_relaxed);
+    int64_t timestamp = now();
+    for (size_t i = 0; i < n; i++) {
+        memset(&records[i], 0, sizeof(NavBinaryLogRecord));
+        records[i].type = i == 0 ? type : type + 1;
+        // continuation records share the sequence number to stay together
+        records[i].seq = seq;
+        records[i].timestamp = timestamp;
+    }
+    return records;
+}
+
+void NavBinaryLog::push(const NavBinaryLogRecord* records, size_t n)
+{
+    if (!ring()->push(records, n)) {
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void NavBinaryLog::logBeacons(const NavBeaconReading* readings, size_t n)
+{
+    if (!isOpen()) {
+        return;
+    }
+    n = std::min<size_t>(n, UINT16_MAX);
+    size_t recordNum = std::max<size_t>(1, (n + NavBinaryLogRecord::kBeaconNum - 1) / NavBinaryLogRecord::kBeaconNum);
+    NavBinaryLogRecord local[16];
+    std::vector<NavBinaryLogRecord> large;
+    NavBinaryLogRecord* records = local;
+    if (recordNum > 16) {
+        large.resize(recordNum);
+        records = large.data();
+    }
+    begin(records, recordNum, NavBinaryLogBeacon);
+    for (size_t i = 0; i < n; i++) {
+        NavBinaryLogRecord& r = records[i / NavBinaryLogRecord::kBeaconNum];
+        NavBinaryLogReading& b = r.beacons[r.count++];
+        b.major = (uint16_t)readings[i].major;
+        b.minor = (uint16_t)readings[i].minor;
+        b.rssi = (int16_t)readings[i].rssi;
+    }
+    records[0].total = (uint16_t)n;
+    push(records, recordNum);
+}
+
+void NavBinaryLog::logValues(uint8_t type, const double* values, int n)
+{
+    if (!isOpen()) {
+        return;
+    }
+    NavBinaryLogRecord record;
+    begin(&record, 1, type);
+    record.count = record.total = (uint8_t)n;
+    memcpy(record.values, values, n * sizeof(double));
+    push(&record, 1);
+}
+
+void NavBinaryLog::logAcc(double x, double y, double z)
+{
+    double values[3] = {x, y, z};
+    logValues(NavBinaryLogAcc, values, 3);
+}
+
+void NavBinaryLog::logMotion(double pitch, double roll, double yaw)
+{
+    double values[3] = {pitch, roll, yaw};
+    logValues(NavBinaryLogMotion, values, 3);
+}
+
+void NavBinaryLog::logDrift(const double values[5])
+{
+    logValues(NavBinaryLogDrift, values, 5);
+}
+
+void NavBinaryLog::logText(const char* text, size_t len)
+{
+    if (!isOpen()) {
+        return;
+    }
+    len = std::min<size_t>(len, UINT16_MAX);
+    size_t recordNum = std::max<size_t>(1, (len + NavBinaryLogRecord::kTextLength - 1) / NavBinaryLogRecord::kTextLength);
+    std::vector<NavBinaryLogRecord> records(recordNum);
+    begin(records.data(), recordNum, NavBinaryLogText);
+    for (size_t i = 0; i < recordNum; i++) {
+        size_t offset = i * NavBinaryLogRecord::kTextLength;
+        records[i].count = (uint8_t)std::min<size_t>(len - offset, NavBinaryLogRecord::kTextLength);
+        memcpy(records[i].text, text + offset, records[i].count);
+    }
+    records[0].total = (uint16_t)len;
+    push(records.data(), recordNum);
+}
+
+bool NavBinaryLog::captureStderr()
+{
+    if (!isOpen() || mStderrSave >= 0) {
+        return false;
+    }
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+    fflush(stderr);
+    mStderrSave = dup(STDERR_FILENO);
+    if (mStderrSave < 0 || dup2(fds[1], STDERR_FILENO) < 0) {
+        if (mStderrSave >= 0) {
+            ::close(mStderrSave);
+            mStderrSave = -1;
+        }
+        ::close(fds[0]);
+        ::close(fds[1]);
+        return false;
+    }
+    ::close(fds[1]);
+    mCaptureFd = fds[0];
+    mCapture = std::thread(&NavBinaryLog::capture, this);
+    return true;
+}
+
+// restoring stderr closes the write end of the pipe, the capture thread
+// logs what is left and ends at EOF
+void NavBinaryLog::releaseStderr()
+{
+    if (mStderrSave < 0) {
+        return;
+    }
+    fflush(stderr);
+    dup2(mStderrSave, STDERR_FILENO);
+    ::close(mStderrSave);
+    mStderrSave = -1;
+    mCapture.join();
+    ::close(mCaptureFd);
+    mCaptureFd = -1;
+}
+
+void NavBinaryLog::capture()
+{
+    std::string line;
+    char buf[4096];
+    for (;;) {
+        ssize_t n = read(mCaptureFd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        for (ssize_t i = 0; i < n; i++) {
+            if (buf[i] != '\n') {
+                line += buf[i];
+                continue;
+            }
+            size_t prefix = logPrefixLength(line);
+            logText(line.data() + prefix, line.size() - prefix);
+            line.clear();
+        }
+    }
+    if (!line.empty()) {
+        size_t prefix = logPrefixLength(line);
+        logText(line.data() + prefix, line.size() - prefix);
+    }
+}
+
+size_t NavBinaryLog::drain(std::vector<NavBinaryLogRecord>& buffer)
+{
+    buffer.clear();
+    {
+        std::lock_guard<std::mutex> lock(mRingsMutex);
+        for (size_t i = 0; i < mRings.size(); i++) {
+            // a ring whose thread has exited gets no more records once drained
+            bool orphaned = mRings[i]->orphaned().load(std::memory_order_acquire);
+            mRings[i]->pop(buffer);
+            if (orphaned) {
+                mRings.erase(mRings.begin() + i--);
+            }
+        }
+    }
+    // rings are drained one after another, restore the order they were logged in
+    std::stable_sort(buffer.begin(), buffer.end(), [](const NavBinaryLogRecord& a, const NavBinaryLogRecord& b) {
+        return a.seq < b.seq;
+    });
+    if (!buffer.empty()) {
+        fwrite(buffer.data(), sizeof(NavBinaryLogRecord), buffer.size(), mFile);
+        fflush(mFile);
+    }
+    return buffer.size();
+}
+
+void NavBinaryLog::run()
+{
+    std::vector<NavBinaryLogRecord> buffer;
+    while (!mStop.load()) {
+        drain(buffer);
+        std::this_thread::sleep_for(std::chrono::milliseconds(WRITER_INTERVAL_MS));
+    }
+    drain(buffer);
+}
+
+bool NavBinaryLog::convertToText(const std::string& binaryPath, const std::string& textPath)
+{
+    FILE* in = fopen(binaryPath.c_str(), "rb");
+    if (in == NULL) {
+        return false;
+    }
+    NavBinaryLogHeader header;
+    if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, NAV_BINARY_LOG_MAGIC, 4) != 0 ||
+        header.version != NAV_BINARY_LOG_VERSION || header.recordSize != sizeof(NavBinaryLogRecord)) {
+        fclose(in);
+        return false;
+    }
+    std::string tmpPath = textPath + ".tmp";
+    FILE* out = fopen(tmpPath.c_str(), "w");
+    if (out == NULL) {
+        fclose(in);
+        return false;
+    }
+    
+    std::string line;
+    char buf[256];
+    auto flush = [&]() {
+        if (!line.empty()) {
+            line += '\n';
+            fwrite(line.data(), 1, line.size(), out);
+            line.clear();
+        }
+    };
+    NavBinaryLogRecord r;
+    while (fread(&r, sizeof(r), 1, in) == 1) {
+        if (r.type == NavBinaryLogBeaconMore || r.type == NavBinaryLogTextMore) {
+            if (line.empty()) {
+                continue;
+            }
+        } else {
+            flush();
+            // same layout as NSLog output
+            int64_t local = r.timestamp + (int64_t)header.timeZoneOffset * 1000;
+            int64_t days = local >= 0 ? local / 86400000 : (local - 86399999) / 86400000;
+            int64_t ms = local - days * 86400000;
+            int y, m, d;
+            civilFromDays(days, y, m, d);
+            snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d:%02d.%03d NavCog[0:0] ", y, m, d,
+                     (int)(ms / 3600000), (int)(ms / 60000 % 60), (int)(ms / 1000 % 60), (int)(ms % 1000));
+            line = buf;
+        }
+        switch (r.type) {
+            case NavBinaryLogBeacon:
+                snprintf(buf, sizeof(buf), "Beacon,%d", (int)r.total);
+                line += buf;
+                // fall through
+            case NavBinaryLogBeaconMore:
+                for (int i = 0; i < r.count && i < NavBinaryLogRecord::kBeaconNum; i++) {
+                    snprintf(buf, sizeof(buf), ",%d,%d,%d", r.beacons[i].major, r.beacons[i].minor, r.beacons[i].rssi);
+                    line += buf;
+                }
+                break;
+            case NavBinaryLogAcc:
+                snprintf(buf, sizeof(buf), "Acc,%.9g,%.9g,%.9g", r.values[0], r.values[1], r.values[2]);
+                line += buf;
+                break;
+            case NavBinaryLogMotion:
+                snprintf(buf, sizeof(buf), "Motion,%f,%f,%f", r.values[0], r.values[1], r.values[2]);
+                line += buf;
+                break;
+            case NavBinaryLogDrift:
+                snprintf(buf, sizeof(buf), "Drift,%f,%f,%f,%f,%f", r.values[0], r.values[1], r.values[2], r.values[3], r.values[4]);
+                line += buf;
+                break;
+            case NavBinaryLogText:
+            case NavBinaryLogTextMore:
+                line.append(r.text, std::min<int>(r.count, NavBinaryLogRecord::kTextLength));
+                break;
+            default:
+                line.clear();
+                break;
+        }
+    }
+    flush();
+    fclose(in);
+    if (fclose(out) != 0 || rename(tmpPath.c_str(), textPath.c_str()) != 0) {
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,155 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavBinaryLog_hpp
+#define NavBinaryLog_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "NavBeaconFrame.hpp"
+
+// Binary sensor log.
+//
+// Producers copy fixed size records into a lock-free single-producer
+// single-consumer ring owned by their thread, a background writer drains all
+// rings into the file. Producers never block or allocate after their first
+// record, records are dropped (and counted) if a ring is full.
+//
+// While stderr is captured, each line written to it (NSLog) becomes a text
+// record stamped when the capture thread reads it.
+//
+// File: NavBinaryLogHeader followed by 64 byte records. A beacon scan or a
+// text line that does not fit one record continues in *More records written
+// right after it.
+
+#define NAV_BINARY_LOG_MAGIC "NVLG"
+#define NAV_BINARY_LOG_VERSION 1
+
+enum NavBinaryLogRecordType {
+    NavBinaryLogBeacon = 1,
+    NavBinaryLogBeaconMore,
+    NavBinaryLogAcc,
+    NavBinaryLogMotion,
+    NavBinaryLogDrift,
+    NavBinaryLogText,
+    NavBinaryLogTextMore
+};
+
+struct NavBinaryLogHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t recordSize;
+    int32_t timeZoneOffset; // seconds added to timestamps for the local time of text logs
+};
+
+struct NavBinaryLogReading {
+    uint16_t major;
+    uint16_t minor;
+    int16_t rssi;
+    int16_t reserved;
+};
+
+struct NavBinaryLogRecord {
+    static const int kBeaconNum = 5;
+    static const int kValueNum = 5;
+    static const int kTextLength = 40;
+
+    uint8_t type;
+    uint8_t count;   // beacons or text bytes in this record
+    uint16_t total;  // beacons or text bytes of the whole scan or line
+    uint32_t reserved;
+    uint64_t seq;
+    int64_t timestamp; // ms since 1970
+    union {
+        double values[kValueNum];
+        NavBinaryLogReading beacons[kBeaconNum];
+        char text[kTextLength];
+    };
+};
+
+class NavBinaryLog {
+public:
+    NavBinaryLog();
+    ~NavBinaryLog();
+
+    bool open(const std::string& path, int32_t timeZoneOffset);
+    // stops accepting records, writes what is buffered and closes the file
+    void close();
+    bool isOpen() const { return mOpen.load(std::memory_order_acquire); }
+
+    void logBeacons(const NavBeaconReading* readings, size_t n);
+    void logAcc(double x, double y, double z);
+    void logMotion(double pitch, double roll, double yaw);
+    void logDrift(const double values[5]);
+    // a line of the text log without time stamp, e.g. "Route,A,B"
+    void logText(const char* text, size_t len);
+    // redirects stderr into text records until close(), the NSLog prefix of
+    // a line is dropped as the converted log adds its own
+    bool captureStderr();
+
+    uint64_t droppedNum() const { return mDropped.load(std::memory_order_relaxed); }
+
+    static int64_t now();
+    // writes the NavLog text format read by NavLogFile
+    static bool convertToText(const std::string& binaryPath, const std::string& textPath);
+
+private:
+    NavBinaryLog(const NavBinaryLog&);
+    NavBinaryLog& operator=(const NavBinaryLog&);
+
+    class Ring;
+
+    static void orphanRing(void* ring);
+    Ring* ring();
+    NavBinaryLogRecord* begin(NavBinaryLogRecord* records, size_t n, uint8_t type);
+    void push(const NavBinaryLogRecord* records, size_t n);
+    void logValues(uint8_t type, const double* values, int n);
+    void run();
+    size_t drain(std::vector<NavBinaryLogRecord>& buffer);
+    void capture();
+    void releaseStderr();
+
+    pthread_key_t mRingKey;
+    std::mutex mRingsMutex;
+    std::vector<std::unique_ptr<Ring> > mRings;
+
+    std::atomic<bool> mOpen;
+    std::atomic<bool> mStop;
+    std::atomic<uint64_t> mSeq;
+    std::atomic<uint64_t> mDropped;
+    std::thread mWriter;
+    FILE* mFile;
+
+    int mStderrSave;
+    int mCaptureFd;
+    std::thread mCapture;
+};
+
+#endif /* NavBinaryLog_hpp */
@@ -19,24 +19,35 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  *
- * Contributors:
- *  IBM Corporation - initial API and implementation
- *******************************************************************************/
 
 #import "NavLog.h"
+#import "NavBinaryLog.hpp"
 
 @implementation NavLog
 
 static int stderrSave = 0;
 
+// sensor records go to a binary log while logging to file, it is converted to
+// the text log when logging stops (set textlog=true to log text directly).
+// stderr is captured into the binary log so the text log keeps every NSLog line.
+static NavBinaryLog *binaryLog;
+static NSString *binaryLogPath;
+static BOOL preventSensorLog = NO;
+
+// sensor callbacks come from several threads, only the binary log's own state is checked there
+static inline BOOL binaryLogging() {
+    return binaryLog && binaryLog->isOpen();
+}
+
 + (void)startLog {
     if (![[NSUserDefaults standardUserDefaults] boolForKey:@"devmode_preference"]) {
         return;
     }
-    if (stderrSave != 0) {
+    if (stderrSave != 0 || binaryLogPath) {
         return;
     }
     NSDictionary* env = [[NSProcessInfo processInfo] environment];
+    preventSensorLog = [[env valueForKey:@"preventSensorLog"] isEqual:@"true"];
     if ([[env valueForKey:@"log2file"] isEqual:@"false"]) {
         NSLog(@"Start log to console");
         stderrSave = -1;
@@ -51,6 +62,24 @@ static int stderrSave = 0;
     NSString *fileName = [formatter stringFromDate:[NSDate date]];
     NSString *dir = [NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES) objectAtIndex:0];
     NSString *path = [dir stringByAppendingPathComponent:fileName];
+    
+    if (![[env valueForKey:@"textlog"] isEqual:@"true"]) {
+        [NavLog convertBinaryLogsInDirectory:dir];
+        NSString *binaryPath = [[path stringByDeletingPathExtension] stringByAppendingPathExtension:@"navlog"];
+        if (!binaryLog) {
+            binaryLog = new NavBinaryLog();
+        }
+        if (binaryLog->open([binaryPath UTF8String], (int32_t)[[NSTimeZone systemTimeZone] secondsFromGMT])) {
+            binaryLogPath = binaryPath;
+            NSLog(@"Start log to %@", binaryPath);
+            if (!binaryLog->captureStderr()) {
+                NSLog(@"Could not capture stderr");
+            }
+            return;
+        }
+        NSLog(@"Could not open %@", binaryPath);
+    }
+    
     NSLog(@"Start log to %@", path);
     
     stderrSave = dup(STDERR_FILENO);
@@ -58,6 +87,14 @@ static int stderrSave = 0;
 }
 
 +(void)stopLog {
+    if (binaryLogPath) {
+        binaryLog->close();
+        NSLog(@"Stop log,%llu dropped", binaryLog->droppedNum());
+        NSString *dir = [binaryLogPath stringByDeletingLastPathComponent];
+        binaryLogPath = nil;
+        [NavLog convertBinaryLogsInDirectory:dir];
+        return;
+    }
     if(stderrSave == 0) {
         return;
     }
@@ -70,11 +107,44 @@ static int stderrSave = 0;
     NSLog(@"Stop log");
 }
 
+// converts every closed binary log which has no text log yet, in the background
++(void)convertBinaryLogsInDirectory:(NSString*)dir {
+    NSString *current = binaryLogPath;
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        NSFileManager *fm = [NSFileManager defaultManager];
+        for (NSString *name in [fm contentsOfDirectoryAtPath:dir error:nil]) {
+            if (![[name pathExtension] isEqualToString:@"navlog"]) {
+                continue;
+            }
+            NSString *binaryPath = [dir stringByAppendingPathComponent:name];
+            NSString *textPath = [[binaryPath stringByDeletingPathExtension] stringByAppendingPathExtension:@"log"];
+            if ([binaryPath isEqualToString:current] || [fm fileExistsAtPath:textPath]) {
+                continue;
+            }
+            NSDate *start = [NSDate date];
+            if (NavBinaryLog::convertToText([binaryPath UTF8String], [textPath UTF8String])) {
+                NSLog(@"ConvertLog,%@,%f", textPath, [[NSDate date] timeIntervalSinceDate:start] * 1000);
+            } else {
+                NSLog(@"Could not convert %@", binaryPath);
+            }
+        }
+    });
+}
+
 +(BOOL)isLogging {
-    return stderrSave != 0;
+    return stderrSave != 0 || binaryLogPath != nil;
 }
 
 +(void)logBeacons:(NSArray *)beacons{
+    if (binaryLogging()) {
+        std::vector<NavBeaconReading> readings;
+        readings.reserve(beacons.count);
+        for (CLBeacon *b in beacons) {
+            readings.push_back({[b.major intValue], [b.minor intValue], (int32_t)b.rssi});
+        }
+        binaryLog->logBeacons(readings.data(), readings.size());
+        return;
+    }
     if(stderrSave == 0) {
         return;
     }
@@ -88,11 +158,14 @@ static int stderrSave = 0;
 }
 
 +(void)logMotion:(CMDeviceMotion *)data withFrame:(CMAttitudeReferenceFrame)frame {
-    if(stderrSave == 0) {
+    if(preventSensorLog) {
         return;
     }
-    NSDictionary* env = [[NSProcessInfo processInfo] environment];
-    if ([[env valueForKey:@"preventSensorLog"] isEqual:@"true"]) {
+    if (binaryLogging()) {
+        binaryLog->logMotion(data.attitude.pitch, data.attitude.roll, data.attitude.yaw);
+        return;
+    }
+    if(stderrSave == 0) {
         return;
     }
 
@@ -100,22 +173,21 @@ static int stderrSave = 0;
 }
 
 +(void)logAcc:(NSDictionary *) data {
-    if(stderrSave == 0) {
+    if(preventSensorLog) {
         return;
     }
-    NSDictionary* env = [[NSProcessInfo processInfo] environment];
-    if ([[env valueForKey:@"preventSensorLog"] isEqual:@"true"]) {
+    if (binaryLogging()) {
+        binaryLog->logAcc([data[@"x"] doubleValue], [data[@"y"] doubleValue], [data[@"z"] doubleValue]);
+        return;
+    }
+    if(stderrSave == 0) {
         return;
     }
     NSLog(@"Acc,%@,%@,%@",data[@"x"],data[@"y"],data[@"z"]);
 }
 
 +(void)logMotion:(NSDictionary *)data {
-    if(stderrSave == 0) {
-        return;
-    }
-    NSDictionary* env = [[NSProcessInfo processInfo] environment];
-    if ([[env valueForKey:@"preventSensorLog"] isEqual:@"true"]) {
+    if(preventSensorLog) {
         return;
     }
     
@@ -123,11 +195,24 @@ static int stderrSave = 0;
     NSNumber *roll = [data objectForKey:@"roll"];
     NSNumber *yaw = [data objectForKey:@"yaw"];
     
+    if (binaryLogging()) {
+        binaryLog->logMotion([pitch doubleValue], [roll doubleValue], [yaw doubleValue]);
+        return;
+    }
+    if(stderrSave == 0) {
+        return;
+    }
+    
     NSLog(@"Motion,%f,%f,%f", [pitch doubleValue], [roll doubleValue], [yaw doubleValue]);
 }
 
 +(void)logGyroDrift:(double)drift edge: (double)edgeori curori: (double)curOri fixedDelta: (double)fixed oldDelta: (double) old{
 
+    if (binaryLogging()) {
+        double values[] = {drift, edgeori, curOri, fixed, old};
+        binaryLog->logDrift(values);
+        return;
+    }
     if(stderrSave == 0) {
         return;
     }
@@ -136,7 +221,7 @@ static int stderrSave = 0;
 }
 
 +(void)logArray:(NSArray *)data withType:(NSString *)type {
-    if(stderrSave == 0) {
+    if(stderrSave == 0 && !binaryLogging()) {
         return;
     }
     NSMutableString *str = [[NSMutableString alloc] init];
@@ -144,6 +229,11 @@ static int stderrSave = 0;
     for(NSObject *obj in data) {
         [str appendFormat:@",%@", obj];
     }
+    if (binaryLogging()) {
+        const char *text = [str UTF8String];
+        binaryLog->logText(text, strlen(text));
+        return;
+    }
     NSLog(@"%@", str);
 }
 
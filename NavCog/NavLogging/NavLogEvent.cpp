@@ -0,0 +1,264 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavLogEvent.hpp"
+#include <string.h>
+
+namespace {
+
+// days since 1970-01-01 of a proleptic Gregorian date
+int64_t daysFromCivil(int64_t y, int m, int d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int64_t yoe = y - era * 400;
+    int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+bool readDigits(const char* p, int n, int& value)
+{
+    value = 0;
+    for (int i = 0; i < n; i++) {
+        if (p[i] < '0' || p[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (p[i] - '0');
+    }
+    return true;
+}
+
+// field parsers never read past end, fields are separated by ','
+bool parseInt(const char*& p, const char* end, int& value)
+{
+    bool negative = p < end && *p == '-';
+    if (negative || (p < end && *p == '+')) {
+        p++;
+    }
+    const char* start = p;
+    int64_t v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+    }
+    value = (int)(negative ? -v : v);
+    return p > start;
+}
+
+bool parseDouble(const char*& p, const char* end, double& value)
+{
+    bool negative = p < end && *p == '-';
+    if (negative || (p < end && *p == '+')) {
+        p++;
+    }
+    const char* start = p;
+    double v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (*p++ - '0');
+    }
+    if (p < end && *p == '.') {
+        p++;
+        double scale = 0.1;
+        while (p < end && *p >= '0' && *p <= '9') {
+            v += (*p++ - '0') * scale;
+            scale *= 0.1;
+        }
+    }
+    if (p == start) {
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        int exponent;
+        if (!parseInt(p, end, exponent)) {
+            return false;
+        }
+        double base = exponent < 0 ? 0.1 : 10;
+        for (int i = exponent < 0 ? -exponent : exponent; i > 0; i--) {
+            v *= base;
+        }
+    }
+    value = negative ? -v : v;
+    return true;
+}
+
+bool skipComma(const char*& p, const char* end)
+{
+    if (p < end && *p == ',') {
+        p++;
+        return true;
+    }
+    return false;
+}
+
+bool parseDoubles(const char*& p, const char* end, double* values, int n)
+{
+    for (int i = 0; i < n; i++) {
+        if (!skipComma(p, end) || !parseDouble(p, end, values[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the text up to the next ',' or the end of the line
+bool parseString(const char*& p, const char* end, std::string& value)
+{
+    const char* comma = (const char*)memchr(p, ',', end - p);
+    const char* last = comma ? comma : end;
+    while (!comma && last > p && last[-1] == '\r') {
+        last--;
+    }
+    value.assign(p, last);
+    p = comma ? comma : end;
+    return true;
+}
+
+bool parseState(const char*& p, const char* end, NavLogState& state)
+{
+    std::string type;
+    int combined, segmentNum;
+    double values[5];
+    if (!skipComma(p, end) || !parseInt(p, end, state.index) ||
+        !skipComma(p, end) || !parseString(p, end, type) ||
+        !skipComma(p, end) || !parseString(p, end, state.edgeID) ||
+        !skipComma(p, end) || !parseString(p, end, state.localizerID) ||
+        !parseDoubles(p, end, values, 5) ||
+        !skipComma(p, end) || !parseInt(p, end, state.len) ||
+        !skipComma(p, end) || !parseInt(p, end, state.extraEdgeLength) ||
+        !skipComma(p, end) || !parseInt(p, end, combined) ||
+        !skipComma(p, end) || !parseInt(p, end, state.transit)) {
+        return false;
+    }
+    state.walking = type == "walking";
+    state.sx = values[0];
+    state.sy = values[1];
+    state.tx = values[2];
+    state.ty = values[3];
+    state.floor = values[4];
+    state.combined = combined != 0;
+    if (!parseDoubles(p, end, values, 4) ||
+        !skipComma(p, end) || !parseInt(p, end, segmentNum) || segmentNum < 0) {
+        return false;
+    }
+    state.knnDistThres = values[0];
+    state.posThres = values[1];
+    state.minKnnDist = values[2];
+    state.maxKnnDist = values[3];
+    state.segments.resize(segmentNum * 4);
+    return segmentNum == 0 || parseDoubles(p, end, &state.segments[0], segmentNum * 4);
+}
+
+bool startsWith(const char* p, const char* end, const char* word, size_t n)
+{
+    return (size_t)(end - p) >= n && memcmp(p, word, n) == 0 && (p + n == end || p[n] == ',');
+}
+
+} // namespace
+
+int64_t NavLogParseTimestamp(const char* p, size_t len)
+{
+    int y, mo, d, h, mi, s, ms;
+    if (len < 23 || p[4] != '-' || p[7] != '-' || p[10] != ' ' || p[13] != ':' || p[16] != ':' || p[19] != '.') {
+        return -1;
+    }
+    if (!readDigits(p, 4, y) || !readDigits(p + 5, 2, mo) || !readDigits(p + 8, 2, d) ||
+        !readDigits(p + 11, 2, h) || !readDigits(p + 14, 2, mi) || !readDigits(p + 17, 2, s) ||
+        !readDigits(p + 20, 3, ms)) {
+        return -1;
+    }
+    if (mo < 1 || mo > 12 || d < 1 || d > 31) {
+        return -1;
+    }
+    return ((daysFromCivil(y, mo, d) * 24 + h) * 60 + mi) * 60000LL + s * 1000LL + ms;
+}
+
+bool NavLogParseLine(const char* line, size_t len, NavLogEvent& event)
+{
+    event.type = NavLogEventNone;
+    int64_t timestamp = NavLogParseTimestamp(line, len);
+    if (timestamp < 0) {
+        return false;
+    }
+    // the payload follows "] " after the process name
+    const char* end = line + len;
+    const char* p = (const char*)memchr(line + 23, ']', len - 23);
+    if (p == NULL || end - p < 2) {
+        return false;
+    }
+    p += 2;
+    
+    event.timestamp = timestamp;
+    if (startsWith(p, end, "Beacon", 6)) {
+        p += 6;
+        int n;
+        if (!skipComma(p, end) || !parseInt(p, end, n) || n < 0) {
+            return false;
+        }
+        event.beacons.clear();
+        for (int i = 0; i < n; i++) {
+            NavBeaconReading r;
+            if (!skipComma(p, end) || !parseInt(p, end, r.major) ||
+                !skipComma(p, end) || !parseInt(p, end, r.minor) ||
+                !skipComma(p, end) || !parseInt(p, end, r.rssi)) {
+                return false;
+            }
+            event.beacons.push_back(r);
+        }
+        event.type = NavLogEventBeacon;
+    } else if (startsWith(p, end, "Acc", 3)) {
+        p += 3;
+        if (!parseDoubles(p, end, event.values, 3)) {
+            return false;
+        }
+        event.type = NavLogEventAcc;
+    } else if (startsWith(p, end, "Motion", 6)) {
+        p += 6;
+        if (!parseDoubles(p, end, event.values, 3)) {
+            return false;
+        }
+        event.type = NavLogEventMotion;
+    } else if (startsWith(p, end, "Route", 5)) {
+        p += 5;
+        if (!skipComma(p, end)) {
+            return false;
+        }
+        const char* comma = (const char*)memchr(p, ',', end - p);
+        if (comma == NULL) {
+            return false;
+        }
+        const char* to = comma + 1;
+        while (end > to && end[-1] == '\r') {
+            end--;
+        }
+        event.from.assign(p, comma);
+        event.to.assign(to, end);
+        event.type = NavLogEventRoute;
+    } else if (startsWith(p, end, "State", 5)) {
+        p += 5;
+        if (!parseState(p, end, event.state)) {
+            return false;
+        }
+        event.type = NavLogEventState;
+    }
+    return event.type != NavLogEventNone;
+}
@@ -0,0 +1,80 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavLogEvent_hpp
+#define NavLogEvent_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "NavBeaconFrame.hpp"
+
+// One sensor line of a NavLog text log, e.g.
+//   2016-03-01 10:20:30.123 NavCog[1234:5678] Beacon,2,1,100,-70,1,101,-80
+// Lines of other types are not events.
+
+enum NavLogEventType {
+    NavLogEventNone = 0,
+    NavLogEventBeacon,
+    NavLogEventAcc,
+    NavLogEventMotion,
+    NavLogEventRoute,
+    NavLogEventState
+};
+
+// One state of the navigation path as NavMachine logs it after planning,
+//   State,index,walking|transition,edgeID,localizerID,sx,sy,tx,ty,floor,
+//         len,extraEdgeLength,combined,transit,knnDistThres,posThres,
+//         minKnnDist,maxKnnDist,segmentNum,x1,y1,x2,y2,...
+// in feet, transit 0 for none, 1 for doors and stairs, 2 for elevators.
+struct NavLogState {
+    int index;
+    bool walking;
+    std::string edgeID, localizerID; // localizerID is empty without a localizer
+    double sx, sy, tx, ty, floor;
+    int len, extraEdgeLength;
+    bool combined;
+    int transit;
+    double knnDistThres, posThres, minKnnDist, maxKnnDist;
+    std::vector<double> segments; // packed x1, y1, x2, y2 of the edge
+};
+
+struct NavLogEvent {
+    NavLogEventType type;
+    int64_t timestamp;   // ms since 1970 of the wall clock time printed on the line, read as UTC
+    double values[3];    // Acc x,y,z or Motion pitch,roll,yaw
+    std::vector<NavBeaconReading> beacons;
+    std::string from, to; // Route node names
+    NavLogState state;
+
+    NavLogEvent() : type(NavLogEventNone), timestamp(0) { values[0] = values[1] = values[2] = 0; }
+};
+
+// parses "yyyy-MM-dd HH:mm:ss.SSS", returns -1 if p does not start with one
+int64_t NavLogParseTimestamp(const char* p, size_t len);
+
+// parses one line without its line break, returns false for non-event lines;
+// event keeps its buffers so it can be reused for every line
+bool NavLogParseLine(const char* line, size_t len, NavLogEvent& event);
+
+#endif /* NavLogEvent_hpp */
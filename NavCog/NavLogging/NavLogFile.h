@@ -30,11 +30,13 @@
 @property NSString* fromNodeName;
 @property NSString* toNodeName;
 @property NSDate* startTime;
-@property NSMutableArray* timesArray;
-@property NSMutableArray* objectsArray;
 @property NSString* uuidStr;
 
 
 - (id)initFromFileAtPath:(NSString *)path withUUIDStr:(NSString*) uuidstr;
 
+// reads the log from the file in order, object is an NSArray of CLBeacon or an
+// NSMutableDictionary of type "acceleration" or "motion"
+- (void)enumerateEventsUsingBlock:(void (^)(NSDate *time, id object, BOOL *stop))block;
+
 @end
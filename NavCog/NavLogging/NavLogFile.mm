@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ * Contributors:
+ *  Dragan Ahmetovic (CMU) - initial API and implementation
+ *******************************************************************************/
+
+#import "NavLogFile.h"
+#import <CoreLocation/CoreLocation.h>
+#import "NavLogReader.hpp"
+
+@interface NavLogFile ()
+
+@property NSString *path;
+@property NSTimeInterval timeZoneOffset;
+
+@end
+
+@implementation NavLogFile
+
+- (id)initFromFileAtPath:(NSString *)path withUUIDStr:(NSString*) uuidStr
+{
+    self = [super init];
+ 
+    _uuidStr = uuidStr;
+    _path = path;
+    // log lines carry the local time
+    _timeZoneOffset = [[NSTimeZone localTimeZone] secondsFromGMT];
+    
+    // events are read when the log is replayed, only the route is looked up here
+    NavLogReader reader;
+    if (!reader.open([path UTF8String])) {
+        return self;
+    }
+    NavLogEvent event;
+    while (reader.next(event)) {
+        if (!_startTime) {
+            _startTime = [self dateOfEvent:event];
+        }
+        if (event.type == NavLogEventRoute) {
+            _startTime = [self dateOfEvent:event];
+            _fromNodeName = [NSString stringWithUTF8String:event.from.c_str()];
+            _toNodeName = [NSString stringWithUTF8String:event.to.c_str()];
+            break;
+        }
+    }
+    
+    return self;
+}
+
+- (NSDate *)dateOfEvent:(const NavLogEvent &)event
+{
+    return [NSDate dateWithTimeIntervalSince1970:event.timestamp / 1000.0 - _timeZoneOffset];
+}
+
+- (void)enumerateEventsUsingBlock:(void (^)(NSDate *time, id object, BOOL *stop))block
+{
+    NavLogReader reader;
+    if (!reader.open([_path UTF8String])) {
+        return;
+    }
+    NSUUID *uuid = [[NSUUID alloc] initWithUUIDString:_uuidStr];
+    NavLogEvent event;
+    BOOL stop = NO;
+    while (!stop && reader.next(event)) {
+        @autoreleasepool {
+            NSDate *currentTime = [self dateOfEvent:event];
+            id object = nil;
+            if (event.type == NavLogEventAcc) { //acceleration data
+                //create motion data object
+                NSMutableDictionary* accData = [@{} mutableCopy];
+                accData[@"timestamp"] = @([currentTime timeIntervalSince1970]);
+                accData[@"type"] = @"acceleration";
+                accData[@"x"] = @((float)event.values[0]);
+                accData[@"y"] = @((float)event.values[1]);
+                accData[@"z"] = @((float)event.values[2]);
+                object = accData;
+            } else if (event.type == NavLogEventMotion) {
+                //create motion data object
+                NSMutableDictionary* motionData = [[NSMutableDictionary alloc] init];
+                motionData[@"timestamp"] = @([currentTime timeIntervalSince1970]);
+                motionData[@"type"] = @"motion";
+                motionData[@"pitch"] = @((float)event.values[0]);
+                motionData[@"roll"] = @((float)event.values[1]);
+                motionData[@"yaw"] = @((float)event.values[2]);
+                object = motionData;
+            } else if (event.type == NavLogEventBeacon) { //beacon data
+                NSMutableArray* beaconArray = [NSMutableArray arrayWithCapacity:event.beacons.size()];
+                for (const NavBeaconReading &b : event.beacons) {
+                    CLBeacon* newBeacon = [[CLBeacon alloc] init];
+                    [newBeacon setValue:@(b.major) forKey:@"major"];
+                    [newBeacon setValue:@(b.minor) forKey:@"minor"];
+                    [newBeacon setValue:@(b.rssi) forKey:@"rssi"];
+                    [newBeacon setValue:uuid forKey:@"proximityUUID"];
+                    [beaconArray addObject:newBeacon];
+                }
+                object = [NSArray arrayWithArray:beaconArray];
+            }
+            if (object) {
+                block(currentTime, object, &stop);
+            }
+        }
+    }
+}
+
+@end
@@ -0,0 +1,108 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavLogReader.hpp"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// consumed pages are released in chunks of this size
+#define RELEASE_CHUNK (8 << 20)
+
+NavLogReader::NavLogReader()
+: mData(NULL), mLength(0), mOffset(0), mReleased(0), mLineNum(0)
+{
+}
+
+NavLogReader::~NavLogReader()
+{
+    close();
+}
+
+bool NavLogReader::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (st.st_size > 0) {
+        void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+        mData = (const char*)data;
+        mLength = (size_t)st.st_size;
+    }
+    ::close(fd);
+    return true;
+}
+
+void NavLogReader::close()
+{
+    if (mData) {
+        munmap((void*)mData, mLength);
+    }
+    mData = NULL;
+    mLength = mOffset = mReleased = mLineNum = 0;
+}
+
+bool NavLogReader::next(NavLogEvent& event)
+{
+    while (mOffset < mLength) {
+        const char* line = mData + mOffset;
+        const char* eol = (const char*)memchr(line, '\n', mLength - mOffset);
+        size_t len = eol ? (size_t)(eol - line) : mLength - mOffset;
+        mOffset += eol ? len + 1 : len;
+        mLineNum++;
+        if (len > 0 && line[len - 1] == '\r') {
+            len--;
+        }
+        if (mOffset - mReleased >= RELEASE_CHUNK) {
+            releaseConsumed();
+        }
+        if (NavLogParseLine(line, len, event)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void NavLogReader::releaseConsumed()
+{
+    // the mapping is read only, released pages are read again from the file if needed
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t end = mOffset / pageSize * pageSize;
+    if (end > mReleased) {
+        madvise((void*)(mData + mReleased), end - mReleased, MADV_DONTNEED);
+        mReleased = end;
+    }
+}
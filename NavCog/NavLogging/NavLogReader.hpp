@@ -0,0 +1,62 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavLogReader_hpp
+#define NavLogReader_hpp
+
+#include <stddef.h>
+#include <string>
+#include "NavLogEvent.hpp"
+
+// Reads the events of a NavLog text log one at a time from a memory mapped
+// file. Nothing is kept per line, so memory does not grow with the log, and
+// pages behind the read position are handed back to the system as it goes.
+class NavLogReader {
+public:
+    NavLogReader();
+    ~NavLogReader();
+
+    bool open(const std::string& path);
+    void close();
+
+    // parses up to the next event line, false at the end of the log
+    bool next(NavLogEvent& event);
+    void rewind() { mOffset = mReleased = mLineNum = 0; }
+
+    size_t length() const { return mLength; }
+    size_t offset() const { return mOffset; }
+    size_t lineNum() const { return mLineNum; }
+
+private:
+    NavLogReader(const NavLogReader&);
+    NavLogReader& operator=(const NavLogReader&);
+
+    void releaseConsumed();
+
+    const char* mData;
+    size_t mLength;
+    size_t mOffset;
+    size_t mReleased;
+    size_t mLineNum;
+};
+
+#endif /* NavLogReader_hpp */
@@ -0,0 +1,419 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavLogReplay.hpp"
+#include "NavLogReader.hpp"
+#include "NavPolylineDistance.hpp"
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+typedef std::chrono::steady_clock ReplayClock;
+
+NavReplayLocalizer::Position NavReplayFingerprintLocalizer::position() const
+{
+    const NavFingerprintLocalizer::Result& r = mLocalizer->result();
+    Position p = {r.x, r.y, 0, r.knndist};
+    return p;
+}
+
+NavLogReplay::NavLogReplay()
+{
+    begin();
+}
+
+int NavLogReplay::addLocalizer(const std::string& name, std::shared_ptr<NavReplayLocalizer> localizer)
+{
+    mNames.push_back(name);
+    mLocalizers.push_back(localizer);
+    return (int)mLocalizers.size() - 1;
+}
+
+int NavLogReplay::localizerIndex(const std::string& name) const
+{
+    for (size_t i = 0; i < mNames.size(); i++) {
+        if (mNames[i] == name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+void NavLogReplay::begin()
+{
+    mReport = NavReplayReport();
+    mTrace.clear();
+    mBeaconLatencies.clear();
+    mAccLatencies.clear();
+    mMotionLatencies.clear();
+    mFrameLatencies.clear();
+    mLocalizerLatencies.assign(mLocalizers.size(), std::vector<float>());
+    mFirstTimestamp = mLastTimestamp = -1;
+    mFrameID = 0;
+    mStates.clear();
+    mCurrentState = -1;
+    mNavigationStart = -1;
+    mStateEvents.clear();
+    for (auto& localizer : mLocalizers) {
+        localizer->reset();
+    }
+}
+
+bool NavLogReplay::run(const std::string& logPath)
+{
+    NavLogReader reader;
+    if (!reader.open(logPath)) {
+        return false;
+    }
+    begin();
+    ReplayClock::time_point start = ReplayClock::now();
+    NavLogEvent event;
+    while (reader.next(event)) {
+        feed(event);
+    }
+    finish(std::chrono::duration<double, std::milli>(ReplayClock::now() - start).count());
+    return true;
+}
+
+void NavLogReplay::feed(const NavLogEvent& event)
+{
+    mReport.eventNum++;
+    if (mFirstTimestamp < 0) {
+        mFirstTimestamp = event.timestamp;
+    }
+    mLastTimestamp = event.timestamp;
+    
+    switch (event.type) {
+        case NavLogEventBeacon: {
+            mReport.beaconNum++;
+            ReplayClock::time_point start = ReplayClock::now();
+            std::vector<NavBeaconReading> readings(event.beacons);
+            NavBeaconFrame frame(++mFrameID, (double)event.timestamp, std::move(readings), false);
+            ReplayClock::time_point mark = ReplayClock::now();
+            mFrameLatencies.push_back(std::chrono::duration<float, std::micro>(mark - start).count());
+            for (size_t i = 0; i < mLocalizers.size(); i++) {
+                mLocalizers[i]->putBeacons(frame);
+                ReplayClock::time_point now = ReplayClock::now();
+                mLocalizerLatencies[i].push_back(std::chrono::duration<float, std::micro>(now - mark).count());
+                mark = now;
+            }
+            mBeaconLatencies.push_back(std::chrono::duration<float, std::micro>(mark - start).count());
+            for (size_t i = 0; i < mLocalizers.size(); i++) {
+                NavReplayLocalizer::Position p = mLocalizers[i]->position();
+                NavReplayTracePoint point = {event.timestamp, (int)i, p.x, p.y, p.floor, p.knndist, mLocalizers[i]->stateNum()};
+                mTrace.push_back(point);
+            }
+            updateState(event.timestamp);
+            break;
+        }
+        case NavLogEventAcc: {
+            mReport.accNum++;
+            ReplayClock::time_point start = ReplayClock::now();
+            for (auto& localizer : mLocalizers) {
+                localizer->putAcceleration(event.timestamp, event.values);
+            }
+            mAccLatencies.push_back(std::chrono::duration<float, std::micro>(ReplayClock::now() - start).count());
+            break;
+        }
+        case NavLogEventMotion: {
+            mReport.motionNum++;
+            ReplayClock::time_point start = ReplayClock::now();
+            for (auto& localizer : mLocalizers) {
+                localizer->putMotion(event.timestamp, event.values);
+            }
+            mMotionLatencies.push_back(std::chrono::duration<float, std::micro>(ReplayClock::now() - start).count());
+            break;
+        }
+        case NavLogEventRoute:
+            mReport.from = event.from;
+            mReport.to = event.to;
+            mStates.clear();
+            mCurrentState = -1;
+            for (auto& localizer : mLocalizers) {
+                localizer->reset();
+            }
+            break;
+        case NavLogEventState:
+            addState(event.state);
+            break;
+        default:
+            break;
+    }
+}
+
+// states are logged in order, index 0 starts a new plan
+void NavLogReplay::addState(const NavLogState& log)
+{
+    if (log.index == 0) {
+        mStates.clear();
+        mCurrentState = 0;
+    }
+    if (log.index != (int)mStates.size()) {
+        return;
+    }
+    mStates.push_back(State());
+    State& state = mStates.back();
+    state.log = log;
+    state.localizer = localizerIndex(log.localizerID);
+    
+    // in the order NavMachine leaves the NavState properties
+    NavStateProgress& progress = state.progress;
+    progress.type(log.walking ? NavStateProgress::Walking : NavStateProgress::Transition);
+    progress.combined(log.combined);
+    progress.extraEdgeLength(log.extraEdgeLength);
+    if (log.walking) {
+        progress.walkingEdge(log.len);
+    } else {
+        progress.targetEdge(log.len, log.minKnnDist, log.maxKnnDist);
+        progress.transit((NavStateProgress::Transit)log.transit, log.knnDistThres, log.posThres);
+    }
+    mReport.stateNum = mStates.size();
+}
+
+void NavLogReplay::startState(State& state)
+{
+    state.progress.start();
+    mReport.statesStarted++;
+    if (state.localizer < 0) {
+        return;
+    }
+    NavReplayLocalizer& localizer = *mLocalizers[state.localizer];
+    const NavLogState& log = state.log;
+    int segmentNum = (int)log.segments.size() / 4;
+    if (!log.walking) {
+        localizer.startTransition();
+    } else if (segmentNum > 0) {
+        // forward if the state starts at the first point of the edge
+        const double* first = &log.segments[0];
+        const double* last = &log.segments[(segmentNum - 1) * 4];
+        bool forward = hypot(log.sx - first[0], log.sy - first[1]) <= hypot(log.sx - last[2], log.sy - last[3]);
+        if (forward) {
+            localizer.startWalking(first[0], first[1], first[2], first[3], log.index == 0);
+        } else {
+            localizer.startWalking(last[2], last[3], last[0], last[1], log.index == 0);
+        }
+    }
+}
+
+// the position of the state's localizer projected onto the state's edge
+bool NavLogReplay::onEdge(const State& state, double& x, double& y, float& knndist)
+{
+    if (state.localizer < 0 || state.log.segments.empty()) {
+        return false;
+    }
+    NavReplayLocalizer& localizer = *mLocalizers[state.localizer];
+    if (!localizer.hasPosition()) {
+        return false;
+    }
+    const double* segments = &state.log.segments[0];
+    int segmentNum = (int)state.log.segments.size() / 4;
+    NavReplayLocalizer::Position p = localizer.position();
+    NavPolylineDistance::distance(segments, segmentNum, p.x, p.y, &x, &y);
+    knndist = localizer.distanceScore(segments, segmentNum);
+    return true;
+}
+
+// checkStateStatusUsingLocationManager: of the current state
+void NavLogReplay::updateState(int64_t timestamp)
+{
+    if (mCurrentState < 0 || mCurrentState >= (int)mStates.size()) {
+        return;
+    }
+    State& state = mStates[mCurrentState];
+    State* next = mCurrentState + 1 < (int)mStates.size() ? &mStates[mCurrentState + 1] : NULL;
+    if (!state.progress.started()) {
+        if (mCurrentState == 0) {
+            mNavigationStart = timestamp;
+        }
+        startState(state);
+        NavReplayStateEvent event = {timestamp, mCurrentState, NavStateProgress::None, 0, 0, 0};
+        mStateEvents.push_back(event);
+        return;
+    }
+    double x, y;
+    float knndist;
+    if (!onEdge(state, x, y, knndist)) {
+        return;
+    }
+    const NavLogState& log = state.log;
+    const double* segments = &log.segments[0];
+    int segmentNum = (int)log.segments.size() / 4;
+    float dist = NavPolylineDistance::pathDistance(segments, segmentNum, x, y, log.tx, log.ty);
+    
+    NavStateProgress::Action action;
+    if (log.walking) {
+        bool forceNext = false;
+        if (state.progress.checksNextEdge(dist) && next != NULL && next->log.walking &&
+            next->localizer >= 0 && mLocalizers[next->localizer]->checksNextEdge()) {
+            // check if we already on the next edge
+            double nextX, nextY;
+            float nextKnndist;
+            if (onEdge(*next, nextX, nextY, nextKnndist)) {
+                const std::vector<double>& nextSegments = next->log.segments;
+                float nextStartDist = NavPolylineDistance::pathDistance(&nextSegments[0], (int)nextSegments.size() / 4,
+                                                                        nextX, nextY, next->log.sx, next->log.sy);
+                float nextStartRatio = nextStartDist / next->log.len;
+                forceNext = nextStartDist > 25 || (nextStartDist > 10 && nextStartRatio > 0.25);
+            }
+        }
+        action = state.progress.update(dist, knndist, forceNext, next != NULL && next->log.combined ? &next->progress : NULL);
+    } else {
+        action = state.progress.update(dist, knndist, false, NULL);
+    }
+    if (action == NavStateProgress::None) {
+        return;
+    }
+    
+    NavReplayStateEvent event = {timestamp, mCurrentState, action, dist, knndist, state.progress.announcedDistance()};
+    mStateEvents.push_back(event);
+    switch (action) {
+        case NavStateProgress::AnnounceDistance:
+            mReport.announceNum++;
+            break;
+        case NavStateProgress::Approaching:
+            mReport.approachingNum++;
+            break;
+        case NavStateProgress::Arrived:
+            mReport.arrivedNum++;
+            if (state.localizer >= 0) {
+                mLocalizers[state.localizer]->arrived();
+            }
+            break;
+        case NavStateProgress::Transited:
+            mReport.transitedNum++;
+            break;
+        default:
+            break;
+    }
+    if (action == NavStateProgress::Arrived || action == NavStateProgress::Transited) {
+        if (++mCurrentState == (int)mStates.size() && mNavigationStart >= 0) {
+            mReport.navigationMs = (double)(timestamp - mNavigationStart);
+        }
+    }
+}
+
+NavReplayLatency NavLogReplay::latency(std::vector<float>& latencies)
+{
+    NavReplayLatency r = NavReplayLatency();
+    r.num = latencies.size();
+    if (latencies.empty()) {
+        return r;
+    }
+    double sum = 0;
+    for (float latency : latencies) {
+        sum += latency;
+    }
+    r.mean = sum / latencies.size();
+    std::sort(latencies.begin(), latencies.end());
+    r.p50 = latencies[latencies.size() / 2];
+    r.p99 = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+    r.max = latencies.back();
+    return r;
+}
+
+void NavLogReplay::finish(double wallMs)
+{
+    mReport.wallMs = wallMs;
+    mReport.logMs = mFirstTimestamp < 0 ? 0 : (double)(mLastTimestamp - mFirstTimestamp);
+    mReport.beaconLatency = latency(mBeaconLatencies);
+    mReport.accLatency = latency(mAccLatencies);
+    mReport.motionLatency = latency(mMotionLatencies);
+    mReport.frameLatency = latency(mFrameLatencies);
+    mReport.localizerLatencies.clear();
+    for (std::vector<float>& latencies : mLocalizerLatencies) {
+        mReport.localizerLatencies.push_back(latency(latencies));
+    }
+}
+
+bool NavLogReplay::writeTrace(const std::string& path) const
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if (fp == NULL) {
+        return false;
+    }
+    fprintf(fp, "timestamp,localizer,x,y,floor,knndist,states\n");
+    for (const NavReplayTracePoint& p : mTrace) {
+        fprintf(fp, "%lld,%s,%f,%f,%f,%f,%d\n", (long long)p.timestamp, mNames[p.localizer].c_str(),
+                p.x, p.y, p.floor, p.knndist, p.stateNum);
+    }
+    return fclose(fp) == 0;
+}
+
+static const char* actionName(NavStateProgress::Action action)
+{
+    switch (action) {
+        case NavStateProgress::AnnounceDistance: return "announce";
+        case NavStateProgress::Approaching: return "approaching";
+        case NavStateProgress::Arrived: return "arrived";
+        case NavStateProgress::Transited: return "transited";
+        default: return "start";
+    }
+}
+
+bool NavLogReplay::writeStates(const std::string& path) const
+{
+    FILE* fp = fopen(path.c_str(), "w");
+    if (fp == NULL) {
+        return false;
+    }
+    fprintf(fp, "timestamp,state,edge,action,dist,knndist,announced\n");
+    for (const NavReplayStateEvent& e : mStateEvents) {
+        fprintf(fp, "%lld,%d,%s,%s,%f,%f,%d\n", (long long)e.timestamp, e.state,
+                e.state < (int)mStates.size() ? mStates[e.state].log.edgeID.c_str() : "",
+                actionName(e.action), e.dist, e.knndist, e.announcedDistance);
+    }
+    return fclose(fp) == 0;
+}
+
+static void printLatency(FILE* out, const char* name, const NavReplayLatency& l)
+{
+    fprintf(out, "%s latency (us): mean %.1f, p50 %.1f, p99 %.1f, max %.1f\n", name, l.mean, l.p50, l.p99, l.max);
+}
+
+void NavLogReplay::printReport(FILE* out) const
+{
+    const NavReplayReport& r = mReport;
+    fprintf(out, "route: %s -> %s\n", r.from.c_str(), r.to.c_str());
+    fprintf(out, "events: %zu (beacon %zu, acc %zu, motion %zu), localizers: %zu\n",
+            r.eventNum, r.beaconNum, r.accNum, r.motionNum, mLocalizers.size());
+    fprintf(out, "log time: %.1f s, wall time: %.1f ms, speedup: %.0fx\n",
+            r.logMs / 1000, r.wallMs, r.wallMs > 0 ? r.logMs / r.wallMs : 0);
+    printLatency(out, "beacon", r.beaconLatency);
+    printLatency(out, "  frame", r.frameLatency);
+    for (size_t i = 0; i < r.localizerLatencies.size(); i++) {
+        printLatency(out, ("  " + mNames[i]).c_str(), r.localizerLatencies[i]);
+    }
+    if (r.accNum > 0) {
+        printLatency(out, "acc", r.accLatency);
+    }
+    if (r.motionNum > 0) {
+        printLatency(out, "motion", r.motionLatency);
+    }
+    if (r.stateNum > 0) {
+        fprintf(out, "states: %zu/%zu started, %zu announcements, %zu approaching, %zu arrived, %zu transited",
+                r.statesStarted, r.stateNum, r.announceNum, r.approachingNum, r.arrivedNum, r.transitedNum);
+        if (r.navigationMs > 0) {
+            fprintf(out, ", finished in %.1f s", r.navigationMs / 1000);
+        }
+        fprintf(out, "\n");
+    }
+}
@@ -0,0 +1,188 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavLogReplay_hpp
+#define NavLogReplay_hpp
+
+#include <stdint.h>
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "NavLogEvent.hpp"
+#include "NavFingerprintLocalizer.hpp"
+#include "NavStateProgress.hpp"
+
+// A localizer as NavLogReplay drives it, positions are in feet. Adapters
+// keep the localizers themselves free of the replay.
+class NavReplayLocalizer {
+public:
+    struct Position {
+        float x, y, floor;
+        float knndist; // as the localizer reports it, see distanceScore()
+    };
+
+    virtual ~NavReplayLocalizer() {}
+
+    virtual void reset() = 0;
+    virtual void putBeacons(const NavBeaconFrame& frame) = 0;
+    // timestamps in ms, Acc x,y,z and Motion pitch,roll,yaw of the log
+    virtual void putAcceleration(int64_t timestamp, const double* values) {}
+    virtual void putMotion(int64_t timestamp, const double* values) {}
+    virtual bool hasPosition() const = 0;
+    virtual Position position() const = 0;
+    // distance score for an edge as computeDistanceScoreWithOptions:
+    virtual float distanceScore(const double* segments, int segmentNum) { return position().knndist; }
+    // 0 if the localizer has no states
+    virtual int stateNum() const { return 0; }
+    // whether NavState checks if the user is already on the next edge with it
+    virtual bool checksNextEdge() const { return false; }
+
+    // initializeState: of a walking state from (x1, y1) towards (x2, y2),
+    // of a transition and on arrival at the end of a walking state
+    virtual void startWalking(double x1, double y1, double x2, double y2, bool first) {}
+    virtual void startTransition() {}
+    virtual void arrived() {}
+};
+
+// NavFingerprintLocalizer as KDTreeLocalization uses it
+class NavReplayFingerprintLocalizer : public NavReplayLocalizer {
+public:
+    explicit NavReplayFingerprintLocalizer(std::shared_ptr<NavFingerprintLocalizer> localizer) : mLocalizer(localizer) {}
+
+    void reset() { mLocalizer->reset(); }
+    void putBeacons(const NavBeaconFrame& frame) { mLocalizer->putBeacons(frame); }
+    bool hasPosition() const { return mLocalizer->hasResult(); }
+    Position position() const;
+    bool checksNextEdge() const { return true; }
+
+    NavFingerprintLocalizer& localizer() const { return *mLocalizer; }
+
+private:
+    std::shared_ptr<NavFingerprintLocalizer> mLocalizer;
+};
+
+struct NavReplayTracePoint {
+    int64_t timestamp; // log time in ms
+    int localizer;
+    float x, y, floor, knndist;
+    int stateNum;
+};
+
+// what the navigation state machine did, see NavStateProgress
+struct NavReplayStateEvent {
+    int64_t timestamp;
+    int state;
+    NavStateProgress::Action action;
+    float dist, knndist;
+    int announcedDistance;
+};
+
+struct NavReplayLatency {
+    size_t num;
+    // time to feed one event to all localizers, in microseconds
+    double mean, p50, p99, max;
+};
+
+struct NavReplayReport {
+    size_t eventNum, beaconNum, accNum, motionNum;
+    double wallMs;  // time spent replaying
+    double logMs;   // log time covered by the events
+    NavReplayLatency beaconLatency, accLatency, motionLatency;
+    // per scan: building the NavBeaconFrame once, and each localizer's share
+    // of beaconLatency in the order of addLocalizer
+    NavReplayLatency frameLatency;
+    std::vector<NavReplayLatency> localizerLatencies;
+    std::string from, to;
+    // navigation, states are counted when they start
+    size_t stateNum, statesStarted, announceNum, approachingNum, arrivedNum, transitedNum;
+    double navigationMs; // from the start of the first state to the end of the last one, 0 if not finished
+};
+
+// Replays a NavLog text log as fast as possible without Foundation or GCD.
+//
+// Events are fed in log order on a virtual clock: scans and sensor samples
+// carry the log time instead of the wall clock, so time dependent behaviour
+// of the localizers is the same as in the recording. Every localizer gets
+// every event, the trace holds each localizer's position after each scan.
+//
+// The State lines NavMachine logs after planning a route drive the
+// navigation state machine. After each scan the current state takes the
+// position of its edge's localizer on the edge, as NavEdgeLocalizer does,
+// and NavStateProgress decides as in NavState. The localizers are
+// initialized for the states as NavState does it; speech, timers and the
+// turning phase of NavMachine are not replayed. Only navlogreplay builds
+// this, it is not part of the app target.
+class NavLogReplay {
+public:
+    NavLogReplay();
+
+    int addLocalizer(const std::string& name, std::shared_ptr<NavReplayLocalizer> localizer);
+    int localizerNum() const { return (int)mLocalizers.size(); }
+    const std::string& localizerName(int i) const { return mNames[i]; }
+
+    bool run(const std::string& logPath);
+
+    const NavReplayReport& report() const { return mReport; }
+    const std::vector<NavReplayTracePoint>& trace() const { return mTrace; }
+    const std::vector<NavReplayStateEvent>& stateEvents() const { return mStateEvents; }
+
+    // timestamp,localizer,x,y,floor,knndist,states
+    bool writeTrace(const std::string& path) const;
+    // timestamp,state,edge,action,dist,knndist,announced
+    bool writeStates(const std::string& path) const;
+    void printReport(FILE* out) const;
+
+private:
+    struct State {
+        NavLogState log;
+        int localizer; // -1 without one
+        NavStateProgress progress;
+    };
+
+    void begin();
+    void feed(const NavLogEvent& event);
+    void finish(double wallMs);
+    void addState(const NavLogState& state);
+    void updateState(int64_t timestamp);
+    void startState(State& state);
+    bool onEdge(const State& state, double& x, double& y, float& knndist);
+    int localizerIndex(const std::string& name) const;
+    static NavReplayLatency latency(std::vector<float>& latencies);
+
+    std::vector<std::string> mNames;
+    std::vector<std::shared_ptr<NavReplayLocalizer> > mLocalizers;
+    std::vector<NavReplayTracePoint> mTrace;
+    std::vector<float> mBeaconLatencies, mAccLatencies, mMotionLatencies, mFrameLatencies;
+    std::vector<std::vector<float> > mLocalizerLatencies;
+    NavReplayReport mReport;
+    int64_t mFirstTimestamp;
+    int64_t mLastTimestamp;
+    uint64_t mFrameID;
+
+    std::vector<State> mStates;
+    int mCurrentState;
+    int64_t mNavigationStart;
+    std::vector<NavReplayStateEvent> mStateEvents;
+};
+
+#endif /* NavLogReplay_hpp */
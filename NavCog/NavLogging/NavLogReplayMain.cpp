@@ -0,0 +1,382 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+// Command line front end of NavLogReplay. It is not part of the app target,
+// on Linux or macOS build it with
+//
+//   c++ -std=c++11 -O2 -INavCog/Model/Localization -INavCog/Model/StateMachine -INavCog/NavLogging
+//       NavCog/NavLogging/NavLogReplayMain.cpp NavCog/NavLogging/NavLogReplay.cpp
+//       NavCog/NavLogging/NavLogEvent.cpp NavCog/NavLogging/NavLogReader.cpp
+//       NavCog/NavLogging/NavBinaryLog.cpp NavCog/Model/StateMachine/NavStateProgress.cpp
+//       NavCog/Model/Localization/NavFingerprintLocalizer.cpp NavCog/Model/Localization/NavPolylineDistance.cpp
+//       NavCog/Model/Localization/NavFingerprintData.cpp NavCog/Model/Localization/NavKNNSearch.cpp
+//       -pthread -o navlogreplay
+//
+// and for the 1D and 2D particle localizers additionally with bleloc and its
+// dependencies (Eigen, Boost, picojson, OpenCV for the floor images)
+//
+//       -DNAV_REPLAY_PARTICLE -I<bleloc include> -I<picojson>
+//       NavCog/NavLogging/NavLogReplayParticle.cpp NavCog/Model/Localization/NavParticleLocalizer.cpp
+//       NavCog/Model/Localization/NavKLDSampling.cpp -lbleloc -lopencv_core -lopencv_imgcodecs
+//
+// usage: navlogreplay [options] log [fingerprint...]
+//   -k id=fingerprint          KDTreeLocalization with the localizer ID of the State lines
+//   -1 id=samples:beacons.csv  OneDLocalizer, beacons as uuid,major,minor,x,y in map units
+//   -2 id=localizer.json       TwoDLocalizer
+//   -b auto|bruteforce|sparse  kNN backend of the fingerprint localizers
+//   -a min,max                 KLD-sampling between min and max states, 0,n for n states
+//   -c min,max                 accuracy against cost, repeatable, see sweepStates
+//   -u meter                   meters per map unit (0.3048)
+//   -w white.png               floor image of the 1D localizers
+//   -o trace.csv -s states.csv positions after each scan, navigation state changes
+//   -v                         diagnostic lines of the localizers to stderr
+//        navlogreplay -p log    (parse throughput only)
+//        navlogreplay -l dir    (sensor logging overhead per sample, binary vs text)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "NavLogReplay.hpp"
+#include "NavLogReader.hpp"
+#include "NavBinaryLog.hpp"
+#ifdef NAV_REPLAY_PARTICLE
+#include "NavLogReplayParticle.hpp"
+#endif
+
+static int benchmarkParse(const char* path)
+{
+    NavLogReader reader;
+    if (!reader.open(path)) {
+        fprintf(stderr, "could not read log %s\n", path);
+        return 1;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    NavLogEvent event;
+    size_t eventNum = 0;
+    while (reader.next(event)) {
+        eventNum++;
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("parsed %zu lines, %zu events, %.1f MB in %.1f ms: %.1f MB/s, %.0f events/s\n",
+           reader.lineNum(), eventNum, reader.length() / 1e6, sec * 1000,
+           sec > 0 ? reader.length() / 1e6 / sec : 0, sec > 0 ? eventNum / sec : 0);
+    return 0;
+}
+
+// Acc samples in bursts of 100 Hz * 1 s, the text baseline formats the line
+// and writes it like NSLog to a redirected stderr does
+static int benchmarkLogging(const std::string& dir)
+{
+    const int burst = 100, burstNum = 200;
+    std::string binaryPath = dir + "/bench.navlog", textPath = dir + "/bench.log", convertedPath = dir + "/bench-converted.log";
+    
+    NavBinaryLog log;
+    if (!log.open(binaryPath, 0)) {
+        fprintf(stderr, "could not open %s\n", binaryPath.c_str());
+        return 1;
+    }
+    double binarySec = 0;
+    for (int i = 0; i < burstNum; i++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int j = 0; j < burst; j++) {
+            log.logAcc(i * 0.001, j * 0.001, -1);
+        }
+        binarySec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    log.close();
+    
+    FILE* text = fopen(textPath.c_str(), "w");
+    if (!text) {
+        fprintf(stderr, "could not open %s\n", textPath.c_str());
+        return 1;
+    }
+    double textSec = 0;
+    for (int i = 0; i < burstNum; i++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int j = 0; j < burst; j++) {
+            char line[128];
+            int n = snprintf(line, sizeof(line), "2016-03-01 10:20:30.000 NavCog[%d:%d] Acc,%.9g,%.9g,%.9g\n",
+                             (int)getpid(), 0, i * 0.001, j * 0.001, -1.0);
+            fwrite(line, 1, n, text);
+            fflush(text);
+        }
+        textSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    fclose(text);
+    
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!NavBinaryLog::convertToText(binaryPath, convertedPath)) {
+        fprintf(stderr, "could not convert %s\n", binaryPath.c_str());
+        return 1;
+    }
+    double convertSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    int sampleNum = burst * burstNum;
+    printf("binary %.1f ns/sample (%llu dropped), text %.1f ns/sample, conversion %.1f ms for %d samples\n",
+           binarySec * 1e9 / sampleNum, (unsigned long long)log.droppedNum(), textSec * 1e9 / sampleNum,
+           convertSec * 1000, sampleNum);
+    return 0;
+}
+
+// "id=value" of -k, -1 and -2
+static bool splitOption(const std::string& option, std::string& id, std::string& value)
+{
+    size_t eq = option.find('=');
+    if (eq == std::string::npos || eq == 0) {
+        return false;
+    }
+    id = option.substr(0, eq);
+    value = option.substr(eq + 1);
+    return true;
+}
+
+static std::shared_ptr<NavReplayLocalizer> loadFingerprint(const std::string& path, const std::string& backend, bool verbose)
+{
+    std::shared_ptr<NavFingerprintData> fingerprint = std::make_shared<NavFingerprintData>();
+    if (!fingerprint->loadFile(path)) {
+        fprintf(stderr, "could not load fingerprint %s\n", path.c_str());
+        return nullptr;
+    }
+    std::shared_ptr<NavKNNSearch> searcher = NavFingerprintLocalizer::createSearcher(*fingerprint, backend);
+    if (!searcher) {
+        fprintf(stderr, "unknown backend %s\n", backend.c_str());
+        return nullptr;
+    }
+    std::shared_ptr<NavFingerprintLocalizer> localizer = std::make_shared<NavFingerprintLocalizer>(fingerprint, searcher);
+    if (verbose) {
+        localizer->logHandler([](const char* line) { fprintf(stderr, "%s\n", line); });
+    }
+    return std::make_shared<NavReplayFingerprintLocalizer>(localizer);
+}
+
+#ifdef NAV_REPLAY_PARTICLE
+// mean and 95th percentile distance in feet between the positions after the
+// same scans of trace and reference, -1 without common scans
+static void traceError(const std::vector<NavReplayTracePoint>& trace, const std::vector<NavReplayTracePoint>& reference,
+                       double& mean, double& p95)
+{
+    std::map<std::pair<int64_t, int>, const NavReplayTracePoint*> byScan;
+    for (const NavReplayTracePoint& p : reference) {
+        byScan[std::make_pair(p.timestamp, p.localizer)] = &p;
+    }
+    std::vector<double> errors;
+    for (const NavReplayTracePoint& p : trace) {
+        auto it = byScan.find(std::make_pair(p.timestamp, p.localizer));
+        if (it != byScan.end()) {
+            errors.push_back(hypot(p.x - it->second->x, p.y - it->second->y));
+        }
+    }
+    mean = p95 = -1;
+    if (errors.empty()) {
+        return;
+    }
+    double sum = 0;
+    for (double e : errors) {
+        sum += e;
+    }
+    mean = sum / errors.size();
+    std::sort(errors.begin(), errors.end());
+    p95 = errors[std::min(errors.size() - 1, errors.size() * 95 / 100)];
+}
+
+// Accuracy against cost of the particle localizers as CSV. The log is
+// replayed with the reference range (-a, fixed 1000 states by default) and
+// then once per range, the first line repeats the reference so its error is
+// the run to run noise. The error is the distance to the reference position
+// after the same scan, the cost the mean number of states and the latency of
+// beacon and acceleration events.
+static int sweepStates(NavLogReplay& replay, const std::vector<std::shared_ptr<NavReplayParticleLocalizer> >& particles,
+                       const std::string& logPath, std::pair<int, int> reference,
+                       const std::vector<std::pair<int, int> >& ranges, FILE* out)
+{
+    auto run = [&](std::pair<int, int> range) {
+        for (auto& localizer : particles) {
+            localizer->particle().stateNumRange(range.first, range.second);
+        }
+        return replay.run(logPath);
+    };
+    if (!run(reference)) {
+        fprintf(stderr, "could not read log %s\n", logPath.c_str());
+        return 1;
+    }
+    std::vector<NavReplayTracePoint> referenceTrace = replay.trace();
+    std::vector<std::pair<int, int> > all(1, reference);
+    all.insert(all.end(), ranges.begin(), ranges.end());
+    fprintf(out, "min,max,states,beacon_us,beacon_p99_us,acc_us,error_mean_ft,error_p95_ft,arrived\n");
+    for (const auto& range : all) {
+        run(range);
+        const NavReplayReport& r = replay.report();
+        double states = 0;
+        for (const NavReplayTracePoint& p : replay.trace()) {
+            states += p.stateNum;
+        }
+        double mean, p95;
+        traceError(replay.trace(), referenceTrace, mean, p95);
+        fprintf(out, "%d,%d,%.1f,%.1f,%.1f,%.1f,%.2f,%.2f,%zu\n", range.first, range.second,
+                replay.trace().empty() ? 0 : states / replay.trace().size(), r.beaconLatency.mean,
+                r.beaconLatency.p99, r.accLatency.mean, mean, p95, r.arrivedNum);
+    }
+    return 0;
+}
+#endif
+
+static void usage(const char* name)
+{
+    fprintf(stderr, "usage: %s [-k id=fingerprint] [-1 id=samples:beacons.csv] [-2 id=localizer.json]\n"
+            "          [-b auto|bruteforce|sparse] [-a min,max] [-c min,max]... [-u meter] [-w white.png]\n"
+            "          [-o trace.csv] [-s states.csv] [-v] log [fingerprint...]\n", name);
+}
+
+int main(int argc, char* argv[])
+{
+    std::string backend = "auto", tracePath, statesPath, imagePath = "NavCog/Model/Localization/white.png";
+    std::vector<std::string> paths;
+    std::vector<std::pair<std::string, std::string> > fingerprints, oneDs, twoDs;
+    std::vector<std::pair<int, int> > ranges;
+    int minStates = 0, maxStates = 1000;
+    double unitToMeter = 0.3048;
+    bool verbose = false;
+    for (int i = 1; i < argc; i++) {
+        std::string id, value;
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            return benchmarkParse(argv[i + 1]);
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            return benchmarkLogging(argv[i + 1]);
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            backend = argv[++i];
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            statesPath = argv[++i];
+        } else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d", &minStates, &maxStates) != 2) {
+                usage(argv[0]);
+                return 2;
+            }
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            std::pair<int, int> range;
+            if (sscanf(argv[++i], "%d,%d", &range.first, &range.second) != 2) {
+                usage(argv[0]);
+                return 2;
+            }
+            ranges.push_back(range);
+        } else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+            unitToMeter = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            imagePath = argv[++i];
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if ((strcmp(argv[i], "-k") == 0 || strcmp(argv[i], "-1") == 0 || strcmp(argv[i], "-2") == 0) &&
+                   i + 1 < argc && splitOption(argv[i + 1], id, value)) {
+            char kind = argv[i][1];
+            i++;
+            (kind == 'k' ? fingerprints : kind == '1' ? oneDs : twoDs).push_back(std::make_pair(id, value));
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    for (size_t i = 1; i < paths.size(); i++) {
+        fingerprints.push_back(std::make_pair(paths[i], paths[i]));
+    }
+    if (paths.empty() || fingerprints.size() + oneDs.size() + twoDs.size() == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    
+    NavLogReplay replay;
+    for (const auto& f : fingerprints) {
+        std::shared_ptr<NavReplayLocalizer> localizer = loadFingerprint(f.second, backend, verbose);
+        if (!localizer) {
+            return 1;
+        }
+        replay.addLocalizer(f.first, localizer);
+    }
+#ifdef NAV_REPLAY_PARTICLE
+    std::vector<std::shared_ptr<NavReplayParticleLocalizer> > particles;
+    for (const auto& d : oneDs) {
+        size_t colon = d.second.rfind(':');
+        if (colon == std::string::npos) {
+            usage(argv[0]);
+            return 2;
+        }
+        std::string error;
+        std::shared_ptr<NavReplayParticleLocalizer> localizer =
+        NavReplayParticleLocalizer::loadOneD(d.first, d.second.substr(0, colon), d.second.substr(colon + 1),
+                                             imagePath, unitToMeter, error);
+        if (!localizer) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        particles.push_back(localizer);
+    }
+    for (const auto& d : twoDs) {
+        std::string error;
+        std::shared_ptr<NavReplayParticleLocalizer> localizer = NavReplayParticleLocalizer::loadTwoD(d.first, d.second, "/tmp", error);
+        if (!localizer) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        particles.push_back(localizer);
+    }
+    for (auto& localizer : particles) {
+        localizer->particle().stateNumRange(minStates, maxStates);
+        if (verbose) {
+            localizer->particle().logHandler([](const char* line) { fprintf(stderr, "%s\n", line); });
+        }
+        replay.addLocalizer(localizer->particle().name(), localizer);
+    }
+    if (!ranges.empty()) {
+        return sweepStates(replay, particles, paths[0], std::make_pair(minStates, maxStates), ranges, stdout);
+    }
+#else
+    if (!oneDs.empty() || !twoDs.empty() || !ranges.empty()) {
+        fprintf(stderr, "built without NAV_REPLAY_PARTICLE, -1, -2 and -c need bleloc\n");
+        return 2;
+    }
+    (void)minStates;
+    (void)maxStates;
+    (void)unitToMeter;
+#endif
+    if (!replay.run(paths[0])) {
+        fprintf(stderr, "could not read log %s\n", paths[0].c_str());
+        return 1;
+    }
+    replay.printReport(stdout);
+    if (!tracePath.empty() && !replay.writeTrace(tracePath)) {
+        fprintf(stderr, "could not write trace %s\n", tracePath.c_str());
+        return 1;
+    }
+    if (!statesPath.empty() && !replay.writeStates(statesPath)) {
+        fprintf(stderr, "could not write states %s\n", statesPath.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,339 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavLogReplayParticle.hpp"
+#include <math.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <picojson.h>
+#include <bleloc/Building.hpp>
+#include <bleloc/DataUtils.hpp>
+
+using namespace loc;
+
+static const double kFeetInMeter = 0.3048;
+
+NavReplayParticleLocalizer::NavReplayParticleLocalizer(std::shared_ptr<NavParticleLocalizer> particle, bool oneD)
+: mParticle(particle), mOneD(oneD), mResetPending(false)
+{
+}
+
+namespace {
+
+bool readFile(const std::string& path, std::string& data)
+{
+    std::ifstream ifs(path.c_str(), std::ios::binary);
+    if (!ifs) {
+        return false;
+    }
+    std::ostringstream os;
+    os << ifs.rdbuf();
+    data = os.str();
+    return true;
+}
+
+int base64Value(char c)
+{
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+// as NavUtil dataFromDataString:type:, "data:<mime>;base64,..." is decoded
+// ignoring unknown characters, anything else is text of type "txt"
+std::string dataFromDataString(const std::string& dataStr, std::string* type)
+{
+    static const char kPrefix[] = "data:";
+    size_t marker = dataStr.find(";base64,");
+    if (dataStr.compare(0, strlen(kPrefix), kPrefix) != 0 || marker == std::string::npos) {
+        if (type) {
+            *type = "txt";
+        }
+        return dataStr;
+    }
+    if (type) {
+        std::string mime = dataStr.substr(strlen(kPrefix), marker - strlen(kPrefix));
+        size_t slash = mime.find('/');
+        *type = slash == std::string::npos ? mime : mime.substr(slash + 1);
+        if (type->compare(0, 2, "x-") == 0) {
+            type->erase(0, 2);
+        }
+    }
+    std::string data;
+    data.reserve((dataStr.size() - marker) * 3 / 4);
+    int bits = 0, value = 0;
+    for (size_t i = marker + 8; i < dataStr.size(); i++) {
+        int v = base64Value(dataStr[i]);
+        if (v < 0) {
+            continue;
+        }
+        value = (value << 6) | v;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            data.push_back((char)((value >> bits) & 0xff));
+        }
+    }
+    return data;
+}
+
+const picojson::value& member(const picojson::value& object, const char* key)
+{
+    return object.get(key);
+}
+
+std::string stringMember(const picojson::value& object, const char* key)
+{
+    const picojson::value& v = member(object, key);
+    return v.is<std::string>() ? v.get<std::string>() : std::string();
+}
+
+double numberMember(const picojson::value& object, const char* key)
+{
+    const picojson::value& v = member(object, key);
+    return v.is<double>() ? v.get<double>() : 0;
+}
+
+} // namespace
+
+std::shared_ptr<NavReplayParticleLocalizer> NavReplayParticleLocalizer::loadOneD(const std::string& name,
+                                                                                 const std::string& samplesPath,
+                                                                                 const std::string& beaconsPath,
+                                                                                 const std::string& imagePath,
+                                                                                 double unitToMeter, std::string& error)
+{
+    std::shared_ptr<DataStoreImpl> dataStore = std::make_shared<DataStoreImpl>();
+    
+    // the flat floor of OneDLocalizer
+    BuildingBuilder buildingBuilder;
+    CoordinateSystemParameters coordSysParams(8, -8, 1, 1000, 1000, 0);
+    buildingBuilder.addFloorCoordinateSystemParametersAndImagePath(0, coordSysParams, imagePath);
+    dataStore->building(buildingBuilder.build());
+    
+    std::ifstream samplesStream(samplesPath.c_str());
+    Samples samples;
+    std::vector<std::string> beaconIDs;
+    if (!samplesStream || !NavParticleLocalizer::readOneDSamples(samplesStream, unitToMeter, samples, beaconIDs)) {
+        error = "could not read samples " + samplesPath;
+        return nullptr;
+    }
+    dataStore->samples(samples);
+    
+    std::ifstream beaconsStream(beaconsPath.c_str());
+    if (!beaconsStream) {
+        error = "could not read beacons " + beaconsPath;
+        return nullptr;
+    }
+    BLEBeacons bleBeacons;
+    std::string line;
+    while (std::getline(beaconsStream, line)) {
+        std::istringstream fields(line);
+        std::string uuid, major, minor, x, y;
+        if (!std::getline(fields, uuid, ',') || !std::getline(fields, major, ',') || !std::getline(fields, minor, ',') ||
+            !std::getline(fields, x, ',') || !std::getline(fields, y, ',')) {
+            continue;
+        }
+        bleBeacons.push_back(BLEBeacon(uuid, atoi(major.c_str()), atoi(minor.c_str()),
+                                       atof(x.c_str()) * unitToMeter, atof(y.c_str()) * unitToMeter, 0, 0));
+    }
+    dataStore->bleBeacons(bleBeacons);
+    
+    std::shared_ptr<NavParticleLocalizer> particle = std::make_shared<NavParticleLocalizer>(name, NavParticleLocalizer::Config::oneD());
+    particle->initialize(dataStore);
+    
+    GaussianProcessLDPLMultiModelTrainer<State, Beacons> trainer;
+    trainer.dataStore(dataStore);
+    std::shared_ptr<NavParticleLocalizer::ObservationModel> model(trainer.train());
+    model->fillsUnknownBeaconRssi(false);
+    particle->observationModel(model);
+    return std::make_shared<NavReplayParticleLocalizer>(particle, true);
+}
+
+std::shared_ptr<NavReplayParticleLocalizer> NavReplayParticleLocalizer::loadTwoD(const std::string& name,
+                                                                                 const std::string& jsonPath,
+                                                                                 const std::string& tempDir, std::string& error)
+{
+    std::string text;
+    if (!readFile(jsonPath, text)) {
+        error = "could not read " + jsonPath;
+        return nullptr;
+    }
+    picojson::value json;
+    std::string parseError = picojson::parse(json, text);
+    if (!parseError.empty() || !json.is<picojson::object>()) {
+        error = jsonPath + ": " + parseError;
+        return nullptr;
+    }
+    text.clear();
+    
+    std::shared_ptr<NavParticleLocalizer::ObservationModel> model = std::make_shared<NavParticleLocalizer::ObservationModel>();
+    {
+        std::istringstream is(dataFromDataString(stringMember(json, "ObservationModelParameters"), NULL));
+        model->load(is);
+    }
+    
+    std::shared_ptr<DataStoreImpl> dataStore = std::make_shared<DataStoreImpl>();
+    BuildingBuilder buildingBuilder;
+    const picojson::value& layers = member(json, "layers");
+    if (layers.is<picojson::array>()) {
+        const picojson::array& floors = layers.get<picojson::array>();
+        for (size_t i = 0; i < floors.size(); i++) {
+            const picojson::value& param = member(floors[i], "param");
+            CoordinateSystemParameters coordSysParams(numberMember(param, "ppmx"), numberMember(param, "ppmy"),
+                                                      numberMember(param, "ppmz"), numberMember(param, "originx"),
+                                                      numberMember(param, "originy"), numberMember(param, "originz"));
+            std::string type;
+            std::string data = dataFromDataString(stringMember(floors[i], "data"), &type);
+            std::ostringstream path;
+            path << tempDir << "/" << name << "-building" << i << "." << type;
+            std::ofstream ofs(path.str().c_str(), std::ios::binary);
+            ofs.write(data.data(), data.size());
+            if (!ofs) {
+                error = "could not write " + path.str();
+                return nullptr;
+            }
+            ofs.close();
+            buildingBuilder.addFloorCoordinateSystemParametersAndImagePath((int)i, coordSysParams, path.str());
+        }
+    }
+    dataStore->building(buildingBuilder.build());
+    
+    const picojson::value& samples = member(json, "samples");
+    if (samples.is<picojson::array>()) {
+        for (const picojson::value& sample : samples.get<picojson::array>()) {
+            std::istringstream is(dataFromDataString(stringMember(sample, "data"), NULL));
+            dataStore->readSamples(is);
+        }
+    }
+    BLEBeacons bleBeacons;
+    const picojson::value& beacons = member(json, "beacons");
+    if (beacons.is<picojson::array>()) {
+        for (const picojson::value& beacon : beacons.get<picojson::array>()) {
+            std::istringstream is(dataFromDataString(stringMember(beacon, "data"), NULL));
+            BLEBeacons bleBeaconsTmp = DataUtils::csvBLEBeaconsToBLEBeacons(is);
+            bleBeacons.insert(bleBeacons.end(), bleBeaconsTmp.begin(), bleBeaconsTmp.end());
+        }
+    }
+    dataStore->bleBeacons(bleBeacons);
+    
+    std::shared_ptr<NavParticleLocalizer> particle = std::make_shared<NavParticleLocalizer>(name, NavParticleLocalizer::Config::twoD());
+    particle->initialize(dataStore);
+    particle->observationModel(model);
+    return std::make_shared<NavReplayParticleLocalizer>(particle, false);
+}
+
+void NavReplayParticleLocalizer::reset()
+{
+    mResetPending = false;
+    mParticle->resetStateNum();
+    mParticle->resetStatus();
+}
+
+void NavReplayParticleLocalizer::putBeacons(const NavBeaconFrame& frame)
+{
+    if (frame.empty() || frame.isRunTest()) {
+        return;
+    }
+    mParticle->putBeacons(NavParticleLocalizer::beacons(frame));
+}
+
+void NavReplayParticleLocalizer::putAcceleration(int64_t timestamp, const double* values)
+{
+    mParticle->putAcceleration((long)timestamp, values[0], values[1], values[2]);
+}
+
+void NavReplayParticleLocalizer::putMotion(int64_t timestamp, const double* values)
+{
+    mParticle->putAttitude((long)timestamp, values[0], values[1], values[2]);
+    tryReset();
+}
+
+NavReplayLocalizer::Position NavReplayParticleLocalizer::position() const
+{
+    std::shared_ptr<Location> loc = mParticle->meanLocation();
+    Position p = {0, 0, 0, 0.25f};
+    if (loc) {
+        p.x = (float)(loc->x() / kFeetInMeter);
+        p.y = (float)(loc->y() / kFeetInMeter);
+        p.floor = (float)loc->floor();
+    }
+    return p;
+}
+
+float NavReplayParticleLocalizer::distanceScore(const double* segments, int segmentNum)
+{
+    if (mOneD) {
+        return (float)mParticle->particleDistanceScore(segments, segmentNum);
+    }
+    if (!mParticle->states()) {
+        return 100 * 100;
+    }
+    // TwoDLocalizer computeDistanceScoreWithOptionsTransit:, 2 m threshold
+    return (float)(mParticle->meanDistance(segments, segmentNum) * kFeetInMeter / 2.0);
+}
+
+void NavReplayParticleLocalizer::startWalking(double x1, double y1, double x2, double y2, bool first)
+{
+    mParticle->resetStateNum();
+    if (!mOneD && !first) {
+        return;
+    }
+    // NavState passes no floor
+    mResetPose = Pose();
+    mResetPose.x(x1 * kFeetInMeter).y(y1 * kFeetInMeter).z(0).floor(0).orientation(atan2(y2 - y1, x2 - x1));
+    if (mOneD) {
+        mParticle->resetStatus(mResetPose);
+    } else {
+        mResetPending = true;
+        tryReset();
+    }
+}
+
+// TwoDLocalizer tryReset: without the timer
+void NavReplayParticleLocalizer::tryReset()
+{
+    if (mResetPending && mParticle->orientationUpdated()) {
+        mResetPending = false;
+        mParticle->resetStatus();
+        mParticle->resetStatus(mResetPose);
+    }
+}
+
+void NavReplayParticleLocalizer::startTransition()
+{
+    mParticle->resetStateNum();
+    if (mOneD) {
+        mParticle->resetStatus();
+    }
+}
+
+void NavReplayParticleLocalizer::arrived()
+{
+    mParticle->resetStateNum();
+    if (mOneD) {
+        mParticle->resetStatus();
+    }
+}
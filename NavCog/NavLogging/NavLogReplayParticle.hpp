@@ -0,0 +1,84 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavLogReplayParticle_hpp
+#define NavLogReplayParticle_hpp
+
+#include <memory>
+#include <string>
+#include "NavLogReplay.hpp"
+#include "NavParticleLocalizer.hpp"
+
+// NavParticleLocalizer as OneDLocalizer and TwoDLocalizer use it, for
+// NavLogReplay. Kept apart from NavLogReplay so the fingerprint replay builds
+// without bleloc.
+//
+// The localizers are initialized for the states as in the app: the 1D
+// localizer is reset to the start of each walking edge and all reset for
+// transitions and on arrival, the 2D localizer is reset to the start of the
+// first edge once the orientation is known. The distance score is the
+// particle based one, of OneDLocalizer with particle_score_preference and of
+// TwoDLocalizer in the transit mode; the transit tables the 1D localizer
+// switches to during transitions are not replayed.
+class NavReplayParticleLocalizer : public NavReplayLocalizer {
+public:
+    NavReplayParticleLocalizer(std::shared_ptr<NavParticleLocalizer> particle, bool oneD);
+
+    // as OneDLocalizer initializeWithFile: and setBeacons:, the beacons are
+    // lines of uuid,major,minor,x,y with x and y in map units, the image is
+    // white.png of the app, the observation model is trained
+    static std::shared_ptr<NavReplayParticleLocalizer> loadOneD(const std::string& name,
+                                                                const std::string& samplesPath,
+                                                                const std::string& beaconsPath,
+                                                                const std::string& imagePath,
+                                                                double unitToMeter, std::string& error);
+    // as TwoDLocalizer initializeWithJSON: from the localizer's JSON, the
+    // floor images are written to tempDir
+    static std::shared_ptr<NavReplayParticleLocalizer> loadTwoD(const std::string& name,
+                                                                const std::string& jsonPath,
+                                                                const std::string& tempDir, std::string& error);
+
+    void reset();
+    void putBeacons(const NavBeaconFrame& frame);
+    void putAcceleration(int64_t timestamp, const double* values);
+    void putMotion(int64_t timestamp, const double* values);
+    bool hasPosition() const { return mParticle->meanLocation() != nullptr; }
+    Position position() const;
+    float distanceScore(const double* segments, int segmentNum);
+    int stateNum() const { return mParticle->stateNum(); }
+
+    void startWalking(double x1, double y1, double x2, double y2, bool first);
+    void startTransition();
+    void arrived();
+
+    NavParticleLocalizer& particle() const { return *mParticle; }
+
+private:
+    void tryReset();
+
+    std::shared_ptr<NavParticleLocalizer> mParticle;
+    bool mOneD;
+    bool mResetPending; // 2D, until the orientation is known
+    loc::Pose mResetPose;
+};
+
+#endif /* NavLogReplayParticle_hpp */
@@ -0,0 +1,155 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#include "NavStatusFrame.hpp"
+#include <string.h>
+#include <algorithm>
+
+namespace {
+
+struct Quantized {
+    int32_t floor, x, y;
+    uint8_t orientation;
+    bool operator<(const Quantized& q) const
+    {
+        if (floor != q.floor) return floor < q.floor;
+        if (x != q.x) return x < q.x;
+        return y < q.y;
+    }
+};
+
+void putBytes(std::vector<uint8_t>& out, const void* p, size_t n)
+{
+    // every supported target is little endian
+    const uint8_t* b = (const uint8_t*)p;
+    out.insert(out.end(), b, b + n);
+}
+
+void putVarint(std::vector<uint8_t>& out, int32_t v)
+{
+    uint32_t z = ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+    while (z >= 0x80) {
+        out.push_back((uint8_t)(z | 0x80));
+        z >>= 7;
+    }
+    out.push_back((uint8_t)z);
+}
+
+bool getVarint(const uint8_t*& p, const uint8_t* end, int32_t& v)
+{
+    uint32_t z = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (p >= end) {
+            return false;
+        }
+        uint8_t b = *p++;
+        z |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            v = (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+}
+
+NavStatusFrame::NavStatusFrame(int maxParticles, double step)
+: mMaxParticles(std::max(1, maxParticles)), mStep(step)
+{
+}
+
+void NavStatusFrame::encode(int64_t timestamp, const NavStatusPose& mean, NavStatusParticle* particles, int n,
+                            int stateNum, std::vector<uint8_t>& out) const
+{
+    n = std::min(n, 0xFFFF);
+    std::vector<Quantized> q(n);
+    for (int i = 0; i < n; i++) {
+        double turns = particles[i].orientation / (2 * M_PI);
+        q[i].floor = (int32_t)lround(particles[i].floor);
+        q[i].x = (int32_t)lround(particles[i].x / mStep);
+        q[i].y = (int32_t)lround(particles[i].y / mStep);
+        q[i].orientation = (uint8_t)((int64_t)lround((turns - floor(turns)) * 256) & 0xFF);
+    }
+    std::sort(q.begin(), q.end());
+    
+    out.clear();
+    out.reserve(48 + n * 5);
+    putBytes(out, NAV_STATUS_FRAME_MAGIC, 4);
+    out.push_back(NAV_STATUS_FRAME_VERSION);
+    out.push_back(0);
+    uint16_t particleNum = (uint16_t)n;
+    uint32_t states = (uint32_t)stateNum;
+    float step = (float)mStep;
+    putBytes(out, &particleNum, sizeof(particleNum));
+    putBytes(out, &states, sizeof(states));
+    putBytes(out, &timestamp, sizeof(timestamp));
+    putBytes(out, &mean, sizeof(mean));
+    putBytes(out, &step, sizeof(step));
+    Quantized prev = {0, 0, 0, 0};
+    for (const Quantized& p : q) {
+        putVarint(out, p.floor - prev.floor);
+        putVarint(out, p.x - prev.x);
+        putVarint(out, p.y - prev.y);
+        out.push_back(p.orientation);
+        prev = p;
+    }
+}
+
+bool NavStatusFrame::decode(const uint8_t* data, size_t length, int64_t& timestamp, NavStatusPose& mean,
+                            std::vector<NavStatusParticle>& particles, int* stateNum)
+{
+    const size_t headerSize = 4 + 2 + 2 + 4 + 8 + sizeof(NavStatusPose) + 4;
+    if (length < headerSize || memcmp(data, NAV_STATUS_FRAME_MAGIC, 4) != 0 || data[4] != NAV_STATUS_FRAME_VERSION) {
+        return false;
+    }
+    uint16_t particleNum;
+    uint32_t states;
+    float step;
+    const uint8_t* p = data + 6;
+    memcpy(&particleNum, p, 2); p += 2;
+    memcpy(&states, p, 4); p += 4;
+    memcpy(&timestamp, p, 8); p += 8;
+    memcpy(&mean, p, sizeof(mean)); p += sizeof(mean);
+    memcpy(&step, p, 4); p += 4;
+    if (stateNum) {
+        *stateNum = (int)states;
+    }
+    
+    const uint8_t* end = data + length;
+    particles.resize(particleNum);
+    int32_t floorNum = 0, x = 0, y = 0;
+    for (int i = 0; i < particleNum; i++) {
+        int32_t df, dx, dy;
+        if (!getVarint(p, end, df) || !getVarint(p, end, dx) || !getVarint(p, end, dy) || p >= end) {
+            return false;
+        }
+        floorNum += df;
+        x += dx;
+        y += dy;
+        particles[i].floor = floorNum;
+        particles[i].x = x * step;
+        particles[i].y = y * step;
+        particles[i].orientation = *p++ * (float)(2 * M_PI / 256);
+    }
+    return true;
+}
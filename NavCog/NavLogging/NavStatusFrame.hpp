@@ -0,0 +1,114 @@
+/*******************************************************************************
+ * Copyright (c) 2014, 2015  IBM Corporation, Carnegie Mellon University and others
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *******************************************************************************/
+
+#ifndef NavStatusFrame_hpp
+#define NavStatusFrame_hpp
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <vector>
+
+// Compact binary frame of a localizer status for the P2P monitor.
+//
+// Frame, little endian:
+//   char[4]  magic "NVST"
+//   uint8    version
+//   uint8    reserved
+//   uint16   particle number in this frame
+//   uint32   state number before decimation
+//   int64    timestamp, ms since 1970
+//   float32  mean x, y, z, floor, orientation, velocity
+//   float32  step, meters per quantization unit of x and y
+// followed by the particles sorted by floor, x and y. Each particle is the
+// zigzag varint difference of its quantized floor, x and y to the previous
+// particle (the first one to zero) and one byte of orientation, 256 levels
+// over a full turn. With 0.1 m steps a converged cloud takes about 4 bytes
+// per particle.
+
+#define NAV_STATUS_FRAME_MAGIC "NVST"
+#define NAV_STATUS_FRAME_VERSION 1
+
+struct NavStatusPose {
+    float x, y, z, floor, orientation, velocity;
+};
+
+struct NavStatusParticle {
+    float x, y, floor, orientation;
+};
+
+class NavStatusFrame {
+public:
+    // keeps at most maxParticles states, every n-th one
+    NavStatusFrame(int maxParticles = 200, double step = 0.1);
+
+    int maxParticles() const { return mMaxParticles; }
+    double step() const { return mStep; }
+
+    // particles are sorted in place
+    void encode(int64_t timestamp, const NavStatusPose& mean, NavStatusParticle* particles, int n,
+                int stateNum, std::vector<uint8_t>& out) const;
+    static bool decode(const uint8_t* data, size_t length, int64_t& timestamp, NavStatusPose& mean,
+                       std::vector<NavStatusParticle>& particles, int* stateNum = NULL);
+
+    // decimates and encodes states with x(), y(), z(), floor(), orientation()
+    // and velocity() accessors, the mean is taken over the states if it is NULL
+    template <class States, class Pose>
+    void encodeStates(int64_t timestamp, const Pose* mean, const States& states, std::vector<uint8_t>& out)
+    {
+        int n = (int)states.size();
+        int stride = n > mMaxParticles ? (n + mMaxParticles - 1) / mMaxParticles : 1;
+        mParticles.clear();
+        NavStatusPose pose = {0, 0, 0, 0, 0, 0};
+        for (int i = 0; i < n; i++) {
+            const Pose& s = states[i];
+            if (!mean) {
+                pose.x += s.x() / n;
+                pose.y += s.y() / n;
+                pose.z += s.z() / n;
+                pose.floor += s.floor() / n;
+                pose.orientation += s.orientation() / n;
+                pose.velocity += s.velocity() / n;
+            }
+            if (i % stride == 0) {
+                NavStatusParticle p = {(float)s.x(), (float)s.y(), (float)s.floor(), (float)s.orientation()};
+                mParticles.push_back(p);
+            }
+        }
+        if (mean) {
+            pose.x = mean->x();
+            pose.y = mean->y();
+            pose.z = mean->z();
+            pose.floor = mean->floor();
+            pose.orientation = mean->orientation();
+            pose.velocity = mean->velocity();
+        }
+        encode(timestamp, pose, mParticles.data(), (int)mParticles.size(), n, out);
+    }
+
+private:
+    int mMaxParticles;
+    double mStep;
+    std::vector<NavStatusParticle> mParticles;
+};
+
+#endif /* NavStatusFrame_hpp */
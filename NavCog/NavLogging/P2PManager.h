@@ -43,6 +43,7 @@
 @property NSMutableArray *handlers;
 @property NSMutableDictionary *filePaths;
 @property NSMutableDictionary *jsons;
+@property double streamRate; // frames per second and type, p2p_status_rate_preference
 
 
 + (P2PManager*) sharedInstance;
@@ -53,6 +54,13 @@
 - (void) addFilePath:(NSString*)path withKey:(NSString*)key;
 - (void) addJSON:(NSObject*)json withKey:(NSString*)key;
 
+// Latest-only stream for frames that supersede each other, such as localizer
+// status. Frames are sent unreliably from a background queue at streamRate,
+// a frame still waiting when the next one comes is dropped. Check
+// isStreamDue: before building a frame to skip the work between sends.
+- (BOOL) isStreamDue: (NSString*) type;
+- (void) stream: (NSObject*) content withType: (NSString*) type;
+
 - (void) startBrowse;
 - (void) stopBrowse;
 - (void) invite;
@@ -26,6 +26,12 @@
 
 @interface P2PManager ()
 
+@property dispatch_queue_t streamQueue;
+@property NSMutableDictionary *streamFrames; // type -> frame waiting to be sent
+@property NSMutableDictionary *streamDue; // type -> NSDate of the next frame
+@property long streamSent;
+@property long streamDropped;
+
 @end
 
 @implementation P2PManager
@@ -52,6 +58,12 @@ static P2PManager* sharedP2PManager = nil;
     self.mSession = [[MCSession alloc] initWithPeer: self.mPeerID];
     self.mSession.delegate = self;
     NSLog(@"%@", self.mPeerID);
+    
+    double rate = [[NSUserDefaults standardUserDefaults] doubleForKey:@"p2p_status_rate_preference"];
+    self.streamRate = rate > 0 ? rate : 2;
+    self.streamQueue = dispatch_queue_create("hulop.navcog.p2pstream", DISPATCH_QUEUE_SERIAL);
+    self.streamFrames = [@{} mutableCopy];
+    self.streamDue = [@{} mutableCopy];
     return self;
 }
 
@@ -140,6 +152,49 @@ static P2PManager* sharedP2PManager = nil;
                       error:&error];
 }
 
+- (BOOL) isStreamDue: (NSString*) type{
+    if(! [self isActive]){
+        return NO;
+    }
+    @synchronized(self) {
+        NSDate *due = self.streamDue[type];
+        return due == nil || [due timeIntervalSinceNow] <= 0;
+    }
+}
+
+- (void) stream: (NSObject*) content withType: (NSString*) type{
+    @synchronized(self) {
+        self.streamDue[type] = [NSDate dateWithTimeIntervalSinceNow:1.0 / self.streamRate];
+        if (self.streamFrames[type]) {
+            self.streamFrames[type] = content;
+            self.streamDropped++;
+            return;
+        }
+        self.streamFrames[type] = content;
+    }
+    dispatch_async(self.streamQueue, ^{
+        NSObject *latest;
+        @synchronized(self) {
+            latest = self.streamFrames[type];
+            [self.streamFrames removeObjectForKey:type];
+            self.streamSent++;
+            if (self.streamSent % 100 == 0) {
+                NSLog(@"P2PStream,%ld,%ld", self.streamSent, self.streamDropped);
+            }
+        }
+        NSArray *peerIDs = self.mSession.connectedPeers;
+        if (peerIDs.count == 0) {
+            return;
+        }
+        NSData *jdata = [NSKeyedArchiver archivedDataWithRootObject:@{@"type":type, @"content":latest}];
+        NSError *error = nil;
+        [self.mSession sendData:jdata
+                        toPeers:peerIDs
+                       withMode:MCSessionSendDataUnreliable
+                          error:&error];
+    });
+}
+
 - (void)session:(MCSession *)session didReceiveData:(NSData *)data fromPeer:(MCPeerID *)peerID
 {
     //data = [NavUtil uncompressByGzip:data];
@@ -43,10 +43,11 @@
 @property (strong, nonatomic) NavMachine *navMachine;
 @property (strong, nonatomic) NSMutableArray *allFromLocationName;
 @property (strong, nonatomic) NSMutableArray *allToLocationName;
+@property (strong, nonatomic) NSMutableArray *allToLocationTitle;
 @property (strong, nonatomic) NSString *fromNodeName;
 @property (strong, nonatomic) NSString *toNodeName;
 @property (strong, nonatomic) UIButton *startNavButton;
-@property (strong, nonatomic) NSArray *pathNodes;
+@property (strong, nonatomic) NavPath *path;
 @property (nonatomic) Boolean isWebViewLoaded;
 @property (nonatomic) Boolean isSpeechEnabled;
 @property (nonatomic) Boolean isClickEnabled;
@@ -78,6 +79,7 @@
     _isWebViewLoaded = false;
     _allFromLocationName = [[NSMutableArray alloc] init];
     _allToLocationName = [[NSMutableArray alloc] init];
+    _allToLocationTitle = [[NSMutableArray alloc] init];
     _fromURL = defaultscreen;
     _fromNodeName = nil;
     _toNodeName = nil;
@@ -261,7 +263,7 @@
     if (pickerView == _fromPicker) {
         return [_allFromLocationName objectAtIndex:row];
     } else {
-        return [_allToLocationName objectAtIndex:row];
+        return [_allToLocationTitle objectAtIndex:row];
     }
 }
 
@@ -278,6 +280,7 @@
 
 // State Machine delegate's methods
 - (void)navigationFinished {
+    [self reloadDestinations];
     [_navFuncViewCtrl.view removeFromSuperview];
     [_navFuncViewCtrl runCmdWithString:@"stopNavigation()"];
 }
@@ -290,8 +293,8 @@
     
     [self.view addSubview:_navFuncViewCtrl.view];
     if (_isWebViewLoaded) {
-        _pathNodes = [_navMachine getPathNodes];
-        NavNode *startNode = [_pathNodes lastObject];
+        _path = [_navMachine getPath];
+        NavNode *startNode = [_path startNode];
         
         NSMutableString *cmd = [[NSMutableString alloc] init];
         [cmd appendString:@"setStartNode("];
@@ -300,16 +303,16 @@
         [_navFuncViewCtrl runCmdWithString:cmd];
         cmd = [[NSMutableString alloc] init];
         
-        NSArray *path = [NavUtil buildPath:_pathNodes];
-        NSString *pathStr = [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:path options:0 error:nil] encoding:NSUTF8StringEncoding];
+        NSArray *pathPoints = [NavUtil buildPath:_path];
+        NSString *pathStr = [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:pathPoints options:0 error:nil] encoding:NSUTF8StringEncoding];
         
         [cmd appendFormat:@"startNavigation(%@, \"%@\");", pathStr, startNode.layerZIndex];
         NSLog(@"%@", cmd);
         /*
         [cmd appendString:@"startNavigation(["];
-        for (int i = (int)[_pathNodes count] - 2; i >= 0; i--) {
-            [cmd appendFormat:@"'%@'",[[[_pathNodes objectAtIndex:i] preEdgeInPath] edgeID]];
-            //[cmd appendFormat:@"'%@'", ((NavNode *)[_pathNodes objectAtIndex:i]).nodeID];
+        for (int i = (int)[_path count] - 2; i >= 0; i--) {
+            [cmd appendFormat:@"'%@'",[[_path edgeToNodeAtIndex:i] edgeID]];
+            //[cmd appendFormat:@"'%@'", [_path nodeAtIndex:i].nodeID];
             if (i > 0) {
                 [cmd appendString:@","];
             }
@@ -343,6 +346,8 @@
 }
 
 - (void)didTriggerStopNavigation {
+    // before the location is reset
+    [self reloadDestinations];
     [_navFuncViewCtrl.view removeFromSuperview];
     [_navMachine stopNavigation];
     [_navFuncViewCtrl runCmdWithString:@"stopNavigation()"];
@@ -352,8 +357,8 @@
     _isWebViewLoaded = true;
     NSString *setDataCMD = [NSString stringWithFormat:@"setMapData(%@)", _mapDataString];
     [_navFuncViewCtrl runCmdWithString:setDataCMD];
-    _pathNodes = [_navMachine getPathNodes];
-    NavNode *startNode = [_pathNodes lastObject];
+    _path = [_navMachine getPath];
+    NavNode *startNode = [_path startNode];
     NSMutableString *cmd = [[NSMutableString alloc] init];
     [cmd appendString:@"setStartNode("];
     [cmd appendFormat:@"%f,", startNode.lat];
@@ -361,15 +366,15 @@
     [_navFuncViewCtrl runCmdWithString:cmd];
     cmd = [[NSMutableString alloc] init];
     
-    NSArray *path = [NavUtil buildPath:_pathNodes];
-    NSString *pathStr = [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:path options:0 error:nil] encoding:NSUTF8StringEncoding];
+    NSArray *pathPoints = [NavUtil buildPath:_path];
+    NSString *pathStr = [[NSString alloc] initWithData:[NSJSONSerialization dataWithJSONObject:pathPoints options:0 error:nil] encoding:NSUTF8StringEncoding];
     
     [cmd appendFormat:@"startNavigation(%@, \"%@\");", pathStr, startNode.layerZIndex];
     NSLog(@"%@", cmd);
     /*
     [cmd appendString:@"startNavigation(["];
-    for (int i = (int)[_pathNodes count] - 2; i >= 0; i--) {
-        [cmd appendFormat:@"'%@'", ((NavNode *)[_pathNodes objectAtIndex:i]).nodeID];
+    for (int i = (int)[_path count] - 2; i >= 0; i--) {
+        [cmd appendFormat:@"'%@'", [_path nodeAtIndex:i].nodeID];
         if (i > 0) {
             [cmd appendString:@","];
         }
@@ -428,24 +433,19 @@
     _topoMap = topoMap;
     NSArray *locations = [_topoMap getAllLocationNamesOnMapSorted:YES];
     [_allFromLocationName removeAllObjects];
-    [_allToLocationName removeAllObjects];
     for (NSString *name in locations) {
         [_allFromLocationName addObject:name];
-        [_allToLocationName addObject:name];
     }
-    if ([_allFromLocationName count] > 0 && [_allToLocationName count] > 0) {
+    if ([_allFromLocationName count] > 0) {
         _fromNodeName = [_allFromLocationName objectAtIndex:0];
-        _toNodeName = [_allToLocationName objectAtIndex:0];
         [_allFromLocationName addObject:NSLocalizedString(@"currentLocation", @"Current Location")];
     } else {
         _fromNodeName = nil;
-        _toNodeName = nil;
     }
+    _toNodeName = nil;
     
     [_fromPicker reloadAllComponents];
     [_fromPicker selectRow:0 inComponent:0 animated:false];
-    [_toPicker reloadAllComponents];
-    [_toPicker selectRow:0 inComponent:0 animated:false];
     if (_isWebViewLoaded) {
         NSString *cmd = [NSString stringWithFormat:@"setMapData(%@)", dataStr];
         [_navFuncViewCtrl runCmdWithString:cmd];
@@ -455,7 +455,41 @@
     
     _navMachine = [[NavMachine alloc] initWithTopoMap:_topoMap withUUID:[_topoMap getUUIDString]];
     _navMachine.delegate = self;
+    [self reloadDestinations];
+}
+
+// destinations by walking distance with distance and ETA while the current
+// location is known, unreachable ones after them, alphabetical otherwise
+- (void)reloadDestinations {
+    NavLocation *location = [[_navMachine getCurrentLocationManager] currentLocation];
+    NSArray *destinations = location ? [_topoMap getDestinationsSortedByDistanceFromCurrentLocation:location] : nil;
+    [_allToLocationName removeAllObjects];
+    [_allToLocationTitle removeAllObjects];
+    BOOL isMeter = [[NSUserDefaults standardUserDefaults] boolForKey:@"meter_preference"];
+    NSString *format = NSLocalizedString(isMeter ? @"destinationMeterETAFormat" : @"destinationFeetETAFormat", @"Format string for a destination with its distance and minutes to walk");
+    for (NSDictionary *destination in destinations) {
+        double distance = [destination[@"distance"] doubleValue];
+        int minutes = MAX(1, (int)round([destination[@"eta"] doubleValue] / 60));
+        [_allToLocationName addObject:destination[@"name"]];
+        [_allToLocationTitle addObject:[NSString stringWithFormat:format, destination[@"name"],
+                                        (int)round(isMeter ? [TopoMap unit2meter:distance] : [TopoMap unit2feet:distance]), minutes]];
+    }
+    for (NSString *name in [_topoMap getAllLocationNamesOnMapSorted:YES]) {
+        if (![_allToLocationName containsObject:name]) {
+            [_allToLocationName addObject:name];
+            [_allToLocationTitle addObject:name];
+        }
+    }
     
+    NSUInteger row = _toNodeName ? [_allToLocationName indexOfObject:_toNodeName] : NSNotFound;
+    if (row == NSNotFound) {
+        row = 0;
+        _toNodeName = [_allToLocationName count] > 0 ? [_allToLocationName objectAtIndex:0] : nil;
+    }
+    [_toPicker reloadAllComponents];
+    if ([_allToLocationName count] > 0) {
+        [_toPicker selectRow:row inComponent:0 animated:false];
+    }
 }
 
 // new topo map loaded